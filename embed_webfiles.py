@@ -3,6 +3,7 @@
 
 from __future__ import annotations
 
+import gzip
 import hashlib
 from pathlib import Path
 import re
@@ -23,6 +24,44 @@ CONTENT_TYPES = {
 }
 
 
+# Also served under a content-hashed name (LOGO.<md5>.png) with immutable caching.
+HASHED_SUFFIXES = {".png", ".jpg", ".jpeg", ".svg", ".ico"}
+# Rewritten to content-hashed names inside these files so the assets they reference can be cached forever.
+REFERENCING_SUFFIXES = {".html", ".css", ".js"}
+# A gzip variant is only embedded when it saves at least this fraction of the raw size.
+MIN_GZIP_SAVING = 0.1
+
+
+# Must match pathHash() in src/path_hash.h.
+PATH_HASH_OFFSET = 2166136261
+PATH_HASH_PRIME = 16777619
+
+
+def path_hash(path: str, seed: int) -> int:
+    value = PATH_HASH_OFFSET ^ seed
+    for byte in path.encode("utf-8"):
+        value = ((value ^ byte) * PATH_HASH_PRIME) & 0xFFFFFFFF
+    return value
+
+
+def perfect_hash_layout(paths: list[str]) -> tuple[int, int, list[int]]:
+    """Find a seed under which every path gets its own slot; returns (seed, slot_bits, slots)."""
+    slot_bits = 3
+    while (1 << slot_bits) < 2 * len(paths):
+        slot_bits += 1
+    mask = (1 << slot_bits) - 1
+    for seed in range(1_000_000):
+        slots = [-1] * (1 << slot_bits)
+        for index, path in enumerate(paths):
+            slot = path_hash(path, seed) & mask
+            if slots[slot] != -1:
+                break
+            slots[slot] = index
+        else:
+            return seed, slot_bits, slots
+    raise RuntimeError("no collision-free seed for embedded paths")
+
+
 def content_type(path: Path) -> str:
     return CONTENT_TYPES.get(path.suffix.lower(), "application/octet-stream")
 
@@ -43,11 +82,42 @@ def bytes_to_cpp_array(data: bytes) -> str:
     return ",\n".join(lines)
 
 
-def generate_single_header(source_file: Path, source_root: Path, out_dir: Path) -> dict:
+def hashed_path(rel: str, md5sum: str) -> str:
+    stem, dot, suffix = rel.rpartition(".")
+    if not dot:
+        return f"{rel}.{md5sum}"
+    return f"{stem}.{md5sum}.{suffix}"
+
+
+def rewrite_references(data: bytes, renames: dict[str, str]) -> bytes:
+    text = data.decode("utf-8")
+    for rel, hashed in renames.items():
+        for prefix in ("/", ""):
+            for quote in ('"', "'"):
+                text = text.replace(f"{quote}{prefix}{rel}{quote}", f"{quote}/{hashed}{quote}")
+    return text.encode("utf-8")
+
+
+def gzip_variant(data: bytes) -> bytes:
+    # mtime=0 keeps the output, and so the firmware image, reproducible.
+    packed = gzip.compress(data, compresslevel=9, mtime=0)
+    if len(packed) > len(data) * (1.0 - MIN_GZIP_SAVING):
+        return b""
+    return packed
+
+
+def generate_single_header(
+    source_file: Path, source_root: Path, out_dir: Path, renames: dict[str, str]
+) -> dict:
     rel = source_file.relative_to(source_root).as_posix()
     symbol = sanitize_symbol(rel)
     data = source_file.read_bytes()
-    md5sum = hashlib.md5(data).hexdigest()[:8]
+    if source_file.suffix.lower() in REFERENCING_SUFFIXES:
+        data = rewrite_references(data, renames)
+    md5_full = hashlib.md5(data).hexdigest()
+    md5sum = md5_full[:8]
+    packed = gzip_variant(data)
+    packed_array = bytes_to_cpp_array(packed) if packed else "    0x00"
 
     header = f"""// Auto-generated from {rel}
 #pragma once
@@ -58,20 +128,34 @@ const uint8_t embedded_{symbol}_data[] PROGMEM = {{
 {bytes_to_cpp_array(data)}
 }};
 
+const uint8_t embedded_{symbol}_gzip_data[] PROGMEM = {{
+{packed_array}
+}};
+
 constexpr size_t embedded_{symbol}_size = {len(data)};
+constexpr size_t embedded_{symbol}_gzip_size = {len(packed)};
 constexpr const char *embedded_{symbol}_path = "/{rel}";
 constexpr const char *embedded_{symbol}_content_type = "{content_type(source_file)}";
 constexpr const char *embedded_{symbol}_checksum = "{md5sum}";
+constexpr const char *embedded_{symbol}_etag = "\\"{md5_full}\\"";
+constexpr const char *embedded_{symbol}_gzip_etag = "\\"{md5_full}-gz\\"";
 """
 
     target = out_dir / f"embedded_{symbol}.h"
     target.write_text(header, encoding="utf-8")
 
-    return {
+    entry = {
         "symbol": symbol,
         "path": f"/{rel}",
         "content_type": content_type(source_file),
+        "immutable": False,
+        "raw_size": len(data),
+        "gzip_size": len(packed),
     }
+    entries = [entry]
+    if rel in renames:
+        entries.append({**entry, "path": f"/{renames[rel]}", "immutable": True})
+    return entries
 
 
 def generate_registry(files: list[dict], out_dir: Path) -> None:
@@ -89,10 +173,17 @@ struct EmbeddedFile {{
     const char *content_type;
     const uint8_t *data;
     size_t size;
+    const uint8_t *gzip_data;
+    size_t gzip_size;  // 0 when gzip would not save enough to be worth embedding
+    const char *etag;
+    const char *gzip_etag;
+    bool immutable;  // path carries the content hash
 }};
 
 extern const EmbeddedFile embedded_files[];
 extern const size_t embedded_files_count;
+// O(1) and allocation-free: a perfect hash over the embedded paths, then one length + memcmp check.
+const EmbeddedFile *findEmbeddedFile(const char *path, size_t length);
 const EmbeddedFile *findEmbeddedFile(const char *path);
 """
 
@@ -101,32 +192,52 @@ const EmbeddedFile *findEmbeddedFile(const char *path);
         f' "{f["path"]}",'
         f' "{f["content_type"]}",'
         f" embedded_{f['symbol']}_data,"
-        f" embedded_{f['symbol']}_size"
+        f" embedded_{f['symbol']}_size,"
+        f" embedded_{f['symbol']}_gzip_data,"
+        f" embedded_{f['symbol']}_gzip_size,"
+        f" embedded_{f['symbol']}_etag,"
+        f" embedded_{f['symbol']}_gzip_etag,"
+        f" {'true' if f['immutable'] else 'false'}"
         " },"
         for f in files
     )
 
+    seed, slot_bits, slots = perfect_hash_layout([f["path"] for f in files])
+    slot_rows = ", ".join(str(slot) for slot in slots)
+    key_rows = ", ".join(f'"{f["path"]}"' for f in files)
+    length_rows = ", ".join(str(len(f["path"].encode("utf-8"))) for f in files)
+
     registry_cpp = f"""// Auto-generated embedded file registry implementation
 #include "embedded_files_registry.h"
 
 #include <cstring>
 
+#include "../path_hash.h"
+
 const EmbeddedFile embedded_files[] = {{
 {rows}
 }};
 
 const size_t embedded_files_count = sizeof(embedded_files) / sizeof(embedded_files[0]);
 
+namespace {{
+
+constexpr uint32_t EMBEDDED_PATH_SEED = {seed}UL;
+constexpr uint8_t EMBEDDED_PATH_SLOT_BITS = {slot_bits};
+const int16_t EMBEDDED_PATH_SLOTS[] = {{{slot_rows}}};
+const char *const EMBEDDED_PATH_KEYS[] = {{{key_rows}}};
+const uint8_t EMBEDDED_PATH_LENGTHS[] = {{{length_rows}}};
+
+}}  // namespace
+
+const EmbeddedFile *findEmbeddedFile(const char *path, size_t length) {{
+    const int index = HeatControl::findPerfectPath(EMBEDDED_PATH_SLOTS, EMBEDDED_PATH_SLOT_BITS, EMBEDDED_PATH_SEED,
+                                                   EMBEDDED_PATH_KEYS, EMBEDDED_PATH_LENGTHS, path, length);
+    return index < 0 ? nullptr : &embedded_files[index];
+}}
+
 const EmbeddedFile *findEmbeddedFile(const char *path) {{
-    if (path == nullptr) {{
-        return nullptr;
-    }}
-    for (size_t i = 0; i < embedded_files_count; ++i) {{
-        if (std::strcmp(embedded_files[i].path, path) == 0) {{
-            return &embedded_files[i];
-        }}
-    }}
-    return nullptr;
+    return path == nullptr ? nullptr : findEmbeddedFile(path, std::strlen(path));
 }}
 """
 
@@ -153,21 +264,33 @@ def main() -> int:
     clean_old_generated(out_dir)
     generated = []
 
-    for source_file in sorted(source_root.rglob("*")):
-        if not source_file.is_file():
-            continue
+    sources = [
+        f
+        for f in sorted(source_root.rglob("*"))
+        if f.is_file() and not f.name.startswith(".") and f.suffix.lower() not in {".md", ".bin"}
+    ]
+    renames = {
+        f.relative_to(source_root).as_posix(): hashed_path(
+            f.relative_to(source_root).as_posix(), hashlib.md5(f.read_bytes()).hexdigest()[:8]
+        )
+        for f in sources
+        if f.suffix.lower() in HASHED_SUFFIXES
+    }
+
+    for source_file in sources:
         rel = source_file.relative_to(source_root).as_posix()
-        if source_file.name.startswith(".") or source_file.suffix.lower() in {".md", ".bin"}:
-            continue
-        generated.append(generate_single_header(source_file, source_root, out_dir))
-        print(f"[embed] {rel}")
+        entries = generate_single_header(source_file, source_root, out_dir, renames)
+        generated.extend(entries)
+        entry = entries[0]
+        gzip_note = f"gzip {entry['gzip_size']} B" if entry["gzip_size"] else "raw only"
+        print(f"[embed] {rel} ({entry['raw_size']} B, {gzip_note})")
 
     if not generated:
         print("[embed] No files found in upload/")
         return 1
 
     generate_registry(generated, out_dir)
-    print(f"[embed] Generated {len(generated)} embedded file(s)")
+    print(f"[embed] Generated {len(sources)} embedded file(s), {len(generated)} route(s)")
     return 0
 
 
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+
+namespace HeatControl {
+namespace logic {
+
+constexpr uint8_t ADC_FILTER_MAX_OVERSAMPLE = 64;
+constexpr uint8_t ADC_FILTER_MAX_MEDIAN = 7;
+constexpr uint8_t ADC_FILTER_MAX_IIR_SHIFT = 8;
+
+struct AdcFilterConfig {
+  uint8_t oversample;    // raw samples averaged into one filter step, 1..ADC_FILTER_MAX_OVERSAMPLE
+  uint8_t medianWindow;  // odd window over the averaged steps, 1 (off)..ADC_FILTER_MAX_MEDIAN
+  uint8_t iirShift;      // first-order low pass y += (x - y) / 2^shift, 0 (off)..ADC_FILTER_MAX_IIR_SHIFT
+};
+
+// Integer filter chain for one ADC channel: block average (oversampling), then a short median to
+// drop switching spikes, then an IIR low pass. Sample units are up to the caller (raw counts or
+// millivolts); only the averaged steps reach the median and IIR stages, so the per-sample cost is
+// one add and compare. Not thread-safe; one instance per channel.
+class AdcFilter {
+ public:
+  explicit AdcFilter(const AdcFilterConfig &config)
+      : oversample_(clampRange(config.oversample, 1, ADC_FILTER_MAX_OVERSAMPLE)),
+        medianWindow_(clampRange(static_cast<uint8_t>(config.medianWindow | 1U), 1, ADC_FILTER_MAX_MEDIAN)),
+        iirShift_(clampRange(config.iirShift, 0, ADC_FILTER_MAX_IIR_SHIFT)) {
+    reset();
+  }
+
+  void reset() {
+    sum_ = 0;
+    count_ = 0;
+    historyLength_ = 0;
+    historyNext_ = 0;
+    state_ = 0;
+    output_ = 0;
+    steps_ = 0;
+  }
+
+  // Feeds one sample; true when it completed an oversampling block and output() moved on.
+  bool push(uint16_t sample) {
+    sum_ += sample;
+    if (++count_ < oversample_) {
+      return false;
+    }
+    const uint16_t average = static_cast<uint16_t>((sum_ + oversample_ / 2U) / oversample_);
+    sum_ = 0;
+    count_ = 0;
+    step(median(average));
+    return true;
+  }
+
+  uint16_t output() const { return output_; }
+  // Completed filter steps since construction or reset(); 0 means output() holds no value yet.
+  uint32_t steps() const { return steps_; }
+  AdcFilterConfig config() const { return AdcFilterConfig{oversample_, medianWindow_, iirShift_}; }
+
+ private:
+  // The IIR state keeps this many fraction bits so small steps are not lost to truncation.
+  static constexpr uint8_t STATE_FRACTION_BITS = 8;
+
+  static uint8_t clampRange(uint8_t value, uint8_t low, uint8_t high) {
+    return value < low ? low : (value > high ? high : value);
+  }
+
+  uint16_t median(uint16_t value) {
+    history_[historyNext_] = value;
+    historyNext_ = static_cast<uint8_t>((historyNext_ + 1U) % medianWindow_);
+    if (historyLength_ < medianWindow_) {
+      ++historyLength_;
+    }
+    if (historyLength_ == 1U) {
+      return value;
+    }
+    // Insertion sort of at most ADC_FILTER_MAX_MEDIAN values beats any selection trick here.
+    uint16_t sorted[ADC_FILTER_MAX_MEDIAN];
+    for (uint8_t i = 0; i < historyLength_; ++i) {
+      uint16_t v = history_[i];
+      uint8_t j = i;
+      for (; j > 0U && sorted[j - 1U] > v; --j) {
+        sorted[j] = sorted[j - 1U];
+      }
+      sorted[j] = v;
+    }
+    return sorted[historyLength_ / 2U];
+  }
+
+  void step(uint16_t value) {
+    const int32_t scaled = static_cast<int32_t>(value) << STATE_FRACTION_BITS;
+    if (steps_ == 0U) {
+      state_ = scaled;
+    } else {
+      // Arithmetic shift of a negative difference rounds towards -inf; fine for a low pass.
+      state_ += (scaled - state_) >> iirShift_;
+    }
+    output_ = static_cast<uint16_t>((state_ + (1 << (STATE_FRACTION_BITS - 1))) >> STATE_FRACTION_BITS);
+    ++steps_;
+  }
+
+  uint8_t oversample_;
+  uint8_t medianWindow_;
+  uint8_t iirShift_;
+  uint8_t count_ = 0;
+  uint32_t sum_ = 0;
+  uint16_t history_[ADC_FILTER_MAX_MEDIAN] = {};
+  uint8_t historyLength_ = 0;
+  uint8_t historyNext_ = 0;
+  int32_t state_ = 0;
+  uint16_t output_ = 0;
+  uint32_t steps_ = 0;
+};
+
+}  // namespace logic
+}  // namespace HeatControl
@@ -0,0 +1,207 @@
+#include "adc_input.h"
+
+#include <Arduino.h>
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <cstring>
+
+#include "adc_filter.h"
+#include "app_state.h"
+#include "control.h"
+#include "pack_resistance.h"
+#include "state_snapshot.h"
+
+namespace HeatControl {
+
+namespace {
+
+constexpr int kChannelPins[ADC_CHANNEL_COUNT] = {ADC_PIN_1, ADC_PIN_2, ADC_PIN_NTC_MOSFET_1, ADC_PIN_NTC_MOSFET_2};
+// ADC1 on the C3 has channels 0..4 (GPIO0..GPIO4).
+constexpr int kAdc1ChannelCount = 5;
+// 2 kHz per channel; oversampling by 16 leaves 125 filter steps per channel and second.
+constexpr uint32_t kSampleRateHz = 8000;
+constexpr uint32_t kResultBytes = sizeof(adc_digi_output_data_t);
+constexpr uint32_t kFrameResults = 64;  // 8 ms of conversions per DMA frame
+constexpr uint32_t kFrameBytes = kFrameResults * kResultBytes;
+constexpr uint32_t kStoreBytes = 4 * kFrameBytes;
+constexpr uint32_t kReadTimeoutMs = 100;
+constexpr uint32_t kStackBytes = 3072;
+// Below the control task, above AsyncTCP: a late read only costs DMA overruns, never control ticks.
+constexpr unsigned kPriority = CONTROL_TASK_PRIORITY - 1;
+// Battery: drop SSR switching spikes but stay fast enough for the 50 ms manual OFF/ON detector.
+constexpr logic::AdcFilterConfig kBatteryFilter = {16, 5, 1};
+// NTC: the MOSFET heats over seconds, so smooth harder (~130 ms time constant).
+constexpr logic::AdcFilterConfig kNtcFilter = {16, 5, 4};
+
+logic::AdcFilter filters[ADC_CHANNEL_COUNT] = {
+    logic::AdcFilter(kBatteryFilter),
+    logic::AdcFilter(kBatteryFilter),
+    logic::AdcFilter(kNtcFilter),
+    logic::AdcFilter(kNtcFilter),
+};
+// Battery slots 0/1 share their index with the heater on that pack.
+logic::PackResistanceEstimator packEstimators[ADC_PACK_COUNT];
+int8_t slotByAdcChannel[kAdc1ChannelCount] = {-1, -1, -1, -1, -1};
+esp_adc_cal_characteristics_t calibration;
+logic::SnapshotBuffer<AdcReadings> readingsBuffer;
+AdcReadings working;  // owned by the acquisition task
+bool continuousMode = false;
+TaskHandle_t acquisitionTask = nullptr;
+
+// Filters run on raw counts; only the filtered value goes through the (non-linear) calibration.
+bool feed(size_t slot, uint16_t raw, uint32_t nowMs) {
+  ++working.samples;
+  if (!filters[slot].push(raw)) {
+    return false;
+  }
+  AdcChannelReading &reading = working.channels[slot];
+  reading.milliVolts = static_cast<uint16_t>(esp_adc_cal_raw_to_voltage(filters[slot].output(), &calibration));
+  reading.updatedMs = nowMs;
+  reading.steps = filters[slot].steps();
+  if (slot < ADC_PACK_COUNT) {
+    // The SSR state when the step completed; the estimator's settle window absorbs the up to one
+    // frame between a switching edge and the step that first sees it.
+    logic::PackResistanceEstimator &estimator = packEstimators[slot];
+    estimator.push(reading.milliVolts, heaterOutputOn(static_cast<uint8_t>(slot)));
+    AdcPackReading &pack = working.packs[slot];
+    pack.restMilliVolts = estimator.restMilliVolts();
+    pack.sagPpm = estimator.sagPpm();
+    pack.edges = estimator.edges();
+    pack.valid = estimator.valid();
+  }
+  return true;
+}
+
+bool readContinuousFrame(uint8_t *frame) {
+  uint32_t length = 0;
+  const esp_err_t err = adc_digi_read_bytes(frame, kFrameBytes, &length, kReadTimeoutMs);
+  if (err == ESP_ERR_INVALID_STATE) {
+    // The driver's buffer filled up and dropped conversions; what it returned is still valid.
+    ++working.overruns;
+  } else if (err != ESP_OK) {
+    return false;
+  }
+
+  const uint32_t now = millis();
+  bool stepped = false;
+  for (uint32_t offset = 0; offset + kResultBytes <= length; offset += kResultBytes) {
+    adc_digi_output_data_t result;
+    std::memcpy(&result, frame + offset, kResultBytes);
+    if (result.type2.unit != 0U || result.type2.channel >= kAdc1ChannelCount) {
+      continue;
+    }
+    const int8_t slot = slotByAdcChannel[result.type2.channel];
+    if (slot >= 0) {
+      stepped |= feed(static_cast<size_t>(slot), static_cast<uint16_t>(result.type2.data), now);
+    }
+  }
+  return stepped;
+}
+
+bool readPolledSamples() {
+  const uint32_t now = millis();
+  bool stepped = false;
+  for (size_t slot = 0; slot < ADC_CHANNEL_COUNT; ++slot) {
+    stepped |= feed(slot, analogRead(kChannelPins[slot]), now);
+  }
+  return stepped;
+}
+
+void acquisitionTaskMain(void *) {
+  static uint8_t frame[kFrameBytes];
+  for (;;) {
+    bool stepped = false;
+    if (continuousMode) {
+      stepped = readContinuousFrame(frame);
+    } else {
+      stepped = readPolledSamples();
+      vTaskDelay(1);
+    }
+    if (stepped) {
+      readingsBuffer.publish(working);
+    }
+  }
+}
+
+bool startContinuous() {
+  adc_digi_pattern_config_t pattern[ADC_CHANNEL_COUNT];
+  uint32_t channelMask = 0;
+  for (size_t slot = 0; slot < ADC_CHANNEL_COUNT; ++slot) {
+    const int8_t channel = digitalPinToAnalogChannel(kChannelPins[slot]);
+    if (channel < 0 || channel >= kAdc1ChannelCount) {
+      return false;
+    }
+    slotByAdcChannel[channel] = static_cast<int8_t>(slot);
+    channelMask |= 1UL << channel;
+    pattern[slot].atten = ADC_ATTEN_DB_11;
+    pattern[slot].channel = static_cast<uint8_t>(channel);
+    pattern[slot].unit = 0;  // ADC1
+    pattern[slot].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  }
+
+  adc_digi_init_config_t init = {};
+  init.max_store_buf_size = kStoreBytes;
+  init.conv_num_each_intr = kFrameBytes;
+  init.adc1_chan_mask = channelMask;
+  init.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&init) != ESP_OK) {
+    return false;
+  }
+
+  adc_digi_configuration_t config = {};
+  config.conv_limit_en = false;
+  config.conv_limit_num = 250;
+  config.pattern_num = ADC_CHANNEL_COUNT;
+  config.adc_pattern = pattern;
+  config.sample_freq_hz = kSampleRateHz;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+  if (adc_digi_controller_configure(&config) != ESP_OK || adc_digi_start() != ESP_OK) {
+    adc_digi_deinitialize();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool startAdcAcquisition() {
+  if (acquisitionTask != nullptr) {
+    return true;
+  }
+  esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, &calibration);
+  continuousMode = startContinuous();
+  working.continuous = continuousMode;
+  if (xTaskCreate(&acquisitionTaskMain, "adc", kStackBytes, nullptr, kPriority, &acquisitionTask) != pdPASS) {
+    acquisitionTask = nullptr;
+    if (continuousMode) {
+      adc_digi_stop();
+      adc_digi_deinitialize();
+    }
+    logf(LogLevel::Error, "ADC acquisition task start failed");
+    return false;
+  }
+  if (continuousMode) {
+    logf("ADC acquisition: continuous | sample_rate_hz=%lu | channels=%u", static_cast<unsigned long>(kSampleRateHz),
+         static_cast<unsigned>(ADC_CHANNEL_COUNT));
+  } else {
+    logf(LogLevel::Error, "ADC acquisition: continuous mode unavailable, polling one-shot reads");
+  }
+  logf("ADC filters: battery x%u/median %u/iir 1/%u | ntc x%u/median %u/iir 1/%u", kBatteryFilter.oversample,
+       kBatteryFilter.medianWindow, 1U << kBatteryFilter.iirShift, kNtcFilter.oversample, kNtcFilter.medianWindow,
+       1U << kNtcFilter.iirShift);
+  return true;
+}
+
+uint32_t readAdcReadings(AdcReadings &readings) {
+  return readingsBuffer.read(readings);
+}
+
+bool adcReadingFresh(const AdcChannelReading &reading, uint32_t nowMs, uint32_t maxAgeMs) {
+  // A reading published after the caller sampled nowMs has a negative age and counts as fresh.
+  return reading.steps > 0U && static_cast<int32_t>(nowMs - reading.updatedMs) <= static_cast<int32_t>(maxAgeMs);
+}
+
+}  // namespace HeatControl
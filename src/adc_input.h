@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace HeatControl {
+
+enum class AdcChannel : uint8_t {
+  Battery1 = 0,
+  Battery2 = 1,
+  NtcMosfet1 = 2,
+  NtcMosfet2 = 3,
+};
+constexpr size_t ADC_CHANNEL_COUNT = 4;
+
+struct AdcChannelReading {
+  uint16_t milliVolts = 0;  // filtered
+  uint32_t updatedMs = 0;   // millis() of the filter step behind milliVolts
+  uint32_t steps = 0;       // filter steps so far; 0 means no value yet
+};
+
+// Battery channels only: load sag measured on the heater switching edges (logic::PackResistanceEstimator).
+struct AdcPackReading {
+  uint16_t restMilliVolts = 0;  // divider voltage with the heater's load sag added back
+  uint32_t sagPpm = 0;          // (V_unloaded - V_loaded) / V_loaded
+  uint32_t edges = 0;           // heater edges that yielded an unloaded/loaded pair
+  bool valid = false;
+};
+constexpr size_t ADC_PACK_COUNT = 2;
+
+struct AdcReadings {
+  AdcChannelReading channels[ADC_CHANNEL_COUNT];
+  AdcPackReading packs[ADC_PACK_COUNT];  // indexed like the heaters: pack 0 feeds heater 1
+  uint32_t samples = 0;     // raw conversions consumed, all channels
+  uint32_t overruns = 0;    // DMA reads that reported lost conversions
+  bool continuous = false;  // false: polled one-shot fallback
+
+  const AdcChannelReading &channel(AdcChannel id) const { return channels[static_cast<size_t>(id)]; }
+};
+
+// Samples both battery dividers and both MOSFET NTCs on a background task: continuous (DMA) mode
+// when the driver accepts the pattern, polled one-shot reads otherwise. Every channel runs through
+// a logic::AdcFilter (oversampling, median, IIR) and the results are published as one snapshot.
+// Each battery step is tagged with its heater's SSR state, so the sag across every switching edge
+// yields the pack's source resistance and a loaded reading can be corrected back to rest.
+// Call once in setup() after the pin attenuation is set; the one-shot API must not be used after.
+bool startAdcAcquisition();
+// Copies the latest readings without blocking the acquisition task; returns the snapshot version.
+uint32_t readAdcReadings(AdcReadings &readings);
+// True when `reading` holds a filtered value that is at most `maxAgeMs` old.
+bool adcReadingFresh(const AdcChannelReading &reading, uint32_t nowMs, uint32_t maxAgeMs);
+
+}  // namespace HeatControl
@@ -5,12 +5,13 @@ namespace HeatControl {
 
 unsigned long lastPrintMs = 0;
 unsigned long lastSensorMs = 0;
-unsigned long lastRuntimeSaveMs = 0;
 unsigned long lastMemCheckMs = 0;
 unsigned long startTimeMs = 0;
 
 uint32_t counter = 0;
 uint32_t savedRuntimeMinutes = 0;
+uint32_t heater1EnergyMilliWh = 0;
+uint32_t heater2EnergyMilliWh = 0;
 
 bool lastHeater1State = false;
 bool lastHeater2State = false;
@@ -18,10 +19,6 @@ bool lastSignalPinState = false;
 bool lastInputPinState = false;
 bool manualHeater1Enabled = true;
 bool manualHeater2Enabled = true;
-bool battery1Off = false;
-bool battery2Off = false;
-unsigned long battery1OffSinceMs = 0;
-unsigned long battery2OffSinceMs = 0;
 
 bool powerMode = false;
 bool manualMode = false;
@@ -50,6 +47,10 @@ float battery1SocSmoothed = 0.0F;
 float battery2SocSmoothed = 0.0F;
 bool battery1SocSmoothingInitialized = false;
 bool battery2SocSmoothingInitialized = false;
+uint32_t battery1SagPpm = 0;
+uint32_t battery2SagPpm = 0;
+bool battery1SagValid = false;
+bool battery2SagValid = false;
 uint16_t ntcMosfet1MilliVolts = 0;
 uint16_t ntcMosfet2MilliVolts = 0;
 float ntcMosfet1TempC = NAN;
@@ -75,17 +76,21 @@ String activeSsid = "HeatControl";
 String activePassword = "HeatControl";
 String activeApSsid = "HeatControl";
 String activeApPassword = "HeatControl";
-char serialLogBuffer[12001] = {0};
-size_t serialLogLength = 0;
+namespace {
+char serialLogStorage[12000];
+}  // namespace
+logic_helpers::LogRing serialLog(serialLogStorage, sizeof(serialLogStorage));
 AsyncWebServer server(80);
 DNSServer dnsServer;
 
 bool restartScheduled = false;
 unsigned long restartAtMs = 0;
 LogLevel currentLogLevel = LogLevel::Info;
-bool pendingTempPersist = false;
-unsigned long pendingTempPersistAtMs = 0;
 
 SignalTimingPreset signalTimingPreset = SignalTimingPreset::Middle;
+logic::ControlMode controlMode = logic::ControlMode::BangBang;
+logic::PidGains pidGains = logic::DEFAULT_PID_GAINS;
+logic::ManualPowerMode manualPowerMode = logic::ManualPowerMode::Duty;
+float heaterElementOhm = HEATER_ELEMENT_OHM_DEFAULT;
 
 }  // namespace HeatControl
@@ -6,8 +6,14 @@
 #include <ESPAsyncWebServer.h>
 #include <OneWire.h>
 
+#include "control_logic.h"
+#include "logic_helpers.h"
+#include "signal_sequencer.h"
+
 namespace HeatControl {
 
+// Byte layout of the emulated EEPROM used by older firmware; storage.cpp reads it once to migrate
+// the values into the settings store.
 constexpr int EEPROM_SIZE = 512;
 constexpr int EEPROM_INIT_ADDR = 0;
 constexpr int EEPROM_SSID_ADDR = 1;
@@ -30,6 +36,12 @@ constexpr int EEPROM_BATTERY1_CHEM_ADDR = 334;
 constexpr int EEPROM_BATTERY2_CHEM_ADDR = 335;
 constexpr int EEPROM_LOG_LEVEL_ADDR = 336;
 constexpr int EEPROM_SIGNAL_TIMING_PRESET_ADDR = 337;
+constexpr int EEPROM_SENSOR_ROM1_ADDR = 340;
+constexpr int EEPROM_SENSOR_ROM2_ADDR = 348;
+constexpr int EEPROM_CONTROL_MODE_ADDR = 356;
+constexpr int EEPROM_PID_KP_ADDR = 360;
+constexpr int EEPROM_PID_KI_ADDR = 364;
+constexpr int EEPROM_PID_KD_ADDR = 368;
 constexpr int EEPROM_TEMP1_ADDR = 64;
 constexpr int EEPROM_TEMP2_ADDR = 68;
 constexpr int EEPROM_SWAP_ADDR = 72;
@@ -92,38 +104,28 @@ constexpr float DEFAULT_TARGET_TEMP = 23.0F;
 constexpr float BATTERY_DIVIDER_RATIO = 4.0F;  // Adjust to your resistor divider (V_batt = V_adc * ratio).
 constexpr float MOSFET_OVERTEMP_LIMIT_C = 80.0F;
 constexpr float MOSFET_OVERTEMP_RESET_C = 75.0F;  // Hysteresis for re-enable after cooldown.
-
-enum class SignalTimingPreset : uint8_t {
-  Short = 0,
-  Middle = 1,
-  Fast = 2,
-};
-
-inline SignalTimingPreset clampSignalTimingPreset(uint8_t value) {
-  return (value <= static_cast<uint8_t>(SignalTimingPreset::Fast)) ? static_cast<SignalTimingPreset>(value)
-                                                                   : SignalTimingPreset::Middle;
-}
-
-inline unsigned long scaleSignalMs(unsigned long baseMs, SignalTimingPreset preset) {
-  switch (preset) {
-    case SignalTimingPreset::Short:
-      return (baseMs * 3UL) / 4UL;
-    case SignalTimingPreset::Fast:
-      return baseMs / 2UL;
-    case SignalTimingPreset::Middle:
-    default:
-      return baseMs;
-  }
-}
+constexpr uint32_t SLOW_PWM_PERIOD_MS = 1000;  // SSR time-proportioning window.
+constexpr uint16_t SLOW_PWM_STEPS = 100;       // Duty resolution per window (10 ms per step).
+constexpr uint32_t CONTROL_TASK_PERIOD_MS = 100;
+constexpr uint32_t CONTROL_TASK_STACK_BYTES = 4096;
+// Above the AsyncTCP worker (CONFIG_ASYNC_TCP_PRIORITY, 10 by default) and the Arduino loop task (1).
+#ifdef CONFIG_ASYNC_TCP_PRIORITY
+constexpr unsigned CONTROL_TASK_PRIORITY = CONFIG_ASYNC_TCP_PRIORITY + 2;
+#else
+constexpr unsigned CONTROL_TASK_PRIORITY = 12;
+#endif
 
 extern unsigned long lastPrintMs;
 extern unsigned long lastSensorMs;
-extern unsigned long lastRuntimeSaveMs;
 extern unsigned long lastMemCheckMs;
 extern unsigned long startTimeMs;
 
 extern uint32_t counter;
 extern uint32_t savedRuntimeMinutes;
+// Heater energy per channel since the last runtime reset, as last handed to the settings store
+// (the control task's EnergyMeter holds the live totals).
+extern uint32_t heater1EnergyMilliWh;
+extern uint32_t heater2EnergyMilliWh;
 
 extern bool lastHeater1State;
 extern bool lastHeater2State;
@@ -132,10 +134,6 @@ extern bool lastInputPinState;
 
 extern bool manualHeater1Enabled;
 extern bool manualHeater2Enabled;
-extern bool battery1Off;
-extern bool battery2Off;
-extern unsigned long battery1OffSinceMs;
-extern unsigned long battery2OffSinceMs;
 
 extern bool powerMode;
 extern bool manualMode;
@@ -164,6 +162,11 @@ extern float battery1SocSmoothed;
 extern float battery2SocSmoothed;
 extern bool battery1SocSmoothingInitialized;
 extern bool battery2SocSmoothingInitialized;
+// Load sag on heater edges from the ADC task (AdcPackReading), copied with the battery state.
+extern uint32_t battery1SagPpm;
+extern uint32_t battery2SagPpm;
+extern bool battery1SagValid;
+extern bool battery2SagValid;
 extern uint16_t ntcMosfet1MilliVolts;
 extern uint16_t ntcMosfet2MilliVolts;
 extern float ntcMosfet1TempC;
@@ -189,8 +192,7 @@ extern String activeSsid;
 extern String activePassword;
 extern String activeApSsid;
 extern String activeApPassword;
-extern char serialLogBuffer[12001];
-extern size_t serialLogLength;
+extern logic_helpers::LogRing serialLog;
 extern AsyncWebServer server;
 extern DNSServer dnsServer;
 
@@ -204,10 +206,12 @@ enum class LogLevel : uint8_t {
 };
 
 extern LogLevel currentLogLevel;
-extern bool pendingTempPersist;
-extern unsigned long pendingTempPersistAtMs;
 
 extern SignalTimingPreset signalTimingPreset;
+extern logic::ControlMode controlMode;
+extern logic::PidGains pidGains;
+extern logic::ManualPowerMode manualPowerMode;
+extern float heaterElementOhm;
 
 const char *logLevelToText(LogLevel level);
 LogLevel parseLogLevel(const String &value, bool *ok = nullptr);
@@ -218,5 +222,8 @@ void logLine(const char *line, LogLevel level = LogLevel::Info);
 void logLine(const String &line, LogLevel level = LogLevel::Info);
 void logf(LogLevel level, const char *fmt, ...);
 void logf(const char *fmt, ...);
+// Serialises access to serialLog between the logging tasks and its readers.
+void lockLogBuffer();
+void unlockLogBuffer();
 
 }  // namespace HeatControl
@@ -1,114 +1,330 @@
 #include "control.h"
 
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <cmath>
+
+#include "adc_input.h"
 #include "app_state.h"
+#include "control_cycle.h"
 #include "control_logic.h"
+#include "energy_meter.h"
+#include "sensor_bus.h"
+#include "signal_sequencer.h"
+#include "slow_pwm.h"
+#include "state_snapshot.h"
+#include "storage.h"
 
 namespace HeatControl {
 
 namespace {
 
-void setSignalAndLeds(bool active) {
-  digitalWrite(SIGNAL_PIN, active ? LOW : HIGH);
-  digitalWrite(BATTERY_LED_PIN_1, active ? HIGH : LOW);
-  digitalWrite(BATTERY_LED_PIN_2, active ? HIGH : LOW);
-}
+// Feedback patterns are queued from loop() and web handlers and played out by updateSignalPatterns().
+portMUX_TYPE signalMux = portMUX_INITIALIZER_UNLOCKED;
+SignalSequencer signalSequencer;
 
-void delayScaled(unsigned long baseMs) {
-  delay(scaleSignalMs(baseMs, signalTimingPreset));
+void logDroppedSignal(const char *name) {
+  logf(LogLevel::Debug, "Signal pattern dropped, queue full | pattern=%s", name);
 }
 
-class ArduinoGpio : public logic::IGpio {
+class DallasSensorBus : public logic::ISensorBus {
  public:
-  void writePin(int pin, int level) override {
-    digitalWrite(pin, level == logic::PIN_LOW ? LOW : HIGH);
+  // Non-blocking: setWaitForConversion(false) is applied in startTemperaturePipeline().
+  void startConversion() override { sensors.requestTemperatures(); }
+
+  bool readScratchpad(const logic::SensorRom &rom, uint8_t *scratchpad) override {
+    return sensors.readScratchPad(rom.bytes, scratchpad);
   }
 
-  int readPin(int pin) const override {
-    return digitalRead(pin) == LOW ? logic::PIN_LOW : logic::PIN_HIGH;
+  uint8_t search(logic::SensorRom *out, uint8_t maxCount) override {
+    uint8_t count = 0;
+    oneWire.reset_search();
+    while (count < maxCount && oneWire.search(out[count].bytes)) {
+      ++count;
+    }
+    oneWire.reset_search();
+    return count;
   }
 };
 
-class DallasSensorsAdapter : public logic::ITemperatureSensors {
- public:
-  void requestTemperatures() override { sensors.requestTemperatures(); }
+// 12-bit DS18B20 conversion time; refined from the bus resolution in startTemperaturePipeline().
+constexpr unsigned long DEFAULT_CONVERSION_MS = 750UL;
 
-  float getTempCByIndex(int index) override { return sensors.getTempCByIndex(index); }
+DallasSensorBus sensorBus;
+logic::RomAddressedSensors temperatureSensors(sensorBus);
+
+// SSR outputs are switched from a periodic esp_timer, independent of the 1 Hz sensor tick.
+logic::SlowPwmOutput heaterOutputs(SSR_PIN_1, SSR_PIN_2, SLOW_PWM_PERIOD_MS, SLOW_PWM_STEPS);
+esp_timer_handle_t heaterOutputTimer = nullptr;
+
+// Pipeline, PID, overtemp guards, energy meter and runtime predictors; owned by the control task.
+logic::HeaterControlCycle controlCycle(DEFAULT_CONVERSION_MS, MOSFET_OVERTEMP_LIMIT_C, MOSFET_OVERTEMP_RESET_C);
+
+// The acquisition task publishes every 8 ms; a much older NTC reading means it stopped.
+constexpr uint32_t NTC_READING_MAX_AGE_MS = 1000;
+// Set by the control task; the settings writes happen from loop() so flash stalls never hit the control cadence.
+volatile bool overtempPersistPending1 = false;
+volatile bool overtempPersistPending2 = false;
+// Overtemp transitions for loop() to log; the control task never blocks on the log mutex.
+struct PendingOvertempLog {
+  bool tripped = false;
+  bool cleared = false;
+  float tripTempC = 0.0F;
+  float clearTempC = 0.0F;
 };
+PendingOvertempLog pendingOvertempLogs[2];  // guarded by controlSharedMux
+logic::SensorRomTable pendingSensorSlots;
+BatterySettingsChange pendingBatteryChanges[2];  // guarded by controlSharedMux
+bool runtimeResetPending = false;  // guarded by controlSharedMux
+bool sensorSlotsPersistPending = false;  // guarded by controlSharedMux together with pendingSensorSlots
+
+// Bumped by resetHeaterEnergy() under controlSharedMux; the control task zeroes the meter whenever
+// it differs from the generation it last applied and publishes that generation with the totals.
+uint32_t heaterEnergyResetRequested = 0;
+uint32_t heaterEnergyResetApplied = 0;
+// A reading this old means the acquisition task stopped; the tick then counts no energy.
+constexpr uint32_t BATTERY_READING_MAX_AGE_MS = 1000;
+
+TaskHandle_t controlTaskHandle = nullptr;
+logic::PeriodJitterTracker controlJitter(CONTROL_TASK_PERIOD_MS * 1000UL);
+uint32_t controlTick = 0;
+portMUX_TYPE controlSharedMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Writers of the input globals serialise on the mutex; the control task and /status only read snapshots.
+SemaphoreHandle_t controlInputsMutex = nullptr;
+logic::SnapshotBuffer<ControlInputs> controlInputsBuffer;
+logic::SnapshotBuffer<HousekeepingState> housekeepingBuffer;
+logic::SnapshotBuffer<ControlSnapshot> controlSnapshotBuffer;
+
+ControlInputs captureControlInputs() {
+  ControlInputs inputs;
+  inputs.powerMode = powerMode;
+  inputs.manualMode = manualMode;
+  inputs.manualPowerPercent1 = manualPowerPercent1;
+  inputs.manualPowerPercent2 = manualPowerPercent2;
+  inputs.manualHeater1Enabled = manualHeater1Enabled;
+  inputs.manualHeater2Enabled = manualHeater2Enabled;
+  inputs.swapAssignment = swapAssignment;
+  inputs.targetTemp1 = targetTemp1;
+  inputs.targetTemp2 = targetTemp2;
+  inputs.controlMode = controlMode;
+  inputs.pidGains = pidGains;
+  inputs.manualPowerMode = manualPowerMode;
+  inputs.heaterElementOhm = heaterElementOhm;
+  return inputs;
+}
+
+// Publishes the input globals as they are now, e.g. the settings loaded before the control task existed.
+void publishControlInputs() {
+  if (controlInputsMutex != nullptr) {
+    xSemaphoreTake(controlInputsMutex, portMAX_DELAY);
+  }
+  controlInputsBuffer.publish(captureControlInputs());
+  if (controlInputsMutex != nullptr) {
+    xSemaphoreGive(controlInputsMutex);
+  }
+}
+
+void onHeaterOutputTick(void *) {
+  ArduinoGpio gpio;
+  heaterOutputs.tick(gpio);
+}
 
-void signalManualPowerPattern(uint8_t manualPowerPercent, bool includeIntroPulse) {
-  const bool prevLed1 = digitalRead(BATTERY_LED_PIN_1) == HIGH;
-  const bool prevLed2 = digitalRead(BATTERY_LED_PIN_2) == HIGH;
-  if (includeIntroPulse) {
-    // Manual mode intro pulse.
-    setSignalAndLeds(true);
-    delayScaled(500);
-    setSignalAndLeds(false);
-    delayScaled(220);
+void logSensorSlots(const logic::SensorRomTable &table) {
+  for (uint8_t slot = 0; slot < logic::SENSOR_SLOT_COUNT; ++slot) {
+    const uint8_t *b = table.slots[slot].bytes;
+    logf("DS18B20 slot %u: %02X%02X%02X%02X%02X%02X%02X%02X", static_cast<unsigned>(slot + 1), b[0], b[1], b[2],
+         b[3], b[4], b[5], b[6], b[7]);
   }
+}
 
-  // Duty step feedback: 1/2/3/4 short pulses for 25/50/75/100%.
-  int stepPulses = 1;
-  if (manualPowerPercent >= 100) {
-    stepPulses = 4;
-  } else if (manualPowerPercent >= 75) {
-    stepPulses = 3;
-  } else if (manualPowerPercent >= 50) {
-    stepPulses = 2;
+// Hands a changed slot table over to loop(), which owns the settings writes.
+void captureSensorSlotsIfChanged() {
+  if (!temperatureSensors.consumeSlotsChanged()) {
+    return;
   }
-  for (int i = 0; i < stepPulses; ++i) {
-    setSignalAndLeds(true);
-    delayScaled(130);
-    setSignalAndLeds(false);
-    delayScaled(130);
+  portENTER_CRITICAL(&controlSharedMux);
+  pendingSensorSlots = temperatureSensors.slots();
+  sensorSlotsPersistPending = true;
+  portEXIT_CRITICAL(&controlSharedMux);
+}
+
+// One ADC snapshot per tick. A stalled acquisition task reads as 0 mV: an invalid NTC instead of a
+// frozen temperature, and no energy counted.
+logic::ControlMeasurements readControlMeasurements(unsigned long now) {
+  AdcReadings adc;
+  readAdcReadings(adc);
+  HousekeepingState hk;
+  housekeepingBuffer.read(hk);
+  logic::ControlMeasurements measurements;
+  const AdcChannel batteryChannels[2] = {AdcChannel::Battery1, AdcChannel::Battery2};
+  const AdcChannel ntcChannels[2] = {AdcChannel::NtcMosfet1, AdcChannel::NtcMosfet2};
+  for (uint8_t channel = 0; channel < 2; ++channel) {
+    const AdcChannelReading &battery = adc.channel(batteryChannels[channel]);
+    const uint32_t packMilliVolts = adcReadingFresh(battery, now, BATTERY_READING_MAX_AGE_MS)
+                                        ? static_cast<uint32_t>(battery.milliVolts * BATTERY_DIVIDER_RATIO + 0.5F)
+                                        : 0U;
+    measurements.packMilliVolts[channel] = static_cast<uint16_t>(packMilliVolts < 0xFFFFU ? packMilliVolts : 0xFFFFU);
+    const AdcChannelReading &ntc = adc.channel(ntcChannels[channel]);
+    measurements.ntcMilliVolts[channel] = adcReadingFresh(ntc, now, NTC_READING_MAX_AGE_MS) ? ntc.milliVolts : 0U;
   }
+  measurements.supplies[0] = {hk.battery1PackVoltage, hk.battery1CellCount, hk.battery1Chemistry};
+  measurements.supplies[1] = {hk.battery2PackVoltage, hk.battery2CellCount, hk.battery2Chemistry};
+  measurements.socCenti[0] = hk.battery1SocCenti;
+  measurements.socCenti[1] = hk.battery2SocCenti;
+  return measurements;
+}
 
-  digitalWrite(BATTERY_LED_PIN_1, prevLed1 ? HIGH : LOW);
-  digitalWrite(BATTERY_LED_PIN_2, prevLed2 ? HIGH : LOW);
+// Applies a resetHeaterEnergy() request before the tick integrates the next interval.
+void applyHeaterEnergyReset() {
+  portENTER_CRITICAL(&controlSharedMux);
+  const uint32_t resetRequested = heaterEnergyResetRequested;
+  portEXIT_CRITICAL(&controlSharedMux);
+  if (resetRequested != heaterEnergyResetApplied) {
+    heaterEnergyResetApplied = resetRequested;
+    controlCycle.resetEnergy();
+  }
 }
 
-}  // namespace
-void startupSignal(bool isPowerMode, bool isManualMode, uint8_t manualPowerPercent) {
-  if (isManualMode) {
-    signalManualPowerPattern(manualPowerPercent, true);
+// Mirrors the tick into the /status globals and queues overtemp trips/clears for loop().
+void recordControlTick(const logic::ControlMeasurements &measurements, const logic::ControlTickResult &result) {
+  currentTemp1 = controlCycle.currentTemp(0);
+  currentTemp2 = controlCycle.currentTemp(1);
+  ntcMosfet1MilliVolts = measurements.ntcMilliVolts[0];
+  ntcMosfet2MilliVolts = measurements.ntcMilliVolts[1];
+  ntcMosfet1TempC = result.ntcValid[0] ? result.ntcTempC[0] : NAN;
+  ntcMosfet2TempC = result.ntcValid[1] ? result.ntcTempC[1] : NAN;
+  mosfet1OvertempActive = controlCycle.guard(0).active();
+  mosfet2OvertempActive = controlCycle.guard(1).active();
+  captureSensorSlotsIfChanged();
+
+  const logic::OvertempEvent &event1 = result.overtemp[0];
+  const logic::OvertempEvent &event2 = result.overtemp[1];
+  if (event1.tripped) {
+    overtempPersistPending1 = true;
+  }
+  if (event2.tripped) {
+    overtempPersistPending2 = true;
+  }
+  if (!event1.tripped && !event1.cleared && !event2.tripped && !event2.cleared) {
     return;
   }
+  portENTER_CRITICAL(&controlSharedMux);
+  for (uint8_t channel = 0; channel < 2; ++channel) {
+    PendingOvertempLog &pending = pendingOvertempLogs[channel];
+    if (result.overtemp[channel].tripped) {
+      pending.tripped = true;
+      pending.tripTempC = result.ntcTempC[channel];
+    } else if (result.overtemp[channel].cleared) {
+      pending.cleared = true;
+      pending.clearTempC = result.ntcTempC[channel];
+    }
+  }
+  portEXIT_CRITICAL(&controlSharedMux);
+}
+
+void publishControlSnapshot(const ControlInputs &inputs) {
+  ControlSnapshot snapshot;
+  snapshot.tick = controlTick;
+  snapshot.inputs = inputs;
+  housekeepingBuffer.read(snapshot.housekeeping);
+  snapshot.currentTemp1 = currentTemp1;
+  snapshot.currentTemp2 = currentTemp2;
+  snapshot.ntcMosfet1MilliVolts = ntcMosfet1MilliVolts;
+  snapshot.ntcMosfet2MilliVolts = ntcMosfet2MilliVolts;
+  snapshot.ntcMosfet1TempC = ntcMosfet1TempC;
+  snapshot.ntcMosfet2TempC = ntcMosfet2TempC;
+  snapshot.mosfet1OvertempActive = mosfet1OvertempActive;
+  snapshot.mosfet2OvertempActive = mosfet2OvertempActive;
+  snapshot.heater1DutyPermille = heaterOutputs.dutyPermille(0);
+  snapshot.heater2DutyPermille = heaterOutputs.dutyPermille(1);
+  snapshot.heater1On = heaterOutputs.outputOn(0);
+  snapshot.heater2On = heaterOutputs.outputOn(1);
+  const logic::EnergyMeter &energy = controlCycle.energy();
+  snapshot.heater1EnergyMilliWh = energy.milliWattHours(0);
+  snapshot.heater2EnergyMilliWh = energy.milliWattHours(1);
+  snapshot.heaterEnergyResetGeneration = heaterEnergyResetApplied;
+  snapshot.heater1MeanMilliWatts = controlCycle.predictor(0).averageMilliWatts();
+  snapshot.heater2MeanMilliWatts = controlCycle.predictor(1).averageMilliWatts();
+  snapshot.battery1RuntimeLeftValid = controlCycle.predictor(0).valid();
+  snapshot.battery2RuntimeLeftValid = controlCycle.predictor(1).valid();
+  snapshot.battery1RuntimeLeftMinutes = controlCycle.predictor(0).minutesLeft();
+  snapshot.battery2RuntimeLeftMinutes = controlCycle.predictor(1).minutesLeft();
+  snapshot.stats.nominalPeriodUs = controlJitter.nominalUs();
+  snapshot.stats.ticks = controlJitter.samples();
+  snapshot.stats.minPeriodUs = controlJitter.minPeriodUs();
+  snapshot.stats.maxPeriodUs = controlJitter.maxPeriodUs();
+  snapshot.stats.meanAbsJitterUs = controlJitter.meanAbsJitterUs();
+  snapshot.stats.maxAbsJitterUs = controlJitter.maxAbsJitterUs();
+  snapshot.stats.overruns = controlJitter.overruns();
+  snapshot.stats.maxBusyUs = controlJitter.maxBusyUs();
+  controlSnapshotBuffer.publish(snapshot);
+}
 
-  const int pulseCount = isPowerMode ? 2 : 1;
-  const bool prevLed1 = digitalRead(BATTERY_LED_PIN_1) == HIGH;
-  const bool prevLed2 = digitalRead(BATTERY_LED_PIN_2) == HIGH;
-  for (int i = 0; i < pulseCount; ++i) {
-    setSignalAndLeds(true);
-    delayScaled(300);
-    setSignalAndLeds(false);
-    delayScaled(200);
+void controlTaskMain(void *) {
+  const TickType_t period = pdMS_TO_TICKS(CONTROL_TASK_PERIOD_MS);
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    vTaskDelayUntil(&lastWake, period);
+    const uint32_t startUs = static_cast<uint32_t>(esp_timer_get_time());
+    controlJitter.recordTickStart(startUs);
+    ++controlTick;
+
+    // One consistent set of settings per tick, however many handlers write in between.
+    ControlInputs inputs;
+    controlInputsBuffer.read(inputs);
+    const unsigned long now = millis();
+    applyHeaterEnergyReset();
+    const logic::ControlMeasurements measurements = readControlMeasurements(now);
+    const logic::ControlTickResult result =
+        controlCycle.tick(now, inputs, measurements, temperatureSensors, heaterOutputs);
+    recordControlTick(measurements, result);
+
+    controlJitter.recordBusy(static_cast<uint32_t>(esp_timer_get_time()) - startUs);
+    publishControlSnapshot(inputs);
   }
+}
 
-  digitalWrite(BATTERY_LED_PIN_1, prevLed1 ? HIGH : LOW);
-  digitalWrite(BATTERY_LED_PIN_2, prevLed2 ? HIGH : LOW);
+}  // namespace
+void startupSignal(bool isPowerMode, bool isManualMode, uint8_t manualPowerPercent) {
+  const SignalTimingPreset preset = signalTimingPreset;
+  portENTER_CRITICAL(&signalMux);
+  const bool queued = enqueueStartupSignal(signalSequencer, isPowerMode, isManualMode, manualPowerPercent, preset);
+  portEXIT_CRITICAL(&signalMux);
+  if (!queued) {
+    logDroppedSignal("startup");
+  }
 }
 
 void signalManualPowerChange(uint8_t manualPowerPercent) {
   // Short feedback pattern without the long intro pulse.
-  signalManualPowerPattern(manualPowerPercent, false);
+  const SignalTimingPreset preset = signalTimingPreset;
+  portENTER_CRITICAL(&signalMux);
+  const bool queued = enqueueManualPowerSignal(signalSequencer, manualPowerPercent, false, preset);
+  portEXIT_CRITICAL(&signalMux);
+  if (!queued) {
+    logDroppedSignal("manual_power");
+  }
 }
 
 void signalTestPulse() {
-  const bool prevLed1 = digitalRead(BATTERY_LED_PIN_1) == HIGH;
-  const bool prevLed2 = digitalRead(BATTERY_LED_PIN_2) == HIGH;
-  setSignalAndLeds(true);
-  delayScaled(120);
-  setSignalAndLeds(false);
-  digitalWrite(BATTERY_LED_PIN_1, prevLed1 ? HIGH : LOW);
-  digitalWrite(BATTERY_LED_PIN_2, prevLed2 ? HIGH : LOW);
-}
-
-bool isSensorError(float temperatureC) {
-  return logic::isSensorError(static_cast<float>(temperatureC));
+  const SignalTimingPreset preset = signalTimingPreset;
+  portENTER_CRITICAL(&signalMux);
+  const bool queued = enqueueTestPulse(signalSequencer, preset);
+  portEXIT_CRITICAL(&signalMux);
+  if (!queued) {
+    logDroppedSignal("test_pulse");
+  }
 }
 
-void controlHeater(int pin, bool forceOn, float currentTemp, float targetTemp) {
-  ArduinoGpio gpio;
-  logic::controlHeater(gpio, pin, forceOn, currentTemp, targetTemp);
+bool updateSignalPatterns(unsigned long nowMs, bool &on) {
+  portENTER_CRITICAL(&signalMux);
+  on = signalSequencer.update(nowMs);
+  const bool active = signalSequencer.active();
+  portEXIT_CRITICAL(&signalMux);
+  return active;
 }
 
 String heaterStateText(int pin) {
@@ -116,12 +332,295 @@ String heaterStateText(int pin) {
   return logic::heaterStateTextFromLevel(gpio.readPin(pin));
 }
 
-void updateSensorsAndHeaters() {
-  ArduinoGpio gpio;
-  DallasSensorsAdapter tempSensors;
-  logic::updateSensorsAndHeaters(tempSensors, gpio, powerMode, manualMode, manualPowerPercent1, manualPowerPercent2,
-                                 manualHeater1Enabled, manualHeater2Enabled, swapAssignment, targetTemp1, targetTemp2,
-                                 currentTemp1, currentTemp2, SSR_PIN_1, SSR_PIN_2, millis());
+uint8_t startTemperaturePipeline() {
+  sensors.setWaitForConversion(false);
+  const int16_t conversionMs = sensors.millisToWaitForConversion(sensors.getResolution());
+  if (conversionMs > 0) {
+    controlCycle.pipeline().setConversionMs(static_cast<unsigned long>(conversionMs));
+  }
+
+  // Persisted ROM codes keep each physical sensor on its slot regardless of bus search order.
+  logic::SensorRomTable persisted;
+  loadSensorRoms(persisted);
+  temperatureSensors.enumerate(persisted);
+  captureSensorSlotsIfChanged();
+  persistControlTaskEvents();
+  logf("DS18B20 pipeline: non-blocking conversion | conversion_ms=%lu | sensors=%u",
+       controlCycle.pipeline().conversionMs(), static_cast<unsigned>(temperatureSensors.sensorCount()));
+  return temperatureSensors.sensorCount();
+}
+
+bool startControlTask() {
+  if (controlTaskHandle != nullptr) {
+    return true;
+  }
+  // Settings loaded during setup() were written before any reader existed; publish them once.
+  publishControlInputs();
+  publishHousekeepingState();
+  controlCycle.energy().restore(0, heater1EnergyMilliWh);
+  controlCycle.energy().restore(1, heater2EnergyMilliWh);
+  if (xTaskCreate(&controlTaskMain, "control", CONTROL_TASK_STACK_BYTES, nullptr, CONTROL_TASK_PRIORITY,
+                  &controlTaskHandle) != pdPASS) {
+    controlTaskHandle = nullptr;
+    logf(LogLevel::Error, "Control task start failed");
+    return false;
+  }
+  logf("Control task: period_ms=%lu | priority=%u", static_cast<unsigned long>(CONTROL_TASK_PERIOD_MS),
+       static_cast<unsigned>(CONTROL_TASK_PRIORITY));
+  return true;
+}
+
+ControlTaskStats controlTaskStats() {
+  return controlSnapshotBuffer.read().stats;
+}
+
+ControlInputsUpdate::ControlInputsUpdate() {
+  if (controlInputsMutex != nullptr) {
+    xSemaphoreTake(controlInputsMutex, portMAX_DELAY);
+  }
+}
+
+ControlInputsUpdate::~ControlInputsUpdate() {
+  controlInputsBuffer.publish(captureControlInputs());
+  if (controlInputsMutex != nullptr) {
+    xSemaphoreGive(controlInputsMutex);
+  }
+}
+
+void initControlState() {
+  if (controlInputsMutex == nullptr) {
+    controlInputsMutex = xSemaphoreCreateMutex();
+  }
+}
+
+void publishHousekeepingState() {
+  HousekeepingState state;
+  state.adc1MilliVolts = adc1MilliVolts;
+  state.adc2MilliVolts = adc2MilliVolts;
+  state.battery1CellCount = battery1CellCount;
+  state.battery1Chemistry = battery1Chemistry;
+  state.battery1SocPercent = battery1SocPercent;
+  state.battery1SocCenti = static_cast<int32_t>(battery1SocSmoothed * 100.0F);
+  state.battery1PackVoltage = battery1PackVoltage;
+  state.battery1CellVoltage = battery1CellVoltage;
+  state.battery1SagPpm = battery1SagPpm;
+  state.battery1SagValid = battery1SagValid;
+  state.battery2CellCount = battery2CellCount;
+  state.battery2Chemistry = battery2Chemistry;
+  state.battery2SocPercent = battery2SocPercent;
+  state.battery2SocCenti = static_cast<int32_t>(battery2SocSmoothed * 100.0F);
+  state.battery2PackVoltage = battery2PackVoltage;
+  state.battery2CellVoltage = battery2CellVoltage;
+  state.battery2SagPpm = battery2SagPpm;
+  state.battery2SagValid = battery2SagValid;
+  state.mosfet1OvertempLatched = mosfet1OvertempLatched;
+  state.mosfet2OvertempLatched = mosfet2OvertempLatched;
+  state.mosfet1OvertempTripTempC = mosfet1OvertempTripTempC;
+  state.mosfet2OvertempTripTempC = mosfet2OvertempTripTempC;
+  state.savedRuntimeMinutes = savedRuntimeMinutes;
+  housekeepingBuffer.publish(state);
+}
+
+void requestBatterySettingsChange(uint8_t battery, const BatterySettingsChange &change) {
+  if (battery < 1U || battery > 2U) {
+    return;
+  }
+  portENTER_CRITICAL(&controlSharedMux);
+  BatterySettingsChange &pending = pendingBatteryChanges[battery - 1U];
+  if (change.setCells) {
+    pending.setCells = true;
+    pending.cells = change.cells;
+  }
+  if (change.setChemistry) {
+    pending.setChemistry = true;
+    pending.chemistry = change.chemistry;
+  }
+  portEXIT_CRITICAL(&controlSharedMux);
+}
+
+void applyBatterySettingsChanges() {
+  BatterySettingsChange changes[2];
+  portENTER_CRITICAL(&controlSharedMux);
+  for (uint8_t i = 0; i < 2; ++i) {
+    changes[i] = pendingBatteryChanges[i];
+    pendingBatteryChanges[i] = BatterySettingsChange();
+  }
+  portEXIT_CRITICAL(&controlSharedMux);
+
+  uint8_t *const cellCounts[2] = {&battery1CellCount, &battery2CellCount};
+  uint8_t *const chemistries[2] = {&battery1Chemistry, &battery2Chemistry};
+  bool *const smoothingInitialized[2] = {&battery1SocSmoothingInitialized, &battery2SocSmoothingInitialized};
+  uint32_t persistFields = 0;
+  for (uint8_t i = 0; i < 2; ++i) {
+    if (changes[i].setCells) {
+      *cellCounts[i] = clampBatteryCellCount(changes[i].cells);
+      persistFields |= PERSIST_BATTERY_CELLS;
+    }
+    if (changes[i].setChemistry) {
+      *chemistries[i] = clampBatteryChemistry(changes[i].chemistry);
+      persistFields |= PERSIST_BATTERY_CHEMISTRY;
+    }
+    if (changes[i].setCells || changes[i].setChemistry) {
+      *smoothingInitialized[i] = false;
+    }
+  }
+  if (persistFields != 0U) {
+    requestPersist(persistFields);
+  }
+}
+
+void requestRuntimeReset() {
+  portENTER_CRITICAL(&controlSharedMux);
+  runtimeResetPending = true;
+  portEXIT_CRITICAL(&controlSharedMux);
+}
+
+void applyRuntimeReset() {
+  portENTER_CRITICAL(&controlSharedMux);
+  const bool pending = runtimeResetPending;
+  runtimeResetPending = false;
+  portEXIT_CRITICAL(&controlSharedMux);
+  if (!pending) {
+    return;
+  }
+  savedRuntimeMinutes = 0;
+  startTimeMs = millis();
+  requestPersist(PERSIST_RUNTIME);
+  resetHeaterEnergy();
+}
+
+uint32_t readControlSnapshot(ControlSnapshot &snapshot) {
+  return controlSnapshotBuffer.read(snapshot);
+}
+
+uint32_t controlSnapshotVersion() {
+  return controlSnapshotBuffer.version();
+}
+
+void persistControlTaskEvents() {
+  logic::SensorRomTable slots;
+  portENTER_CRITICAL(&controlSharedMux);
+  const bool slotsPending = sensorSlotsPersistPending;
+  sensorSlotsPersistPending = false;
+  if (slotsPending) {
+    slots = pendingSensorSlots;
+  }
+  portEXIT_CRITICAL(&controlSharedMux);
+  if (slotsPending) {
+    saveSensorRoms(slots);
+    logSensorSlots(slots);
+  }
+
+  if (overtempPersistPending1) {
+    overtempPersistPending1 = false;
+    saveMosfetOvertempEvent(1U, controlCycle.guard(0).tripTempC());
+  }
+  if (overtempPersistPending2) {
+    overtempPersistPending2 = false;
+    saveMosfetOvertempEvent(2U, controlCycle.guard(1).tripTempC());
+  }
+}
+
+void logControlTaskEvents(unsigned long now) {
+  PendingOvertempLog pending[2];
+  portENTER_CRITICAL(&controlSharedMux);
+  for (uint8_t channel = 0; channel < 2; ++channel) {
+    pending[channel] = pendingOvertempLogs[channel];
+    pendingOvertempLogs[channel] = PendingOvertempLog();
+  }
+  portEXIT_CRITICAL(&controlSharedMux);
+
+  bool overtempChanged = false;
+  for (uint8_t channel = 0; channel < 2; ++channel) {
+    // A trip and its clear between two passes are both reported, in that order.
+    if (pending[channel].tripped) {
+      logf("MOSFET%u overtemp TRIP | temp=%.2fC | limit=%.1fC | heater forced OFF", static_cast<unsigned>(channel + 1),
+           pending[channel].tripTempC, MOSFET_OVERTEMP_LIMIT_C);
+    }
+    if (pending[channel].cleared) {
+      logf("MOSFET%u cooled down | temp=%.2fC | resume<=%.1fC", static_cast<unsigned>(channel + 1),
+           pending[channel].clearTempC, MOSFET_OVERTEMP_RESET_C);
+    }
+    overtempChanged = overtempChanged || pending[channel].tripped || pending[channel].cleared;
+  }
+
+  static unsigned long lastNtcLogMs = 0;
+  if (!shouldLog(LogLevel::Debug) || (!overtempChanged && (now - lastNtcLogMs) < 5000UL)) {
+    return;
+  }
+  lastNtcLogMs = now;
+  ControlSnapshot snapshot;
+  readControlSnapshot(snapshot);
+  char ntc1Text[16];
+  char ntc2Text[16];
+  if (!std::isnan(snapshot.ntcMosfet1TempC)) {
+    snprintf(ntc1Text, sizeof(ntc1Text), "%.2fC", snapshot.ntcMosfet1TempC);
+  } else {
+    snprintf(ntc1Text, sizeof(ntc1Text), "n/a");
+  }
+  if (!std::isnan(snapshot.ntcMosfet2TempC)) {
+    snprintf(ntc2Text, sizeof(ntc2Text), "%.2fC", snapshot.ntcMosfet2TempC);
+  } else {
+    snprintf(ntc2Text, sizeof(ntc2Text), "n/a");
+  }
+  logf(LogLevel::Debug, "MOSFET NTC | h1=%s (%u mV) | h2=%s (%u mV) | ot1=%d | ot2=%d", ntc1Text,
+       snapshot.ntcMosfet1MilliVolts, ntc2Text, snapshot.ntcMosfet2MilliVolts, snapshot.mosfet1OvertempActive ? 1 : 0,
+       snapshot.mosfet2OvertempActive ? 1 : 0);
+}
+
+void persistHeaterEnergy() {
+  ControlSnapshot snapshot;
+  readControlSnapshot(snapshot);
+  if (snapshot.tick == 0U) {
+    return;  // the control task has not run yet
+  }
+  bool changed = false;
+  portENTER_CRITICAL(&controlSharedMux);
+  // Totals from before the latest reset (requested after the snapshot was published, or not yet
+  // applied by the control task) must not overwrite the zeroed values.
+  if (snapshot.heaterEnergyResetGeneration == heaterEnergyResetRequested &&
+      (snapshot.heater1EnergyMilliWh != heater1EnergyMilliWh ||
+       snapshot.heater2EnergyMilliWh != heater2EnergyMilliWh)) {
+    heater1EnergyMilliWh = snapshot.heater1EnergyMilliWh;
+    heater2EnergyMilliWh = snapshot.heater2EnergyMilliWh;
+    changed = true;
+  }
+  portEXIT_CRITICAL(&controlSharedMux);
+  if (changed) {
+    requestPersist(PERSIST_HEATER_ENERGY);
+  }
+}
+
+void resetHeaterEnergy() {
+  portENTER_CRITICAL(&controlSharedMux);
+  ++heaterEnergyResetRequested;
+  heater1EnergyMilliWh = 0;
+  heater2EnergyMilliWh = 0;
+  portEXIT_CRITICAL(&controlSharedMux);
+  requestPersist(PERSIST_HEATER_ENERGY);
+}
+
+bool startHeaterOutputs() {
+  esp_timer_create_args_t args = {};
+  args.callback = &onHeaterOutputTick;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "ssr_pwm";
+  if (esp_timer_create(&args, &heaterOutputTimer) != ESP_OK ||
+      esp_timer_start_periodic(heaterOutputTimer, heaterOutputs.tickIntervalUs()) != ESP_OK) {
+    logf(LogLevel::Error, "SSR slow-PWM timer start failed");
+    return false;
+  }
+  logf("SSR slow-PWM: period_ms=%lu | steps=%u | tick_us=%lu", static_cast<unsigned long>(heaterOutputs.periodMs()),
+       static_cast<unsigned>(heaterOutputs.steps()), static_cast<unsigned long>(heaterOutputs.tickIntervalUs()));
+  return true;
+}
+
+uint16_t heaterDutyPermille(uint8_t channel) {
+  return heaterOutputs.dutyPermille(channel);
+}
+
+bool heaterOutputOn(uint8_t channel) {
+  return heaterOutputs.outputOn(channel);
 }
 
 }  // namespace HeatControl
@@ -2,15 +2,154 @@
 
 #include <Arduino.h>
 
+#include "control_cycle.h"
+#include "control_logic.h"
+
 namespace HeatControl {
 
+class ArduinoGpio : public logic::IGpio {
+ public:
+  void writePin(int pin, int level) override {
+    digitalWrite(pin, level == logic::PIN_LOW ? LOW : HIGH);
+  }
+
+  int readPin(int pin) const override {
+    return digitalRead(pin) == LOW ? logic::PIN_LOW : logic::PIN_HIGH;
+  }
+};
+
+// Signal patterns are queued and return at once; updateSignalPatterns() plays them from loop().
 void startupSignal(bool isPowerMode, bool isManualMode, uint8_t manualPowerPercent);
 void signalManualPowerChange(uint8_t manualPowerPercent);
 void signalTestPulse();
-bool isSensorError(float temperatureC);
-void controlHeater(int pin, bool forceOn, float currentTemp, float targetTemp);
+// Advances the queued signal patterns; returns true (with the output level in `on`) until the queue is empty.
+bool updateSignalPatterns(unsigned long nowMs, bool &on);
 String heaterStateText(int pin);
 
-void updateSensorsAndHeaters();
+// Enumerates the DS18B20 bus once and returns the number of sensors mapped to heater slots.
+uint8_t startTemperaturePipeline();
+// Starts the periodic SSR output timer; until then both heater pins stay LOW.
+bool startHeaterOutputs();
+// Requested duty (permille) of a heater channel as last set by the control tick.
+uint16_t heaterDutyPermille(uint8_t channel);
+// Whether the SSR output of a heater channel is switched on right now (callable from any task).
+bool heaterOutputOn(uint8_t channel);
+
+struct ControlTaskStats {
+  uint32_t nominalPeriodUs = 0;
+  uint32_t ticks = 0;
+  uint32_t minPeriodUs = 0;
+  uint32_t maxPeriodUs = 0;
+  uint32_t meanAbsJitterUs = 0;
+  uint32_t maxAbsJitterUs = 0;
+  uint32_t overruns = 0;
+  uint32_t maxBusyUs = 0;
+};
+
+// Battery, runtime and overtemp-latch state owned by loop(); published once per loop pass.
+struct HousekeepingState {
+  uint16_t adc1MilliVolts = 0;
+  uint16_t adc2MilliVolts = 0;
+  uint8_t battery1CellCount = 0;
+  uint8_t battery1Chemistry = 0;
+  uint8_t battery1SocPercent = 0;
+  int32_t battery1SocCenti = 0;  // smoothed SoC behind battery1SocPercent, in 1/100 %
+  float battery1PackVoltage = 0.0F;
+  float battery1CellVoltage = 0.0F;
+  uint32_t battery1SagPpm = 0;  // AdcPackReading::sagPpm, meaningful when battery1SagValid
+  bool battery1SagValid = false;
+  uint8_t battery2CellCount = 0;
+  uint8_t battery2Chemistry = 0;
+  uint8_t battery2SocPercent = 0;
+  int32_t battery2SocCenti = 0;
+  float battery2PackVoltage = 0.0F;
+  float battery2CellVoltage = 0.0F;
+  uint32_t battery2SagPpm = 0;
+  bool battery2SagValid = false;
+  bool mosfet1OvertempLatched = false;
+  bool mosfet2OvertempLatched = false;
+  float mosfet1OvertempTripTempC = 0.0F;
+  float mosfet2OvertempTripTempC = 0.0F;
+  uint32_t savedRuntimeMinutes = 0;
+};
+
+// Everything /status reports about the controller, captured at the end of one control tick.
+struct ControlSnapshot {
+  uint32_t tick = 0;
+  ControlInputs inputs;
+  HousekeepingState housekeeping;
+  float currentTemp1 = 0.0F;
+  float currentTemp2 = 0.0F;
+  uint16_t ntcMosfet1MilliVolts = 0;
+  uint16_t ntcMosfet2MilliVolts = 0;
+  float ntcMosfet1TempC = 0.0F;
+  float ntcMosfet2TempC = 0.0F;
+  bool mosfet1OvertempActive = false;
+  bool mosfet2OvertempActive = false;
+  uint16_t heater1DutyPermille = 0;
+  uint16_t heater2DutyPermille = 0;
+  bool heater1On = false;
+  bool heater2On = false;
+  uint32_t heater1EnergyMilliWh = 0;  // since the last runtime reset, including the persisted part
+  uint32_t heater2EnergyMilliWh = 0;
+  uint32_t heaterEnergyResetGeneration = 0;  // resetHeaterEnergy() calls applied to these totals
+  uint32_t heater1MeanMilliWatts = 0;  // logic::RuntimePredictor mean power
+  uint32_t heater2MeanMilliWatts = 0;
+  bool battery1RuntimeLeftValid = false;
+  bool battery2RuntimeLeftValid = false;
+  uint32_t battery1RuntimeLeftMinutes = 0;
+  uint32_t battery2RuntimeLeftMinutes = 0;
+  ControlTaskStats stats;
+};
+
+// Holds the writer lock for the control input globals and publishes them when the scope ends.
+class ControlInputsUpdate {
+ public:
+  ControlInputsUpdate();
+  ~ControlInputsUpdate();
+  ControlInputsUpdate(const ControlInputsUpdate &) = delete;
+  ControlInputsUpdate &operator=(const ControlInputsUpdate &) = delete;
+};
+
+// Cell count and/or chemistry change for one pack, requested by a web handler. loop() owns the
+// battery state (HousekeepingState), so the handler only queues it.
+struct BatterySettingsChange {
+  bool setCells = false;
+  uint8_t cells = 0;
+  bool setChemistry = false;
+  uint8_t chemistry = 0;
+};
+
+// Queues a change for pack 1 or 2; a later change to the same field before loop() runs wins.
+void requestBatterySettingsChange(uint8_t battery, const BatterySettingsChange &change);
+// Applies queued changes, restarts the SoC smoothing of the changed packs and persists them;
+// called from loop() before the battery update.
+void applyBatterySettingsChanges();
+// Runtime reset requested by a web handler; applied by loop() like the battery settings.
+void requestRuntimeReset();
+// Zeroes the runtime counter, the uptime base and the energy totals if a reset is queued, and
+// persists them; called from loop().
+void applyRuntimeReset();
+
+// Creates the shared-state locks; call first thing in setup().
+void initControlState();
+void publishHousekeepingState();
+// Copies the latest control tick without ever blocking the control task; returns the snapshot version.
+uint32_t readControlSnapshot(ControlSnapshot &snapshot);
+uint32_t controlSnapshotVersion();
+
+// Fixed-rate control task (vTaskDelayUntil) above the AsyncTCP and loop priorities. It owns the
+// sensor pipeline, heater duties, SSR outputs and the MOSFET overtemp trip.
+bool startControlTask();
+ControlTaskStats controlTaskStats();
+// Writes overtemp trips and sensor slot changes recorded by the control task to the settings store; called from loop().
+void persistControlTaskEvents();
+// Logs overtemp trips/clears recorded by the control task and, at Debug level, the MOSFET NTC
+// readings every 5 s; called from loop() so the control task never waits on the log mutex.
+void logControlTaskEvents(unsigned long now);
+// Hands the control task's energy totals to the settings store; called from loop() once a minute.
+void persistHeaterEnergy();
+// Zeroes both energy totals (and the runtime estimates) on the next control tick and persists that.
+void resetHeaterEnergy();
 
 }  // namespace HeatControl
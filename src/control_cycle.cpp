@@ -0,0 +1,148 @@
+#include "control_cycle.h"
+
+#include "logic_helpers.h"
+#include "sensor_bus.h"
+
+namespace HeatControl {
+namespace logic {
+
+HeaterControlCycle::HeaterControlCycle(unsigned long conversionMs, float overtempLimitC, float overtempResetC)
+    : pipeline_(conversionMs),
+      guards_{OvertempGuard(overtempLimitC, overtempResetC), OvertempGuard(overtempLimitC, overtempResetC)},
+      currentTemp_{SENSOR_DISCONNECTED_C, SENSOR_DISCONNECTED_C} {}
+
+ControlTickResult HeaterControlCycle::tick(uint32_t nowMs, const ControlInputs &inputs,
+                                           const ControlMeasurements &measurements, ITemperatureSensors &sensors,
+                                           SlowPwmOutput &outputs) {
+  ControlTickResult result;
+  updateEnergy(nowMs, inputs, measurements, outputs);
+  // Inhibit before the duty update so a tripped heater never sees another ON edge.
+  updateOvertemp(measurements, outputs, result);
+  updateDuties(nowMs, inputs, measurements, sensors, outputs, result);
+  return result;
+}
+
+void HeaterControlCycle::resetEnergy() {
+  energy_.reset();
+  predictors_[0].reset();
+  predictors_[1].reset();
+}
+
+// Integrates the duty that was in force since the previous tick.
+void HeaterControlCycle::updateEnergy(uint32_t nowMs, const ControlInputs &inputs,
+                                      const ControlMeasurements &measurements, const SlowPwmOutput &outputs) {
+  const uint32_t dtMs = energyClockStarted_ ? nowMs - lastEnergyMs_ : 0U;
+  lastEnergyMs_ = nowMs;
+  energyClockStarted_ = true;
+
+  const uint32_t elementMilliOhm = static_cast<uint32_t>(inputs.heaterElementOhm * 1000.0F + 0.5F);
+  for (uint8_t channel = 0; channel < 2; ++channel) {
+    const uint16_t packMilliVolts = measurements.packMilliVolts[channel];
+    const uint8_t cells = measurements.supplies[channel].cellCount;
+    const uint16_t duty = outputs.inhibited(channel) ? 0U : outputs.dutyPermille(channel);
+    energy_.add(channel, duty, packMilliVolts, elementMilliOhm, dtMs);
+    // No pack (below 0.5 V per cell): whatever comes next is a different discharge.
+    if (cells == 0U || packMilliVolts < 500U * cells) {
+      predictors_[channel].reset();
+    } else {
+      predictors_[channel].update(nowMs, energy_.microJoules(channel), measurements.socCenti[channel]);
+    }
+  }
+}
+
+void HeaterControlCycle::updateOvertemp(const ControlMeasurements &measurements, SlowPwmOutput &outputs,
+                                        ControlTickResult &result) {
+  for (uint8_t channel = 0; channel < 2; ++channel) {
+    // Fixed-point table lookup; the C3 has no FPU, so the float version's log() is a soft-float call.
+    int32_t centiC = 0;
+    const bool valid = logic_helpers::ntcMilliVoltsToCentiC(measurements.ntcMilliVolts[channel], centiC);
+    result.ntcValid[channel] = valid;
+    result.ntcTempC[channel] = static_cast<float>(centiC) / 100.0F;
+    result.overtemp[channel] = guards_[channel].update(valid, result.ntcTempC[channel]);
+    outputs.setInhibited(channel, guards_[channel].active());
+  }
+}
+
+void HeaterControlCycle::updateDuties(uint32_t nowMs, const ControlInputs &inputs,
+                                      const ControlMeasurements &measurements, ITemperatureSensors &sensors,
+                                      SlowPwmOutput &outputs, ControlTickResult &result) {
+  // Readings lag one conversion behind; until the first one lands the temps stay at
+  // SENSOR_DISCONNECTED_C, which keeps the heaters OFF in temperature-controlled mode.
+  result.freshReading = pipeline_.update(sensors, nowMs, currentTemp_[0], currentTemp_[1]);
+
+  // The PID integrates only over new readings; a sensor swap or mode switch starts it from scratch.
+  float dtS = 0.0F;
+  if (result.freshReading) {
+    dtS = haveReading_ ? static_cast<float>(nowMs - lastReadingMs_) / 1000.0F : 0.0F;
+    lastReadingMs_ = nowMs;
+    haveReading_ = true;
+  }
+  if (inputs.controlMode != lastControlMode_ || inputs.swapAssignment != lastSwapForPid_) {
+    pids_[0].reset();
+    pids_[1].reset();
+    lastControlMode_ = inputs.controlMode;
+    lastSwapForPid_ = inputs.swapAssignment;
+  }
+  pids_[0].setGains(inputs.pidGains);
+  pids_[1].setGains(inputs.pidGains);
+
+  uint16_t duty1 = 0;
+  uint16_t duty2 = 0;
+  computeHeaterDuties(inputs.powerMode, inputs.manualMode, inputs.manualPowerMode, inputs.manualPowerPercent1,
+                      inputs.manualPowerPercent2, inputs.manualHeater1Enabled, inputs.manualHeater2Enabled,
+                      measurements.supplies[0], measurements.supplies[1], inputs.heaterElementOhm,
+                      inputs.swapAssignment, inputs.targetTemp1, inputs.targetTemp2, currentTemp_[0],
+                      currentTemp_[1], inputs.controlMode, pids_[0], pids_[1], dtS, duty1, duty2);
+  outputs.setDutyPermille(0, duty1);
+  outputs.setDutyPermille(1, duty2);
+}
+
+HousekeepingCycle::HousekeepingCycle(uint16_t offThresholdMv, uint16_t onThresholdMv, uint8_t stableSamples)
+    : detectors_{BatteryToggleDetector(offThresholdMv, onThresholdMv, stableSamples),
+                 BatteryToggleDetector(offThresholdMv, onThresholdMv, stableSamples)} {}
+
+void HousekeepingCycle::start(uint32_t nowMs) {
+  lastBatteryMs_ = nowMs;
+  lastRuntimeMs_ = nowMs;
+}
+
+bool HousekeepingCycle::batteryDue(uint32_t nowMs, bool manualMode) {
+  const uint32_t intervalMs = manualMode ? MANUAL_TOGGLE_CHECK_MS : BATTERY_UPDATE_MS;
+  if (nowMs - lastBatteryMs_ < intervalMs) {
+    return false;
+  }
+  lastBatteryMs_ = nowMs;
+  return true;
+}
+
+ManualToggleResult HousekeepingCycle::detectToggle(uint8_t battery, uint16_t adcMilliVolts, uint32_t nowMs,
+                                                   uint32_t maxOffMs) {
+  ManualToggleResult result;
+  if (battery >= 2U) {
+    return result;
+  }
+  result.sample = detectors_[battery].update(adcMilliVolts);
+  // An OFF period counts as a step request only if the power returns within maxOffMs.
+  if (result.sample.offNow && !batteryOff_[battery]) {
+    batteryOff_[battery] = true;
+    batteryOffSinceMs_[battery] = nowMs;
+    result.offEdge = true;
+  } else if (!result.sample.offNow && result.sample.onNow && batteryOff_[battery]) {
+    batteryOff_[battery] = false;
+    result.onEdge = true;
+    result.offMs = nowMs - batteryOffSinceMs_[battery];
+    result.step = result.offMs <= maxOffMs;
+  }
+  return result;
+}
+
+bool HousekeepingCycle::runtimeMinuteDue(uint32_t nowMs) {
+  if (nowMs - lastRuntimeMs_ < RUNTIME_MINUTE_MS) {
+    return false;
+  }
+  lastRuntimeMs_ = nowMs;
+  return true;
+}
+
+}  // namespace logic
+}  // namespace HeatControl
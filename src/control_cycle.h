@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+
+#include "battery_toggle.h"
+#include "control_logic.h"
+#include "energy_meter.h"
+#include "slow_pwm.h"
+
+namespace HeatControl {
+
+// Settings the control task acts on. Writers change the globals inside a ControlInputsUpdate scope.
+struct ControlInputs {
+  bool powerMode = false;
+  bool manualMode = false;
+  uint8_t manualPowerPercent1 = 0;
+  uint8_t manualPowerPercent2 = 0;
+  bool manualHeater1Enabled = false;
+  bool manualHeater2Enabled = false;
+  bool swapAssignment = false;
+  float targetTemp1 = 0.0F;
+  float targetTemp2 = 0.0F;
+  logic::ControlMode controlMode = logic::ControlMode::BangBang;
+  logic::PidGains pidGains = logic::DEFAULT_PID_GAINS;
+  logic::ManualPowerMode manualPowerMode = logic::ManualPowerMode::Duty;
+  float heaterElementOhm = 0.0F;
+};
+
+namespace logic {
+
+// What a control tick reads besides the settings, per heater channel. A stale ADC reading is passed
+// as 0 mV: the tick then counts no energy and the MOSFET NTC reads as invalid.
+struct ControlMeasurements {
+  uint16_t packMilliVolts[2] = {0, 0};  // live pack voltage; the SSRs switch every second
+  uint16_t ntcMilliVolts[2] = {0, 0};
+  HeaterSupply supplies[2] = {{0.0F, 0, 0}, {0.0F, 0, 0}};  // loop()'s pack state
+  int32_t socCenti[2] = {0, 0};
+};
+
+struct ControlTickResult {
+  bool freshReading = false;
+  bool ntcValid[2] = {false, false};
+  float ntcTempC[2] = {0.0F, 0.0F};  // meaningful when ntcValid
+  OvertempEvent overtemp[2] = {{false, false}, {false, false}};
+};
+
+// One control tick as the control task runs it: the energy of the duty in force since the previous
+// tick, the MOSFET overtemp trip, then the DS18B20 pipeline and the new heater duties. The dive
+// simulation drives the same object, so it cannot drift from the firmware's sequencing.
+class HeaterControlCycle {
+ public:
+  HeaterControlCycle(unsigned long conversionMs, float overtempLimitC, float overtempResetC);
+
+  ControlTickResult tick(uint32_t nowMs, const ControlInputs &inputs, const ControlMeasurements &measurements,
+                         ITemperatureSensors &sensors, SlowPwmOutput &outputs);
+  // Zeroes the energy totals and the runtime estimates.
+  void resetEnergy();
+
+  TemperatureConversionPipeline &pipeline() { return pipeline_; }
+  EnergyMeter &energy() { return energy_; }
+  const EnergyMeter &energy() const { return energy_; }
+  const RuntimePredictor &predictor(uint8_t channel) const { return predictors_[channel < 2U ? channel : 0U]; }
+  const OvertempGuard &guard(uint8_t channel) const { return guards_[channel < 2U ? channel : 0U]; }
+  // Last DS18B20 reading of a sensor slot (SENSOR_DISCONNECTED_C until the first one lands).
+  float currentTemp(uint8_t slot) const { return currentTemp_[slot < 2U ? slot : 0U]; }
+
+ private:
+  void updateEnergy(uint32_t nowMs, const ControlInputs &inputs, const ControlMeasurements &measurements,
+                    const SlowPwmOutput &outputs);
+  void updateOvertemp(const ControlMeasurements &measurements, SlowPwmOutput &outputs, ControlTickResult &result);
+  void updateDuties(uint32_t nowMs, const ControlInputs &inputs, const ControlMeasurements &measurements,
+                    ITemperatureSensors &sensors, SlowPwmOutput &outputs, ControlTickResult &result);
+
+  TemperatureConversionPipeline pipeline_;
+  PidController pids_[2];
+  OvertempGuard guards_[2];
+  EnergyMeter energy_;
+  RuntimePredictor predictors_[2];
+  float currentTemp_[2];
+  uint32_t lastEnergyMs_ = 0;
+  bool energyClockStarted_ = false;
+  uint32_t lastReadingMs_ = 0;
+  bool haveReading_ = false;
+  ControlMode lastControlMode_ = ControlMode::BangBang;
+  bool lastSwapForPid_ = false;
+};
+
+constexpr uint32_t MANUAL_TOGGLE_CHECK_MS = 50;
+constexpr uint32_t BATTERY_UPDATE_MS = 1000;
+constexpr uint32_t RUNTIME_MINUTE_MS = 60000;
+
+struct ManualToggleResult {
+  BatteryToggleDetector::SampleResult sample = {false, false, false, false};
+  bool offEdge = false;  // the pack just went OFF
+  bool onEdge = false;   // it came back after offMs
+  uint32_t offMs = 0;
+  bool step = false;     // back within the toggle window: advance the manual power step
+};
+
+// loop()'s battery and runtime cadence, shared with the dive simulation: battery state every 50 ms in
+// manual mode (the OFF/ON detection needs the resolution), otherwise once a second, and one runtime
+// minute per 60 s. Timestamps are free-running milliseconds.
+class HousekeepingCycle {
+ public:
+  HousekeepingCycle(uint16_t offThresholdMv, uint16_t onThresholdMv, uint8_t stableSamples);
+
+  // Restarts every interval at nowMs (setup() runs long before the first loop pass).
+  void start(uint32_t nowMs);
+  // True when this pass refreshes the battery state; the interval restarts on true.
+  bool batteryDue(uint32_t nowMs, bool manualMode);
+  // Feeds one filtered battery reading to the OFF/ON detector of pack 0 or 1.
+  ManualToggleResult detectToggle(uint8_t battery, uint16_t adcMilliVolts, uint32_t nowMs, uint32_t maxOffMs);
+  bool batteryOff(uint8_t battery) const { return battery < 2U && batteryOff_[battery]; }
+  bool runtimeMinuteDue(uint32_t nowMs);
+
+ private:
+  BatteryToggleDetector detectors_[2];
+  bool batteryOff_[2] = {false, false};
+  uint32_t batteryOffSinceMs_[2] = {0, 0};
+  uint32_t lastBatteryMs_ = 0;
+  uint32_t lastRuntimeMs_ = 0;
+};
+
+}  // namespace logic
+}  // namespace HeatControl
@@ -12,48 +12,168 @@ bool shouldHeaterBeOn(bool forceOn, float currentTemp, float targetTemp) {
   return forceOn || (!isSensorError(currentTemp) && currentTemp < targetTemp);
 }
 
-bool shouldManualHeaterBeOn(uint8_t manualPowerPercent, unsigned long nowMs) {
-  if (manualPowerPercent >= 100) {
-    return true;
+const char *heaterStateTextFromLevel(int level) {
+  return level == PIN_HIGH ? "ON" : "OFF";
+}
+
+PidController::PidController(const PidGains &gains) : gains_(gains) {}
+
+void PidController::setGains(const PidGains &gains) {
+  gains_ = gains;
+}
+
+void PidController::reset() {
+  integral_ = 0.0F;
+  hasLastTemp_ = false;
+}
+
+uint16_t PidController::update(float targetTemp, float currentTemp, float dtS) {
+  if (isSensorError(currentTemp)) {
+    reset();
+    return 0;
   }
-  if (manualPowerPercent < 25) {
-    return false;
+  if (!(dtS > 0.0F)) {
+    dtS = 0.0F;
   }
-  const unsigned long cycleMs = 1000UL;
-  const unsigned long onTimeMs = (cycleMs * static_cast<unsigned long>(manualPowerPercent)) / 100UL;
-  return (nowMs % cycleMs) < onTimeMs;
+
+  const float error = targetTemp - currentTemp;
+  const float proportional = gains_.kp * error;
+  float derivative = 0.0F;
+  if (hasLastTemp_ && dtS > 0.0F) {
+    derivative = -gains_.kd * (currentTemp - lastTemp_) / dtS;
+  }
+  lastTemp_ = currentTemp;
+  hasLastTemp_ = true;
+
+  // Conditional integration: skip the step when it would push a saturated output further out.
+  const float candidate = integral_ + gains_.ki * error * dtS;
+  const float unclamped = proportional + candidate + derivative;
+  const bool windingUp = (unclamped > 1.0F && error > 0.0F) || (unclamped < 0.0F && error < 0.0F);
+  if (!windingUp) {
+    integral_ = candidate;
+  }
+  if (integral_ < 0.0F) {
+    integral_ = 0.0F;
+  } else if (integral_ > 1.0F) {
+    integral_ = 1.0F;
+  }
+
+  float output = proportional + integral_ + derivative;
+  if (output < 0.0F) {
+    output = 0.0F;
+  } else if (output > 1.0F) {
+    output = 1.0F;
+  }
+  return static_cast<uint16_t>(output * static_cast<float>(HEATER_DUTY_MAX) + 0.5F);
 }
 
-void controlHeater(IGpio &gpio, int pin, bool forceOn, float currentTemp, float targetTemp) {
-  // Active-high logic: HIGH = ON, LOW = OFF.
-  gpio.writePin(pin, shouldHeaterBeOn(forceOn, currentTemp, targetTemp) ? PIN_HIGH : PIN_LOW);
+uint16_t temperatureDutyPermille(ControlMode mode, PidController &pid, bool forceOn, float currentTemp,
+                                 float targetTemp, float dtS) {
+  if (forceOn) {
+    pid.reset();
+    return HEATER_DUTY_MAX;
+  }
+  if (mode == ControlMode::Pid) {
+    return pid.update(targetTemp, currentTemp, dtS);
+  }
+  return shouldHeaterBeOn(false, currentTemp, targetTemp) ? HEATER_DUTY_MAX : 0U;
 }
 
-const char *heaterStateTextFromLevel(int level) {
-  return level == PIN_HIGH ? "ON" : "OFF";
+OvertempGuard::OvertempGuard(float limitC, float resetC) : limitC_(limitC), resetC_(resetC) {}
+
+OvertempEvent OvertempGuard::update(bool valid, float tempC) {
+  OvertempEvent event = {false, false};
+  if (!valid) {
+    return event;
+  }
+  if (!active_ && tempC >= limitC_) {
+    active_ = true;
+    tripTempC_ = tempC;
+    event.tripped = true;
+  } else if (active_ && tempC <= resetC_) {
+    active_ = false;
+    event.cleared = true;
+  }
+  return event;
 }
 
-void updateSensorsAndHeaters(ITemperatureSensors &sensors, IGpio &gpio, bool powerMode, bool manualMode,
-                             uint8_t manualPowerPercent1, uint8_t manualPowerPercent2, bool manualHeater1Enabled,
-                             bool manualHeater2Enabled, bool swapAssignment, float targetTemp1, float targetTemp2,
-                             float &currentTemp1, float &currentTemp2, int heaterPin1, int heaterPin2, unsigned long nowMs) {
-  sensors.requestTemperatures();
-  currentTemp1 = sensors.getTempCByIndex(0);
-  currentTemp2 = sensors.getTempCByIndex(1);
-
-  if (manualMode) {
-    const bool manualOn1 = shouldManualHeaterBeOn(manualPowerPercent1, nowMs);
-    const bool manualOn2 = shouldManualHeaterBeOn(manualPowerPercent2, nowMs);
-    gpio.writePin(heaterPin1, (manualHeater1Enabled && manualOn1) ? PIN_HIGH : PIN_LOW);
-    gpio.writePin(heaterPin2, (manualHeater2Enabled && manualOn2) ? PIN_HIGH : PIN_LOW);
+PeriodJitterTracker::PeriodJitterTracker(uint32_t nominalUs) : nominalUs_(nominalUs) {}
+
+void PeriodJitterTracker::recordTickStart(uint32_t nowUs) {
+  if (!hasLastStart_) {
+    lastStartUs_ = nowUs;
+    hasLastStart_ = true;
     return;
   }
 
-  const float controlTemp1 = swapAssignment ? currentTemp2 : currentTemp1;
-  const float controlTemp2 = swapAssignment ? currentTemp1 : currentTemp2;
+  const uint32_t periodUs = nowUs - lastStartUs_;
+  lastStartUs_ = nowUs;
+  const uint32_t absJitterUs = periodUs > nominalUs_ ? periodUs - nominalUs_ : nominalUs_ - periodUs;
+
+  if (samples_ == 0U || periodUs < minPeriodUs_) {
+    minPeriodUs_ = periodUs;
+  }
+  if (periodUs > maxPeriodUs_) {
+    maxPeriodUs_ = periodUs;
+  }
+  if (absJitterUs > maxAbsJitterUs_) {
+    maxAbsJitterUs_ = absJitterUs;
+  }
+  if (periodUs > nominalUs_ + nominalUs_ / 2U) {
+    ++overruns_;
+  }
+  sumAbsJitterUs_ += absJitterUs;
+  ++samples_;
+}
 
-  controlHeater(gpio, heaterPin1, powerMode, controlTemp1, targetTemp1);
-  controlHeater(gpio, heaterPin2, powerMode, controlTemp2, targetTemp2);
+void PeriodJitterTracker::recordBusy(uint32_t busyUs) {
+  if (busyUs > maxBusyUs_) {
+    maxBusyUs_ = busyUs;
+  }
+}
+
+void PeriodJitterTracker::reset() {
+  hasLastStart_ = false;
+  samples_ = 0;
+  minPeriodUs_ = 0;
+  maxPeriodUs_ = 0;
+  maxAbsJitterUs_ = 0;
+  sumAbsJitterUs_ = 0;
+  overruns_ = 0;
+  maxBusyUs_ = 0;
+}
+
+uint32_t PeriodJitterTracker::meanAbsJitterUs() const {
+  return samples_ > 0U ? static_cast<uint32_t>(sumAbsJitterUs_ / samples_) : 0U;
+}
+
+TemperatureConversionPipeline::TemperatureConversionPipeline(unsigned long conversionMs)
+    : conversionMs_(conversionMs) {}
+
+void TemperatureConversionPipeline::setConversionMs(unsigned long conversionMs) {
+  conversionMs_ = conversionMs;
+}
+
+bool TemperatureConversionPipeline::update(ITemperatureSensors &sensors, unsigned long nowMs, float &temp1,
+                                           float &temp2) {
+  if (!pending_) {
+    sensors.requestTemperatures();
+    startedAtMs_ = nowMs;
+    pending_ = true;
+    return false;
+  }
+
+  if ((nowMs - startedAtMs_) < conversionMs_) {
+    return false;
+  }
+
+  temp1 = sensors.getTempCByIndex(0);
+  temp2 = sensors.getTempCByIndex(1);
+
+  // Kick off the next conversion right away so it runs while the loop does other work.
+  sensors.requestTemperatures();
+  startedAtMs_ = nowMs;
+  return true;
 }
 
 }  // namespace logic
@@ -7,6 +7,36 @@ namespace logic {
 
 constexpr int PIN_LOW = 0;
 constexpr int PIN_HIGH = 1;
+constexpr uint16_t HEATER_DUTY_MAX = 1000;  // Heater duty is expressed in permille.
+
+enum class ControlMode : uint8_t {
+  BangBang = 0,
+  Pid = 1,
+};
+
+inline ControlMode clampControlMode(uint8_t value) {
+  return value == static_cast<uint8_t>(ControlMode::Pid) ? ControlMode::Pid : ControlMode::BangBang;
+}
+
+// How manual mode reads its 25/50/75/100 % steps: as heater duty, or as a share of the element's
+// rated power (at the pack's nominal voltage) that is held while the pack voltage sags.
+enum class ManualPowerMode : uint8_t {
+  Duty = 0,
+  ConstantPower = 1,
+};
+
+inline ManualPowerMode clampManualPowerMode(uint8_t value) {
+  return value == static_cast<uint8_t>(ManualPowerMode::ConstantPower) ? ManualPowerMode::ConstantPower
+                                                                      : ManualPowerMode::Duty;
+}
+
+struct PidGains {
+  float kp;  // Duty fraction per degC of error.
+  float ki;  // Duty fraction per degC and second.
+  float kd;  // Duty fraction per degC/s, applied to the measurement.
+};
+
+constexpr PidGains DEFAULT_PID_GAINS = {0.1F, 0.001F, 0.0F};
 
 class IGpio {
  public:
@@ -22,15 +52,108 @@ class ITemperatureSensors {
   virtual float getTempCByIndex(int index) = 0;
 };
 
+// Splits a DS18B20 cycle into a start-conversion and a collect-result phase so the caller never
+// waits on the OneWire bus. Readings of a conversion are handed over on a later update() call.
+class TemperatureConversionPipeline {
+ public:
+  explicit TemperatureConversionPipeline(unsigned long conversionMs);
+
+  void setConversionMs(unsigned long conversionMs);
+  unsigned long conversionMs() const { return conversionMs_; }
+  bool conversionPending() const { return pending_; }
+
+  // Returns true when temp1/temp2 were refreshed from a finished conversion.
+  bool update(ITemperatureSensors &sensors, unsigned long nowMs, float &temp1, float &temp2);
+
+ private:
+  unsigned long conversionMs_;
+  unsigned long startedAtMs_ = 0;
+  bool pending_ = false;
+};
+
+// PI(D) heater controller producing a duty in permille for the time-proportioning output.
+// The derivative acts on the measurement (no setpoint kick) and the integrator only runs while
+// the output is not saturated in the direction of the error, so it cannot wind up during warm-up.
+class PidController {
+ public:
+  explicit PidController(const PidGains &gains = DEFAULT_PID_GAINS);
+
+  void setGains(const PidGains &gains);
+  const PidGains &gains() const { return gains_; }
+  void reset();
+  float integralTerm() const { return integral_; }
+
+  // dtS is the time since the previous measurement; 0 re-evaluates without advancing the integrator.
+  // Sensor errors reset the controller and return 0.
+  uint16_t update(float targetTemp, float currentTemp, float dtS);
+
+ private:
+  PidGains gains_;
+  float integral_ = 0.0F;  // Stored already scaled by ki so gain changes do not bump the output.
+  float lastTemp_ = 0.0F;
+  bool hasLastTemp_ = false;
+};
+
+struct OvertempEvent {
+  bool tripped;
+  bool cleared;
+};
+
+// MOSFET overtemperature trip with hysteresis. Invalid readings keep the current state.
+class OvertempGuard {
+ public:
+  OvertempGuard(float limitC, float resetC);
+
+  OvertempEvent update(bool valid, float tempC);
+  bool active() const { return active_; }
+  float tripTempC() const { return tripTempC_; }
+
+ private:
+  float limitC_;
+  float resetC_;
+  float tripTempC_ = 0.0F;
+  bool active_ = false;
+};
+
+// Measures how far the start of each periodic tick deviates from the nominal period.
+// Timestamps are free-running microseconds; wrap-around is handled by unsigned arithmetic.
+class PeriodJitterTracker {
+ public:
+  explicit PeriodJitterTracker(uint32_t nominalUs);
+
+  void recordTickStart(uint32_t nowUs);
+  void recordBusy(uint32_t busyUs);
+  void reset();
+
+  uint32_t nominalUs() const { return nominalUs_; }
+  uint32_t samples() const { return samples_; }
+  uint32_t minPeriodUs() const { return samples_ > 0U ? minPeriodUs_ : 0U; }
+  uint32_t maxPeriodUs() const { return maxPeriodUs_; }
+  uint32_t maxAbsJitterUs() const { return maxAbsJitterUs_; }
+  uint32_t meanAbsJitterUs() const;
+  // Periods longer than 1.5x nominal, i.e. a tick that was effectively late by half a period or more.
+  uint32_t overruns() const { return overruns_; }
+  uint32_t maxBusyUs() const { return maxBusyUs_; }
+
+ private:
+  uint32_t nominalUs_;
+  uint32_t lastStartUs_ = 0;
+  bool hasLastStart_ = false;
+  uint32_t samples_ = 0;
+  uint32_t minPeriodUs_ = 0;
+  uint32_t maxPeriodUs_ = 0;
+  uint32_t maxAbsJitterUs_ = 0;
+  uint64_t sumAbsJitterUs_ = 0;
+  uint32_t overruns_ = 0;
+  uint32_t maxBusyUs_ = 0;
+};
+
 bool isSensorError(float temperatureC);
 bool shouldHeaterBeOn(bool forceOn, float currentTemp, float targetTemp);
-bool shouldManualHeaterBeOn(uint8_t manualPowerPercent, unsigned long nowMs);
-void controlHeater(IGpio &gpio, int pin, bool forceOn, float currentTemp, float targetTemp);
 const char *heaterStateTextFromLevel(int level);
-void updateSensorsAndHeaters(ITemperatureSensors &sensors, IGpio &gpio, bool powerMode, bool manualMode,
-                             uint8_t manualPowerPercent1, uint8_t manualPowerPercent2, bool manualHeater1Enabled,
-                             bool manualHeater2Enabled, bool swapAssignment, float targetTemp1, float targetTemp2,
-                             float &currentTemp1, float &currentTemp2, int heaterPin1, int heaterPin2, unsigned long nowMs);
+// Duty for a temperature-controlled heater: full on in power mode, otherwise bang-bang or PID.
+uint16_t temperatureDutyPermille(ControlMode mode, PidController &pid, bool forceOn, float currentTemp,
+                                 float targetTemp, float dtS);
 
 }  // namespace logic
 }  // namespace HeatControl
@@ -0,0 +1,145 @@
+#include "energy_meter.h"
+
+namespace HeatControl {
+namespace logic {
+
+void EnergyMeter::add(uint8_t channel, uint16_t dutyPermille, uint16_t packMilliVolts, uint32_t elementMilliOhm,
+                      uint32_t dtMs) {
+  if (channel >= ENERGY_CHANNELS) {
+    return;
+  }
+  if (dutyPermille == 0U || packMilliVolts == 0U || elementMilliOhm == 0U) {
+    milliWatts_[channel] = 0;
+    return;
+  }
+  const uint64_t divisor = static_cast<uint64_t>(elementMilliOhm) * 1000ULL;
+  if (divisor != divisor_[channel]) {
+    // The carried remainder is in units of the old divisor; dropping it costs under 1 uJ.
+    divisor_[channel] = divisor;
+    remainder_[channel] = 0;
+  }
+  const uint64_t powerNumerator =
+      static_cast<uint64_t>(packMilliVolts) * packMilliVolts * static_cast<uint64_t>(dutyPermille);
+  milliWatts_[channel] = static_cast<uint32_t>(powerNumerator / divisor);
+  const uint64_t total = powerNumerator * dtMs + remainder_[channel];
+  microJoules_[channel] += total / divisor;
+  remainder_[channel] = total % divisor;
+}
+
+uint64_t EnergyMeter::microJoules(uint8_t channel) const {
+  return channel < ENERGY_CHANNELS ? microJoules_[channel] : 0U;
+}
+
+uint32_t EnergyMeter::milliWattHours(uint8_t channel) const {
+  return static_cast<uint32_t>(microJoules(channel) / MICROJOULES_PER_MILLIWATT_HOUR);
+}
+
+uint32_t EnergyMeter::milliWatts(uint8_t channel) const {
+  return channel < ENERGY_CHANNELS ? milliWatts_[channel] : 0U;
+}
+
+void EnergyMeter::restore(uint8_t channel, uint32_t milliWattHours) {
+  if (channel >= ENERGY_CHANNELS) {
+    return;
+  }
+  microJoules_[channel] = static_cast<uint64_t>(milliWattHours) * MICROJOULES_PER_MILLIWATT_HOUR;
+  remainder_[channel] = 0;
+}
+
+void EnergyMeter::reset() {
+  for (uint8_t i = 0; i < ENERGY_CHANNELS; ++i) {
+    microJoules_[i] = 0;
+    remainder_[i] = 0;
+    milliWatts_[i] = 0;
+  }
+}
+
+void RuntimePredictor::update(uint32_t nowMs, uint64_t energyMicroJoules, int32_t socCenti) {
+  if (started_ && energyMicroJoules < lastEnergy_) {
+    reset();  // the meter was reset
+  }
+  if (!started_) {
+    started_ = true;
+    lastSampleMs_ = nowMs;
+    lastEnergy_ = energyMicroJoules;
+    lastCheckpointMs_ = nowMs;
+    clearCheckpoints(energyMicroJoules, socCenti);
+    return;
+  }
+  const uint32_t elapsedMs = nowMs - lastSampleMs_;
+  if (elapsedMs < RUNTIME_SAMPLE_MS) {
+    return;
+  }
+
+  const int64_t sampleMilliWatts = static_cast<int64_t>((energyMicroJoules - lastEnergy_) / elapsedMs);
+  if (!haveAverage_) {
+    averageMilliWatts_ = static_cast<uint32_t>(sampleMilliWatts);
+    haveAverage_ = true;
+  } else {
+    const uint32_t weightMs = elapsedMs < RUNTIME_POWER_TAU_MS ? elapsedMs : RUNTIME_POWER_TAU_MS;
+    const int64_t average = static_cast<int64_t>(averageMilliWatts_);
+    const int64_t step = (sampleMilliWatts - average) * weightMs / static_cast<int64_t>(RUNTIME_POWER_TAU_MS);
+    averageMilliWatts_ = static_cast<uint32_t>(average + step);
+  }
+  lastSampleMs_ = nowMs;
+  lastEnergy_ = energyMicroJoules;
+
+  const uint8_t oldest = static_cast<uint8_t>((newestCheckpoint_ + RUNTIME_CHECKPOINTS + 1U - checkpointCount_) %
+                                              RUNTIME_CHECKPOINTS);
+  if (averageMilliWatts_ == 0U || socCenti > checkpoints_[oldest].socCenti + RUNTIME_SOC_RISE_RESET_CENTI) {
+    // Idle heater (the SoC estimate sags under load, so count from a loaded reading) or a new pack.
+    lastCheckpointMs_ = nowMs;
+    clearCheckpoints(energyMicroJoules, socCenti);
+  } else if (nowMs - lastCheckpointMs_ >= RUNTIME_CHECKPOINT_MS) {
+    lastCheckpointMs_ = nowMs;
+    newestCheckpoint_ = static_cast<uint8_t>((newestCheckpoint_ + 1U) % RUNTIME_CHECKPOINTS);
+    checkpoints_[newestCheckpoint_] = Checkpoint{energyMicroJoules, socCenti};
+    if (checkpointCount_ < RUNTIME_CHECKPOINTS) {
+      ++checkpointCount_;
+    }
+  }
+  estimate(socCenti);
+}
+
+void RuntimePredictor::reset() {
+  *this = RuntimePredictor();
+}
+
+void RuntimePredictor::clearCheckpoints(uint64_t energyMicroJoules, int32_t socCenti) {
+  checkpoints_[0] = Checkpoint{energyMicroJoules, socCenti};
+  checkpointCount_ = 1;
+  newestCheckpoint_ = 0;
+  valid_ = false;
+  minutesLeft_ = 0;
+}
+
+void RuntimePredictor::estimate(int32_t socCenti) {
+  // The newest checkpoint the SoC has dropped far enough from: as recent as the noise allows.
+  const Checkpoint *from = nullptr;
+  for (uint8_t age = 0; age < checkpointCount_; ++age) {
+    const Checkpoint &candidate =
+        checkpoints_[(newestCheckpoint_ + RUNTIME_CHECKPOINTS - age) % RUNTIME_CHECKPOINTS];
+    if (candidate.socCenti - socCenti >= RUNTIME_MIN_SOC_DROP_CENTI) {
+      from = &candidate;
+      break;
+    }
+  }
+  if (from == nullptr || lastEnergy_ <= from->energyMicroJoules || averageMilliWatts_ == 0U) {
+    valid_ = false;
+    minutesLeft_ = 0;
+    return;
+  }
+  valid_ = true;
+  if (socCenti <= 0) {
+    minutesLeft_ = 0;
+    return;
+  }
+  const uint64_t usedMicroJoules = lastEnergy_ - from->energyMicroJoules;
+  const uint64_t remainingMicroJoules =
+      static_cast<uint64_t>(socCenti) * usedMicroJoules / static_cast<uint64_t>(from->socCenti - socCenti);
+  // mW * 60000 ms = uJ per minute.
+  minutesLeft_ = static_cast<uint32_t>(remainingMicroJoules / (static_cast<uint64_t>(averageMilliWatts_) * 60000ULL));
+}
+
+}  // namespace logic
+}  // namespace HeatControl
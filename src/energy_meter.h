@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+
+namespace HeatControl {
+namespace logic {
+
+constexpr uint8_t ENERGY_CHANNELS = 2;
+constexpr uint64_t MICROJOULES_PER_MILLIWATT_HOUR = 3600000ULL;
+
+// Heater energy per channel, integrated as duty * V^2 / R once per control tick. Integer only (the
+// C3 has no FPU): every tick adds mV^2 * permille * ms / (mOhm * 1000) microjoules, and the division
+// remainder is carried to the next tick, so short ticks and low duties lose nothing to rounding.
+class EnergyMeter {
+ public:
+  // A tick with zero duty, voltage or time adds nothing; elementMilliOhm == 0 is ignored as unset.
+  void add(uint8_t channel, uint16_t dutyPermille, uint16_t packMilliVolts, uint32_t elementMilliOhm, uint32_t dtMs);
+
+  uint64_t microJoules(uint8_t channel) const;
+  uint32_t milliWattHours(uint8_t channel) const;
+  // Power of the last add() on the channel.
+  uint32_t milliWatts(uint8_t channel) const;
+
+  // Continues from a persisted total (the sub-mWh part is lost, at most 1 mWh per restart).
+  void restore(uint8_t channel, uint32_t milliWattHours);
+  void reset();
+
+ private:
+  uint64_t microJoules_[ENERGY_CHANNELS] = {0, 0};
+  uint64_t remainder_[ENERGY_CHANNELS] = {0, 0};  // in units of 1 / divisor_ microjoules
+  uint64_t divisor_[ENERGY_CHANNELS] = {0, 0};
+  uint32_t milliWatts_[ENERGY_CHANNELS] = {0, 0};
+};
+
+constexpr uint32_t RUNTIME_SAMPLE_MS = 10000;
+// Mean-power time constant: long enough to ride out the PID's on/off cycles.
+constexpr uint32_t RUNTIME_POWER_TAU_MS = 300000;
+// Energy per percent comes from checkpoints up to RUNTIME_CHECKPOINTS * RUNTIME_CHECKPOINT_MS back,
+// so it follows the flat and steep parts of the discharge curve instead of averaging the whole pack.
+constexpr uint32_t RUNTIME_CHECKPOINT_MS = 600000;
+constexpr uint8_t RUNTIME_CHECKPOINTS = 12;
+// SoC drop (1/100 %) a checkpoint needs before its energy per percent is trusted; the voltage-based
+// SoC moves with load and temperature, so smaller drops are mostly noise.
+constexpr int32_t RUNTIME_MIN_SOC_DROP_CENTI = 500;
+// A SoC this far above the oldest checkpoint means a fresh pack (or a long rest): start over.
+constexpr int32_t RUNTIME_SOC_RISE_RESET_CENTI = 500;
+
+// Minutes of heating left on one pack, from two rates measured on the go: the heater energy per
+// percent of state of charge over the recent discharge and the recent mean power. Remaining
+// energy = SoC * (energy per percent); minutes left = remaining energy / mean power. No pack
+// capacity has to be configured, and the ratio absorbs the losses in the pack, wiring and MOSFET.
+class RuntimePredictor {
+ public:
+  // energyMicroJoules is the channel's running EnergyMeter total; socCenti the pack's state of
+  // charge in 1/100 %. One sample per RUNTIME_SAMPLE_MS; calls in between only check the clock.
+  void update(uint32_t nowMs, uint64_t energyMicroJoules, int32_t socCenti);
+  // Drops all history, e.g. when the pack is disconnected.
+  void reset();
+
+  bool valid() const { return valid_; }
+  uint32_t minutesLeft() const { return minutesLeft_; }
+  uint32_t averageMilliWatts() const { return averageMilliWatts_; }
+
+ private:
+  struct Checkpoint {
+    uint64_t energyMicroJoules;
+    int32_t socCenti;
+  };
+
+  void clearCheckpoints(uint64_t energyMicroJoules, int32_t socCenti);
+  void estimate(int32_t socCenti);
+
+  bool started_ = false;
+  uint32_t lastSampleMs_ = 0;
+  uint64_t lastEnergy_ = 0;
+  bool haveAverage_ = false;
+  uint32_t averageMilliWatts_ = 0;
+  Checkpoint checkpoints_[RUNTIME_CHECKPOINTS] = {};
+  uint8_t checkpointCount_ = 0;
+  uint8_t newestCheckpoint_ = 0;
+  uint32_t lastCheckpointMs_ = 0;
+  bool valid_ = false;
+  uint32_t minutesLeft_ = 0;
+};
+
+}  // namespace logic
+}  // namespace HeatControl
@@ -0,0 +1,98 @@
+#include "heatshrink.h"
+
+#include <cstring>
+
+namespace HeatControl {
+namespace logic {
+
+bool HeatshrinkDecoder::reset(uint8_t *window, uint8_t windowBits, uint8_t lookaheadBits) {
+  if (window == nullptr || windowBits < MIN_WINDOW_BITS || windowBits > MAX_WINDOW_BITS ||
+      lookaheadBits < MIN_LOOKAHEAD_BITS || lookaheadBits >= windowBits) {
+    return false;
+  }
+  window_ = window;
+  windowBits_ = windowBits;
+  lookaheadBits_ = lookaheadBits;
+  windowMask_ = static_cast<uint16_t>((1U << windowBits) - 1U);
+  // heatshrink starts from a zeroed history; the encoder never refers to it, but a corrupt stream may.
+  std::memset(window_, 0, static_cast<size_t>(windowMask_) + 1U);
+  head_ = 0;
+  phase_ = Phase::Tag;
+  bitBuffer_ = 0;
+  bitCount_ = 0;
+  distance_ = 0;
+  remaining_ = 0;
+  return true;
+}
+
+bool HeatshrinkDecoder::readBits(uint8_t count, const uint8_t *&input, size_t &inputLength, uint16_t &value) {
+  while (bitCount_ < count) {
+    if (inputLength == 0U) {
+      return false;
+    }
+    bitBuffer_ = (bitBuffer_ << 8) | *input++;
+    --inputLength;
+    bitCount_ = static_cast<uint8_t>(bitCount_ + 8U);
+  }
+  bitCount_ = static_cast<uint8_t>(bitCount_ - count);
+  value = static_cast<uint16_t>((bitBuffer_ >> bitCount_) & ((1UL << count) - 1UL));
+  return true;
+}
+
+size_t HeatshrinkDecoder::decode(const uint8_t *&input, size_t &inputLength, uint8_t *out, size_t outCapacity) {
+  if (window_ == nullptr) {
+    return 0;
+  }
+  size_t produced = 0;
+  uint16_t value = 0;
+  while (produced < outCapacity) {
+    switch (phase_) {
+      case Phase::Tag:
+        if (!readBits(1, input, inputLength, value)) {
+          return produced;
+        }
+        phase_ = value != 0U ? Phase::Literal : Phase::Distance;
+        break;
+      case Phase::Literal:
+        if (!readBits(8, input, inputLength, value)) {
+          return produced;
+        }
+        out[produced++] = static_cast<uint8_t>(value);
+        window_[head_] = static_cast<uint8_t>(value);
+        head_ = static_cast<uint16_t>((head_ + 1U) & windowMask_);
+        phase_ = Phase::Tag;
+        break;
+      case Phase::Distance:
+        if (!readBits(windowBits_, input, inputLength, value)) {
+          return produced;
+        }
+        distance_ = static_cast<uint16_t>(value + 1U);
+        phase_ = Phase::Length;
+        break;
+      case Phase::Length:
+        if (!readBits(lookaheadBits_, input, inputLength, value)) {
+          return produced;
+        }
+        remaining_ = static_cast<uint16_t>(value + 1U);
+        phase_ = Phase::Copy;
+        break;
+      case Phase::Copy:
+        // May stop mid-reference when `out` is full and resume on the next call.
+        while (remaining_ > 0U && produced < outCapacity) {
+          const uint8_t byte = window_[(head_ - distance_) & windowMask_];
+          out[produced++] = byte;
+          window_[head_] = byte;
+          head_ = static_cast<uint16_t>((head_ + 1U) & windowMask_);
+          --remaining_;
+        }
+        if (remaining_ == 0U) {
+          phase_ = Phase::Tag;
+        }
+        break;
+    }
+  }
+  return produced;
+}
+
+}  // namespace logic
+}  // namespace HeatControl
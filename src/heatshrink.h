@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace HeatControl {
+namespace logic {
+
+// Streaming decoder for heatshrink's LZSS bit stream: a 1 bit starts an 8-bit literal, a 0 bit a
+// back-reference of (distance - 1) in windowBits and (length - 1) in lookaheadBits, MSB first.
+// tools/release/compress_firmware.py is the matching encoder. Output history lives in a caller
+// buffer of 1 << windowBits bytes; nothing else is kept beyond a few registers.
+class HeatshrinkDecoder {
+ public:
+  static constexpr uint8_t MIN_WINDOW_BITS = 8;
+  static constexpr uint8_t MAX_WINDOW_BITS = 15;
+  static constexpr uint8_t MIN_LOOKAHEAD_BITS = 3;
+
+  // False for unsupported parameters; `window` must hold 1 << windowBits bytes.
+  bool reset(uint8_t *window, uint8_t windowBits, uint8_t lookaheadBits);
+
+  // Decodes until `outCapacity` bytes were produced or the input ran out; advances `input` and
+  // `inputLength` past the consumed bytes and returns the number of bytes written to `out`.
+  size_t decode(const uint8_t *&input, size_t &inputLength, uint8_t *out, size_t outCapacity);
+
+ private:
+  enum class Phase : uint8_t { Tag, Literal, Distance, Length, Copy };
+
+  bool readBits(uint8_t count, const uint8_t *&input, size_t &inputLength, uint16_t &value);
+
+  uint8_t *window_ = nullptr;
+  uint16_t windowMask_ = 0;
+  uint16_t head_ = 0;
+  uint8_t windowBits_ = 0;
+  uint8_t lookaheadBits_ = 0;
+  Phase phase_ = Phase::Tag;
+  uint32_t bitBuffer_ = 0;
+  uint8_t bitCount_ = 0;
+  uint16_t distance_ = 0;
+  uint16_t remaining_ = 0;
+};
+
+}  // namespace logic
+}  // namespace HeatControl
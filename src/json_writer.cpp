@@ -0,0 +1,179 @@
+#include "json_writer.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace HeatControl {
+
+namespace {
+
+const float POW10[JsonWriter::MAX_DECIMALS + 1] = {1.0F, 10.0F, 100.0F, 1000.0F, 10000.0F, 100000.0F, 1000000.0F};
+// Keeps the rounded value inside int64_t.
+constexpr float MAX_SCALED_MAGNITUDE = 1.0e18F;
+
+}  // namespace
+
+JsonWriter::JsonWriter(char *buffer, size_t capacity) : buffer_(buffer), capacity_(capacity) {
+  if (buffer_ == nullptr || capacity_ == 0U) {
+    overflowed_ = true;
+    capacity_ = 0;
+    return;
+  }
+  buffer_[0] = '\0';
+}
+
+void JsonWriter::beginObject() {
+  put('{');
+  needComma_ = false;
+}
+
+void JsonWriter::endObject() {
+  put('}');
+  needComma_ = true;
+}
+
+void JsonWriter::field(const char *name, const char *value) {
+  field(name, value, value != nullptr ? std::strlen(value) : 0U);
+}
+
+void JsonWriter::field(const char *name, const char *value, size_t length) {
+  key(name);
+  put('"');
+  if (value != nullptr) {
+    putEscaped(value, length);
+  }
+  put('"');
+}
+
+void JsonWriter::fieldBool(const char *name, bool value) {
+  key(name);
+  put(value ? '1' : '0');
+}
+
+void JsonWriter::fieldUint(const char *name, uint32_t value) {
+  key(name);
+  putUint(value, 1);
+}
+
+void JsonWriter::fieldInt(const char *name, int32_t value) {
+  key(name);
+  if (value < 0) {
+    put('-');
+    putUint(static_cast<uint64_t>(-static_cast<int64_t>(value)), 1);
+  } else {
+    putUint(static_cast<uint64_t>(value), 1);
+  }
+}
+
+void JsonWriter::fieldFixed(const char *name, float value, uint8_t decimals) {
+  if (decimals > MAX_DECIMALS) {
+    decimals = MAX_DECIMALS;
+  }
+  const float scaled = value * POW10[decimals];
+  if (!(scaled > -MAX_SCALED_MAGNITUDE && scaled < MAX_SCALED_MAGNITUDE)) {
+    fieldNull(name);
+    return;
+  }
+
+  // scaled - truncated is exact for any float, so this matches std::round() bit for bit.
+  int64_t rounded = static_cast<int64_t>(scaled);
+  const float fraction = scaled - static_cast<float>(rounded);
+  if (fraction >= 0.5F) {
+    ++rounded;
+  } else if (fraction <= -0.5F) {
+    --rounded;
+  }
+
+  key(name);
+  // Keeps the sign of values that round to zero ("-0.00"), as printf("%.*f") does.
+  if (rounded < 0 || (rounded == 0 && std::signbit(scaled))) {
+    put('-');
+  }
+  const uint64_t magnitude = static_cast<uint64_t>(rounded < 0 ? -rounded : rounded);
+  if (decimals == 0U) {
+    putUint(magnitude, 1);
+    return;
+  }
+  const uint64_t divisor = static_cast<uint64_t>(POW10[decimals]);
+  putUint(magnitude / divisor, 1);
+  put('.');
+  putUint(magnitude % divisor, decimals);
+}
+
+void JsonWriter::fieldNull(const char *name) {
+  key(name);
+  put("null");
+}
+
+void JsonWriter::rollback(const Mark &mark) {
+  if (mark.length > length_ || capacity_ == 0U) {
+    return;
+  }
+  length_ = mark.length;
+  needComma_ = mark.needComma;
+  buffer_[length_] = '\0';
+}
+
+void JsonWriter::key(const char *name) {
+  if (needComma_) {
+    put(',');
+  }
+  needComma_ = true;
+  put('"');
+  put(name);
+  put("\":");
+}
+
+void JsonWriter::put(char c) {
+  if (length_ + 1U >= capacity_) {
+    overflowed_ = true;
+    return;
+  }
+  buffer_[length_++] = c;
+  buffer_[length_] = '\0';
+}
+
+void JsonWriter::put(const char *text) {
+  while (*text != '\0') {
+    put(*text++);
+  }
+}
+
+void JsonWriter::putEscaped(const char *text, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    const char c = text[i];
+    switch (c) {
+      case '\\':
+      case '"':
+        put('\\');
+        put(c);
+        break;
+      case '\n':
+        put("\\n");
+        break;
+      case '\r':
+        put("\\r");
+        break;
+      default:
+        put(c);
+        break;
+    }
+  }
+}
+
+void JsonWriter::putUint(uint64_t value, uint8_t minDigits) {
+  char digits[20];
+  uint8_t count = 0;
+  do {
+    digits[count++] = static_cast<char>('0' + value % 10U);
+    value /= 10U;
+  } while (value != 0U && count < sizeof(digits));
+  while (count < minDigits && count < sizeof(digits)) {
+    digits[count++] = '0';
+  }
+  while (count > 0U) {
+    put(digits[--count]);
+  }
+}
+
+}  // namespace HeatControl
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace HeatControl {
+
+// Appends one flat JSON object to a caller-provided buffer. Never allocates; numbers are formatted
+// with integer arithmetic only. Once the buffer is full every further write is dropped and
+// overflowed() turns true; the buffer always stays NUL-terminated.
+class JsonWriter {
+ public:
+  static constexpr uint8_t MAX_DECIMALS = 6;
+
+  JsonWriter(char *buffer, size_t capacity);
+
+  void beginObject();
+  void endObject();
+
+  void field(const char *key, const char *value);
+  void field(const char *key, const char *value, size_t length);
+  void fieldBool(const char *key, bool value);  // Emitted as 1/0 like the rest of the web API.
+  void fieldUint(const char *key, uint32_t value);
+  void fieldInt(const char *key, int32_t value);
+  // Rounds half away from zero to `decimals` places; NaN, infinity and values beyond 1e18 become null.
+  void fieldFixed(const char *key, float value, uint8_t decimals);
+  void fieldNull(const char *key);
+
+  // Position to return to when a field written after it turns out to be unwanted.
+  struct Mark {
+    size_t length;
+    bool needComma;
+  };
+  Mark mark() const { return Mark{length_, needComma_}; }
+  void rollback(const Mark &mark);
+
+  const char *c_str() const { return buffer_; }
+  size_t size() const { return length_; }
+  bool overflowed() const { return overflowed_; }
+
+ private:
+  void key(const char *name);
+  void put(char c);
+  void put(const char *text);
+  void putEscaped(const char *text, size_t length);
+  void putUint(uint64_t value, uint8_t minDigits);
+
+  char *buffer_;
+  size_t capacity_;
+  size_t length_ = 0;
+  bool overflowed_ = false;
+  bool needComma_ = false;
+};
+
+}  // namespace HeatControl
@@ -1,138 +1,70 @@
 #include "led_patterns.h"
 
-#include "app_state.h"
-
 namespace HeatControl {
 
 namespace {
 
-constexpr unsigned long STEP_ON_MS = 130;
-constexpr unsigned long STEP_OFF_MS = 130;
-constexpr unsigned long STEP_DONE_PAUSE_MS = 600;
-
-constexpr unsigned long SOS_SHORT_ON_MS = 150;
-constexpr unsigned long SOS_LONG_ON_MS = 450;
-constexpr unsigned long SOS_OFF_MS = 150;
-constexpr unsigned long SOS_DONE_PAUSE_MS = 800;
-
-constexpr bool sosIsLongPulse(uint8_t index) {
-  return index >= 3 && index <= 5;
+constexpr uint8_t layer(StatusLayer value) {
+  return static_cast<uint8_t>(value);
 }
 
 }  // namespace
 
-LedPattern::LedPattern(int pin) : pin_(pin) {}
-
-void LedPattern::begin() {
-  pinMode(pin_, OUTPUT);
-  setOutput(false);
+StatusOutputs::StatusOutputs(int led1Pin, int led2Pin, int signalPin) {
+  leds_[0] = static_cast<uint8_t>(scheduler_.addOutput(led1Pin, false));
+  leds_[1] = static_cast<uint8_t>(scheduler_.addOutput(led2Pin, false));
+  signal_ = static_cast<uint8_t>(scheduler_.addOutput(signalPin, true));
 }
 
-void LedPattern::setBaseOn(bool on) {
-  baseOn_ = on;
+void StatusOutputs::begin(logic::IGpio &gpio) {
+  scheduler_.begin(gpio);
 }
 
-void LedPattern::setTripLatched(bool latched) {
-  if (tripLatched_ == latched) {
-    return;
-  }
-  tripLatched_ = latched;
-
-  sosPulseIndex_ = 0;
-  sosPhaseOn_ = false;
-  sosPhaseUntilMs_ = 0;
+void StatusOutputs::tick(unsigned long nowMs, SignalTimingPreset preset, logic::IGpio &gpio) {
+  scheduler_.tick(nowMs, preset, gpio);
 }
 
-void LedPattern::triggerManualPowerStepFromPercent(uint8_t manualPowerPercent) {
-  uint8_t pulses = 1;
-  if (manualPowerPercent >= 100) {
-    pulses = 4;
-  } else if (manualPowerPercent >= 75) {
-    pulses = 3;
-  } else if (manualPowerPercent >= 50) {
-    pulses = 2;
+void StatusOutputs::setBaseOn(uint8_t led, bool on) {
+  if (led < STATUS_LED_COUNT) {
+    scheduler_.hold(leds_[led], layer(StatusLayer::Base), on);
   }
-
-  stepBlinksRemaining_ = pulses;
-  stepPhaseOn_ = false;
-  stepPhaseUntilMs_ = 0;
 }
 
-void LedPattern::update(unsigned long nowMs) {
-  if (tripLatched_) {
-    updateTrip(nowMs);
+void StatusOutputs::setTripLatched(uint8_t led, bool latched) {
+  if (led >= STATUS_LED_COUNT || tripLatched_[led] == latched) {
     return;
   }
-  if (stepBlinksRemaining_ > 0) {
-    updateStepBlink(nowMs);
-    return;
+  tripLatched_[led] = latched;
+  if (latched) {
+    scheduler_.play(leds_[led], layer(StatusLayer::Trip), LED_TRIP_SOS);
+  } else {
+    scheduler_.stop(leds_[led], layer(StatusLayer::Trip));
   }
-
-  updateBase();
 }
 
-void LedPattern::setOutput(bool on) {
-  if (outputOn_ == on) {
-    return;
+void StatusOutputs::triggerManualPowerStepFromPercent(uint8_t led, uint8_t manualPowerPercent) {
+  if (led < STATUS_LED_COUNT) {
+    scheduler_.play(leds_[led], layer(StatusLayer::Step), LED_STEP_BLINK, manualPowerStepPulses(manualPowerPercent));
   }
-  outputOn_ = on;
-  digitalWrite(pin_, on ? HIGH : LOW);
-}
-
-void LedPattern::updateBase() {
-  setOutput(baseOn_);
 }
 
-void LedPattern::updateStepBlink(unsigned long nowMs) {
-  if (stepPhaseUntilMs_ != 0 && nowMs < stepPhaseUntilMs_) {
-    return;
-  }
-
-  if (!stepPhaseOn_) {
-    stepPhaseOn_ = true;
-    setOutput(true);
-    stepPhaseUntilMs_ = nowMs + scaleSignalMs(STEP_ON_MS, signalTimingPreset);
-    return;
-  }
-
-  stepPhaseOn_ = false;
-  setOutput(false);
-  stepPhaseUntilMs_ = nowMs + scaleSignalMs(STEP_OFF_MS, signalTimingPreset);
-
-  if (stepBlinksRemaining_ > 0) {
-    --stepBlinksRemaining_;
-  }
-
-  if (stepBlinksRemaining_ == 0) {
-    stepPhaseUntilMs_ = nowMs + scaleSignalMs(STEP_DONE_PAUSE_MS, signalTimingPreset);
+void StatusOutputs::setSignal(bool active, bool on) {
+  const uint8_t outputs[] = {leds_[0], leds_[1], signal_};
+  for (uint8_t output : outputs) {
+    if (active) {
+      scheduler_.hold(output, layer(StatusLayer::Signal), on);
+    } else {
+      scheduler_.stop(output, layer(StatusLayer::Signal));
+    }
   }
 }
 
-void LedPattern::updateTrip(unsigned long nowMs) {
-  if (sosPhaseUntilMs_ != 0 && nowMs < sosPhaseUntilMs_) {
-    return;
-  }
-
-  if (sosPulseIndex_ >= 9) {
-    sosPulseIndex_ = 0;
-    sosPhaseOn_ = false;
-    setOutput(false);
-    sosPhaseUntilMs_ = nowMs + SOS_DONE_PAUSE_MS;
-    return;
-  }
-
-  if (!sosPhaseOn_) {
-    sosPhaseOn_ = true;
-    setOutput(true);
-    const unsigned long onMs = sosIsLongPulse(sosPulseIndex_) ? SOS_LONG_ON_MS : SOS_SHORT_ON_MS;
-    sosPhaseUntilMs_ = nowMs + onMs;
-    return;
-  }
+bool StatusOutputs::ledOn(uint8_t led) const {
+  return led < STATUS_LED_COUNT && scheduler_.outputOn(leds_[led]);
+}
 
-  sosPhaseOn_ = false;
-  setOutput(false);
-  sosPhaseUntilMs_ = nowMs + SOS_OFF_MS;
-  ++sosPulseIndex_;
+bool StatusOutputs::signalOn() const {
+  return scheduler_.outputOn(signal_);
 }
 
 }  // namespace HeatControl
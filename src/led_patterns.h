@@ -1,43 +1,61 @@
 #pragma once
 
-#include <Arduino.h>
 #include <cstdint>
 
-namespace HeatControl {
-
-class LedPattern {
- public:
-  explicit LedPattern(int pin);
+#include "pattern_engine.h"
 
-  void begin();
-  void update(unsigned long nowMs);
+namespace HeatControl {
 
-  void setBaseOn(bool on);
-  void setTripLatched(bool latched);
+// Priority layers of the status outputs, highest first.
+enum class StatusLayer : uint8_t {
+  Signal = 0,  // signal sequencer pattern (both LEDs and SIGNAL_PIN)
+  Trip = 1,    // MOSFET overtemp latched: SOS
+  Step = 2,    // manual power step blinks
+  Base = 3,    // battery presence
+};
 
-  void triggerManualPowerStepFromPercent(uint8_t manualPowerPercent);
+constexpr uint8_t STATUS_LED_COUNT = 2;
 
- private:
-  void setOutput(bool on);
+// Manual power step: 1..4 blinks (start() argument) of 130 ms on/off at the Middle preset. The
+// output goes back to the base level one tick after the last blink is switched off.
+constexpr logic::PatternOp LED_STEP_BLINK_OPS[] = {
+    logic::patternOn(130),       logic::patternRepeatArg(4), logic::patternOff(0),
+    logic::patternEnd(),         logic::patternOff(130),     logic::patternLoop(0),
+};
+// Overtemp trip: ... --- ... then 800 ms dark, forever; not scaled by the timing preset.
+constexpr logic::PatternOp LED_TRIP_SOS_OPS[] = {
+    logic::patternOn(150),  logic::patternOff(150), logic::patternRepeat(0, 3),
+    logic::patternOn(450),  logic::patternOff(150), logic::patternRepeat(3, 3),
+    logic::patternOn(150),  logic::patternOff(150), logic::patternRepeat(6, 3),
+    logic::patternOff(800), logic::patternLoop(0),
+};
+constexpr logic::PatternProgram LED_STEP_BLINK = logic::patternProgram(LED_STEP_BLINK_OPS, true);
+constexpr logic::PatternProgram LED_TRIP_SOS = logic::patternProgram(LED_TRIP_SOS_OPS, false);
 
-  void updateTrip(unsigned long nowMs);
-  void updateStepBlink(unsigned long nowMs);
-  void updateBase();
+// Both battery LEDs and SIGNAL_PIN on one pattern scheduler, ticked from loop().
+class StatusOutputs {
+ public:
+  StatusOutputs(int led1Pin, int led2Pin, int signalPin);
 
-  int pin_;
-  bool baseOn_ = false;
-  bool tripLatched_ = false;
+  // Writes the idle levels (LEDs off, SIGNAL_PIN HIGH).
+  void begin(logic::IGpio &gpio);
+  void tick(unsigned long nowMs, SignalTimingPreset preset, logic::IGpio &gpio);
 
-  bool outputOn_ = false;
+  // led: 0 = battery 1, 1 = battery 2.
+  void setBaseOn(uint8_t led, bool on);
+  void setTripLatched(uint8_t led, bool latched);
+  void triggerManualPowerStepFromPercent(uint8_t led, uint8_t manualPowerPercent);
+  // Level of the signal sequencer; while active it owns all three outputs.
+  void setSignal(bool active, bool on);
 
-  uint8_t stepBlinksRemaining_ = 0;
-  bool stepPhaseOn_ = false;
-  unsigned long stepPhaseUntilMs_ = 0;
+  bool ledOn(uint8_t led) const;
+  bool signalOn() const;
 
-  uint8_t sosPulseIndex_ = 0;
-  bool sosPhaseOn_ = false;
-  unsigned long sosPhaseUntilMs_ = 0;
+ private:
+  logic::PatternScheduler scheduler_;
+  uint8_t leds_[STATUS_LED_COUNT];
+  uint8_t signal_;
+  bool tripLatched_[STATUS_LED_COUNT] = {false, false};
 };
 
 }  // namespace HeatControl
-
@@ -11,71 +11,198 @@ namespace logic_helpers {
 
 namespace {
 
+template <size_t... I>
+struct IndexList {};
+template <size_t N, size_t... I>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+template <size_t... I>
+struct MakeIndexList<0, I...> : IndexList<I...> {};
+
 struct VoltToSoc {
-  float volt;
+  uint16_t milliVolts;
   uint8_t soc;
 };
 
 constexpr VoltToSoc VOLT_TO_SOC_LI_ION[] = {
-    {4.18F, 100}, {4.10F, 96}, {3.99F, 82}, {3.85F, 68}, {3.77F, 58}, {3.58F, 34},
-    {3.42F, 20},  {3.33F, 14}, {3.21F, 8},  {3.00F, 2},  {2.87F, 0},
+    {4180, 100}, {4100, 96}, {3990, 82}, {3850, 68}, {3770, 58}, {3580, 34},
+    {3420, 20},  {3330, 14}, {3210, 8},  {3000, 2},  {2870, 0},
 };
 
 constexpr VoltToSoc VOLT_TO_SOC_LI_PO[] = {
-    {4.20F, 100}, {4.12F, 96}, {4.00F, 84}, {3.90F, 72}, {3.82F, 62}, {3.73F, 50},
-    {3.63F, 34},  {3.52F, 20}, {3.42F, 10}, {3.25F, 2},  {3.10F, 0},
+    {4200, 100}, {4120, 96}, {4000, 84}, {3900, 72}, {3820, 62}, {3730, 50},
+    {3630, 34},  {3520, 20}, {3420, 10}, {3250, 2},  {3100, 0},
 };
 
 constexpr VoltToSoc VOLT_TO_SOC_LI_FE_PO4[] = {
-    {3.60F, 100}, {3.45F, 96}, {3.38F, 86}, {3.34F, 72}, {3.30F, 58}, {3.26F, 42},
-    {3.22F, 26},  {3.18F, 14}, {3.12F, 8},  {3.05F, 2},  {2.95F, 0},
+    {3600, 100}, {3450, 96}, {3380, 86}, {3340, 72}, {3300, 58}, {3260, 42},
+    {3220, 26},  {3180, 14}, {3120, 8},  {3050, 2},  {2950, 0},
 };
 
 constexpr VoltToSoc VOLT_TO_SOC_NI_MH[] = {
-    {1.45F, 100}, {1.40F, 96}, {1.36F, 88}, {1.33F, 78}, {1.30F, 64}, {1.27F, 50},
-    {1.24F, 36},  {1.21F, 22}, {1.18F, 12}, {1.12F, 4},  {1.05F, 0},
+    {1450, 100}, {1400, 96}, {1360, 88}, {1330, 78}, {1300, 64}, {1270, 50},
+    {1240, 36},  {1210, 22}, {1180, 12}, {1120, 4},  {1050, 0},
 };
 
 constexpr VoltToSoc VOLT_TO_SOC_LEAD_GEL[] = {
-    {2.15F, 100}, {2.12F, 95}, {2.10F, 88}, {2.08F, 78}, {2.05F, 64}, {2.03F, 50},
-    {2.00F, 36},  {1.98F, 24}, {1.95F, 12}, {1.90F, 4},  {1.85F, 0},
+    {2150, 100}, {2120, 95}, {2100, 88}, {2080, 78}, {2050, 64}, {2030, 50},
+    {2000, 36},  {1980, 24}, {1950, 12}, {1900, 4},  {1850, 0},
+};
+
+// Every curve point sits on the 10 mV grid, so interpolating the grid reproduces the curve exactly.
+constexpr uint16_t SOC_LUT_STEP_MV = 10;
+
+constexpr bool onSocGrid(const VoltToSoc *points, size_t count) {
+  return count == 0U || (points[0].milliVolts % SOC_LUT_STEP_MV == 0U && onSocGrid(points + 1, count - 1U));
+}
+
+static_assert(onSocGrid(VOLT_TO_SOC_LI_ION, sizeof(VOLT_TO_SOC_LI_ION) / sizeof(VOLT_TO_SOC_LI_ION[0])) &&
+                  onSocGrid(VOLT_TO_SOC_LI_PO, sizeof(VOLT_TO_SOC_LI_PO) / sizeof(VOLT_TO_SOC_LI_PO[0])) &&
+                  onSocGrid(VOLT_TO_SOC_LI_FE_PO4, sizeof(VOLT_TO_SOC_LI_FE_PO4) / sizeof(VOLT_TO_SOC_LI_FE_PO4[0])) &&
+                  onSocGrid(VOLT_TO_SOC_NI_MH, sizeof(VOLT_TO_SOC_NI_MH) / sizeof(VOLT_TO_SOC_NI_MH[0])) &&
+                  onSocGrid(VOLT_TO_SOC_LEAD_GEL, sizeof(VOLT_TO_SOC_LEAD_GEL) / sizeof(VOLT_TO_SOC_LEAD_GEL[0])),
+              "SoC curve points must be multiples of SOC_LUT_STEP_MV");
+
+// SoC in 1/100 % between points[0] and points[1] (descending voltages), rounded to nearest.
+constexpr int32_t socSegmentCenti(const VoltToSoc *points, uint16_t milliVolts) {
+  return static_cast<int32_t>(points[1].soc) * 100 +
+         (static_cast<int32_t>(milliVolts - points[1].milliVolts) * (points[0].soc - points[1].soc) * 100 +
+          (points[0].milliVolts - points[1].milliVolts) / 2) /
+             (points[0].milliVolts - points[1].milliVolts);
+}
+
+constexpr int32_t socCentiAt(const VoltToSoc *points, size_t count, uint16_t milliVolts) {
+  return count <= 2U || milliVolts >= points[1].milliVolts ? socSegmentCenti(points, milliVolts)
+                                                           : socCentiAt(points + 1, count - 1U, milliVolts);
+}
+
+template <size_t Points>
+constexpr size_t socLutSize(const VoltToSoc (&points)[Points]) {
+  return (points[0].milliVolts - points[Points - 1].milliVolts) / SOC_LUT_STEP_MV + 1U;
+}
+
+template <size_t N>
+struct SocLut {
+  int16_t centi[N];  // entry i holds the SoC at the lowest curve voltage + i * SOC_LUT_STEP_MV
+};
+
+template <size_t Points, size_t... I>
+constexpr SocLut<sizeof...(I)> makeSocLut(const VoltToSoc (&points)[Points], IndexList<I...>) {
+  return SocLut<sizeof...(I)>{{static_cast<int16_t>(
+      socCentiAt(points, Points, static_cast<uint16_t>(points[Points - 1].milliVolts + I * SOC_LUT_STEP_MV)))...}};
+}
+
+constexpr SocLut<socLutSize(VOLT_TO_SOC_LI_ION)> SOC_LUT_LI_ION =
+    makeSocLut(VOLT_TO_SOC_LI_ION, MakeIndexList<socLutSize(VOLT_TO_SOC_LI_ION)>());
+constexpr SocLut<socLutSize(VOLT_TO_SOC_LI_PO)> SOC_LUT_LI_PO =
+    makeSocLut(VOLT_TO_SOC_LI_PO, MakeIndexList<socLutSize(VOLT_TO_SOC_LI_PO)>());
+constexpr SocLut<socLutSize(VOLT_TO_SOC_LI_FE_PO4)> SOC_LUT_LI_FE_PO4 =
+    makeSocLut(VOLT_TO_SOC_LI_FE_PO4, MakeIndexList<socLutSize(VOLT_TO_SOC_LI_FE_PO4)>());
+constexpr SocLut<socLutSize(VOLT_TO_SOC_NI_MH)> SOC_LUT_NI_MH =
+    makeSocLut(VOLT_TO_SOC_NI_MH, MakeIndexList<socLutSize(VOLT_TO_SOC_NI_MH)>());
+constexpr SocLut<socLutSize(VOLT_TO_SOC_LEAD_GEL)> SOC_LUT_LEAD_GEL =
+    makeSocLut(VOLT_TO_SOC_LEAD_GEL, MakeIndexList<socLutSize(VOLT_TO_SOC_LEAD_GEL)>());
+
+struct SocCurve {
+  const VoltToSoc *points;
+  size_t pointCount;
+  const int16_t *lut;
 };
 
-const VoltToSoc *selectSocCurve(uint8_t chemistry, size_t &tableSize) {
+template <size_t Points, size_t N>
+SocCurve socCurve(const VoltToSoc (&points)[Points], const SocLut<N> &lut) {
+  return SocCurve{points, Points, lut.centi};
+}
+
+SocCurve selectSocCurve(uint8_t chemistry) {
   if (chemistry == BATTERY_CHEMISTRY_LI_PO) {
-    tableSize = sizeof(VOLT_TO_SOC_LI_PO) / sizeof(VOLT_TO_SOC_LI_PO[0]);
-    return VOLT_TO_SOC_LI_PO;
+    return socCurve(VOLT_TO_SOC_LI_PO, SOC_LUT_LI_PO);
   }
   if (chemistry == BATTERY_CHEMISTRY_LI_FE_PO4) {
-    tableSize = sizeof(VOLT_TO_SOC_LI_FE_PO4) / sizeof(VOLT_TO_SOC_LI_FE_PO4[0]);
-    return VOLT_TO_SOC_LI_FE_PO4;
+    return socCurve(VOLT_TO_SOC_LI_FE_PO4, SOC_LUT_LI_FE_PO4);
   }
   if (chemistry == BATTERY_CHEMISTRY_NI_MH) {
-    tableSize = sizeof(VOLT_TO_SOC_NI_MH) / sizeof(VOLT_TO_SOC_NI_MH[0]);
-    return VOLT_TO_SOC_NI_MH;
+    return socCurve(VOLT_TO_SOC_NI_MH, SOC_LUT_NI_MH);
   }
   if (chemistry == BATTERY_CHEMISTRY_LEAD_GEL) {
-    tableSize = sizeof(VOLT_TO_SOC_LEAD_GEL) / sizeof(VOLT_TO_SOC_LEAD_GEL[0]);
-    return VOLT_TO_SOC_LEAD_GEL;
+    return socCurve(VOLT_TO_SOC_LEAD_GEL, SOC_LUT_LEAD_GEL);
   }
-  tableSize = sizeof(VOLT_TO_SOC_LI_ION) / sizeof(VOLT_TO_SOC_LI_ION[0]);
-  return VOLT_TO_SOC_LI_ION;
+  return socCurve(VOLT_TO_SOC_LI_ION, SOC_LUT_LI_ION);
 }
 
+// ln() for the table generator; std::log is not constexpr. Reduces to [0.75, 1.5) by powers of two,
+// then sums 2 * atanh((x - 1) / (x + 1)), whose terms shrink by at least 25x each.
+constexpr double LN_2 = 0.69314718055994530942;
+
+constexpr double lnSeries(double y2, double term, int n) {
+  return n > 25 ? 0.0 : term / n + lnSeries(y2, term * y2, n + 2);
+}
+
+constexpr double constLn(double x, int exponent = 0) {
+  return x >= 1.5    ? constLn(x / 2.0, exponent + 1)
+         : x < 0.75 ? constLn(x * 2.0, exponent - 1)
+                    : exponent * LN_2 + 2.0 * lnSeries(((x - 1.0) / (x + 1.0)) * ((x - 1.0) / (x + 1.0)),
+                                                       (x - 1.0) / (x + 1.0), 1);
+}
+
+constexpr int32_t roundToInt(double value) {
+  return value >= 0.0 ? static_cast<int32_t>(value + 0.5) : -static_cast<int32_t>(-value + 0.5);
+}
+
+constexpr uint16_t NTC_LUT_STEP_MV = 16;
+constexpr size_t NTC_LUT_SIZE = static_cast<size_t>(NTC_VCC_MV) / NTC_LUT_STEP_MV + 1U;
+
+// 0 mV means an open NTC, i.e. infinite resistance, whose limit is absolute zero.
+constexpr int32_t ntcCentiAt(double milliVolts) {
+  return milliVolts <= 0.0
+             ? -27315
+             : roundToInt(100.0 / (1.0 / (static_cast<double>(NTC_NOMINAL_TEMP_C) + 273.15) +
+                                   constLn(NTC_SERIES_RESISTOR_OHM * (NTC_VCC_MV / milliVolts - 1.0) /
+                                           NTC_NOMINAL_RESISTANCE_OHM) /
+                                       NTC_BETA) -
+                          27315.0);
+}
+
+struct NtcLut {
+  int32_t centi[NTC_LUT_SIZE];  // entry i holds the temperature at i * NTC_LUT_STEP_MV
+};
+
+template <size_t... I>
+constexpr NtcLut makeNtcLut(IndexList<I...>) {
+  return NtcLut{{ntcCentiAt(static_cast<double>(I * NTC_LUT_STEP_MV))...}};
+}
+
+constexpr NtcLut NTC_LUT = makeNtcLut(MakeIndexList<NTC_LUT_SIZE>());
+
 }  // namespace
 
+uint16_t nominalCellMilliVolts(uint8_t chemistry) {
+  switch (chemistry) {
+    case BATTERY_CHEMISTRY_LI_PO:
+      return 3700;
+    case BATTERY_CHEMISTRY_LI_FE_PO4:
+      return 3200;
+    case BATTERY_CHEMISTRY_NI_MH:
+      return 1200;
+    case BATTERY_CHEMISTRY_LEAD_GEL:
+      return 2000;
+    case BATTERY_CHEMISTRY_LI_ION:
+    default:
+      return 3600;
+  }
+}
+
 float voltageToSocFloat(float cellVolt, uint8_t chemistry) {
-  size_t tableSize = 0;
-  const VoltToSoc *table = selectSocCurve(clampBatteryChemistry(chemistry), tableSize);
-  const size_t last = tableSize - 1;
+  const SocCurve curve = selectSocCurve(clampBatteryChemistry(chemistry));
+  const VoltToSoc *table = curve.points;
+  const size_t last = curve.pointCount - 1;
 
-  if (cellVolt >= table[0].volt) {
+  if (cellVolt >= table[0].milliVolts / 1000.0F) {
     return static_cast<float>(table[0].soc);
   }
 
-  if (cellVolt <= table[last].volt) {
-    const float vHigh = table[last - 1].volt;
-    const float vLow = table[last].volt;
+  if (cellVolt <= table[last].milliVolts / 1000.0F) {
+    const float vHigh = table[last - 1].milliVolts / 1000.0F;
+    const float vLow = table[last].milliVolts / 1000.0F;
     const float socHigh = static_cast<float>(table[last - 1].soc);
     const float socLow = static_cast<float>(table[last].soc);
     const float t = (cellVolt - vLow) / (vHigh - vLow);
@@ -83,8 +210,8 @@ float voltageToSocFloat(float cellVolt, uint8_t chemistry) {
   }
 
   for (size_t i = 0; i < last; ++i) {
-    const float vHigh = table[i].volt;
-    const float vLow = table[i + 1].volt;
+    const float vHigh = table[i].milliVolts / 1000.0F;
+    const float vLow = table[i + 1].milliVolts / 1000.0F;
     if (cellVolt <= vHigh && cellVolt > vLow) {
       const float socHigh = static_cast<float>(table[i].soc);
       const float socLow = static_cast<float>(table[i + 1].soc);
@@ -96,6 +223,32 @@ float voltageToSocFloat(float cellVolt, uint8_t chemistry) {
   return 0.0F;
 }
 
+int32_t voltageToSocCenti(uint16_t cellMilliVolts, uint8_t chemistry) {
+  const SocCurve curve = selectSocCurve(clampBatteryChemistry(chemistry));
+  const VoltToSoc &top = curve.points[0];
+  const VoltToSoc &high = curve.points[curve.pointCount - 2U];
+  const VoltToSoc &low = curve.points[curve.pointCount - 1U];
+
+  if (cellMilliVolts >= top.milliVolts) {
+    return static_cast<int32_t>(top.soc) * 100;
+  }
+  if (cellMilliVolts < low.milliVolts) {
+    // Same slope as the lowest segment, like voltageToSocFloat().
+    const int32_t span = high.milliVolts - low.milliVolts;
+    const int32_t below = static_cast<int32_t>(low.milliVolts - cellMilliVolts) * (high.soc - low.soc) * 100;
+    return static_cast<int32_t>(low.soc) * 100 - (below + span / 2) / span;
+  }
+
+  const uint32_t offset = static_cast<uint32_t>(cellMilliVolts - low.milliVolts);
+  const uint32_t index = offset / SOC_LUT_STEP_MV;
+  const int32_t remainder = static_cast<int32_t>(offset % SOC_LUT_STEP_MV);
+  const int32_t base = curve.lut[index];
+  if (remainder == 0) {
+    return base;
+  }
+  return base + ((curve.lut[index + 1U] - base) * remainder + SOC_LUT_STEP_MV / 2) / SOC_LUT_STEP_MV;
+}
+
 uint8_t clampSocPercent(float soc) {
   if (soc <= 0.0F) return 0;
   if (soc >= 100.0F) return 100;
@@ -103,13 +256,20 @@ uint8_t clampSocPercent(float soc) {
 }
 
 float updateBatteryFromAdc(uint16_t adcMilliVolts, uint8_t cellCount, float dividerRatio, float &packV, float &cellV,
-                           uint8_t chemistry, float &socSmoothed, bool &smoothingInitialized, uint8_t &socPercent) {
+                           uint8_t chemistry, float &socSmoothed, bool &smoothingInitialized, uint8_t &socPercent,
+                           uint16_t restAdcMilliVolts) {
   constexpr float SOC_EMA_ALPHA = 0.18F;
-  const float adcV = static_cast<float>(adcMilliVolts) / 1000.0F;
-  packV = adcV * dividerRatio;
+  const uint32_t packMilliVolts = static_cast<uint32_t>(static_cast<float>(adcMilliVolts) * dividerRatio + 0.5F);
+  packV = static_cast<float>(packMilliVolts) / 1000.0F;
   const uint8_t cells = cellCount == 0 ? 3 : cellCount;
   cellV = packV / static_cast<float>(cells);
-  const float socRaw = voltageToSocFloat(cellV, chemistry);
+  const uint32_t restPackMilliVolts =
+      restAdcMilliVolts == 0U ? packMilliVolts
+                              : static_cast<uint32_t>(static_cast<float>(restAdcMilliVolts) * dividerRatio + 0.5F);
+  const uint32_t cellMilliVolts = (restPackMilliVolts + cells / 2U) / cells;
+  const float socRaw =
+      static_cast<float>(voltageToSocCenti(static_cast<uint16_t>(std::min<uint32_t>(cellMilliVolts, 0xFFFFU)), chemistry)) /
+      100.0F;
   if (!smoothingInitialized) {
     socSmoothed = socRaw;
     smoothingInitialized = true;
@@ -120,6 +280,21 @@ float updateBatteryFromAdc(uint16_t adcMilliVolts, uint8_t cellCount, float divi
   return socRaw;
 }
 
+bool ntcMilliVoltsToCentiC(uint16_t adcMilliVolts, int32_t &centiC) {
+  if (adcMilliVolts == 0U || adcMilliVolts >= static_cast<uint16_t>(NTC_VCC_MV)) {
+    return false;
+  }
+  const uint32_t index = adcMilliVolts / NTC_LUT_STEP_MV;
+  if (index + 1U >= NTC_LUT_SIZE) {
+    centiC = NTC_LUT.centi[NTC_LUT_SIZE - 1U];
+    return true;
+  }
+  const int32_t remainder = static_cast<int32_t>(adcMilliVolts % NTC_LUT_STEP_MV);
+  const int32_t base = NTC_LUT.centi[index];
+  centiC = base + ((NTC_LUT.centi[index + 1U] - base) * remainder + NTC_LUT_STEP_MV / 2) / NTC_LUT_STEP_MV;
+  return true;
+}
+
 bool ntcMilliVoltsToTempC(uint16_t adcMilliVolts, float vccMilliVolts, float seriesResistorOhm,
                           float nominalResistorOhm, float betaValue, float nominalTempC, float &tempC) {
   const float vNodeMv = static_cast<float>(adcMilliVolts);
@@ -142,38 +317,121 @@ bool ntcMilliVoltsToTempC(uint16_t adcMilliVolts, float vccMilliVolts, float ser
   return true;
 }
 
-size_t appendLineToRollingBuffer(char *buffer, size_t bufferSize, size_t &currentLength, const char *line,
-                                 size_t lineLength) {
-  if (bufferSize == 0 || buffer == nullptr) {
-    currentLength = 0;
-    return 0;
+LogRing::LogRing(char *storage, size_t capacity) : storage_(storage), capacity_(storage != nullptr ? capacity : 0U) {}
+
+void LogRing::append(const char *line, size_t length) {
+  if (capacity_ < 2U || line == nullptr) {
+    return;
+  }
+  const size_t maxText = capacity_ - 1U;
+  if (length > maxText) {
+    line += length - maxText;
+    length = maxText;
+  }
+  while (used_ + length + 1U > capacity_) {
+    dropOldestLine();
   }
 
-  if (line == nullptr || lineLength == 0) {
-    return currentLength;
+  size_t index = indexOf(static_cast<uint32_t>(used_));
+  for (size_t i = 0; i < length; ++i) {
+    storage_[index] = line[i] == '\n' ? ' ' : line[i];
+    index = index + 1U == capacity_ ? 0U : index + 1U;
   }
+  storage_[index] = '\n';
+  used_ += length + 1U;
+  ++nextSeq_;
+}
 
-  const size_t maxLen = bufferSize - 1;
-  const size_t appendLen = std::min(lineLength + 1, bufferSize) - 1;
+void LogRing::dropOldestLine() {
+  size_t dropped = 0;
+  while (dropped < used_) {
+    const char c = storage_[indexOf(static_cast<uint32_t>(dropped))];
+    ++dropped;
+    if (c == '\n') {
+      break;
+    }
+  }
+  start_ = indexOf(static_cast<uint32_t>(dropped));
+  used_ -= dropped;
+  discarded_ += static_cast<uint32_t>(dropped);
+  ++firstSeq_;
+}
 
-  if (appendLen >= maxLen) {
-    const size_t copyOffset = lineLength - maxLen;
-    std::memcpy(buffer, line + copyOffset, maxLen);
-    buffer[maxLen] = '\0';
-    currentLength = maxLen;
-    return currentLength;
+uint32_t LogRing::positionOf(uint32_t seq) const {
+  // Sequence numbers wrap like positions; compare through the signed distance.
+  if (static_cast<int32_t>(seq - firstSeq_) <= 0) {
+    return discarded_;
+  }
+  if (static_cast<int32_t>(seq - nextSeq_) >= 0) {
+    return endPosition();
   }
+  uint32_t linesToSkip = seq - firstSeq_;
+  size_t offset = 0;
+  while (linesToSkip > 0U && offset < used_) {
+    if (storage_[indexOf(static_cast<uint32_t>(offset))] == '\n') {
+      --linesToSkip;
+    }
+    ++offset;
+  }
+  return discarded_ + static_cast<uint32_t>(offset);
+}
 
-  if (currentLength + appendLen > maxLen) {
-    const size_t overflow = (currentLength + appendLen) - maxLen;
-    std::memmove(buffer, buffer + overflow, currentLength - overflow);
-    currentLength -= overflow;
+size_t LogRing::read(uint32_t &position, uint32_t end, char *out, size_t maxLen) const {
+  if (out == nullptr || capacity_ == 0U) {
+    return 0;
+  }
+  uint32_t offset = position - discarded_;
+  if (offset > used_) {
+    offset = 0;
+    position = discarded_;
+  }
+  if (static_cast<int32_t>(end - position) <= 0) {
+    return 0;
+  }
+  const uint32_t available = end - position;
+  size_t count = available > used_ - offset ? used_ - offset : available;
+  if (count > maxLen) {
+    count = maxLen;
   }
+  const size_t first = indexOf(offset);
+  const size_t firstPart = std::min(count, capacity_ - first);
+  std::memcpy(out, storage_ + first, firstPart);
+  std::memcpy(out + firstPart, storage_, count - firstPart);
+  position += static_cast<uint32_t>(count);
+  return count;
+}
 
-  std::memcpy(buffer + currentLength, line, appendLen);
-  currentLength += appendLen;
-  buffer[currentLength] = '\0';
-  return currentLength;
+size_t formatRuntime(unsigned long seconds, bool showSeconds, char *out, size_t outSize) {
+  if (out == nullptr || outSize == 0U) {
+    return 0;
+  }
+  const unsigned long parts[4] = {seconds / 86400UL, seconds % 86400UL / 3600UL, seconds % 3600UL / 60UL,
+                                  seconds % 60UL};
+  const char units[4] = {'d', 'h', 'm', 's'};
+  size_t length = 0;
+  out[0] = '\0';
+  for (uint8_t i = 0; i < 4; ++i) {
+    const bool isSeconds = i == 3U;
+    if ((isSeconds && !showSeconds) || (!isSeconds && parts[i] == 0UL)) {
+      continue;
+    }
+    // Same text as the String version always produced, trailing space after minutes included.
+    const int written = snprintf(out + length, outSize - length, isSeconds ? "%lu%c" : "%lu%c ", parts[i], units[i]);
+    if (written < 0) {
+      break;
+    }
+    length += static_cast<size_t>(written);
+    if (length >= outSize) {
+      return outSize - 1U;
+    }
+  }
+  if (length == 0U) {
+    length = static_cast<size_t>(snprintf(out, outSize, "%s", showSeconds ? "0s" : "0m"));
+    if (length >= outSize) {
+      length = outSize - 1U;
+    }
+  }
+  return length;
 }
 
 std::string jsonEscape(const std::string &value) {
@@ -7,16 +7,77 @@
 namespace HeatControl {
 namespace logic_helpers {
 
+// Board NTC divider: 3.3V -> NTC (10k, B3950) -> ADC node -> 10k resistor -> GND.
+constexpr float NTC_VCC_MV = 3300.0F;
+constexpr float NTC_SERIES_RESISTOR_OHM = 10000.0F;
+constexpr float NTC_NOMINAL_RESISTANCE_OHM = 10000.0F;
+constexpr float NTC_BETA = 3950.0F;
+constexpr float NTC_NOMINAL_TEMP_C = 25.0F;
+
 float voltageToSocFloat(float cellVolt, uint8_t chemistry);
+// Integer version for the FPU-less target: state of charge in 1/100 % from a compile-time table
+// with one entry per 10 mV of cell voltage. Matches voltageToSocFloat(), including the linear
+// extrapolation below the curve, to within 0.01 %.
+int32_t voltageToSocCenti(uint16_t cellMilliVolts, uint8_t chemistry);
 uint8_t clampSocPercent(float soc);
+// Nominal cell voltage of a BATTERY_CHEMISTRY_* (unknown values: Li-ion).
+uint16_t nominalCellMilliVolts(uint8_t chemistry);
+// packV/cellV follow adcMilliVolts; the SoC comes from restAdcMilliVolts when given (the reading
+// with the heater's load sag added back, see logic::PackResistanceEstimator), since the SoC curve
+// is an open-circuit curve. Returns the unsmoothed SoC.
 float updateBatteryFromAdc(uint16_t adcMilliVolts, uint8_t cellCount, float dividerRatio, float &packV, float &cellV,
-                           uint8_t chemistry, float &socSmoothed, bool &smoothingInitialized, uint8_t &socPercent);
+                           uint8_t chemistry, float &socSmoothed, bool &smoothingInitialized, uint8_t &socPercent,
+                           uint16_t restAdcMilliVolts = 0);
 
 bool ntcMilliVoltsToTempC(uint16_t adcMilliVolts, float vccMilliVolts, float seriesResistorOhm,
                           float nominalResistorOhm, float betaValue, float nominalTempC, float &tempC);
+// ntcMilliVoltsToTempC() for the board divider above, in 1/100 degC, from a compile-time table with
+// one entry per 16 mV and integer interpolation; within 0.05 degC of the float version from 100 to
+// 3000 mV (-37..88 degC). False outside (0, NTC_VCC_MV); readings beyond the last table entry
+// (above ~330 degC) clamp to it.
+bool ntcMilliVoltsToCentiC(uint16_t adcMilliVolts, int32_t &centiC);
+
+// Circular log of newline-terminated lines over caller-provided storage. Appending costs O(line):
+// only the oldest lines needed to make room are dropped. Every line gets the next sequence number;
+// readers resume from a sequence number (or an absolute byte position) instead of copying it all.
+class LogRing {
+ public:
+  LogRing(char *storage, size_t capacity);
+
+  // Stores `line` plus a terminating '\n'. Embedded newlines become spaces so one call stays one
+  // line; a line longer than the ring keeps only its tail.
+  void append(const char *line, size_t length);
+
+  uint32_t firstSeq() const { return firstSeq_; }  // oldest line still held
+  uint32_t nextSeq() const { return nextSeq_; }    // sequence the next appended line gets
+  size_t size() const { return used_; }
+  size_t capacity() const { return capacity_; }
+
+  // Absolute byte position where line `seq` starts. Lines already dropped resolve to the oldest
+  // one held, lines not written yet to endPosition(). Positions only grow (modulo 2^32).
+  uint32_t positionOf(uint32_t seq) const;
+  uint32_t endPosition() const { return discarded_ + static_cast<uint32_t>(used_); }
+
+  // Copies up to `maxLen` bytes from `position` towards `end` and advances `position`. A position
+  // whose bytes were overwritten meanwhile first skips ahead to the oldest line still held.
+  size_t read(uint32_t &position, uint32_t end, char *out, size_t maxLen) const;
+
+ private:
+  void dropOldestLine();
+  size_t indexOf(uint32_t offset) const { return (start_ + offset) % capacity_; }
+
+  char *storage_;
+  size_t capacity_;
+  size_t start_ = 0;       // storage index of the oldest byte
+  size_t used_ = 0;
+  uint32_t discarded_ = 0;  // bytes dropped so far, i.e. the absolute position of start_
+  uint32_t firstSeq_ = 0;
+  uint32_t nextSeq_ = 0;
+};
 
-size_t appendLineToRollingBuffer(char *buffer, size_t bufferSize, size_t &currentLength, const char *line,
-                                 size_t lineLength);
+// Duration as "1d 2h 3m 4s" without the zero units ("0s", or "0m" without seconds; "2h 5m " keeps
+// its trailing space). Truncates to fit `outSize`; returns the length written.
+size_t formatRuntime(unsigned long seconds, bool showSeconds, char *out, size_t outSize);
 
 std::string jsonEscape(const std::string &value);
 
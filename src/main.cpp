@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <EEPROM.h>
 #include <LittleFS.h>
 #include <WiFi.h>
 #include <cstdarg>
@@ -8,11 +7,13 @@
 #include <cmath>
 #include <esp_system.h>
 
+#include "adc_input.h"
 #include "app_state.h"
-#include "battery_toggle.h"
 #include "control.h"
+#include "control_cycle.h"
 #include "led_patterns.h"
 #include "logic_helpers.h"
+#include "pack_resistance.h"
 #include "storage.h"
 #include "web_server.h"
 
@@ -20,23 +21,16 @@ using namespace HeatControl;
 
 namespace {
 
-// NTC input model:
-// 3.3V -> NTC (10k, B3950) -> ADC node -> 10k resistor -> GND
-constexpr float NTC_VCC_MV = 3300.0F;
-constexpr float NTC_SERIES_RESISTOR_OHM = 10000.0F;
-constexpr float NTC_NOMINAL_RESISTANCE_OHM = 10000.0F;
-constexpr float NTC_BETA = 3950.0F;
-constexpr float NTC_NOMINAL_TEMP_C = 25.0F;
 constexpr uint16_t BATTERY_ADC_OFF_THRESHOLD_MV = 80;
 constexpr uint16_t BATTERY_ADC_ON_THRESHOLD_MV = 300;
 constexpr uint8_t BATTERY_STABLE_SAMPLES = 2;
 constexpr char DEFAULT_WIFI_SSID_FALLBACK[] = "HeatControl";
 constexpr char DEFAULT_WIFI_PASSWORD_FALLBACK[] = "HeatControl";
 
-BatteryToggleDetector battery1Detector(BATTERY_ADC_OFF_THRESHOLD_MV, BATTERY_ADC_ON_THRESHOLD_MV, BATTERY_STABLE_SAMPLES);
-BatteryToggleDetector battery2Detector(BATTERY_ADC_OFF_THRESHOLD_MV, BATTERY_ADC_ON_THRESHOLD_MV, BATTERY_STABLE_SAMPLES);
-LedPattern batteryLed1(BATTERY_LED_PIN_1);
-LedPattern batteryLed2(BATTERY_LED_PIN_2);
+// Battery cadence, OFF/ON detection and runtime minutes; the dive simulation runs the same object.
+logic::HousekeepingCycle housekeepingCycle(BATTERY_ADC_OFF_THRESHOLD_MV, BATTERY_ADC_ON_THRESHOLD_MV,
+                                           BATTERY_STABLE_SAMPLES);
+StatusOutputs statusOutputs(BATTERY_LED_PIN_1, BATTERY_LED_PIN_2, SIGNAL_PIN);
 
 uint8_t lastManualPowerLedStep1 = 0;
 uint8_t lastManualPowerLedStep2 = 0;
@@ -59,6 +53,113 @@ const char *wifiModeToText(wifi_mode_t mode) {
   }
 }
 
+// Right after boot the acquisition task may not have a filtered value yet; 0 mV would read as a
+// battery OFF edge and seed the SoC smoothing with an empty battery.
+bool batteryAdcReady(const AdcReadings &adc) {
+  return adc.channel(AdcChannel::Battery1).steps > 0U && adc.channel(AdcChannel::Battery2).steps > 0U;
+}
+
+void logWeakPack(uint8_t battery, uint32_t sagPpm, bool valid, bool &reported) {
+  const bool weak = valid && sagPpm >= logic::PACK_SAG_WEAK_PPM;
+  if (weak && !reported) {
+    logf("Battery %u weak: sags %lu.%lu %% under heater load | source_mohm=%lu", static_cast<unsigned>(battery),
+         static_cast<unsigned long>(sagPpm / 10000UL), static_cast<unsigned long>(sagPpm / 1000UL % 10UL),
+         static_cast<unsigned long>(static_cast<float>(sagPpm) * heaterElementOhm / 1000.0F + 0.5F));
+  }
+  reported = weak;
+}
+
+// Measured pack voltages for display and the OFF/ON detector; the SoC uses the sag-corrected rest
+// voltage, so it no longer dips every time the heater switches on.
+void updateBatteriesFromAdc(const AdcReadings &adc) {
+  static bool weakReported[2] = {false, false};
+  adc1MilliVolts = adc.channel(AdcChannel::Battery1).milliVolts;
+  adc2MilliVolts = adc.channel(AdcChannel::Battery2).milliVolts;
+  const AdcPackReading &pack1 = adc.packs[0];
+  const AdcPackReading &pack2 = adc.packs[1];
+  logic_helpers::updateBatteryFromAdc(adc1MilliVolts, battery1CellCount, BATTERY_DIVIDER_RATIO, battery1PackVoltage,
+                                      battery1CellVoltage, battery1Chemistry, battery1SocSmoothed,
+                                      battery1SocSmoothingInitialized, battery1SocPercent, pack1.restMilliVolts);
+  logic_helpers::updateBatteryFromAdc(adc2MilliVolts, battery2CellCount, BATTERY_DIVIDER_RATIO, battery2PackVoltage,
+                                      battery2CellVoltage, battery2Chemistry, battery2SocSmoothed,
+                                      battery2SocSmoothingInitialized, battery2SocPercent, pack2.restMilliVolts);
+  battery1SagPpm = pack1.sagPpm;
+  battery1SagValid = pack1.valid;
+  battery2SagPpm = pack2.sagPpm;
+  battery2SagValid = pack2.valid;
+  logWeakPack(1, battery1SagPpm, battery1SagValid, weakReported[0]);
+  logWeakPack(2, battery2SagPpm, battery2SagValid, weakReported[1]);
+}
+
+// Robust OFF/ON detection on the filtered ADC (hysteresis and debounce). An OFF period shorter than
+// manualPowerToggleMaxOffMs is the diver's request to cycle that heater's manual power step.
+void handleManualToggles(unsigned long now) {
+  const uint16_t adcMilliVolts[2] = {adc1MilliVolts, adc2MilliVolts};
+  uint8_t currentMask = 0;
+  for (uint8_t i = 0; i < 2; ++i) {
+    const unsigned battery = i + 1U;
+    const uint16_t adcMv = adcMilliVolts[i];
+    const logic::ManualToggleResult toggle =
+        housekeepingCycle.detectToggle(i, adcMv, now, manualPowerToggleMaxOffMs);
+    const BatteryToggleDetector::SampleResult &sample = toggle.sample;
+
+    // Battery presence LEDs: only stable ON/OFF changes them, so the hysteresis band does not flicker.
+    if (sample.onNow) {
+      statusOutputs.setBaseOn(i, true);
+    } else if (sample.offNow) {
+      statusOutputs.setBaseOn(i, false);
+    }
+    if (adcMv >= BATTERY_ADC_ON_THRESHOLD_MV) {
+      currentMask |= static_cast<uint8_t>(1U << i);
+    }
+
+    // Edge logging for OFF/ON detection flags to debug threshold behavior.
+    if (sample.offEdge) {
+      logf(LogLevel::Debug, "Batt%uOffNow changed -> %d | adc%u_mv=%u (off_thresh=%u, on_thresh=%u)", battery,
+           sample.offNow ? 1 : 0, battery, adcMv, BATTERY_ADC_OFF_THRESHOLD_MV, BATTERY_ADC_ON_THRESHOLD_MV);
+    }
+    if (sample.onEdge) {
+      logf(LogLevel::Debug, "Batt%uOnNow changed  -> %d | adc%u_mv=%u (off_thresh=%u, on_thresh=%u)", battery,
+           sample.onNow ? 1 : 0, battery, adcMv, BATTERY_ADC_OFF_THRESHOLD_MV, BATTERY_ADC_ON_THRESHOLD_MV);
+    }
+
+    if (toggle.offEdge) {
+      logf(LogLevel::Debug, "Battery %u OFF edge detected | now_ms=%lu | adc%u_mv=%u", battery, now, battery, adcMv);
+    } else if (toggle.onEdge) {
+      logf(LogLevel::Debug, "Battery %u ON edge detected  | off_ms=%lu (limit=%u) | adc%u_mv=%u", battery,
+           static_cast<unsigned long>(toggle.offMs), static_cast<unsigned int>(manualPowerToggleMaxOffMs), battery,
+           adcMv);
+      if (toggle.step) {
+        uint8_t percent = 0;
+        if (i == 0U) {
+          cycleManualPowerPercent1();
+          percent = manualPowerPercent1;
+          lastManualPowerLedStep1 = percent;
+        } else {
+          cycleManualPowerPercent2();
+          percent = manualPowerPercent2;
+          lastManualPowerLedStep2 = percent;
+        }
+        logf(LogLevel::Info, "Battery %u OFF/ON trigger (%lums) -> manual power %u = %u%%", battery,
+             static_cast<unsigned long>(toggle.offMs), battery, percent);
+        // Haptic feedback for the manual heater power change.
+        signalManualPowerChange(percent);
+        statusOutputs.triggerManualPowerStepFromPercent(i, percent);
+      } else {
+        logf(LogLevel::Debug, "Battery %u OFF/ON ignored (off_ms too long for toggle window)", battery);
+      }
+    }
+  }
+
+  // Persist the last known battery presence mask (bit0 = battery1, bit1 = battery2) only when it
+  // changes, to avoid unnecessary flash wear.
+  static uint8_t lastSavedMask = 0xFFU;
+  if (currentMask != lastSavedMask) {
+    lastSavedMask = currentMask;
+    saveLastBatteryMask(currentMask);
+  }
+}
+
 uint32_t apAutoOffTimeoutMs() {
   return static_cast<uint32_t>(apAutoOffMinutes) * 60000UL;
 }
@@ -103,26 +204,42 @@ void handleWifiLifetime(unsigned long now) {
   disableAllWifiRadios();
 }
 
+// logf() is called from loop(), the AsyncTCP task and the control task; one writer at a time keeps
+// Serial lines and the log ring intact.
+SemaphoreHandle_t logMutex = nullptr;
+// Longer lines are cut, as the old fixed line buffer did.
+constexpr size_t kMaxLogLineLength = 319;
+
 void appendSerialLogLine(const char *line) {
   if (line == nullptr) {
     return;
   }
-  char lineBuf[320];
-  const int written = snprintf(lineBuf, sizeof(lineBuf), "%s\n", line);
-  if (written <= 0) {
-    return;
-  }
+  serialLog.append(line, strnlen(line, kMaxLogLineLength));
+}
 
-  const size_t appendLen =
-      static_cast<size_t>(written >= static_cast<int>(sizeof(lineBuf)) ? sizeof(lineBuf) - 1 : written);
-  logic_helpers::appendLineToRollingBuffer(serialLogBuffer, sizeof(serialLogBuffer), serialLogLength, lineBuf,
-                                           appendLen);
+void emitLogLine(const char *line) {
+  lockLogBuffer();
+  Serial.println(line);
+  appendSerialLogLine(line);
+  unlockLogBuffer();
 }
 
 }  // namespace
 
 namespace HeatControl {
 
+void lockLogBuffer() {
+  if (logMutex != nullptr) {
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+  }
+}
+
+void unlockLogBuffer() {
+  if (logMutex != nullptr) {
+    xSemaphoreGive(logMutex);
+  }
+}
+
 const char *logLevelToText(LogLevel level) {
   switch (level) {
     case LogLevel::Error:
@@ -176,16 +293,14 @@ void logLine(const char *line, LogLevel level) {
   if (!shouldLog(level) || line == nullptr) {
     return;
   }
-  Serial.println(line);
-  appendSerialLogLine(line);
+  emitLogLine(line);
 }
 
 void logLine(const String &line, LogLevel level) {
   if (!shouldLog(level)) {
     return;
   }
-  Serial.println(line);
-  appendSerialLogLine(line.c_str());
+  emitLogLine(line.c_str());
 }
 
 void logf(LogLevel level, const char *fmt, ...) {
@@ -197,8 +312,7 @@ void logf(LogLevel level, const char *fmt, ...) {
   va_start(args, fmt);
   vsnprintf(buffer, sizeof(buffer), fmt, args);
   va_end(args);
-  Serial.println(buffer);
-  appendSerialLogLine(buffer);
+  emitLogLine(buffer);
 }
 
 void logf(const char *fmt, ...) {
@@ -210,17 +324,19 @@ void logf(const char *fmt, ...) {
   va_start(args, fmt);
   vsnprintf(buffer, sizeof(buffer), fmt, args);
   va_end(args);
-  Serial.println(buffer);
-  appendSerialLogLine(buffer);
+  emitLogLine(buffer);
 }
 
 }  // namespace HeatControl
 
 void setup() {
+  logMutex = xSemaphoreCreateMutex();
+  initControlState();
   Serial.begin(115200);
   delay(500);
 
-  EEPROM.begin(EEPROM_SIZE);
+  fileSystemReady = LittleFS.begin(true);
+  beginSettingsStore();
 
   pinMode(SSR_PIN_1, OUTPUT);
   pinMode(SSR_PIN_2, OUTPUT);
@@ -230,9 +346,12 @@ void setup() {
   digitalWrite(SSR_PIN_1, LOW);
   digitalWrite(SSR_PIN_2, LOW);
   digitalWrite(SIGNAL_PIN, HIGH);
+  startHeaterOutputs();
 
-  batteryLed1.begin();
-  batteryLed2.begin();
+  pinMode(BATTERY_LED_PIN_1, OUTPUT);
+  pinMode(BATTERY_LED_PIN_2, OUTPUT);
+  ArduinoGpio gpio;
+  statusOutputs.begin(gpio);
 
   // ADC setup (ESP32-C3): 12-bit readings, extended input range.
   analogReadResolution(12);
@@ -240,6 +359,7 @@ void setup() {
   analogSetPinAttenuation(ADC_PIN_2, ADC_11db);
   analogSetPinAttenuation(ADC_PIN_NTC_MOSFET_1, ADC_11db);
   analogSetPinAttenuation(ADC_PIN_NTC_MOSFET_2, ADC_11db);
+  startAdcAcquisition();
   
   // Initialize state tracking
   lastHeater1State = (digitalRead(SSR_PIN_1) == HIGH);
@@ -257,7 +377,7 @@ void setup() {
   }
 
   sensors.begin();
-  const uint8_t sensorCount = static_cast<uint8_t>(sensors.getDeviceCount());
+  const uint8_t sensorCount = startTemperaturePipeline();
 
   // Normal (temperature-controlled) mode is only allowed when both sensors are present.
   // For any configuration with fewer than two sensors, fall back to manual PWM mode.
@@ -269,7 +389,7 @@ void setup() {
     lastManualPowerLedStep2 = manualPowerPercent2;
     if (digitalRead(INPUT_PIN) == HIGH) {
       // Short OFF/ON gesture in manual mode: adjust only the heater that belonged
-      // to the last active battery, if we have a clear mapping from EEPROM.
+      // to the last active battery, if we have a clear mapping in the settings store.
       const uint8_t lastMask = loadLastBatteryMask();
       if (lastMask == 0x01U) {
         cycleManualPowerPercent1();
@@ -290,6 +410,7 @@ void setup() {
   startupSignal(powerMode, manualMode, manualPowerPercent1);
   loadTemperatureTargets();
   loadSwapAssignment();
+  loadControlSettings();
   loadWiFiCredentials();
   loadApCredentials();
   loadApAutoOffMinutes();
@@ -301,6 +422,7 @@ void setup() {
   logf("Manual toggle window: %u ms (min=100, max=5000)", manualPowerToggleMaxOffMs);
   logf("AP auto-off timeout: %u min (0=disabled)", apAutoOffMinutes);
   loadSavedRuntime();
+  loadHeaterEnergy();
 
   if (activeApSsid.isEmpty()) {
     activeApSsid = "HeatControl";
@@ -312,9 +434,7 @@ void setup() {
   }
 
   startTimeMs = millis();
-  lastRuntimeSaveMs = millis();
-
-  fileSystemReady = LittleFS.begin(true);
+  housekeepingCycle.start(millis());
 
   WiFi.mode(WIFI_AP_STA);
   WiFi.persistent(false);
@@ -398,235 +518,60 @@ void setup() {
   logf("AP SSID: %s", activeApSsid.c_str());
   logf("Configured STA SSID: %s", activeSsid.c_str());
   logf("LittleFS: %s", fileSystemReady ? "ready" : "not ready");
-  logLine("HTTP: /, /status, /runtime, /setTemp, /setLogLevel, /setApEnabled, /saveSettings, /swapSensors, /setWiFi, /restart, /resetRuntime, /update, /signalTest, /logs");
+  logLine("HTTP: /, /status, /runtime, /setTemp, /setLogLevel, /setApEnabled, /saveSettings, /swapSensors, /setWiFi, /restart, /resetRuntime, /update, /ota/status, /storage/status, /signalTest, /logs, /ws");
   logf("SSR1: %s | SSR2: %s", heaterStateText(SSR_PIN_1).c_str(), heaterStateText(SSR_PIN_2).c_str());
+  startControlTask();
 }
 
 void loop() {
   const unsigned long now = millis();
 
-  batteryLed1.setTripLatched(mosfet1OvertempLatched);
-  batteryLed2.setTripLatched(mosfet2OvertempLatched);
+  statusOutputs.setTripLatched(0, mosfet1OvertempLatched);
+  statusOutputs.setTripLatched(1, mosfet2OvertempLatched);
 
   if (restartScheduled && (static_cast<long>(now - restartAtMs) >= 0)) {
     restartScheduled = false;
-    if (pendingTempPersist) {
-      saveTemperatureTargets();
-      pendingTempPersist = false;
-      logf(LogLevel::Info, "Pending temperature targets persisted before restart.");
-    }
+    flushPersistence();
     logLine("Restart scheduled: rebooting now.");
     delay(80);
     ESP.restart();
   }
 
-  // High-frequency ADC check for manual OFF/ON detection (better than 1s resolution).
-  static unsigned long lastManualToggleCheckMs = 0;
-  if (manualMode && (now - lastManualToggleCheckMs) >= 50UL) {
-    lastManualToggleCheckMs = now;
-
-    // Read ADC inputs (millivolts) and update battery state.
-    adc1MilliVolts = static_cast<uint16_t>(analogReadMilliVolts(ADC_PIN_1));
-    adc2MilliVolts = static_cast<uint16_t>(analogReadMilliVolts(ADC_PIN_2));
-    logic_helpers::updateBatteryFromAdc(adc1MilliVolts, battery1CellCount, BATTERY_DIVIDER_RATIO, battery1PackVoltage,
-                                        battery1CellVoltage, battery1Chemistry, battery1SocSmoothed,
-                                        battery1SocSmoothingInitialized, battery1SocPercent);
-    logic_helpers::updateBatteryFromAdc(adc2MilliVolts, battery2CellCount, BATTERY_DIVIDER_RATIO, battery2PackVoltage,
-                                        battery2CellVoltage, battery2Chemistry, battery2SocSmoothed,
-                                        battery2SocSmoothingInitialized, battery2SocPercent);
-
-    // Robust OFF/ON detection based on raw ADC with hysteresis and debounce.
-    const auto batt1Sample = battery1Detector.update(adc1MilliVolts);
-    const auto batt2Sample = battery2Detector.update(adc2MilliVolts);
-    const bool batt1OffNow = batt1Sample.offNow;
-    const bool batt1OnNow = batt1Sample.onNow;
-    const bool batt2OffNow = batt2Sample.offNow;
-    const bool batt2OnNow = batt2Sample.onNow;
-
-    // Battery presence LEDs: ON when battery is stably detected as ON.
-    // Avoid flicker in the hysteresis band by only updating on stable ON/OFF.
-    if (batt1OnNow) {
-      batteryLed1.setBaseOn(true);
-    } else if (batt1OffNow) {
-      batteryLed1.setBaseOn(false);
-    }
+  applyBatterySettingsChanges();
+  applyRuntimeReset();
 
-    if (batt2OnNow) {
-      batteryLed2.setBaseOn(true);
-    } else if (batt2OffNow) {
-      batteryLed2.setBaseOn(false);
-    }
-
-    // Persist last known battery presence mask (bit0 = battery1, bit1 = battery2)
-    // only when it changes, to avoid unnecessary EEPROM wear.
-    uint8_t currentMask = 0;
-    if (adc1MilliVolts >= BATTERY_ADC_ON_THRESHOLD_MV) {
-      currentMask |= 0x01U;
-    }
-    if (adc2MilliVolts >= BATTERY_ADC_ON_THRESHOLD_MV) {
-      currentMask |= 0x02U;
-    }
-    static uint8_t lastSavedMask = 0xFFU;
-    if (currentMask != lastSavedMask) {
-      lastSavedMask = currentMask;
-      saveLastBatteryMask(currentMask);
-    }
-
-    // Edge logging for OFF/ON detection flags to debug threshold behavior.
-    if (batt1Sample.offEdge) {
-      logf(LogLevel::Debug, "Batt1OffNow changed -> %d | adc1_mv=%u (off_thresh=%u, on_thresh=%u)", batt1OffNow ? 1 : 0,
-           adc1MilliVolts, BATTERY_ADC_OFF_THRESHOLD_MV, BATTERY_ADC_ON_THRESHOLD_MV);
-    }
-    if (batt1Sample.onEdge) {
-      logf(LogLevel::Debug, "Batt1OnNow changed  -> %d | adc1_mv=%u (off_thresh=%u, on_thresh=%u)", batt1OnNow ? 1 : 0,
-           adc1MilliVolts, BATTERY_ADC_OFF_THRESHOLD_MV, BATTERY_ADC_ON_THRESHOLD_MV);
-    }
-    if (batt2Sample.offEdge) {
-      logf(LogLevel::Debug, "Batt2OffNow changed -> %d | adc2_mv=%u (off_thresh=%u, on_thresh=%u)", batt2OffNow ? 1 : 0,
-           adc2MilliVolts, BATTERY_ADC_OFF_THRESHOLD_MV, BATTERY_ADC_ON_THRESHOLD_MV);
-    }
-    if (batt2Sample.onEdge) {
-      logf(LogLevel::Debug, "Batt2OnNow changed  -> %d | adc2_mv=%u (off_thresh=%u, on_thresh=%u)", batt2OnNow ? 1 : 0,
-           adc2MilliVolts, BATTERY_ADC_OFF_THRESHOLD_MV, BATTERY_ADC_ON_THRESHOLD_MV);
-    }
-
-    // Battery switch detection: treat an OFF period as a user trigger to cycle the manual PWM step
-    // only if power returns within manualPowerToggleMaxOffMs.
-    if (batt1OffNow && !battery1Off) {
-      battery1Off = true;
-      battery1OffSinceMs = now;
-      logf(LogLevel::Debug, "Battery 1 OFF edge detected | now_ms=%lu | adc1_mv=%u", now, adc1MilliVolts);
-    } else if (!batt1OffNow && batt1OnNow && battery1Off) {
-      const unsigned long offMs = now - battery1OffSinceMs;
-      battery1Off = false;
-      logf(LogLevel::Debug, "Battery 1 ON edge detected  | off_ms=%lu (limit=%u) | adc1_mv=%u", offMs,
-           static_cast<unsigned int>(manualPowerToggleMaxOffMs), adc1MilliVolts);
-      if (offMs <= static_cast<unsigned long>(manualPowerToggleMaxOffMs)) {
-        cycleManualPowerPercent1();
-        logf(LogLevel::Info, "Battery 1 OFF/ON trigger (%lums) -> manual power 1 = %u%%", offMs, manualPowerPercent1);
-        // Haptic feedback for manual heater 1 power change.
-        signalManualPowerChange(manualPowerPercent1);
-        batteryLed1.triggerManualPowerStepFromPercent(manualPowerPercent1);
-        lastManualPowerLedStep1 = manualPowerPercent1;
-      } else {
-        logf(LogLevel::Debug, "Battery 1 OFF/ON ignored (off_ms too long for toggle window)");
-      }
-    }
-
-    if (batt2OffNow && !battery2Off) {
-      battery2Off = true;
-      battery2OffSinceMs = now;
-      logf(LogLevel::Debug, "Battery 2 OFF edge detected | now_ms=%lu | adc2_mv=%u", now, adc2MilliVolts);
-    } else if (!batt2OffNow && batt2OnNow && battery2Off) {
-      const unsigned long offMs = now - battery2OffSinceMs;
-      battery2Off = false;
-      logf(LogLevel::Debug, "Battery 2 ON edge detected  | off_ms=%lu (limit=%u) | adc2_mv=%u", offMs,
-           static_cast<unsigned int>(manualPowerToggleMaxOffMs), adc2MilliVolts);
-      if (offMs <= static_cast<unsigned long>(manualPowerToggleMaxOffMs)) {
-        cycleManualPowerPercent2();
-        logf(LogLevel::Info, "Battery 2 OFF/ON trigger (%lums) -> manual power 2 = %u%%", offMs, manualPowerPercent2);
-        // Haptic feedback for manual heater 2 power change.
-        signalManualPowerChange(manualPowerPercent2);
-        batteryLed2.triggerManualPowerStepFromPercent(manualPowerPercent2);
-        lastManualPowerLedStep2 = manualPowerPercent2;
-      } else {
-        logf(LogLevel::Debug, "Battery 2 OFF/ON ignored (off_ms too long for toggle window)");
-      }
+  // Battery state every 50 ms in manual mode (OFF/ON detection), otherwise once a second, all
+  // from one ADC snapshot.
+  AdcReadings adc;
+  readAdcReadings(adc);
+  if (batteryAdcReady(adc) && housekeepingCycle.batteryDue(now, manualMode)) {
+    updateBatteriesFromAdc(adc);
+    if (manualMode) {
+      handleManualToggles(now);
     }
   }
 
   if (manualPowerPercent1 != lastManualPowerLedStep1) {
-    batteryLed1.triggerManualPowerStepFromPercent(manualPowerPercent1);
+    statusOutputs.triggerManualPowerStepFromPercent(0, manualPowerPercent1);
     lastManualPowerLedStep1 = manualPowerPercent1;
   }
   if (manualPowerPercent2 != lastManualPowerLedStep2) {
-    batteryLed2.triggerManualPowerStepFromPercent(manualPowerPercent2);
+    statusOutputs.triggerManualPowerStepFromPercent(1, manualPowerPercent2);
     lastManualPowerLedStep2 = manualPowerPercent2;
   }
 
-  batteryLed1.update(now);
-  batteryLed2.update(now);
+  bool signalOn = false;
+  const bool signalActive = updateSignalPatterns(now, signalOn);
+  statusOutputs.setSignal(signalActive, signalOn);
+  ArduinoGpio gpio;
+  statusOutputs.tick(now, signalTimingPreset, gpio);
+
+  persistControlTaskEvents();
+  logControlTaskEvents(now);
 
   if (now - lastSensorMs >= 1000) {
     lastSensorMs = now;
-    updateSensorsAndHeaters();
-    const bool prevOvertemp1 = mosfet1OvertempActive;
-    const bool prevOvertemp2 = mosfet2OvertempActive;
-
-    ntcMosfet1MilliVolts = static_cast<uint16_t>(analogReadMilliVolts(ADC_PIN_NTC_MOSFET_1));
-    ntcMosfet2MilliVolts = static_cast<uint16_t>(analogReadMilliVolts(ADC_PIN_NTC_MOSFET_2));
-    const bool ntc1Valid = logic_helpers::ntcMilliVoltsToTempC(ntcMosfet1MilliVolts, NTC_VCC_MV, NTC_SERIES_RESISTOR_OHM,
-                                                              NTC_NOMINAL_RESISTANCE_OHM, NTC_BETA, NTC_NOMINAL_TEMP_C,
-                                                              ntcMosfet1TempC);
-    const bool ntc2Valid = logic_helpers::ntcMilliVoltsToTempC(ntcMosfet2MilliVolts, NTC_VCC_MV, NTC_SERIES_RESISTOR_OHM,
-                                                              NTC_NOMINAL_RESISTANCE_OHM, NTC_BETA, NTC_NOMINAL_TEMP_C,
-                                                              ntcMosfet2TempC);
-    if (!ntc1Valid) {
-      ntcMosfet1TempC = NAN;
-    }
-    if (!ntc2Valid) {
-      ntcMosfet2TempC = NAN;
-    }
-
-    if (!mosfet1OvertempActive && ntc1Valid && ntcMosfet1TempC >= MOSFET_OVERTEMP_LIMIT_C) {
-      mosfet1OvertempActive = true;
-      saveMosfetOvertempEvent(1U, ntcMosfet1TempC);
-      logf("MOSFET1 overtemp TRIP | temp=%.2fC | limit=%.1fC | heater forced OFF", ntcMosfet1TempC,
-           MOSFET_OVERTEMP_LIMIT_C);
-    } else if (mosfet1OvertempActive && ntc1Valid && ntcMosfet1TempC <= MOSFET_OVERTEMP_RESET_C) {
-      mosfet1OvertempActive = false;
-      logf("MOSFET1 cooled down | temp=%.2fC | resume<=%.1fC", ntcMosfet1TempC, MOSFET_OVERTEMP_RESET_C);
-    }
-
-    if (!mosfet2OvertempActive && ntc2Valid && ntcMosfet2TempC >= MOSFET_OVERTEMP_LIMIT_C) {
-      mosfet2OvertempActive = true;
-      saveMosfetOvertempEvent(2U, ntcMosfet2TempC);
-      logf("MOSFET2 overtemp TRIP | temp=%.2fC | limit=%.1fC | heater forced OFF", ntcMosfet2TempC,
-           MOSFET_OVERTEMP_LIMIT_C);
-    } else if (mosfet2OvertempActive && ntc2Valid && ntcMosfet2TempC <= MOSFET_OVERTEMP_RESET_C) {
-      mosfet2OvertempActive = false;
-      logf("MOSFET2 cooled down | temp=%.2fC | resume<=%.1fC", ntcMosfet2TempC, MOSFET_OVERTEMP_RESET_C);
-    }
-
-    if (mosfet1OvertempActive) {
-      digitalWrite(SSR_PIN_1, LOW);
-    }
-    if (mosfet2OvertempActive) {
-      digitalWrite(SSR_PIN_2, LOW);
-    }
 
-    static unsigned long lastNtcLogMs = 0;
-    const bool overtempChanged = (prevOvertemp1 != mosfet1OvertempActive) || (prevOvertemp2 != mosfet2OvertempActive);
-    if (overtempChanged || (now - lastNtcLogMs) >= 5000UL) {
-      lastNtcLogMs = now;
-      char ntc1Text[16];
-      char ntc2Text[16];
-      if (ntc1Valid) {
-        snprintf(ntc1Text, sizeof(ntc1Text), "%.2fC", ntcMosfet1TempC);
-      } else {
-        snprintf(ntc1Text, sizeof(ntc1Text), "n/a");
-      }
-      if (ntc2Valid) {
-        snprintf(ntc2Text, sizeof(ntc2Text), "%.2fC", ntcMosfet2TempC);
-      } else {
-        snprintf(ntc2Text, sizeof(ntc2Text), "n/a");
-      }
-      logf(LogLevel::Debug, "MOSFET NTC | h1=%s (%u mV) | h2=%s (%u mV) | ot1=%d | ot2=%d", ntc1Text, ntcMosfet1MilliVolts,
-           ntc2Text, ntcMosfet2MilliVolts, mosfet1OvertempActive ? 1 : 0, mosfet2OvertempActive ? 1 : 0);
-    }
-
-    // In non-manual modes, update ADC/battery state at 1 Hz for diagnostics.
-    if (!manualMode) {
-      adc1MilliVolts = static_cast<uint16_t>(analogReadMilliVolts(ADC_PIN_1));
-      adc2MilliVolts = static_cast<uint16_t>(analogReadMilliVolts(ADC_PIN_2));
-      logic_helpers::updateBatteryFromAdc(adc1MilliVolts, battery1CellCount, BATTERY_DIVIDER_RATIO, battery1PackVoltage,
-                                          battery1CellVoltage, battery1Chemistry, battery1SocSmoothed,
-                                          battery1SocSmoothingInitialized, battery1SocPercent);
-      logic_helpers::updateBatteryFromAdc(adc2MilliVolts, battery2CellCount, BATTERY_DIVIDER_RATIO, battery2PackVoltage,
-                                          battery2CellVoltage, battery2Chemistry, battery2SocSmoothed,
-                                          battery2SocSmoothingInitialized, battery2SocPercent);
-    }
-    
     // Check for heater state changes (motor/vibration)
     const bool currentHeater1State = (digitalRead(SSR_PIN_1) == HIGH);
     const bool currentHeater2State = (digitalRead(SSR_PIN_2) == HIGH);
@@ -751,24 +696,32 @@ void loop() {
     }
   }
 
-  if (pendingTempPersist && static_cast<long>(now - pendingTempPersistAtMs) >= 0) {
-    saveTemperatureTargets();
-    pendingTempPersist = false;
-    logf(LogLevel::Debug, "Temperature targets persisted to EEPROM.");
-  }
+  servicePersistence(now);
 
-  if (now - lastRuntimeSaveMs >= 60000UL) {
+  if (housekeepingCycle.runtimeMinuteDue(now)) {
     saveRuntimeMinute();
-    lastRuntimeSaveMs = now;
+    persistHeaterEnergy();
   }
+  publishHousekeepingState();
+  serviceStatusPush(now);
+  serviceOtaUpload(now);
 
   if (now - lastMemCheckMs >= 30000UL) {
     const uint32_t freeHeap = ESP.getFreeHeap();
+    // The sampled value misses short dips between checks (request bursts); the low-water mark does not.
+    static uint32_t lastMinFreeHeap = UINT32_MAX;
+    const uint32_t minFreeHeap = ESP.getMinFreeHeap();
+    if (minFreeHeap < lastMinFreeHeap) {
+      logf(LogLevel::Debug, "Heap low-water mark dropped | free_heap=%u | min_free_heap=%u | largest_block=%u", freeHeap,
+           minFreeHeap, ESP.getMaxAllocHeap());
+      lastMinFreeHeap = minFreeHeap;
+    }
     if (freeHeap < 30000) {
       logf("Memory warning: free_heap=%u", freeHeap);
     }
     if (freeHeap < 12000) {
       logLine("Memory critical, restarting...");
+      flushPersistence();
       delay(100);
       ESP.restart();
     }
@@ -0,0 +1,352 @@
+#include "ota_session.h"
+
+#include <cstring>
+
+#include "json_writer.h"
+
+namespace HeatControl {
+namespace logic {
+
+namespace {
+
+const char *otaStateText(OtaState state) {
+  switch (state) {
+    case OtaState::Receiving:
+      return "receiving";
+    case OtaState::Succeeded:
+      return "ok";
+    case OtaState::Failed:
+      return "failed";
+    case OtaState::Idle:
+    default:
+      return "idle";
+  }
+}
+
+const char *otaFormatText(OtaFormat format) {
+  switch (format) {
+    case OtaFormat::Raw:
+      return "raw";
+    case OtaFormat::Heatshrink:
+      return "heatshrink";
+    case OtaFormat::Unknown:
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace
+
+OtaSession::OtaSession(IFirmwareSink &sink, uint32_t (*clockUs)()) : sink_(sink), clockUs_(clockUs) {
+  std::memset(&progress_, 0, sizeof(progress_));
+  progress_.state = OtaState::Idle;
+  progress_.message = "";
+  std::memset(expected_, 0, sizeof(expected_));
+  std::memset(digest_, 0, sizeof(digest_));
+}
+
+bool OtaSession::begin(uint32_t declaredBytes, const char *sha256Hex) {
+  if (progress_.state == OtaState::Receiving) {
+    fail("Superseded by a new upload.");
+  }
+  std::memset(&progress_, 0, sizeof(progress_));
+  progress_.state = OtaState::Receiving;
+  progress_.format = OtaFormat::Unknown;
+  progress_.declaredBytes = declaredBytes;
+  progress_.message = "";
+  hash_.reset();
+  imageHash_.reset();
+  std::memset(digest_, 0, sizeof(digest_));
+  headerFill_ = 0;
+  sinkStarted_ = false;
+  block_ = nullptr;
+  blockFill_ = 0;
+  chunkTotalUs_ = 0;
+  startUs_ = clockUs_();
+  lastChunkUs_ = startUs_;
+
+  progress_.checksumExpected = sha256Hex != nullptr && sha256Hex[0] != '\0';
+  if (progress_.checksumExpected && !parseSha256Hex(sha256Hex, expected_)) {
+    progress_.state = OtaState::Failed;
+    progress_.message = "Expected SHA-256 must be 64 hex digits.";
+    return false;
+  }
+  return true;
+}
+
+bool OtaSession::write(const uint8_t *data, size_t length) {
+  if (progress_.state != OtaState::Receiving) {
+    return false;
+  }
+  const uint32_t enteredUs = clockUs_();
+  if (progress_.declaredBytes != 0U && length > progress_.declaredBytes - progress_.receivedBytes) {
+    fail("Upload is larger than the declared image size.");
+    return false;
+  }
+  hash_.update(data, length);
+  progress_.receivedBytes += static_cast<uint32_t>(length);
+
+  const uint8_t *rest = data;
+  size_t restLength = length;
+  if (progress_.format == OtaFormat::Unknown && !startImage(rest, restLength)) {
+    return false;
+  }
+  const bool stored =
+      progress_.format == OtaFormat::Heatshrink ? storeCompressed(rest, restLength) : storeRaw(rest, restLength);
+  if (!stored) {
+    return false;
+  }
+
+  const uint32_t nowUs = clockUs_();
+  const uint32_t spentUs = nowUs - enteredUs;
+  ++progress_.chunks;
+  chunkTotalUs_ += spentUs;
+  progress_.chunkMeanUs = static_cast<uint32_t>(chunkTotalUs_ / progress_.chunks);
+  if (spentUs > progress_.chunkMaxUs) {
+    progress_.chunkMaxUs = spentUs;
+  }
+  lastChunkUs_ = nowUs;
+  const uint32_t elapsedUs = nowUs - startUs_;
+  progress_.elapsedMs = elapsedUs / 1000U;
+  if (elapsedUs > 0U) {
+    progress_.bytesPerSecond =
+        static_cast<uint32_t>(static_cast<uint64_t>(progress_.receivedBytes) * 1000000ULL / elapsedUs);
+  }
+  return true;
+}
+
+bool OtaSession::finish() {
+  if (progress_.state != OtaState::Receiving) {
+    return false;
+  }
+  if (progress_.declaredBytes != 0U && progress_.receivedBytes != progress_.declaredBytes) {
+    fail("Upload ended before the declared image size.");
+    return false;
+  }
+  if (progress_.format == OtaFormat::Unknown || progress_.writtenBytes < OTA_MIN_IMAGE_BYTES) {
+    fail("Firmware image too small.");
+    return false;
+  }
+  if (progress_.imageBytes != 0U && progress_.writtenBytes != progress_.imageBytes) {
+    fail("Compressed stream ended before the image size in its header.");
+    return false;
+  }
+  if (blockFill_ > 0U && !flushBlock()) {
+    return false;
+  }
+  hash_.finish(digest_);
+  if (progress_.checksumExpected && std::memcmp(digest_, expected_, SHA256_DIGEST_BYTES) != 0) {
+    fail("SHA-256 mismatch.");
+    return false;
+  }
+  if (progress_.format == OtaFormat::Heatshrink) {
+    uint8_t imageDigest[SHA256_DIGEST_BYTES];
+    imageHash_.finish(imageDigest);
+    if (std::memcmp(imageDigest, header_ + 12, SHA256_DIGEST_BYTES) != 0) {
+      fail("Decompressed image does not match the SHA-256 in its header.");
+      return false;
+    }
+  }
+  if (!sink_.end()) {
+    progress_.sinkError = sink_.errorCode();
+    fail("Finalize failed.");
+    return false;
+  }
+  progress_.checksumVerified = progress_.checksumExpected || progress_.format == OtaFormat::Heatshrink;
+  progress_.elapsedMs = (clockUs_() - startUs_) / 1000U;
+  progress_.state = OtaState::Succeeded;
+  progress_.message = "OK";
+  return true;
+}
+
+void OtaSession::fail(const char *message) {
+  if (progress_.state != OtaState::Receiving) {
+    return;
+  }
+  if (sinkStarted_) {
+    sink_.abort();
+    sinkStarted_ = false;
+  }
+  block_ = nullptr;
+  blockFill_ = 0;
+  progress_.state = OtaState::Failed;
+  progress_.message = message;
+}
+
+void OtaSession::reject(const char *message) {
+  fail("Superseded by a new upload.");
+  std::memset(&progress_, 0, sizeof(progress_));
+  progress_.state = OtaState::Failed;
+  progress_.message = message;
+}
+
+bool OtaSession::stalled(uint32_t timeoutUs) const {
+  return progress_.state == OtaState::Receiving && clockUs_() - lastChunkUs_ > timeoutUs;
+}
+
+// Decides the format from the first bytes and starts the sink with the image size, so an image
+// that cannot fit is refused right at the first chunk.
+bool OtaSession::startImage(const uint8_t *&data, size_t &length) {
+  if (headerFill_ == 0U && length > 0U && data[0] != OTA_COMPRESSED_MAGIC[0]) {
+    progress_.format = OtaFormat::Raw;
+    progress_.imageBytes = progress_.declaredBytes;
+  } else {
+    while (headerFill_ < OTA_COMPRESSED_HEADER_BYTES && length > 0U) {
+      header_[headerFill_++] = *data++;
+      --length;
+    }
+    if (headerFill_ < OTA_COMPRESSED_HEADER_BYTES) {
+      return true;
+    }
+    if (std::memcmp(header_, OTA_COMPRESSED_MAGIC, sizeof(OTA_COMPRESSED_MAGIC)) != 0) {
+      fail("Unknown firmware image format.");
+      return false;
+    }
+    progress_.format = OtaFormat::Heatshrink;
+    progress_.imageBytes = static_cast<uint32_t>(header_[8]) | (static_cast<uint32_t>(header_[9]) << 8) |
+                           (static_cast<uint32_t>(header_[10]) << 16) | (static_cast<uint32_t>(header_[11]) << 24);
+  }
+  if ((progress_.format == OtaFormat::Heatshrink || progress_.imageBytes != 0U) &&
+      progress_.imageBytes < OTA_MIN_IMAGE_BYTES) {
+    fail("Firmware image too small.");
+    return false;
+  }
+  if (progress_.format == OtaFormat::Heatshrink && header_[4] > OTA_MAX_WINDOW_BITS) {
+    fail("Compression window too large for this device.");
+    return false;
+  }
+  // The sink rejects an image size that does not fit the OTA partition before anything is written.
+  if (!sink_.begin(progress_.imageBytes)) {
+    progress_.sinkError = sink_.errorCode();
+    progress_.state = OtaState::Failed;
+    progress_.message = "Update begin failed.";
+    return false;
+  }
+  sinkStarted_ = true;
+  if (progress_.format == OtaFormat::Heatshrink) {
+    uint8_t *window = sink_.windowBuffer();
+    if (window == nullptr) {
+      fail("No memory for the decompression window.");
+      return false;
+    }
+    if (!decoder_.reset(window, header_[4], header_[5])) {
+      fail("Unsupported compression parameters.");
+      return false;
+    }
+  }
+  return true;
+}
+
+bool OtaSession::storeRaw(const uint8_t *data, size_t length) {
+  size_t offset = 0;
+  while (offset < length) {
+    if (!ensureBlock()) {
+      return false;
+    }
+    size_t take = OTA_BLOCK_BYTES - blockFill_;
+    if (take > length - offset) {
+      take = length - offset;
+    }
+    std::memcpy(block_ + blockFill_, data + offset, take);
+    blockFill_ += take;
+    offset += take;
+    progress_.writtenBytes += static_cast<uint32_t>(take);
+    if (blockFill_ == OTA_BLOCK_BYTES && !flushBlock()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool OtaSession::storeCompressed(const uint8_t *data, size_t length) {
+  for (;;) {
+    if (!ensureBlock()) {
+      return false;
+    }
+    const size_t produced = decoder_.decode(data, length, block_ + blockFill_, OTA_BLOCK_BYTES - blockFill_);
+    imageHash_.update(block_ + blockFill_, produced);
+    blockFill_ += produced;
+    progress_.writtenBytes += static_cast<uint32_t>(produced);
+    if (progress_.writtenBytes > progress_.imageBytes) {
+      fail("Compressed stream is larger than the image size in its header.");
+      return false;
+    }
+    if (blockFill_ < OTA_BLOCK_BYTES) {
+      // The block still has room, so the decoder stopped for lack of input.
+      return true;
+    }
+    if (!flushBlock()) {
+      return false;
+    }
+  }
+}
+
+bool OtaSession::ensureBlock() {
+  if (block_ != nullptr) {
+    return true;
+  }
+  block_ = sink_.acquireBlock();
+  blockFill_ = 0;
+  if (block_ == nullptr) {
+    progress_.sinkError = sink_.errorCode();
+    fail("Write failed.");
+    return false;
+  }
+  return true;
+}
+
+bool OtaSession::flushBlock() {
+  const size_t length = blockFill_;
+  block_ = nullptr;
+  blockFill_ = 0;
+  if (!sink_.commitBlock(length)) {
+    progress_.sinkError = sink_.errorCode();
+    fail("Write failed.");
+    return false;
+  }
+  ++progress_.blocks;
+  return true;
+}
+
+size_t writeOtaStatusJson(const OtaProgress &progress, const uint8_t *digest, char *out, size_t capacity) {
+  JsonWriter w(out, capacity);
+  w.beginObject();
+  w.field("state", otaStateText(progress.state));
+  w.field("message", progress.message);
+  w.field("format", otaFormatText(progress.format));
+  w.fieldUint("declaredBytes", progress.declaredBytes);
+  w.fieldUint("receivedBytes", progress.receivedBytes);
+  w.fieldUint("imageBytes", progress.imageBytes);
+  w.fieldUint("writtenBytes", progress.writtenBytes);
+  if (progress.declaredBytes != 0U) {
+    w.fieldUint("progressPermille",
+                static_cast<uint32_t>(static_cast<uint64_t>(progress.receivedBytes) * 1000U / progress.declaredBytes));
+  } else {
+    w.fieldNull("progressPermille");
+  }
+  w.fieldUint("bytesPerSecond", progress.bytesPerSecond);
+  w.fieldUint("elapsedMs", progress.elapsedMs);
+  w.fieldUint("chunks", progress.chunks);
+  w.fieldUint("chunkMeanUs", progress.chunkMeanUs);
+  w.fieldUint("chunkMaxUs", progress.chunkMaxUs);
+  w.fieldUint("blocks", progress.blocks);
+  w.fieldBool("checksumExpected", progress.checksumExpected);
+  w.fieldBool("checksumVerified", progress.checksumVerified);
+  w.fieldInt("sinkError", progress.sinkError);
+  if (progress.state == OtaState::Succeeded && digest != nullptr) {
+    static const char HEX[] = "0123456789abcdef";
+    char hex[2 * SHA256_DIGEST_BYTES];
+    for (size_t i = 0; i < SHA256_DIGEST_BYTES; ++i) {
+      hex[2 * i] = HEX[digest[i] >> 4];
+      hex[2 * i + 1] = HEX[digest[i] & 0x0FU];
+    }
+    w.field("sha256", hex, sizeof(hex));
+  } else {
+    w.fieldNull("sha256");
+  }
+  w.endObject();
+  return w.overflowed() ? 0U : w.size();
+}
+
+}  // namespace logic
+}  // namespace HeatControl
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "heatshrink.h"
+#include "sha256.h"
+
+namespace HeatControl {
+namespace logic {
+
+// One flash sector: the sink only ever sees whole sectors, except for the image tail.
+constexpr size_t OTA_BLOCK_BYTES = 4096;
+constexpr uint32_t OTA_MIN_IMAGE_BYTES = 100UL * 1024UL;
+
+// Compressed uploads (tools/release/compress_firmware.py) start with this header, little endian:
+// magic, window bits, lookahead bits, 2 reserved bytes, image size, SHA-256 of the image.
+constexpr size_t OTA_COMPRESSED_HEADER_BYTES = 44;
+constexpr uint8_t OTA_COMPRESSED_MAGIC[4] = {'H', 'C', 'H', 'S'};
+// The decoder window is one sink block.
+constexpr uint8_t OTA_MAX_WINDOW_BITS = 12;
+static_assert((1U << OTA_MAX_WINDOW_BITS) <= OTA_BLOCK_BYTES, "window must fit a block");
+
+class IFirmwareSink {
+ public:
+  virtual ~IFirmwareSink() = default;
+  // imageBytes is 0 when the client did not declare a size.
+  virtual bool begin(uint32_t imageBytes) = 0;
+  // Buffer of OTA_BLOCK_BYTES to fill next; may wait until a previous block has been written.
+  virtual uint8_t *acquireBlock() = 0;
+  // Hands the acquired block over for writing; only the last block of an image may be shorter.
+  virtual bool commitBlock(size_t length) = 0;
+  // OTA_BLOCK_BYTES of scratch for the decompression window, valid from begin() to end()/abort().
+  virtual uint8_t *windowBuffer() = 0;
+  // Waits for every committed block, then validates and activates the image.
+  virtual bool end() = 0;
+  virtual void abort() = 0;
+  virtual int errorCode() const = 0;
+};
+
+enum class OtaState : uint8_t { Idle, Receiving, Succeeded, Failed };
+enum class OtaFormat : uint8_t { Unknown, Raw, Heatshrink };
+
+struct OtaProgress {
+  OtaState state;
+  OtaFormat format;        // known after the first bytes (raw images start with 0xE9, not the magic)
+  uint32_t declaredBytes;  // upload size, 0 = unknown
+  uint32_t receivedBytes;
+  uint32_t imageBytes;  // size of the image in flash, 0 = unknown
+  uint32_t writtenBytes;
+  uint32_t bytesPerSecond;
+  uint32_t chunks;
+  uint32_t chunkMeanUs;  // time spent inside write() per chunk, including waits for a free block
+  uint32_t chunkMaxUs;
+  uint32_t blocks;
+  uint32_t elapsedMs;
+  bool checksumExpected;
+  bool checksumVerified;
+  int sinkError;
+  const char *message;
+};
+
+// Streams an uploaded image into an IFirmwareSink in sector-sized blocks while hashing it. The
+// declared size and the expected SHA-256 are both optional; whatever is known is checked as early
+// as possible so a bad upload stops before the rest of it has to cross the link. A compressed
+// upload is inflated on the way and its image checked against the digest in its header.
+class OtaSession {
+ public:
+  OtaSession(IFirmwareSink &sink, uint32_t (*clockUs)());
+
+  // Starts a new image, abandoning any unfinished one. sha256Hex may be null or empty.
+  bool begin(uint32_t declaredBytes, const char *sha256Hex);
+  bool write(const uint8_t *data, size_t length);
+  // Writes the tail, checks size and digest and only then lets the sink activate the image.
+  bool finish();
+  // Aborts the image (if any) and records `message`; no-op once the session has ended.
+  void fail(const char *message);
+  // Records an upload refused before it started, e.g. for its file name, without starting the sink.
+  void reject(const char *message);
+
+  // A receiving session without a chunk for `timeoutUs` belongs to a client that went away.
+  bool stalled(uint32_t timeoutUs) const;
+  const OtaProgress &progress() const { return progress_; }
+  // Digest of the uploaded bytes; valid once the session succeeded.
+  const uint8_t *digest() const { return digest_; }
+
+ private:
+  bool startImage(const uint8_t *&data, size_t &length);
+  bool storeRaw(const uint8_t *data, size_t length);
+  bool storeCompressed(const uint8_t *data, size_t length);
+  bool ensureBlock();
+  bool flushBlock();
+
+  IFirmwareSink &sink_;
+  uint32_t (*clockUs_)();
+  OtaProgress progress_;
+  Sha256 hash_;
+  Sha256 imageHash_;
+  HeatshrinkDecoder decoder_;
+  uint8_t expected_[SHA256_DIGEST_BYTES];
+  uint8_t digest_[SHA256_DIGEST_BYTES];
+  uint8_t header_[OTA_COMPRESSED_HEADER_BYTES];
+  size_t headerFill_ = 0;
+  bool sinkStarted_ = false;
+  uint8_t *block_ = nullptr;
+  size_t blockFill_ = 0;
+  uint32_t startUs_ = 0;
+  uint32_t lastChunkUs_ = 0;
+  uint64_t chunkTotalUs_ = 0;
+};
+
+// Flat JSON for /ota/status; returns the length written (0 when `capacity` was too small).
+size_t writeOtaStatusJson(const OtaProgress &progress, const uint8_t *digest, char *out, size_t capacity);
+
+}  // namespace logic
+}  // namespace HeatControl
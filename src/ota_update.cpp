@@ -0,0 +1,266 @@
+#include "ota_update.h"
+
+#include <Arduino.h>
+#include <Update.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <cstdlib>
+
+namespace HeatControl {
+
+namespace {
+
+// Two sectors: one filling on the AsyncTCP task while the other is erased and written.
+constexpr uint8_t kFlashBlockCount = 2;
+constexpr uint32_t kFlashWriterStackBytes = 3072;
+// Below AsyncTCP so a waiting flash write never delays incoming segments, above loop().
+#ifdef CONFIG_ASYNC_TCP_PRIORITY
+constexpr unsigned kFlashWriterPriority = CONFIG_ASYNC_TCP_PRIORITY - 1;
+#else
+constexpr unsigned kFlashWriterPriority = 9;
+#endif
+// A sector write takes tens of ms; a writer stuck for this long means the flash is not coming back.
+constexpr uint32_t kBlockWaitMs = 5000UL;
+constexpr uint32_t kUploadStallUs = 15000000UL;
+constexpr int kWriterUnavailableError = -1;
+constexpr int kBlockTimeoutError = -2;
+
+struct PendingBlock {
+  uint8_t index;
+  size_t length;
+};
+
+class UpdateFlashSink : public logic::IFirmwareSink {
+ public:
+  bool begin(uint32_t imageBytes) override {
+    error_ = 0;
+    failed_ = false;
+    if (!startWriter() || !allocateBlocks()) {
+      error_ = kWriterUnavailableError;
+      return false;
+    }
+    if (!Update.begin(imageBytes == 0U ? UPDATE_SIZE_UNKNOWN : imageBytes, U_FLASH)) {
+      error_ = Update.getError();
+      releaseBlocks();
+      return false;
+    }
+    return true;
+  }
+
+  uint8_t *acquireBlock() override {
+    uint8_t index = 0;
+    if (xQueueReceive(freeBlocks_, &index, pdMS_TO_TICKS(kBlockWaitMs)) != pdTRUE) {
+      error_ = kBlockTimeoutError;
+      return nullptr;
+    }
+    held_ = static_cast<int8_t>(index);
+    return blocks_[index];
+  }
+
+  bool commitBlock(size_t length) override {
+    const PendingBlock block{static_cast<uint8_t>(held_), length};
+    held_ = -1;
+    xQueueSend(pendingBlocks_, &block, portMAX_DELAY);
+    // A failed earlier write shows up one block late; the session stops at the next commit.
+    return !failed_;
+  }
+
+  bool end() override {
+    if (!waitForWriter()) {
+      return false;
+    }
+    const bool ok = !failed_ && Update.end(true);
+    if (!ok && error_ == 0) {
+      error_ = Update.getError();
+    }
+    releaseBlocks();
+    return ok;
+  }
+
+  void abort() override {
+    // A writer stuck inside Update keeps its blocks; the next begin() reports it.
+    if (!waitForWriter()) {
+      return;
+    }
+    Update.abort();
+    releaseBlocks();
+  }
+
+  // Only compressed uploads need it, so it is allocated on first use.
+  uint8_t *windowBuffer() override {
+    if (window_ == nullptr) {
+      window_ = static_cast<uint8_t *>(malloc(logic::OTA_BLOCK_BYTES));
+    }
+    return window_;
+  }
+
+  int errorCode() const override { return error_; }
+
+ private:
+  static void writerMain(void *arg) {
+    UpdateFlashSink &sink = *static_cast<UpdateFlashSink *>(arg);
+    PendingBlock block;
+    for (;;) {
+      if (xQueueReceive(sink.pendingBlocks_, &block, portMAX_DELAY) != pdTRUE) {
+        continue;
+      }
+      if (!sink.failed_ && Update.write(sink.blocks_[block.index], block.length) != block.length) {
+        sink.error_ = Update.getError();
+        sink.failed_ = true;
+      }
+      xQueueSend(sink.freeBlocks_, &block.index, portMAX_DELAY);
+    }
+  }
+
+  bool startWriter() {
+    if (writerTask_ != nullptr) {
+      return true;
+    }
+    freeBlocks_ = xQueueCreate(kFlashBlockCount, sizeof(uint8_t));
+    pendingBlocks_ = xQueueCreate(kFlashBlockCount, sizeof(PendingBlock));
+    if (freeBlocks_ == nullptr || pendingBlocks_ == nullptr) {
+      return false;
+    }
+    if (xTaskCreate(&writerMain, "ota_flash", kFlashWriterStackBytes, this, kFlashWriterPriority, &writerTask_) !=
+        pdPASS) {
+      writerTask_ = nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  // The sectors live on the heap only while an upload runs.
+  bool allocateBlocks() {
+    for (uint8_t i = 0; i < kFlashBlockCount; ++i) {
+      if (blocks_[i] == nullptr) {
+        blocks_[i] = static_cast<uint8_t *>(malloc(logic::OTA_BLOCK_BYTES));
+        if (blocks_[i] == nullptr) {
+          releaseBlocks();
+          return false;
+        }
+      }
+    }
+    xQueueReset(freeBlocks_);
+    for (uint8_t i = 0; i < kFlashBlockCount; ++i) {
+      xQueueSend(freeBlocks_, &i, 0);
+    }
+    held_ = -1;
+    return true;
+  }
+
+  void releaseBlocks() {
+    for (uint8_t i = 0; i < kFlashBlockCount; ++i) {
+      free(blocks_[i]);
+      blocks_[i] = nullptr;
+    }
+    free(window_);
+    window_ = nullptr;
+    held_ = -1;
+  }
+
+  // Every block is back in the free queue (or held by the session) once the writer went idle.
+  bool waitForWriter() {
+    const UBaseType_t expected = kFlashBlockCount - (held_ >= 0 ? 1U : 0U);
+    for (uint32_t waitedMs = 0; uxQueueMessagesWaiting(freeBlocks_) < expected; ++waitedMs) {
+      if (waitedMs >= kBlockWaitMs) {
+        error_ = kBlockTimeoutError;
+        return false;
+      }
+      vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    return true;
+  }
+
+  uint8_t *blocks_[kFlashBlockCount] = {};
+  uint8_t *window_ = nullptr;
+  int8_t held_ = -1;
+  QueueHandle_t freeBlocks_ = nullptr;
+  QueueHandle_t pendingBlocks_ = nullptr;
+  TaskHandle_t writerTask_ = nullptr;
+  volatile bool failed_ = false;
+  volatile int error_ = 0;
+};
+
+uint32_t otaClockUs() {
+  return static_cast<uint32_t>(micros());
+}
+
+UpdateFlashSink flashSink;
+logic::OtaSession uploadSession(flashSink, &otaClockUs);
+// Serialises the AsyncTCP task feeding the session and loop() aborting a stalled one.
+SemaphoreHandle_t sessionMutex = nullptr;
+
+class SessionLock {
+ public:
+  SessionLock() {
+    if (sessionMutex != nullptr) {
+      xSemaphoreTake(sessionMutex, portMAX_DELAY);
+    }
+  }
+  ~SessionLock() {
+    if (sessionMutex != nullptr) {
+      xSemaphoreGive(sessionMutex);
+    }
+  }
+  SessionLock(const SessionLock &) = delete;
+  SessionLock &operator=(const SessionLock &) = delete;
+};
+
+}  // namespace
+
+void initOtaUpload() {
+  sessionMutex = xSemaphoreCreateMutex();
+}
+
+bool otaBeginUpload(uint32_t declaredBytes, const char *sha256Hex) {
+  SessionLock lock;
+  return uploadSession.begin(declaredBytes, sha256Hex);
+}
+
+bool otaWriteUpload(const uint8_t *data, size_t length) {
+  SessionLock lock;
+  return uploadSession.write(data, length);
+}
+
+bool otaFinishUpload() {
+  SessionLock lock;
+  return uploadSession.finish();
+}
+
+void otaFailUpload(const char *message) {
+  SessionLock lock;
+  uploadSession.fail(message);
+}
+
+void otaRejectUpload(const char *message) {
+  SessionLock lock;
+  uploadSession.reject(message);
+}
+
+bool otaUploadStalled() {
+  SessionLock lock;
+  return uploadSession.stalled(kUploadStallUs);
+}
+
+bool otaAbortStalledUpload() {
+  SessionLock lock;
+  if (!uploadSession.stalled(kUploadStallUs)) {
+    return false;
+  }
+  uploadSession.fail("Upload stalled.");
+  return true;
+}
+
+logic::OtaProgress otaUploadProgress() {
+  SessionLock lock;
+  return uploadSession.progress();
+}
+
+size_t renderOtaStatusJson(char *out, size_t capacity) {
+  SessionLock lock;
+  return logic::writeOtaStatusJson(uploadSession.progress(), uploadSession.digest(), out, capacity);
+}
+
+}  // namespace HeatControl
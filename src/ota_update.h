@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ota_session.h"
+
+namespace HeatControl {
+
+// Firmware upload behind POST /update. Chunks are hashed and gathered into flash sectors on the
+// AsyncTCP task; a background task writes the sectors through Update while the next one fills.
+// One upload at a time. The session is locked, so loop() may abort an upload the AsyncTCP task
+// stopped feeding.
+void initOtaUpload();
+bool otaBeginUpload(uint32_t declaredBytes, const char *sha256Hex);
+bool otaWriteUpload(const uint8_t *data, size_t length);
+bool otaFinishUpload();
+void otaFailUpload(const char *message);
+void otaRejectUpload(const char *message);
+// True when a receiving upload has not seen data for a while (client gone without finishing).
+bool otaUploadStalled();
+// Fails a stalled upload so Update and the sector buffers are released; called from loop().
+// Returns true if it aborted one.
+bool otaAbortStalledUpload();
+// Copy taken under the session lock; the session itself may be fed from another task meanwhile.
+logic::OtaProgress otaUploadProgress();
+size_t renderOtaStatusJson(char *out, size_t capacity);
+
+}  // namespace HeatControl
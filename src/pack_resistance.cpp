@@ -0,0 +1,90 @@
+#include "pack_resistance.h"
+
+namespace HeatControl {
+namespace logic {
+
+namespace {
+
+constexpr uint8_t SAG_FRACTION_BITS = 4;
+
+}  // namespace
+
+void PackResistanceEstimator::push(uint16_t milliVolts, bool loadOn) {
+  if (!started_ || loadOn != loadOn_) {
+    // An edge only counts when the plateau before it settled; a pulse shorter than the settle time
+    // (low duties) drops the pair instead of measuring the filter's step response.
+    pending_ = started_ && settled_;
+    beforeMilliVolts_ = settledMilliVolts_;
+    if (!started_) {
+      restMilliVolts_ = milliVolts;
+    }
+    started_ = true;
+    loadOn_ = loadOn;
+    stepsSinceEdge_ = 0;
+    settled_ = false;
+    return;
+  }
+  if (stepsSinceEdge_ < PACK_SAG_SETTLE_STEPS) {
+    ++stepsSinceEdge_;
+  }
+  if (stepsSinceEdge_ < PACK_SAG_SETTLE_STEPS) {
+    return;
+  }
+
+  settled_ = true;
+  settledMilliVolts_ = milliVolts;
+  if (pending_) {
+    pending_ = false;
+    if (loadOn_) {
+      addEdge(beforeMilliVolts_, milliVolts);
+    } else {
+      addEdge(milliVolts, beforeMilliVolts_);
+    }
+  }
+  if (loadOn_ && valid()) {
+    const uint64_t rest = static_cast<uint64_t>(milliVolts) * (1000000ULL + sagPpm()) / 1000000ULL;
+    restMilliVolts_ = static_cast<uint16_t>(rest < 0xFFFFULL ? rest : 0xFFFFULL);
+  } else {
+    restMilliVolts_ = milliVolts;
+  }
+}
+
+void PackResistanceEstimator::reset() {
+  *this = PackResistanceEstimator();
+}
+
+uint32_t PackResistanceEstimator::sagPpm() const {
+  return (sagState_ + (1U << (SAG_FRACTION_BITS - 1U))) >> SAG_FRACTION_BITS;
+}
+
+uint32_t PackResistanceEstimator::sourceMilliOhm(uint32_t elementMilliOhm) const {
+  return static_cast<uint32_t>((static_cast<uint64_t>(sagPpm()) * elementMilliOhm + 500000ULL) / 1000000ULL);
+}
+
+void PackResistanceEstimator::addEdge(uint16_t unloadedMilliVolts, uint16_t loadedMilliVolts) {
+  if (unloadedMilliVolts == 0U || loadedMilliVolts == 0U) {
+    return;
+  }
+  uint64_t ppm = 0;
+  if (loadedMilliVolts > unloadedMilliVolts) {
+    const uint64_t rise =
+        static_cast<uint64_t>(loadedMilliVolts - unloadedMilliVolts) * 1000000ULL / unloadedMilliVolts;
+    if (rise > PACK_SAG_MAX_RISE_PPM) {
+      return;
+    }
+  } else {
+    ppm = static_cast<uint64_t>(unloadedMilliVolts - loadedMilliVolts) * 1000000ULL / loadedMilliVolts;
+    if (ppm > PACK_SAG_MAX_PPM) {
+      return;
+    }
+  }
+
+  const int64_t sample = static_cast<int64_t>(ppm) << SAG_FRACTION_BITS;
+  const int64_t state = static_cast<int64_t>(sagState_);
+  ++edges_;
+  const int64_t weight = edges_ < PACK_SAG_FILTER_EDGES ? static_cast<int64_t>(edges_) : PACK_SAG_FILTER_EDGES;
+  sagState_ = static_cast<uint32_t>(state + (sample - state) / weight);
+}
+
+}  // namespace logic
+}  // namespace HeatControl
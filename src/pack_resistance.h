@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+namespace HeatControl {
+namespace logic {
+
+// Filter steps after a heater edge before a reading counts as settled: the battery AdcFilter's
+// median of 5 follows a step on its third filter step and the IIR (1/2) halves the rest on every
+// step after that, so 8 steps (64 ms) leave under 1 %, a block straddling the edge included.
+constexpr uint8_t PACK_SAG_SETTLE_STEPS = 8;
+// Accepted edges before sagPpm() is trusted, and the edge count up to which it is a plain running
+// mean; later edges enter with weight 1 / PACK_SAG_FILTER_EDGES.
+constexpr uint8_t PACK_SAG_MIN_EDGES = 4;
+constexpr uint8_t PACK_SAG_FILTER_EDGES = 16;
+// A sag above this is a pack being pulled (the manual OFF/ON gesture), not its resistance.
+constexpr uint32_t PACK_SAG_MAX_PPM = 500000;
+// A reading this much higher under load than without is rejected; less counts as zero sag (noise).
+constexpr uint32_t PACK_SAG_MAX_RISE_PPM = 20000;
+// Sag under the heater's load from which the pack is reported as weak: it loses about this share
+// of the heater power in itself and its wiring.
+constexpr uint32_t PACK_SAG_WEAK_PPM = 100000;
+
+// Source resistance of one pack from its voltage sag on heater switching edges. Each edge whose
+// neighbouring plateaus both settled yields an unloaded/loaded pair; the sag ratio
+// (V_unloaded - V_loaded) / V_loaded equals R_source / R_element, so it needs neither the divider
+// ratio nor the configured element resistance, and it turns a loaded reading back into the
+// open-circuit voltage the SoC curve expects. Integer only; one instance per pack.
+class PackResistanceEstimator {
+ public:
+  // One filtered reading per ADC filter step (any unit, e.g. divider millivolts) and whether the
+  // heater on this pack was switched on during that step.
+  void push(uint16_t milliVolts, bool loadOn);
+  void reset();
+
+  bool valid() const { return edges_ >= PACK_SAG_MIN_EDGES; }
+  uint32_t edges() const { return edges_; }
+  // Running sag ratio in parts per million (0 until the first accepted edge).
+  uint32_t sagPpm() const;
+  // sagPpm() times the element: cells, wiring and MOSFET together.
+  uint32_t sourceMilliOhm(uint32_t elementMilliOhm) const;
+  bool weak() const { return valid() && sagPpm() >= PACK_SAG_WEAK_PPM; }
+  // Latest settled reading with the load sag added back while the heater is on; it holds its value
+  // for PACK_SAG_SETTLE_STEPS after an edge. Until valid() it is the plain reading.
+  uint16_t restMilliVolts() const { return restMilliVolts_; }
+
+ private:
+  void addEdge(uint16_t unloadedMilliVolts, uint16_t loadedMilliVolts);
+
+  bool started_ = false;
+  bool loadOn_ = false;
+  uint8_t stepsSinceEdge_ = 0;
+  // Last settled reading of the current plateau; becomes the "before" reading at the next edge.
+  bool settled_ = false;
+  uint16_t settledMilliVolts_ = 0;
+  // Edge waiting for the new plateau to settle.
+  bool pending_ = false;
+  uint16_t beforeMilliVolts_ = 0;
+  uint32_t edges_ = 0;
+  uint32_t sagState_ = 0;  // sag ratio in ppm, 4 fraction bits
+  uint16_t restMilliVolts_ = 0;
+};
+
+}  // namespace logic
+}  // namespace HeatControl
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace HeatControl {
+
+constexpr uint32_t PATH_HASH_OFFSET = 2166136261UL;
+constexpr uint32_t PATH_HASH_PRIME = 16777619UL;
+
+// Seeded FNV-1a. embed_webfiles.py implements the same function to lay out the embedded file table.
+inline uint32_t pathHash(const char *path, size_t length, uint32_t seed) {
+  uint32_t hash = PATH_HASH_OFFSET ^ seed;
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(path[i])) * PATH_HASH_PRIME;
+  }
+  return hash;
+}
+
+// Looks `path` up in a collision-free slot array: one hash, one slot, one compare. `slots` holds
+// the index into `keys` for each slot or -1; returns that index or -1 when the path is unknown.
+inline int findPerfectPath(const int16_t *slots, uint8_t slotBits, uint32_t seed, const char *const *keys,
+                           const uint8_t *keyLengths, const char *path, size_t length) {
+  if (path == nullptr) {
+    return -1;
+  }
+  const uint32_t slot = pathHash(path, length, seed) & ((1UL << slotBits) - 1UL);
+  const int16_t index = slots[slot];
+  if (index < 0 || keyLengths[index] != length || std::memcmp(keys[index], path, length) != 0) {
+    return -1;
+  }
+  return index;
+}
+
+// The same lookup for paths only known at runtime: add() every path, then build() searches for a
+// seed under which no two paths share a slot. Fixed storage, no allocation.
+template <uint8_t Capacity, uint8_t SlotBits>
+class PerfectPathTable {
+  static_assert(SlotBits <= 12, "slot array too large");
+  static_assert((1U << SlotBits) >= 2U * Capacity, "keep the load factor at or below one half");
+
+ public:
+  static constexpr uint16_t SLOT_COUNT = 1U << SlotBits;
+  static constexpr uint32_t MAX_SEED_ATTEMPTS = 100000UL;
+
+  // Returns the path's index, or -1 when the table is full or already built. Paths are not copied.
+  int add(const char *path) {
+    const size_t length = std::strlen(path);
+    if (built_ || count_ >= Capacity || length > UINT8_MAX) {
+      return -1;
+    }
+    keys_[count_] = path;
+    lengths_[count_] = static_cast<uint8_t>(length);
+    return count_++;
+  }
+
+  // False when two paths are identical or no collision-free seed was found.
+  bool build() {
+    for (uint8_t i = 0; i < count_; ++i) {
+      for (uint8_t j = static_cast<uint8_t>(i + 1U); j < count_; ++j) {
+        if (lengths_[i] == lengths_[j] && std::memcmp(keys_[i], keys_[j], lengths_[i]) == 0) {
+          return false;
+        }
+      }
+    }
+    for (uint32_t seed = 0; seed < MAX_SEED_ATTEMPTS; ++seed) {
+      if (tryBuild(seed)) {
+        seed_ = seed;
+        built_ = true;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  int find(const char *path, size_t length) const {
+    if (!built_) {
+      return -1;
+    }
+    return findPerfectPath(slots_, SlotBits, seed_, keys_, lengths_, path, length);
+  }
+
+  uint8_t size() const { return count_; }
+  uint32_t seed() const { return seed_; }
+
+ private:
+  bool tryBuild(uint32_t seed) {
+    for (uint16_t i = 0; i < SLOT_COUNT; ++i) {
+      slots_[i] = -1;
+    }
+    for (uint8_t i = 0; i < count_; ++i) {
+      const uint32_t slot = pathHash(keys_[i], lengths_[i], seed) & (SLOT_COUNT - 1U);
+      if (slots_[slot] >= 0) {
+        return false;
+      }
+      slots_[slot] = i;
+    }
+    return true;
+  }
+
+  const char *keys_[Capacity] = {};
+  uint8_t lengths_[Capacity] = {};
+  int16_t slots_[1U << SlotBits] = {};
+  uint8_t count_ = 0;
+  uint32_t seed_ = 0;
+  bool built_ = false;
+};
+
+}  // namespace HeatControl
@@ -0,0 +1,162 @@
+#include "pattern_engine.h"
+
+namespace HeatControl {
+namespace logic {
+
+namespace {
+
+constexpr PatternOp HOLD_OFF_OPS[] = {patternHold(false)};
+constexpr PatternOp HOLD_ON_OPS[] = {patternHold(true)};
+constexpr PatternProgram HOLD_OFF = patternProgram(HOLD_OFF_OPS, false);
+constexpr PatternProgram HOLD_ON = patternProgram(HOLD_ON_OPS, false);
+
+}  // namespace
+
+void PatternPlayer::start(const PatternProgram &program, uint8_t arg) {
+  program_ = program;
+  pc_ = 0;
+  arg_ = arg;
+  repeatLeft_ = 0;
+  waiting_ = false;
+  holding_ = false;
+}
+
+bool PatternPlayer::advance(unsigned long nowMs, SignalTimingPreset preset) {
+  if (!running()) {
+    return false;
+  }
+  if (holding_) {
+    return true;
+  }
+  if (waiting_) {
+    if (static_cast<long>(nowMs - waitUntilMs_) < 0) {
+      return true;
+    }
+    waiting_ = false;
+    ++pc_;
+  }
+
+  // Every pass either waits or moves on, so a program without a Level/Hold in its loop ends here.
+  for (uint16_t executed = 0; executed <= program_.length; ++executed) {
+    if (pc_ >= program_.length) {
+      break;
+    }
+    const PatternOp &op = program_.ops[pc_];
+    switch (op.code) {
+      case PatternOpCode::Level:
+        level_ = op.a != 0U;
+        waiting_ = true;
+        waitUntilMs_ = nowMs + (program_.scaled ? scaleSignalMs(op.b, preset) : op.b);
+        return true;
+      case PatternOpCode::Hold:
+        level_ = op.a != 0U;
+        holding_ = true;
+        return true;
+      case PatternOpCode::Repeat:
+        if (repeatLeft_ == 0U) {
+          repeatLeft_ = (op.a != 0U) ? op.a : arg_;
+        }
+        if (repeatLeft_ > 0U) {
+          --repeatLeft_;
+        }
+        pc_ = (repeatLeft_ > 0U) ? static_cast<uint8_t>(op.b) : static_cast<uint8_t>(pc_ + 1U);
+        break;
+      case PatternOpCode::Loop:
+        pc_ = static_cast<uint8_t>(op.b);
+        break;
+      case PatternOpCode::End:
+      default:
+        stop();
+        return false;
+    }
+  }
+  stop();
+  return false;
+}
+
+int PatternScheduler::addOutput(int pin, bool activeLow) {
+  if (count_ >= PATTERN_MAX_OUTPUTS) {
+    return -1;
+  }
+  Output &output = outputs_[count_];
+  output.pin = pin;
+  output.activeLow = activeLow;
+  output.on = false;
+  output.written = false;
+  for (uint8_t layer = 0; layer < PATTERN_LAYERS; ++layer) {
+    output.holdLevel[layer] = -1;
+    output.layers[layer].stop();
+  }
+  return count_++;
+}
+
+void PatternScheduler::begin(IGpio &gpio) {
+  for (uint8_t i = 0; i < count_; ++i) {
+    outputs_[i].written = false;
+    write(outputs_[i], outputs_[i].on, gpio);
+  }
+}
+
+void PatternScheduler::play(uint8_t output, uint8_t layer, const PatternProgram &program, uint8_t arg) {
+  if (output >= count_ || layer >= PATTERN_LAYERS) {
+    return;
+  }
+  outputs_[output].holdLevel[layer] = -1;
+  outputs_[output].layers[layer].start(program, arg);
+}
+
+void PatternScheduler::stop(uint8_t output, uint8_t layer) {
+  if (output >= count_ || layer >= PATTERN_LAYERS) {
+    return;
+  }
+  outputs_[output].holdLevel[layer] = -1;
+  outputs_[output].layers[layer].stop();
+}
+
+bool PatternScheduler::playing(uint8_t output, uint8_t layer) const {
+  return output < count_ && layer < PATTERN_LAYERS && outputs_[output].layers[layer].running();
+}
+
+void PatternScheduler::hold(uint8_t output, uint8_t layer, bool on) {
+  if (output >= count_ || layer >= PATTERN_LAYERS || outputs_[output].holdLevel[layer] == (on ? 1 : 0)) {
+    return;
+  }
+  play(output, layer, on ? HOLD_ON : HOLD_OFF);
+  outputs_[output].holdLevel[layer] = on ? 1 : 0;
+}
+
+void PatternScheduler::tick(unsigned long nowMs, SignalTimingPreset preset, IGpio &gpio) {
+  for (uint8_t i = 0; i < count_; ++i) {
+    Output &output = outputs_[i];
+    bool on = false;
+    for (uint8_t layer = 0; layer < PATTERN_LAYERS; ++layer) {
+      PatternPlayer &player = output.layers[layer];
+      if (!player.running()) {
+        continue;
+      }
+      if (player.advance(nowMs, preset)) {
+        on = player.level();
+        break;
+      }
+      // The owner just ended; the next running layer takes over in this tick.
+      output.holdLevel[layer] = -1;
+    }
+    write(output, on, gpio);
+  }
+}
+
+bool PatternScheduler::outputOn(uint8_t output) const {
+  return output < count_ && outputs_[output].on;
+}
+
+void PatternScheduler::write(Output &output, bool on, IGpio &gpio) {
+  if (output.written && output.on == on) {
+    return;
+  }
+  output.on = on;
+  output.written = true;
+  gpio.writePin(output.pin, (on != output.activeLow) ? PIN_HIGH : PIN_LOW);
+}
+
+}  // namespace logic
+}  // namespace HeatControl
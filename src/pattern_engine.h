@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "control_logic.h"
+#include "signal_sequencer.h"
+
+namespace HeatControl {
+namespace logic {
+
+// Output patterns as tiny programs. A Level op sets the output and waits; the others are control
+// flow and take no time. Programs are constexpr tables, so a new pattern needs no new code.
+enum class PatternOpCode : uint8_t {
+  Level,   // on = a, wait b ms
+  Hold,    // on = a, wait forever
+  Repeat,  // jump to b the first a - 1 times it is reached, then fall through (a = 0: the start() argument)
+  Loop,    // jump to b
+  End,     // release the output to the next layer
+};
+
+struct PatternOp {
+  PatternOpCode code;
+  uint8_t a;
+  uint16_t b;
+};
+
+constexpr PatternOp patternOn(uint16_t ms) { return PatternOp{PatternOpCode::Level, 1, ms}; }
+constexpr PatternOp patternOff(uint16_t ms) { return PatternOp{PatternOpCode::Level, 0, ms}; }
+constexpr PatternOp patternHold(bool on) { return PatternOp{PatternOpCode::Hold, static_cast<uint8_t>(on ? 1 : 0), 0}; }
+constexpr PatternOp patternRepeat(uint16_t target, uint8_t times) {
+  return PatternOp{PatternOpCode::Repeat, times, target};
+}
+constexpr PatternOp patternRepeatArg(uint16_t target) { return PatternOp{PatternOpCode::Repeat, 0, target}; }
+constexpr PatternOp patternLoop(uint16_t target) { return PatternOp{PatternOpCode::Loop, 0, target}; }
+constexpr PatternOp patternEnd() { return PatternOp{PatternOpCode::End, 0, 0}; }
+
+struct PatternProgram {
+  const PatternOp *ops;
+  uint8_t length;
+  // Level durations follow the signal timing preset (scaleSignalMs).
+  bool scaled;
+};
+
+template <size_t N>
+constexpr PatternProgram patternProgram(const PatternOp (&ops)[N], bool scaled) {
+  static_assert(N > 0 && N <= 255, "pattern programs hold 1..255 ops");
+  return PatternProgram{ops, static_cast<uint8_t>(N), scaled};
+}
+
+// Runs one program (copied, the ops table must be static). A Level op ends at the first advance() at or after (its start + duration), and
+// the next op starts at that advance(), as the hand-written LED state machines did.
+class PatternPlayer {
+ public:
+  void start(const PatternProgram &program, uint8_t arg);
+  void stop() { program_.ops = nullptr; }
+  bool running() const { return program_.ops != nullptr; }
+  bool level() const { return level_; }
+  // Executes due ops; returns false once the program has ended. Bounded by the program length.
+  bool advance(unsigned long nowMs, SignalTimingPreset preset);
+
+ private:
+  PatternProgram program_ = {nullptr, 0, false};
+  uint8_t pc_ = 0;
+  uint8_t arg_ = 0;
+  uint8_t repeatLeft_ = 0;
+  bool level_ = false;
+  bool waiting_ = false;
+  bool holding_ = false;
+  unsigned long waitUntilMs_ = 0;
+};
+
+constexpr uint8_t PATTERN_MAX_OUTPUTS = 4;
+constexpr uint8_t PATTERN_LAYERS = 4;
+
+// Drives several outputs from one tick. Each output has PATTERN_LAYERS program slots; layer 0 has the
+// highest priority and the highest running layer owns the pin. Lower layers are paused, not reset,
+// while they are covered. tick() advances only the owner and writes a pin only when its level changes.
+class PatternScheduler {
+ public:
+  // Returns the output index, or -1 when all outputs are taken.
+  int addOutput(int pin, bool activeLow);
+  // Drives every output to its current level, whether or not it changed.
+  void begin(IGpio &gpio);
+
+  // Starts `program` on a layer from its first op; `arg` feeds patternRepeatArg().
+  void play(uint8_t output, uint8_t layer, const PatternProgram &program, uint8_t arg = 0);
+  void stop(uint8_t output, uint8_t layer);
+  bool playing(uint8_t output, uint8_t layer) const;
+  // Keeps a layer at a fixed level; cheap to call every pass with the same value.
+  void hold(uint8_t output, uint8_t layer, bool on);
+
+  void tick(unsigned long nowMs, SignalTimingPreset preset, IGpio &gpio);
+  bool outputOn(uint8_t output) const;
+
+ private:
+  struct Output {
+    int pin;
+    bool activeLow;
+    bool on;
+    bool written;
+    int8_t holdLevel[PATTERN_LAYERS];  // -1: layer not held by hold()
+    PatternPlayer layers[PATTERN_LAYERS];
+  };
+
+  void write(Output &output, bool on, IGpio &gpio);
+
+  Output outputs_[PATTERN_MAX_OUTPUTS];
+  uint8_t count_ = 0;
+};
+
+}  // namespace logic
+}  // namespace HeatControl
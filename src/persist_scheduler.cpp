@@ -0,0 +1,69 @@
+#include "persist_scheduler.h"
+
+#include <cstring>
+
+namespace HeatControl {
+namespace logic {
+
+namespace {
+
+// Signed so a mark stamped on another task after the caller captured `nowMs` reads as "just now"
+// instead of wrapping to a 49-day-old change.
+bool within(uint32_t nowMs, uint32_t sinceMs, uint32_t windowMs) {
+  return static_cast<int32_t>(nowMs - sinceMs) < static_cast<int32_t>(windowMs);
+}
+
+}  // namespace
+
+PersistScheduler::PersistScheduler(uint32_t debounceMs, uint32_t maxDelayMs)
+    : debounceMs_(debounceMs), maxDelayMs_(maxDelayMs) {
+  std::memset(&stats_, 0, sizeof(stats_));
+}
+
+void PersistScheduler::mark(uint32_t fields, uint32_t nowMs) {
+  if (fields == 0U) {
+    return;
+  }
+  if (pending_ == 0U) {
+    firstMarkMs_ = nowMs;
+  }
+  pending_ |= fields;
+  lastMarkMs_ = nowMs;
+  ++stats_.marks;
+}
+
+uint32_t PersistScheduler::take(uint32_t nowMs) {
+  if (pending_ == 0U || (within(nowMs, lastMarkMs_, debounceMs_) && within(nowMs, firstMarkMs_, maxDelayMs_))) {
+    return 0;
+  }
+  return takeAll();
+}
+
+uint32_t PersistScheduler::takeAll() {
+  const uint32_t fields = pending_;
+  pending_ = 0;
+  if (fields != 0U) {
+    ++stats_.flushes;
+    stats_.lastFields = fields;
+  }
+  return fields;
+}
+
+void PersistScheduler::recordFlush(uint32_t durationUs) {
+  stats_.lastFlushUs = durationUs;
+  if (durationUs > stats_.maxFlushUs) {
+    stats_.maxFlushUs = durationUs;
+  }
+}
+
+void writePersistStatsFields(JsonWriter &w, const PersistStats &stats, uint32_t pending) {
+  w.fieldUint("persistPending", pending);
+  w.fieldUint("persistMarks", stats.marks);
+  w.fieldUint("persistFlushes", stats.flushes);
+  w.fieldUint("persistLastFields", stats.lastFields);
+  w.fieldUint("persistLastFlushUs", stats.lastFlushUs);
+  w.fieldUint("persistMaxFlushUs", stats.maxFlushUs);
+}
+
+}  // namespace logic
+}  // namespace HeatControl
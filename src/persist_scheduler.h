@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#include "json_writer.h"
+
+namespace HeatControl {
+namespace logic {
+
+struct PersistStats {
+  uint32_t marks;         // mark() calls, each naming one or more fields
+  uint32_t flushes;       // batches handed out by take()/takeAll()
+  uint32_t lastFlushUs;   // as reported by recordFlush()
+  uint32_t maxFlushUs;
+  uint32_t lastFields;    // fields of the last flush
+};
+
+// Coalesces settings changes into few flash commits. Callers mark changed fields (bits of a mask
+// the caller defines); the owner of the flash writes asks take() which fields are due. A field is
+// due once no change arrived for `debounceMs`, or `maxDelayMs` after the first unwritten change so
+// a steady stream of edits still reaches flash. Not thread-safe; the firmware wraps it in a lock.
+class PersistScheduler {
+ public:
+  PersistScheduler(uint32_t debounceMs, uint32_t maxDelayMs);
+
+  void mark(uint32_t fields, uint32_t nowMs);
+  // Fields to write now, cleared from the pending set; 0 when nothing is due yet.
+  uint32_t take(uint32_t nowMs);
+  // Everything pending regardless of timing, e.g. right before a restart.
+  uint32_t takeAll();
+  uint32_t pending() const { return pending_; }
+  void recordFlush(uint32_t durationUs);
+  const PersistStats &stats() const { return stats_; }
+
+ private:
+  uint32_t debounceMs_;
+  uint32_t maxDelayMs_;
+  uint32_t pending_ = 0;
+  uint32_t firstMarkMs_ = 0;
+  uint32_t lastMarkMs_ = 0;
+  PersistStats stats_;
+};
+
+// Appends the scheduler counters to an open JSON object.
+void writePersistStatsFields(JsonWriter &w, const PersistStats &stats, uint32_t pending);
+
+}  // namespace logic
+}  // namespace HeatControl
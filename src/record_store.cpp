@@ -0,0 +1,383 @@
+#include "record_store.h"
+
+#include <cstring>
+
+namespace HeatControl {
+namespace logic {
+
+namespace {
+
+constexpr uint8_t SECTOR_MAGIC[4] = {'H', 'C', 'R', 'S'};
+constexpr uint8_t BATCH_MARKER = 0xB5;
+constexpr uint8_t ERASED_BYTE = 0xFF;
+
+uint32_t crc32(const uint8_t *data, size_t length) {
+  static const uint32_t table[16] = {
+      0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL, 0x76DC4190UL, 0x6B6B51F4UL,
+      0x4DB26158UL, 0x5005713CUL, 0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL,
+      0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL,
+  };
+  uint32_t crc = 0xFFFFFFFFUL;
+  for (size_t i = 0; i < length; ++i) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 0x0FU];
+    crc = (crc >> 4) ^ table[crc & 0x0FU];
+  }
+  return ~crc;
+}
+
+void put16(uint8_t *out, uint16_t value) {
+  out[0] = static_cast<uint8_t>(value);
+  out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void put32(uint8_t *out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+uint16_t get16(const uint8_t *in) {
+  return static_cast<uint16_t>(in[0] | (in[1] << 8));
+}
+
+uint32_t get32(const uint8_t *in) {
+  return static_cast<uint32_t>(in[0]) | (static_cast<uint32_t>(in[1]) << 8) |
+         (static_cast<uint32_t>(in[2]) << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+
+// Batches start on 4-byte boundaries so every flash write is word aligned.
+size_t alignUp(size_t length) {
+  return (length + 3U) & ~static_cast<size_t>(3U);
+}
+
+uint64_t keyBit(uint8_t key) {
+  return static_cast<uint64_t>(1) << key;
+}
+
+}  // namespace
+
+RecordStore::RecordStore(IFlashRegion &flash, uint32_t (*clockUs)()) : flash_(flash), clockUs_(clockUs) {
+  std::memset(&stats_, 0, sizeof(stats_));
+  std::memset(values_, 0, sizeof(values_));
+  std::memset(lengths_, 0, sizeof(lengths_));
+  std::memset(eraseCounts_, 0, sizeof(eraseCounts_));
+}
+
+bool RecordStore::readSectorHeader(size_t sector, uint32_t &eraseCount, uint32_t &generation) {
+  uint8_t header[RECORD_SECTOR_HEADER_BYTES];
+  if (!flash_.read(sector * sectorBytes_, header, sizeof(header))) {
+    ++stats_.flashErrors;
+    return false;
+  }
+  if (std::memcmp(header, SECTOR_MAGIC, sizeof(SECTOR_MAGIC)) != 0 || header[4] != RECORD_FORMAT_VERSION ||
+      get32(header + 16) != crc32(header, 16)) {
+    return false;
+  }
+  eraseCount = get32(header + 8);
+  generation = get32(header + 12);
+  return generation != 0U;
+}
+
+bool RecordStore::mount() {
+  const uint32_t startUs = clockUs_();
+  sectorBytes_ = flash_.sectorBytes();
+  sectorCount_ = flash_.sectorCount();
+  std::memset(&stats_, 0, sizeof(stats_));
+  present_ = 0;
+  dirty_ = 0;
+  needsCompaction_ = true;
+  mounted_ = false;
+  if (sectorCount_ < 2U || sectorCount_ > RECORD_MAX_SECTORS ||
+      sectorBytes_ < RECORD_SECTOR_HEADER_BYTES + RECORD_MAX_BATCH_BYTES || sectorBytes_ > 0xFFFFU) {
+    return false;
+  }
+
+  size_t newest = sectorCount_;
+  for (size_t sector = 0; sector < sectorCount_; ++sector) {
+    uint32_t eraseCount = 0;
+    uint32_t generation = 0;
+    eraseCounts_[sector] = 0;
+    if (readSectorHeader(sector, eraseCount, generation)) {
+      eraseCounts_[sector] = eraseCount;
+      if (generation > stats_.generation) {
+        stats_.generation = generation;
+        newest = sector;
+      }
+    }
+  }
+
+  stats_.sectors = static_cast<uint16_t>(sectorCount_);
+  if (newest < sectorCount_) {
+    stats_.activeSector = static_cast<uint16_t>(newest);
+    replaySector(newest);
+  }
+  updateEraseStats();
+  stats_.mountUs = clockUs_() - startUs;
+  mounted_ = true;
+  return true;
+}
+
+void RecordStore::replaySector(size_t sector) {
+  const size_t base = sector * sectorBytes_;
+  size_t offset = RECORD_SECTOR_HEADER_BYTES;
+  bool clean = true;
+  while (offset + RECORD_BATCH_HEADER_BYTES <= sectorBytes_) {
+    uint8_t *header = scratch_;
+    if (!flash_.read(base + offset, header, RECORD_BATCH_HEADER_BYTES)) {
+      ++stats_.flashErrors;
+      clean = false;
+      break;
+    }
+    if (header[0] == ERASED_BYTE) {
+      break;
+    }
+    const uint8_t records = header[1];
+    const size_t bodyLength = get16(header + 2);
+    const uint32_t crc = get32(header + 4);
+    uint8_t *body = scratch_ + RECORD_BATCH_HEADER_BYTES;
+    if (header[0] != BATCH_MARKER || bodyLength > RECORD_MAX_BATCH_BYTES - RECORD_BATCH_HEADER_BYTES ||
+        offset + RECORD_BATCH_HEADER_BYTES + bodyLength > sectorBytes_ ||
+        !flash_.read(base + offset + RECORD_BATCH_HEADER_BYTES, body, bodyLength) ||
+        crc32(body, bodyLength) != crc) {
+      ++stats_.droppedBatches;
+      clean = false;
+      break;
+    }
+
+    // Validate the whole batch before applying any of it.
+    size_t cursor = 0;
+    uint8_t seen = 0;
+    while (cursor + 2U <= bodyLength && body[cursor] < RECORD_KEY_COUNT &&
+           body[cursor + 1] <= RECORD_MAX_VALUE_BYTES && cursor + 2U + body[cursor + 1] <= bodyLength) {
+      cursor += 2U + body[cursor + 1];
+      ++seen;
+    }
+    if (cursor != bodyLength || seen != records) {
+      ++stats_.droppedBatches;
+      clean = false;
+      break;
+    }
+    for (cursor = 0; cursor < bodyLength; cursor += 2U + body[cursor + 1]) {
+      const uint8_t key = body[cursor];
+      lengths_[key] = body[cursor + 1];
+      std::memcpy(values_[key], body + cursor + 2, lengths_[key]);
+      present_ |= keyBit(key);
+    }
+    offset += alignUp(RECORD_BATCH_HEADER_BYTES + bodyLength);
+  }
+
+  // Bytes after the last batch must still be erased, or a half-written batch sits there.
+  for (size_t tail = offset; clean && tail < sectorBytes_;) {
+    const size_t chunk = sectorBytes_ - tail < sizeof(scratch_) ? sectorBytes_ - tail : sizeof(scratch_);
+    if (!flash_.read(base + tail, scratch_, chunk)) {
+      ++stats_.flashErrors;
+      clean = false;
+      break;
+    }
+    for (size_t i = 0; i < chunk; ++i) {
+      if (scratch_[i] != ERASED_BYTE) {
+        clean = false;
+        break;
+      }
+    }
+    tail += chunk;
+  }
+
+  writeOffset_ = offset;
+  needsCompaction_ = !clean;
+  stats_.usedBytes = static_cast<uint16_t>(offset);
+  uint16_t keys = 0;
+  for (uint8_t key = 0; key < RECORD_KEY_COUNT; ++key) {
+    keys = static_cast<uint16_t>(keys + ((present_ & keyBit(key)) != 0U ? 1U : 0U));
+  }
+  stats_.keys = keys;
+}
+
+bool RecordStore::get(uint8_t key, void *out, size_t length) const {
+  if (key >= RECORD_KEY_COUNT || (present_ & keyBit(key)) == 0U || lengths_[key] != length) {
+    return false;
+  }
+  std::memcpy(out, values_[key], length);
+  return true;
+}
+
+size_t RecordStore::getBytes(uint8_t key, void *out, size_t capacity) const {
+  if (key >= RECORD_KEY_COUNT || (present_ & keyBit(key)) == 0U) {
+    return 0;
+  }
+  std::memcpy(out, values_[key], lengths_[key] < capacity ? lengths_[key] : capacity);
+  return lengths_[key];
+}
+
+bool RecordStore::set(uint8_t key, const void *data, size_t length) {
+  if (key >= RECORD_KEY_COUNT || length > RECORD_MAX_VALUE_BYTES || (data == nullptr && length > 0U)) {
+    return false;
+  }
+  if ((present_ & keyBit(key)) != 0U && lengths_[key] == length && std::memcmp(values_[key], data, length) == 0) {
+    return true;
+  }
+  if (length > 0U) {
+    std::memcpy(values_[key], data, length);
+  }
+  if ((present_ & keyBit(key)) == 0U) {
+    ++stats_.keys;
+  }
+  lengths_[key] = static_cast<uint8_t>(length);
+  present_ |= keyBit(key);
+  dirty_ |= keyBit(key);
+  return true;
+}
+
+size_t RecordStore::encodeBatch(uint64_t keys) {
+  size_t length = RECORD_BATCH_HEADER_BYTES;
+  uint8_t records = 0;
+  for (uint8_t key = 0; key < RECORD_KEY_COUNT; ++key) {
+    if ((keys & keyBit(key)) == 0U) {
+      continue;
+    }
+    scratch_[length] = key;
+    scratch_[length + 1] = lengths_[key];
+    std::memcpy(scratch_ + length + 2, values_[key], lengths_[key]);
+    length += 2U + lengths_[key];
+    ++records;
+  }
+  const size_t bodyLength = length - RECORD_BATCH_HEADER_BYTES;
+  scratch_[0] = BATCH_MARKER;
+  scratch_[1] = records;
+  put16(scratch_ + 2, static_cast<uint16_t>(bodyLength));
+  put32(scratch_ + 4, crc32(scratch_ + RECORD_BATCH_HEADER_BYTES, bodyLength));
+  // Padding stays erased so the next batch can still be written after it.
+  while (length % 4U != 0U) {
+    scratch_[length++] = ERASED_BYTE;
+  }
+  return length;
+}
+
+bool RecordStore::compact() {
+  // Next sector in the ring, or the least worn one when nothing was stored yet.
+  size_t target = 0;
+  if (stats_.generation != 0U) {
+    target = (static_cast<size_t>(stats_.activeSector) + 1U) % sectorCount_;
+  } else {
+    for (size_t sector = 1; sector < sectorCount_; ++sector) {
+      if (eraseCounts_[sector] < eraseCounts_[target]) {
+        target = sector;
+      }
+    }
+  }
+
+  if (!flash_.eraseSector(target)) {
+    ++stats_.flashErrors;
+    return false;
+  }
+  ++eraseCounts_[target];
+
+  // The header goes in last: a sector without one is ignored at mount, so the previous sector
+  // stays authoritative until the snapshot is complete.
+  const size_t base = target * sectorBytes_;
+  const size_t length = encodeBatch(present_);
+  uint8_t header[RECORD_SECTOR_HEADER_BYTES];
+  std::memcpy(header, SECTOR_MAGIC, sizeof(SECTOR_MAGIC));
+  header[4] = RECORD_FORMAT_VERSION;
+  header[5] = ERASED_BYTE;
+  header[6] = ERASED_BYTE;
+  header[7] = ERASED_BYTE;
+  put32(header + 8, eraseCounts_[target]);
+  put32(header + 12, stats_.generation + 1U);
+  put32(header + 16, crc32(header, 16));
+  if (!flash_.write(base + RECORD_SECTOR_HEADER_BYTES, scratch_, length) ||
+      !flash_.write(base, header, sizeof(header))) {
+    ++stats_.flashErrors;
+    return false;
+  }
+
+  ++stats_.generation;
+  ++stats_.compactions;
+  stats_.bytesWritten += static_cast<uint32_t>(length + sizeof(header));
+  stats_.activeSector = static_cast<uint16_t>(target);
+  writeOffset_ = RECORD_SECTOR_HEADER_BYTES + length;
+  stats_.usedBytes = static_cast<uint16_t>(writeOffset_);
+  needsCompaction_ = false;
+  dirty_ = 0;
+  updateEraseStats();
+  return true;
+}
+
+bool RecordStore::commit() {
+  if (!mounted_) {
+    return false;
+  }
+  if (dirty_ == 0U) {
+    return true;
+  }
+  const uint32_t startUs = clockUs_();
+  bool ok = false;
+  if (!needsCompaction_) {
+    const size_t length = encodeBatch(dirty_);
+    if (writeOffset_ + length <= sectorBytes_) {
+      ok = flash_.write(stats_.activeSector * sectorBytes_ + writeOffset_, scratch_, length);
+      if (ok) {
+        writeOffset_ += length;
+        stats_.usedBytes = static_cast<uint16_t>(writeOffset_);
+        stats_.bytesWritten += static_cast<uint32_t>(length);
+        dirty_ = 0;
+      } else {
+        // Whatever part of the batch made it to flash now blocks the rest of the sector.
+        ++stats_.flashErrors;
+        needsCompaction_ = true;
+      }
+    } else {
+      needsCompaction_ = true;
+    }
+  }
+  if (!ok && needsCompaction_) {
+    ok = compact();
+  }
+  if (ok) {
+    ++stats_.commits;
+  }
+  stats_.lastCommitUs = clockUs_() - startUs;
+  if (stats_.lastCommitUs > stats_.maxCommitUs) {
+    stats_.maxCommitUs = stats_.lastCommitUs;
+  }
+  return ok;
+}
+
+uint32_t RecordStore::eraseCount(size_t sector) const {
+  return sector < sectorCount_ ? eraseCounts_[sector] : 0U;
+}
+
+void RecordStore::updateEraseStats() {
+  stats_.minEraseCount = eraseCounts_[0];
+  stats_.maxEraseCount = eraseCounts_[0];
+  for (size_t sector = 1; sector < sectorCount_; ++sector) {
+    if (eraseCounts_[sector] < stats_.minEraseCount) {
+      stats_.minEraseCount = eraseCounts_[sector];
+    }
+    if (eraseCounts_[sector] > stats_.maxEraseCount) {
+      stats_.maxEraseCount = eraseCounts_[sector];
+    }
+  }
+}
+
+void writeRecordStoreStatsFields(JsonWriter &w, const RecordStoreStats &stats) {
+  w.fieldUint("sectors", stats.sectors);
+  w.fieldUint("activeSector", stats.activeSector);
+  w.fieldUint("usedBytes", stats.usedBytes);
+  w.fieldUint("keys", stats.keys);
+  w.fieldUint("generation", stats.generation);
+  w.fieldUint("minEraseCount", stats.minEraseCount);
+  w.fieldUint("maxEraseCount", stats.maxEraseCount);
+  w.fieldUint("commits", stats.commits);
+  w.fieldUint("compactions", stats.compactions);
+  w.fieldUint("bytesWritten", stats.bytesWritten);
+  w.fieldUint("lastCommitUs", stats.lastCommitUs);
+  w.fieldUint("maxCommitUs", stats.maxCommitUs);
+  w.fieldUint("mountUs", stats.mountUs);
+  w.fieldUint("droppedBatches", stats.droppedBatches);
+  w.fieldUint("flashErrors", stats.flashErrors);
+}
+
+}  // namespace logic
+}  // namespace HeatControl
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "json_writer.h"
+
+namespace HeatControl {
+namespace logic {
+
+// Raw flash the record store lives on: erased bytes read 0xFF, writes can only clear bits and
+// erasing works on whole sectors.
+class IFlashRegion {
+ public:
+  virtual ~IFlashRegion() = default;
+  virtual size_t sectorBytes() const = 0;
+  virtual size_t sectorCount() const = 0;
+  virtual bool read(size_t offset, void *out, size_t length) = 0;
+  virtual bool write(size_t offset, const void *data, size_t length) = 0;
+  virtual bool eraseSector(size_t sector) = 0;
+};
+
+constexpr uint8_t RECORD_KEY_COUNT = 64;
+constexpr uint8_t RECORD_MAX_VALUE_BYTES = 32;
+constexpr size_t RECORD_MAX_SECTORS = 32;
+constexpr uint8_t RECORD_FORMAT_VERSION = 1;
+constexpr size_t RECORD_SECTOR_HEADER_BYTES = 20;
+constexpr size_t RECORD_BATCH_HEADER_BYTES = 8;
+// A batch holding every key at full length; a sector must fit one after its header.
+constexpr size_t RECORD_MAX_BATCH_BYTES =
+    RECORD_BATCH_HEADER_BYTES + static_cast<size_t>(RECORD_KEY_COUNT) * (2U + RECORD_MAX_VALUE_BYTES);
+
+struct RecordStoreStats {
+  uint32_t generation;     // bumped by every compaction, 0 = nothing stored yet
+  uint32_t commits;        // batches written since mount
+  uint32_t compactions;    // sector switches since mount
+  uint32_t bytesWritten;   // since mount, headers included
+  uint32_t flashErrors;
+  uint32_t mountUs;
+  uint32_t lastCommitUs;   // including a compaction it caused
+  uint32_t maxCommitUs;
+  uint32_t minEraseCount;  // over all sectors of the region
+  uint32_t maxEraseCount;
+  uint16_t sectors;
+  uint16_t activeSector;
+  uint16_t usedBytes;      // of the active sector
+  uint16_t keys;           // keys holding a value
+  uint16_t droppedBatches; // torn or corrupt batches skipped at mount
+};
+
+// Append-only key/value store with a ring of flash sectors. Every commit appends one CRC-checked
+// batch of the changed keys to the active sector; when it is full, the next sector in the ring is
+// erased and starts with a snapshot of all values, so sectors wear evenly and only the newest one
+// has to be read at boot. A sector header (written after its snapshot) carries the format version,
+// its erase count and a generation number; a torn batch is dropped and forces the next commit into
+// a fresh sector. Values of up to RECORD_MAX_VALUE_BYTES live in RAM, so reads never touch flash.
+class RecordStore {
+ public:
+  RecordStore(IFlashRegion &flash, uint32_t (*clockUs)());
+
+  // Finds the newest sector and replays its batches in one pass; false for an unusable region.
+  bool mount();
+  // True when the region held no valid sector, e.g. on first boot.
+  bool empty() const { return stats_.generation == 0U; }
+
+  // Copies the value of `key` if exactly `length` bytes are stored.
+  bool get(uint8_t key, void *out, size_t length) const;
+  // Copies up to `capacity` bytes of a variable-length value and returns its stored length (0 = none).
+  size_t getBytes(uint8_t key, void *out, size_t capacity) const;
+  // Stages a value for the next commit; an unchanged value stays clean. False for a bad key or size.
+  bool set(uint8_t key, const void *data, size_t length);
+  bool dirty() const { return dirty_ != 0U; }
+  // Writes every staged value as one batch; nothing is written when nothing changed.
+  bool commit();
+
+  uint32_t eraseCount(size_t sector) const;
+  const RecordStoreStats &stats() const { return stats_; }
+
+ private:
+  bool readSectorHeader(size_t sector, uint32_t &eraseCount, uint32_t &generation);
+  void replaySector(size_t sector);
+  size_t encodeBatch(uint64_t keys);
+  bool compact();
+  void updateEraseStats();
+
+  IFlashRegion &flash_;
+  uint32_t (*clockUs_)();
+  RecordStoreStats stats_;
+  uint8_t values_[RECORD_KEY_COUNT][RECORD_MAX_VALUE_BYTES];
+  uint8_t lengths_[RECORD_KEY_COUNT];
+  uint64_t present_ = 0;
+  uint64_t dirty_ = 0;
+  uint32_t eraseCounts_[RECORD_MAX_SECTORS];
+  size_t sectorBytes_ = 0;
+  size_t sectorCount_ = 0;
+  size_t writeOffset_ = 0;
+  bool mounted_ = false;
+  bool needsCompaction_ = true;
+  uint8_t scratch_[RECORD_MAX_BATCH_BYTES];
+};
+
+// Appends the store counters (erase counts, commit latency, ...) to an open JSON object.
+void writeRecordStoreStatsFields(JsonWriter &w, const RecordStoreStats &stats);
+
+}  // namespace logic
+}  // namespace HeatControl
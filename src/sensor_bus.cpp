@@ -0,0 +1,238 @@
+#include "sensor_bus.h"
+
+#include <cstring>
+
+namespace HeatControl {
+namespace logic {
+
+namespace {
+
+constexpr uint8_t FAMILY_DS18B20 = 0x28;
+constexpr uint8_t FAMILY_DS1822 = 0x22;
+constexpr uint8_t FAMILY_DS1825 = 0x3B;
+// An empty slot is only probed for a hot-plugged sensor every this many cycles.
+constexpr uint8_t SENSOR_HOTPLUG_SCAN_CYCLES = 30;
+
+bool isAllZeros(const uint8_t *data, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    if (data[i] != 0U) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+uint8_t dallasCrc8(const uint8_t *data, size_t length) {
+  // Dallas/Maxim CRC-8 (polynomial x^8 + x^5 + x^4 + 1, reflected 0x8C).
+  uint8_t crc = 0;
+  for (size_t i = 0; i < length; ++i) {
+    uint8_t in = data[i];
+    for (uint8_t bit = 0; bit < 8; ++bit) {
+      const uint8_t mix = static_cast<uint8_t>((crc ^ in) & 0x01U);
+      crc = static_cast<uint8_t>(crc >> 1);
+      if (mix != 0U) {
+        crc ^= 0x8CU;
+      }
+      in = static_cast<uint8_t>(in >> 1);
+    }
+  }
+  return crc;
+}
+
+bool isEmptySensorRom(const SensorRom &rom) {
+  return isAllZeros(rom.bytes, SENSOR_ROM_BYTES);
+}
+
+bool isValidSensorRom(const SensorRom &rom) {
+  const uint8_t family = rom.bytes[0];
+  if (family != FAMILY_DS18B20 && family != FAMILY_DS1822 && family != FAMILY_DS1825) {
+    return false;
+  }
+  return dallasCrc8(rom.bytes, SENSOR_ROM_BYTES - 1) == rom.bytes[SENSOR_ROM_BYTES - 1];
+}
+
+bool sameSensorRom(const SensorRom &a, const SensorRom &b) {
+  return std::memcmp(a.bytes, b.bytes, SENSOR_ROM_BYTES) == 0;
+}
+
+void clearSensorRomTable(SensorRomTable &table) {
+  std::memset(&table, 0, sizeof(table));
+}
+
+uint8_t sensorRomTableCount(const SensorRomTable &table) {
+  uint8_t count = 0;
+  for (uint8_t slot = 0; slot < SENSOR_SLOT_COUNT; ++slot) {
+    if (!isEmptySensorRom(table.slots[slot])) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+bool decodeScratchpadTempC(const uint8_t *scratchpad, float &tempC) {
+  if (scratchpad == nullptr || isAllZeros(scratchpad, SENSOR_SCRATCHPAD_BYTES)) {
+    return false;
+  }
+  if (dallasCrc8(scratchpad, SENSOR_SCRATCHPAD_BYTES - 1) != scratchpad[SENSOR_SCRATCHPAD_BYTES - 1]) {
+    return false;
+  }
+
+  int16_t raw = static_cast<int16_t>((static_cast<uint16_t>(scratchpad[1]) << 8) | scratchpad[0]);
+  // Config register bits 6:5 select 9..12 bit resolution; lower bits are undefined below 12 bit.
+  const uint8_t resolutionBits = static_cast<uint8_t>((scratchpad[4] >> 5) & 0x03U);
+  const int16_t undefinedMask = static_cast<int16_t>((1 << (3 - resolutionBits)) - 1);
+  raw = static_cast<int16_t>(raw & ~undefinedMask);
+
+  tempC = static_cast<float>(raw) * 0.0625F;
+  return true;
+}
+
+bool assignSensorSlots(const SensorRomTable &previous, const SensorRom *found, uint8_t foundCount,
+                       SensorRomTable &slots) {
+  SensorRomTable next;
+  clearSensorRomTable(next);
+  bool placed[SENSOR_MAX_BUS_DEVICES] = {false, false, false, false};
+  if (foundCount > SENSOR_MAX_BUS_DEVICES) {
+    foundCount = SENSOR_MAX_BUS_DEVICES;
+  }
+
+  for (uint8_t slot = 0; slot < SENSOR_SLOT_COUNT; ++slot) {
+    if (isEmptySensorRom(previous.slots[slot])) {
+      continue;
+    }
+    for (uint8_t i = 0; i < foundCount; ++i) {
+      if (!placed[i] && sameSensorRom(found[i], previous.slots[slot])) {
+        next.slots[slot] = found[i];
+        placed[i] = true;
+        break;
+      }
+    }
+  }
+
+  for (uint8_t i = 0; i < foundCount; ++i) {
+    if (placed[i]) {
+      continue;
+    }
+    for (uint8_t slot = 0; slot < SENSOR_SLOT_COUNT; ++slot) {
+      if (isEmptySensorRom(next.slots[slot])) {
+        next.slots[slot] = found[i];
+        placed[i] = true;
+        break;
+      }
+    }
+  }
+
+  bool changed = false;
+  for (uint8_t slot = 0; slot < SENSOR_SLOT_COUNT; ++slot) {
+    if (!sameSensorRom(next.slots[slot], previous.slots[slot])) {
+      changed = true;
+    }
+  }
+  slots = next;
+  return changed;
+}
+
+float readTempCByRom(ISensorBus &bus, const SensorRom &rom, uint8_t attempts, uint8_t *failedAttempts) {
+  uint8_t failures = 0;
+  float tempC = SENSOR_DISCONNECTED_C;
+  bool ok = false;
+  for (uint8_t attempt = 0; attempt < attempts && !ok; ++attempt) {
+    uint8_t scratchpad[SENSOR_SCRATCHPAD_BYTES] = {0};
+    ok = bus.readScratchpad(rom, scratchpad) && decodeScratchpadTempC(scratchpad, tempC);
+    if (!ok) {
+      ++failures;
+    }
+  }
+  if (failedAttempts != nullptr) {
+    *failedAttempts = failures;
+  }
+  return ok ? tempC : SENSOR_DISCONNECTED_C;
+}
+
+RomAddressedSensors::RomAddressedSensors(ISensorBus &bus) : bus_(bus) {
+  clearSensorRomTable(slots_);
+}
+
+void RomAddressedSensors::enumerate(const SensorRomTable &persisted) {
+  SensorRom searched[SENSOR_MAX_BUS_DEVICES];
+  SensorRom found[SENSOR_MAX_BUS_DEVICES];
+  const uint8_t searchedCount = bus_.search(searched, SENSOR_MAX_BUS_DEVICES);
+  uint8_t foundCount = 0;
+  for (uint8_t i = 0; i < searchedCount && i < SENSOR_MAX_BUS_DEVICES; ++i) {
+    if (!isValidSensorRom(searched[i])) {
+      continue;
+    }
+    bool duplicate = false;
+    for (uint8_t j = 0; j < foundCount; ++j) {
+      duplicate = duplicate || sameSensorRom(found[j], searched[i]);
+    }
+    if (!duplicate) {
+      found[foundCount++] = searched[i];
+    }
+  }
+
+  if (assignSensorSlots(persisted, found, foundCount, slots_)) {
+    slotsChanged_ = true;
+  }
+  failStreak_[0] = 0;
+  failStreak_[1] = 0;
+  cyclesSinceRescan_ = 0;
+}
+
+void RomAddressedSensors::rescan() {
+  const SensorRomTable previous = slots_;
+  enumerate(previous);
+  ++rescanCount_;
+}
+
+void RomAddressedSensors::requestTemperatures() {
+  if (cyclesSinceRescan_ < 255U) {
+    ++cyclesSinceRescan_;
+  }
+
+  bool failing = false;
+  bool empty = false;
+  for (uint8_t slot = 0; slot < SENSOR_SLOT_COUNT; ++slot) {
+    failing = failing || failStreak_[slot] >= SENSOR_RESCAN_AFTER_CYCLES;
+    empty = empty || isEmptySensorRom(slots_.slots[slot]);
+  }
+  if ((failing && cyclesSinceRescan_ >= SENSOR_RESCAN_AFTER_CYCLES) ||
+      (empty && cyclesSinceRescan_ >= SENSOR_HOTPLUG_SCAN_CYCLES)) {
+    rescan();
+  }
+
+  bus_.startConversion();
+}
+
+float RomAddressedSensors::getTempCByIndex(int index) {
+  if (index < 0 || index >= static_cast<int>(SENSOR_SLOT_COUNT)) {
+    return SENSOR_DISCONNECTED_C;
+  }
+  const SensorRom &rom = slots_.slots[index];
+  if (isEmptySensorRom(rom)) {
+    return SENSOR_DISCONNECTED_C;
+  }
+
+  uint8_t failures = 0;
+  const float tempC = readTempCByRom(bus_, rom, SENSOR_READ_ATTEMPTS, &failures);
+  crcRetries_ += failures;
+  if (tempC == SENSOR_DISCONNECTED_C) {
+    if (failStreak_[index] < 255U) {
+      ++failStreak_[index];
+    }
+  } else {
+    failStreak_[index] = 0;
+  }
+  return tempC;
+}
+
+bool RomAddressedSensors::consumeSlotsChanged() {
+  const bool changed = slotsChanged_;
+  slotsChanged_ = false;
+  return changed;
+}
+
+}  // namespace logic
+}  // namespace HeatControl
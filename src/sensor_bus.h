@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "control_logic.h"
+
+namespace HeatControl {
+namespace logic {
+
+constexpr uint8_t SENSOR_SLOT_COUNT = 2;
+constexpr size_t SENSOR_ROM_BYTES = 8;
+constexpr size_t SENSOR_SCRATCHPAD_BYTES = 9;
+constexpr uint8_t SENSOR_READ_ATTEMPTS = 3;
+constexpr uint8_t SENSOR_MAX_BUS_DEVICES = 4;
+// A failing slot triggers a bus search after this many failed cycles; searches are spaced by the same amount.
+constexpr uint8_t SENSOR_RESCAN_AFTER_CYCLES = 3;
+constexpr float SENSOR_DISCONNECTED_C = -127.0F;
+
+struct SensorRom {
+  uint8_t bytes[SENSOR_ROM_BYTES];
+};
+
+struct SensorRomTable {
+  SensorRom slots[SENSOR_SLOT_COUNT];
+};
+
+uint8_t dallasCrc8(const uint8_t *data, size_t length);
+bool isValidSensorRom(const SensorRom &rom);
+bool isEmptySensorRom(const SensorRom &rom);
+bool sameSensorRom(const SensorRom &a, const SensorRom &b);
+void clearSensorRomTable(SensorRomTable &table);
+uint8_t sensorRomTableCount(const SensorRomTable &table);
+
+// Validates the scratchpad CRC and converts the raw reading, masking bits undefined at the configured resolution.
+bool decodeScratchpadTempC(const uint8_t *scratchpad, float &tempC);
+
+// Sensors known from `previous` keep their slot; newly found sensors fill the free slots in bus order.
+// Returns true when the resulting table differs from `previous`.
+bool assignSensorSlots(const SensorRomTable &previous, const SensorRom *found, uint8_t foundCount,
+                       SensorRomTable &slots);
+
+class ISensorBus {
+ public:
+  virtual ~ISensorBus() = default;
+  // Broadcast (skip ROM) conversion start; must not wait for the conversion.
+  virtual void startConversion() = 0;
+  virtual bool readScratchpad(const SensorRom &rom, uint8_t *scratchpad) = 0;
+  // Full OneWire search; returns the number of ROM codes written to `out`.
+  virtual uint8_t search(SensorRom *out, uint8_t maxCount) = 0;
+};
+
+// Retries CRC failures up to `attempts` times; returns SENSOR_DISCONNECTED_C when every attempt failed.
+float readTempCByRom(ISensorBus &bus, const SensorRom &rom, uint8_t attempts, uint8_t *failedAttempts = nullptr);
+
+// Reads DS18B20s by cached ROM code instead of enumerating the bus on every access.
+// The bus is searched once at startup and again only when a slot stays empty or keeps failing.
+class RomAddressedSensors : public ITemperatureSensors {
+ public:
+  explicit RomAddressedSensors(ISensorBus &bus);
+
+  // Searches the bus and maps the found sensors onto slots, preferring the persisted assignment.
+  void enumerate(const SensorRomTable &persisted);
+
+  void requestTemperatures() override;
+  float getTempCByIndex(int index) override;
+
+  const SensorRomTable &slots() const { return slots_; }
+  uint8_t sensorCount() const { return sensorRomTableCount(slots_); }
+  uint32_t crcRetries() const { return crcRetries_; }
+  uint32_t rescanCount() const { return rescanCount_; }
+
+  // True once after the slot table changed (first enumeration or hot-plug); used to persist it.
+  bool consumeSlotsChanged();
+
+ private:
+  void rescan();
+
+  ISensorBus &bus_;
+  SensorRomTable slots_;
+  uint8_t failStreak_[SENSOR_SLOT_COUNT] = {0, 0};
+  uint8_t cyclesSinceRescan_ = 0;
+  bool slotsChanged_ = false;
+  uint32_t crcRetries_ = 0;
+  uint32_t rescanCount_ = 0;
+};
+
+}  // namespace logic
+}  // namespace HeatControl
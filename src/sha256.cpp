@@ -0,0 +1,165 @@
+#include "sha256.h"
+
+#include <cstring>
+
+namespace HeatControl {
+namespace logic {
+
+namespace {
+
+const uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL, 0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
+    0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL, 0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL,
+    0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL, 0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
+    0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL, 0xc6e00bf3UL, 0xd5a79147UL, 0x06ca6351UL, 0x14292967UL,
+    0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL, 0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
+    0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL, 0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
+    0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL, 0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL, 0x682e6ff3UL,
+    0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL, 0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL,
+};
+
+inline uint32_t rotr(uint32_t value, unsigned bits) {
+  return (value >> bits) | (value << (32U - bits));
+}
+
+int hexNibble(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+}  // namespace
+
+void Sha256::reset() {
+  state_[0] = 0x6a09e667UL;
+  state_[1] = 0xbb67ae85UL;
+  state_[2] = 0x3c6ef372UL;
+  state_[3] = 0xa54ff53aUL;
+  state_[4] = 0x510e527fUL;
+  state_[5] = 0x9b05688cUL;
+  state_[6] = 0x1f83d9abUL;
+  state_[7] = 0x5be0cd19UL;
+  totalBytes_ = 0;
+  bufferLength_ = 0;
+}
+
+void Sha256::update(const uint8_t *data, size_t length) {
+  if (data == nullptr) {
+    return;
+  }
+  totalBytes_ += length;
+  if (bufferLength_ > 0U) {
+    const size_t take = length < sizeof(buffer_) - bufferLength_ ? length : sizeof(buffer_) - bufferLength_;
+    std::memcpy(buffer_ + bufferLength_, data, take);
+    bufferLength_ += take;
+    data += take;
+    length -= take;
+    if (bufferLength_ < sizeof(buffer_)) {
+      return;
+    }
+    processBlock(buffer_);
+    bufferLength_ = 0;
+  }
+  // Whole blocks straight from the caller's buffer.
+  while (length >= sizeof(buffer_)) {
+    processBlock(data);
+    data += sizeof(buffer_);
+    length -= sizeof(buffer_);
+  }
+  std::memcpy(buffer_, data, length);
+  bufferLength_ = length;
+}
+
+void Sha256::finish(uint8_t digest[SHA256_DIGEST_BYTES]) {
+  const uint64_t totalBits = totalBytes_ * 8U;
+  buffer_[bufferLength_++] = 0x80U;
+  if (bufferLength_ > 56U) {
+    std::memset(buffer_ + bufferLength_, 0, sizeof(buffer_) - bufferLength_);
+    processBlock(buffer_);
+    bufferLength_ = 0;
+  }
+  std::memset(buffer_ + bufferLength_, 0, 56U - bufferLength_);
+  for (int i = 0; i < 8; ++i) {
+    buffer_[56 + i] = static_cast<uint8_t>(totalBits >> (56 - 8 * i));
+  }
+  processBlock(buffer_);
+
+  for (int i = 0; i < 8; ++i) {
+    digest[4 * i] = static_cast<uint8_t>(state_[i] >> 24);
+    digest[4 * i + 1] = static_cast<uint8_t>(state_[i] >> 16);
+    digest[4 * i + 2] = static_cast<uint8_t>(state_[i] >> 8);
+    digest[4 * i + 3] = static_cast<uint8_t>(state_[i]);
+  }
+  reset();
+}
+
+void Sha256::processBlock(const uint8_t *block) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; ++i) {
+    w[i] = (static_cast<uint32_t>(block[4 * i]) << 24) | (static_cast<uint32_t>(block[4 * i + 1]) << 16) |
+           (static_cast<uint32_t>(block[4 * i + 2]) << 8) | static_cast<uint32_t>(block[4 * i + 3]);
+  }
+  for (int i = 16; i < 64; ++i) {
+    const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = state_[0];
+  uint32_t b = state_[1];
+  uint32_t c = state_[2];
+  uint32_t d = state_[3];
+  uint32_t e = state_[4];
+  uint32_t f = state_[5];
+  uint32_t g = state_[6];
+  uint32_t h = state_[7];
+  for (int i = 0; i < 64; ++i) {
+    const uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+    const uint32_t ch = (e & f) ^ (~e & g);
+    const uint32_t t1 = h + s1 + ch + ROUND_CONSTANTS[i] + w[i];
+    const uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+    const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    const uint32_t t2 = s0 + maj;
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state_[0] += a;
+  state_[1] += b;
+  state_[2] += c;
+  state_[3] += d;
+  state_[4] += e;
+  state_[5] += f;
+  state_[6] += g;
+  state_[7] += h;
+}
+
+bool parseSha256Hex(const char *hex, uint8_t digest[SHA256_DIGEST_BYTES]) {
+  if (hex == nullptr) {
+    return false;
+  }
+  for (size_t i = 0; i < SHA256_DIGEST_BYTES; ++i) {
+    const int high = hexNibble(hex[2 * i]);
+    const int low = high < 0 ? -1 : hexNibble(hex[2 * i + 1]);
+    if (low < 0) {
+      return false;
+    }
+    digest[i] = static_cast<uint8_t>((high << 4) | low);
+  }
+  return hex[2 * SHA256_DIGEST_BYTES] == '\0';
+}
+
+}  // namespace logic
+}  // namespace HeatControl
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace HeatControl {
+namespace logic {
+
+constexpr size_t SHA256_DIGEST_BYTES = 32;
+
+// Incremental SHA-256 (FIPS 180-4); feeds any chunk size, keeps 108 bytes of state.
+class Sha256 {
+ public:
+  Sha256() { reset(); }
+
+  void reset();
+  void update(const uint8_t *data, size_t length);
+  void finish(uint8_t digest[SHA256_DIGEST_BYTES]);
+
+ private:
+  void processBlock(const uint8_t *block);
+
+  uint32_t state_[8];
+  uint64_t totalBytes_;
+  uint8_t buffer_[64];
+  size_t bufferLength_;
+};
+
+// Accepts exactly 64 hex digits, either case.
+bool parseSha256Hex(const char *hex, uint8_t digest[SHA256_DIGEST_BYTES]);
+
+}  // namespace logic
+}  // namespace HeatControl
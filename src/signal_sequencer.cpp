@@ -0,0 +1,95 @@
+#include "signal_sequencer.h"
+
+namespace HeatControl {
+
+namespace {
+
+template <uint8_t N>
+constexpr uint8_t countOf(const uint16_t (&)[N]) {
+  return N;
+}
+
+}  // namespace
+
+uint8_t manualPowerStepPulses(uint8_t manualPowerPercent) {
+  if (manualPowerPercent >= 100) {
+    return 4;
+  }
+  if (manualPowerPercent >= 75) {
+    return 3;
+  }
+  if (manualPowerPercent >= 50) {
+    return 2;
+  }
+  return 1;
+}
+
+bool SignalSequencer::enqueue(const uint16_t *durationsMs, uint8_t count, uint8_t repeat, SignalTimingPreset preset) {
+  const unsigned total = static_cast<unsigned>(count) * repeat;
+  if (durationsMs == nullptr || total == 0U || total > static_cast<unsigned>(CAPACITY - count_)) {
+    return false;
+  }
+  for (uint8_t r = 0; r < repeat; ++r) {
+    for (uint8_t i = 0; i < count; ++i) {
+      Step &step = steps_[(head_ + count_) % CAPACITY];
+      step.durationMs = static_cast<uint16_t>(scaleSignalMs(durationsMs[i], preset));
+      step.on = (i % 2U) == 0U;
+      ++count_;
+    }
+  }
+  return true;
+}
+
+bool SignalSequencer::update(unsigned long nowMs) {
+  if (count_ == 0U) {
+    running_ = false;
+    return false;
+  }
+  if (!running_) {
+    running_ = true;
+    stepStartMs_ = nowMs;
+  }
+  while (count_ > 0U && nowMs - stepStartMs_ >= steps_[head_].durationMs) {
+    stepStartMs_ += steps_[head_].durationMs;
+    head_ = static_cast<uint8_t>((head_ + 1U) % CAPACITY);
+    --count_;
+  }
+  if (count_ == 0U) {
+    running_ = false;
+    return false;
+  }
+  return steps_[head_].on;
+}
+
+void SignalSequencer::clear() {
+  head_ = 0;
+  count_ = 0;
+  running_ = false;
+}
+
+bool enqueueStartupSignal(SignalSequencer &sequencer, bool isPowerMode, bool isManualMode, uint8_t manualPowerPercent,
+                          SignalTimingPreset preset) {
+  if (isManualMode) {
+    return enqueueManualPowerSignal(sequencer, manualPowerPercent, true, preset);
+  }
+  return sequencer.enqueue(SIGNAL_STARTUP_PULSE, countOf(SIGNAL_STARTUP_PULSE), isPowerMode ? 2 : 1, preset);
+}
+
+bool enqueueManualPowerSignal(SignalSequencer &sequencer, uint8_t manualPowerPercent, bool includeIntroPulse,
+                              SignalTimingPreset preset) {
+  const uint8_t pulses = manualPowerStepPulses(manualPowerPercent);
+  const unsigned needed = (includeIntroPulse ? countOf(SIGNAL_MANUAL_INTRO) : 0U) + pulses * countOf(SIGNAL_MANUAL_STEP);
+  if (needed > static_cast<unsigned>(SignalSequencer::CAPACITY - sequencer.queuedSteps())) {
+    return false;
+  }
+  if (includeIntroPulse) {
+    sequencer.enqueue(SIGNAL_MANUAL_INTRO, countOf(SIGNAL_MANUAL_INTRO), 1, preset);
+  }
+  return sequencer.enqueue(SIGNAL_MANUAL_STEP, countOf(SIGNAL_MANUAL_STEP), pulses, preset);
+}
+
+bool enqueueTestPulse(SignalSequencer &sequencer, SignalTimingPreset preset) {
+  return sequencer.enqueue(SIGNAL_TEST_PULSE, countOf(SIGNAL_TEST_PULSE), 1, preset);
+}
+
+}  // namespace HeatControl
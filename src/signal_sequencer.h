@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+
+namespace HeatControl {
+
+enum class SignalTimingPreset : uint8_t {
+  Short = 0,
+  Middle = 1,
+  Fast = 2,
+};
+
+inline SignalTimingPreset clampSignalTimingPreset(uint8_t value) {
+  return (value <= static_cast<uint8_t>(SignalTimingPreset::Fast)) ? static_cast<SignalTimingPreset>(value)
+                                                                   : SignalTimingPreset::Middle;
+}
+
+inline unsigned long scaleSignalMs(unsigned long baseMs, SignalTimingPreset preset) {
+  switch (preset) {
+    case SignalTimingPreset::Short:
+      return (baseMs * 3UL) / 4UL;
+    case SignalTimingPreset::Fast:
+      return baseMs / 2UL;
+    case SignalTimingPreset::Middle:
+    default:
+      return baseMs;
+  }
+}
+
+// Signal patterns as alternating on/off durations (ms at the Middle preset), starting with "on".
+constexpr uint16_t SIGNAL_STARTUP_PULSE[] = {300, 200};
+constexpr uint16_t SIGNAL_MANUAL_INTRO[] = {500, 220};
+constexpr uint16_t SIGNAL_MANUAL_STEP[] = {130, 130};
+constexpr uint16_t SIGNAL_TEST_PULSE[] = {120};
+
+// Number of step pulses for a manual power level: 1/2/3/4 for 25/50/75/100 %.
+uint8_t manualPowerStepPulses(uint8_t manualPowerPercent);
+
+// Plays queued on/off patterns against caller-supplied timestamps instead of delay(). Requests are
+// appended and return at once; update() from the main loop reports the output level. Each step ends
+// exactly where the previous one was due to end, so a late update() never stretches the pattern.
+// Not thread-safe; the firmware guards it with a critical section.
+class SignalSequencer {
+ public:
+  static constexpr uint8_t CAPACITY = 32;
+
+  // Appends `repeat` copies of `durationsMs` scaled for `preset`. All or nothing: false when the
+  // queue cannot take the whole request.
+  bool enqueue(const uint16_t *durationsMs, uint8_t count, uint8_t repeat, SignalTimingPreset preset);
+  // Advances to `nowMs` and returns the output level. A request made while idle starts here.
+  bool update(unsigned long nowMs);
+  // True while steps are queued or playing.
+  bool active() const { return count_ > 0U; }
+  uint8_t queuedSteps() const { return count_; }
+  void clear();
+
+ private:
+  struct Step {
+    uint16_t durationMs;
+    bool on;
+  };
+
+  Step steps_[CAPACITY];
+  uint8_t head_ = 0;
+  uint8_t count_ = 0;
+  bool running_ = false;
+  unsigned long stepStartMs_ = 0;
+};
+
+// The firmware's feedback patterns. Each returns false (and queues nothing) when the queue is full.
+bool enqueueStartupSignal(SignalSequencer &sequencer, bool isPowerMode, bool isManualMode, uint8_t manualPowerPercent,
+                          SignalTimingPreset preset);
+bool enqueueManualPowerSignal(SignalSequencer &sequencer, uint8_t manualPowerPercent, bool includeIntroPulse,
+                              SignalTimingPreset preset);
+bool enqueueTestPulse(SignalSequencer &sequencer, SignalTimingPreset preset);
+
+}  // namespace HeatControl
@@ -0,0 +1,132 @@
+#include "slow_pwm.h"
+
+#include "logic_helpers.h"
+
+namespace HeatControl {
+namespace logic {
+
+SlowPwmOutput::SlowPwmOutput(int pin1, int pin2, uint32_t periodMs, uint16_t steps)
+    : pins_{pin1, pin2}, periodMs_(1), steps_(1) {
+  configure(periodMs, steps);
+}
+
+void SlowPwmOutput::configure(uint32_t periodMs, uint16_t steps) {
+  periodMs_ = periodMs == 0U ? 1U : periodMs;
+  steps_ = steps == 0U ? 1U : steps;
+  step_ = 0;
+}
+
+uint32_t SlowPwmOutput::tickIntervalUs() const {
+  const uint64_t intervalUs = (static_cast<uint64_t>(periodMs_) * 1000ULL) / steps_;
+  return intervalUs == 0U ? 1U : static_cast<uint32_t>(intervalUs);
+}
+
+void SlowPwmOutput::setDutyPermille(uint8_t channel, uint16_t dutyPermille) {
+  if (channel >= SLOW_PWM_CHANNELS) {
+    return;
+  }
+  requestedDuty_[channel] = dutyPermille > SLOW_PWM_DUTY_MAX ? SLOW_PWM_DUTY_MAX : dutyPermille;
+}
+
+uint16_t SlowPwmOutput::dutyPermille(uint8_t channel) const {
+  return channel < SLOW_PWM_CHANNELS ? requestedDuty_[channel] : 0U;
+}
+
+void SlowPwmOutput::setInhibited(uint8_t channel, bool inhibited) {
+  if (channel < SLOW_PWM_CHANNELS) {
+    inhibited_[channel] = inhibited;
+  }
+}
+
+bool SlowPwmOutput::inhibited(uint8_t channel) const {
+  return channel < SLOW_PWM_CHANNELS && inhibited_[channel];
+}
+
+bool SlowPwmOutput::outputOn(uint8_t channel) const {
+  return channel < SLOW_PWM_CHANNELS && outputOn_[channel];
+}
+
+void SlowPwmOutput::tick(IGpio &gpio) {
+  if (step_ == 0U) {
+    for (uint8_t ch = 0; ch < SLOW_PWM_CHANNELS; ++ch) {
+      // Round to the nearest step so the delivered duty error stays below half a step.
+      const uint32_t scaled = static_cast<uint32_t>(requestedDuty_[ch]) * steps_ + (SLOW_PWM_DUTY_MAX / 2U);
+      onSteps_[ch] = static_cast<uint16_t>(scaled / SLOW_PWM_DUTY_MAX);
+    }
+  }
+
+  for (uint8_t ch = 0; ch < SLOW_PWM_CHANNELS; ++ch) {
+    const bool on = !inhibited_[ch] && step_ < onSteps_[ch];
+    if (!outputKnown_ || on != outputOn_[ch]) {
+      gpio.writePin(pins_[ch], on ? PIN_HIGH : PIN_LOW);
+      outputOn_[ch] = on;
+    }
+  }
+  outputKnown_ = true;
+
+  ++step_;
+  if (step_ >= steps_) {
+    step_ = 0;
+  }
+}
+
+uint16_t manualDutyPermille(uint8_t manualPowerPercent) {
+  if (manualPowerPercent >= 100) {
+    return SLOW_PWM_DUTY_MAX;
+  }
+  if (manualPowerPercent < 25) {
+    return 0;
+  }
+  return static_cast<uint16_t>(manualPowerPercent * 10U);
+}
+
+float manualStepWatts(uint8_t manualPowerPercent, uint8_t cellCount, uint8_t chemistry, float elementOhm) {
+  if (manualPowerPercent < 25 || !(elementOhm > 0.0F)) {
+    return 0.0F;
+  }
+  const float nominalVolts = static_cast<float>(cellCount) * logic_helpers::nominalCellMilliVolts(chemistry) / 1000.0F;
+  const float percent = manualPowerPercent >= 100 ? 100.0F : static_cast<float>(manualPowerPercent);
+  return nominalVolts * nominalVolts / elementOhm * percent / 100.0F;
+}
+
+uint16_t constantPowerDutyPermille(float watts, float packVolts, float elementOhm) {
+  if (!(watts > 0.0F) || !(packVolts > 0.0F) || !(elementOhm > 0.0F)) {
+    return 0;
+  }
+  const float duty = watts * elementOhm / (packVolts * packVolts) * static_cast<float>(SLOW_PWM_DUTY_MAX) + 0.5F;
+  return duty >= static_cast<float>(SLOW_PWM_DUTY_MAX) ? SLOW_PWM_DUTY_MAX : static_cast<uint16_t>(duty);
+}
+
+uint16_t manualModeDutyPermille(ManualPowerMode mode, uint8_t manualPowerPercent, float packVolts, uint8_t cellCount,
+                                uint8_t chemistry, float elementOhm) {
+  if (mode != ManualPowerMode::ConstantPower || cellCount == 0U || !(packVolts >= 0.5F * cellCount)) {
+    return manualDutyPermille(manualPowerPercent);
+  }
+  return constantPowerDutyPermille(manualStepWatts(manualPowerPercent, cellCount, chemistry, elementOhm), packVolts,
+                                   elementOhm);
+}
+
+void computeHeaterDuties(bool powerMode, bool manualMode, ManualPowerMode manualPowerMode, uint8_t manualPowerPercent1,
+                         uint8_t manualPowerPercent2, bool manualHeater1Enabled, bool manualHeater2Enabled,
+                         const HeaterSupply &supply1, const HeaterSupply &supply2, float elementOhm,
+                         bool swapAssignment, float targetTemp1, float targetTemp2, float currentTemp1,
+                         float currentTemp2, ControlMode controlMode, PidController &pid1, PidController &pid2,
+                         float dtS, uint16_t &duty1, uint16_t &duty2) {
+  if (manualMode) {
+    duty1 = manualHeater1Enabled ? manualModeDutyPermille(manualPowerMode, manualPowerPercent1, supply1.packVolts,
+                                                          supply1.cellCount, supply1.chemistry, elementOhm)
+                                 : 0U;
+    duty2 = manualHeater2Enabled ? manualModeDutyPermille(manualPowerMode, manualPowerPercent2, supply2.packVolts,
+                                                          supply2.cellCount, supply2.chemistry, elementOhm)
+                                 : 0U;
+    return;
+  }
+
+  const float controlTemp1 = swapAssignment ? currentTemp2 : currentTemp1;
+  const float controlTemp2 = swapAssignment ? currentTemp1 : currentTemp2;
+  duty1 = temperatureDutyPermille(controlMode, pid1, powerMode, controlTemp1, targetTemp1, dtS);
+  duty2 = temperatureDutyPermille(controlMode, pid2, powerMode, controlTemp2, targetTemp2, dtS);
+}
+
+}  // namespace logic
+}  // namespace HeatControl
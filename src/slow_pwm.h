@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+
+#include "control_logic.h"
+
+namespace HeatControl {
+namespace logic {
+
+constexpr uint8_t SLOW_PWM_CHANNELS = 2;
+constexpr uint16_t SLOW_PWM_DUTY_MAX = HEATER_DUTY_MAX;
+
+// Time-proportioning output for SSRs that are too slow for LEDC PWM. tick() must be called once per
+// step from a periodic source (period / steps); each channel switches exactly at its duty edges.
+// A new duty is latched at the start of the next period so every period delivers one complete duty.
+class SlowPwmOutput {
+ public:
+  SlowPwmOutput(int pin1, int pin2, uint32_t periodMs, uint16_t steps);
+
+  // Restarts the period; callers must re-arm their tick source with tickIntervalUs().
+  void configure(uint32_t periodMs, uint16_t steps);
+  uint32_t periodMs() const { return periodMs_; }
+  uint16_t steps() const { return steps_; }
+  uint32_t tickIntervalUs() const;
+
+  void setDutyPermille(uint8_t channel, uint16_t dutyPermille);
+  uint16_t dutyPermille(uint8_t channel) const;
+  // An inhibited channel is driven LOW on the next tick and stays off regardless of duty.
+  void setInhibited(uint8_t channel, bool inhibited);
+  bool inhibited(uint8_t channel) const;
+  bool outputOn(uint8_t channel) const;
+
+  void tick(IGpio &gpio);
+
+ private:
+  int pins_[SLOW_PWM_CHANNELS];
+  uint32_t periodMs_;
+  uint16_t steps_;
+  uint16_t step_ = 0;
+  // Written from the control loop, read from the tick context; 16-bit stores are atomic on the target.
+  volatile uint16_t requestedDuty_[SLOW_PWM_CHANNELS] = {0, 0};
+  volatile bool inhibited_[SLOW_PWM_CHANNELS] = {false, false};
+  uint16_t onSteps_[SLOW_PWM_CHANNELS] = {0, 0};
+  bool outputOn_[SLOW_PWM_CHANNELS] = {false, false};
+  bool outputKnown_ = false;
+};
+
+// Maps the manual power steps onto a slow-PWM duty (below 25 % means off, as before).
+uint16_t manualDutyPermille(uint8_t manualPowerPercent);
+
+// Constant-power manual steps: a step is that share of the element's rated power, V_nominal^2 / R with
+// V_nominal = cells * nominalCellMilliVolts(chemistry). 0 W below 25 %, like manualDutyPermille().
+float manualStepWatts(uint8_t manualPowerPercent, uint8_t cellCount, uint8_t chemistry, float elementOhm);
+// Duty that delivers `watts` into `elementOhm` at `packVolts`, rounded and capped at full on.
+uint16_t constantPowerDutyPermille(float watts, float packVolts, float elementOhm);
+// Manual duty for either ManualPowerMode. Without a plausible pack voltage (battery absent or not
+// measured yet, below 0.5 V per cell) constant power falls back to the plain duty step.
+uint16_t manualModeDutyPermille(ManualPowerMode mode, uint8_t manualPowerPercent, float packVolts, uint8_t cellCount,
+                                uint8_t chemistry, float elementOhm);
+
+// The pack feeding one heater, as measured by loop(); constant-power manual steps scale with it.
+struct HeaterSupply {
+  float packVolts;
+  uint8_t cellCount;
+  uint8_t chemistry;
+};
+
+// Duty for both heater pins in every mode: manual steps (plain duty or constant power, see
+// manualModeDutyPermille()), power mode (full on) or the temperature controller selected by controlMode.
+// Sensor errors keep the temperature-controlled heater off. dtS is passed to the PID controllers (0 when
+// no new reading arrived since the last call).
+void computeHeaterDuties(bool powerMode, bool manualMode, ManualPowerMode manualPowerMode, uint8_t manualPowerPercent1,
+                         uint8_t manualPowerPercent2, bool manualHeater1Enabled, bool manualHeater2Enabled,
+                         const HeaterSupply &supply1, const HeaterSupply &supply2, float elementOhm,
+                         bool swapAssignment, float targetTemp1, float targetTemp2, float currentTemp1,
+                         float currentTemp2, ControlMode controlMode, PidController &pid1, PidController &pid2,
+                         float dtS, uint16_t &duty1, uint16_t &duty2);
+
+}  // namespace logic
+}  // namespace HeatControl
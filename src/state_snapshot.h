@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+namespace HeatControl {
+namespace logic {
+
+// Single-writer, multi-reader snapshot of a trivially copyable struct (double-buffered seqlock).
+// publish() fills the copy readers are not directed to, so a reader never waits for a writer in
+// progress; it only retries when a publish overlapped its copy. The version counts publishes.
+template <typename T>
+class SnapshotBuffer {
+  static_assert(std::is_trivially_copyable<T>::value, "SnapshotBuffer needs a trivially copyable type");
+
+ public:
+  SnapshotBuffer() : sequence_(0) {
+    slots_[0] = T();
+    slots_[1] = T();
+  }
+
+  explicit SnapshotBuffer(const T &initial) : sequence_(0) {
+    slots_[0] = initial;
+    slots_[1] = initial;
+  }
+
+  // Must not be called from more than one task at a time.
+  void publish(const T &value) {
+    const uint32_t seq = sequence_.load(std::memory_order_relaxed);
+    // Odd sequence: readers switch to slot 1 while slot 0 is rewritten.
+    sequence_.store(seq + 1U, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slots_[0] = value;
+    std::atomic_thread_fence(std::memory_order_release);
+    // Even sequence: readers are back on slot 0, slot 1 catches up.
+    sequence_.store(seq + 2U, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slots_[1] = value;
+  }
+
+  // Copies the latest complete snapshot into `out` and returns its version.
+  uint32_t read(T &out) const {
+    for (;;) {
+      const uint32_t seq = sequence_.load(std::memory_order_acquire);
+      out = slots_[seq & 1U];
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == seq) {
+        return seq >> 1;
+      }
+    }
+  }
+
+  T read() const {
+    T out;
+    read(out);
+    return out;
+  }
+
+  uint32_t version() const { return sequence_.load(std::memory_order_acquire) >> 1; }
+
+ private:
+  std::atomic<uint32_t> sequence_;
+  T slots_[2];
+};
+
+}  // namespace logic
+}  // namespace HeatControl
@@ -1,90 +1,199 @@
 #include "status_builder.h"
 
-#include <cmath>
-#include <cstdio>
-
-#include "logic_helpers.h"
+#include "json_writer.h"
 
 namespace HeatControl {
 namespace {
 
-std::string formatBool(bool value) {
-  return value ? "1" : "0";
-}
+// Forwards every field to the JsonWriter. With a digest attached, a field whose rendered text
+// hashes the same as last time is rolled back again, leaving only the changed fields.
+class StatusFieldWriter {
+ public:
+  StatusFieldWriter(JsonWriter &writer, bool includeLive, const StatusFieldDigest *previous, uint32_t *hashes)
+      : writer_(writer), includeLive_(includeLive), previous_(previous), hashes_(hashes) {}
+
+  bool includeLive() const { return includeLive_; }
 
-std::string formatFloat(float value, int decimals) {
-  if (std::isnan(value)) {
-    return "null";
+  void field(const char *key, const char *value) {
+    const JsonWriter::Mark start = writer_.mark();
+    writer_.field(key, value);
+    finish(start);
+  }
+  void fieldBool(const char *key, bool value) {
+    const JsonWriter::Mark start = writer_.mark();
+    writer_.fieldBool(key, value);
+    finish(start);
+  }
+  void fieldUint(const char *key, uint32_t value) {
+    const JsonWriter::Mark start = writer_.mark();
+    writer_.fieldUint(key, value);
+    finish(start);
+  }
+  void fieldFixed(const char *key, float value, uint8_t decimals) {
+    const JsonWriter::Mark start = writer_.mark();
+    writer_.fieldFixed(key, value, decimals);
+    finish(start);
+  }
+  void fieldOptionalFixed(const char *key, bool valid, float value, uint8_t decimals) {
+    const JsonWriter::Mark start = writer_.mark();
+    if (valid) {
+      writer_.fieldFixed(key, value, decimals);
+    } else {
+      writer_.fieldNull(key);
+    }
+    finish(start);
   }
-  char buffer[32];
-  const float scale = std::pow(10.0F, static_cast<float>(decimals));
-  const float rounded = std::round(value * scale) / scale;
-  snprintf(buffer, sizeof(buffer), "%.*f", decimals, static_cast<double>(rounded));
-  return std::string(buffer);
-}
 
-std::string formatOptionalFloat(bool valid, float value, int decimals) {
-  if (!valid) {
-    return "null";
+  uint8_t changedCount() const { return changed_; }
+
+ private:
+  void finish(const JsonWriter::Mark &start) {
+    const uint8_t index = index_++;
+    if (hashes_ == nullptr || index >= STATUS_FIELD_COUNT) {
+      ++changed_;
+      return;
+    }
+    // FNV-1a over the rendered "key":value, without the separating comma.
+    uint32_t hash = 2166136261UL;
+    const char *text = writer_.c_str();
+    for (size_t i = start.length + (start.needComma ? 1U : 0U); i < writer_.size(); ++i) {
+      hash = (hash ^ static_cast<uint8_t>(text[i])) * 16777619UL;
+    }
+    hashes_[index] = hash;
+    if (previous_ != nullptr && previous_->primed && previous_->hashes[index] == hash) {
+      writer_.rollback(start);
+      return;
+    }
+    ++changed_;
   }
-  return formatFloat(value, decimals);
+
+  JsonWriter &writer_;
+  bool includeLive_;
+  const StatusFieldDigest *previous_;
+  uint32_t *hashes_;
+  uint8_t index_ = 0;
+  uint8_t changed_ = 0;
+};
+
+void writeStatusFields(const StatusMetrics &m, StatusFieldWriter &w) {
+  w.field("mode", m.modeText);
+  w.field("logLevel", m.logLevelText);
+  w.fieldBool("manualMode", m.manualMode);
+  w.fieldUint("manualPercent1", m.manualPercent1);
+  w.fieldUint("manualPercent2", m.manualPercent2);
+  w.fieldBool("manualH1Enabled", m.manualHeater1Enabled);
+  w.fieldBool("manualH2Enabled", m.manualHeater2Enabled);
+  w.field("bootPin", m.bootPinText);
+  w.fieldUint("adc1Mv", m.adc1MilliVolts);
+  w.fieldUint("adc2Mv", m.adc2MilliVolts);
+  w.fieldUint("ntcMosfet1Mv", m.ntcMosfet1MilliVolts);
+  w.fieldUint("ntcMosfet2Mv", m.ntcMosfet2MilliVolts);
+  w.fieldOptionalFixed("ntcMosfet1C", m.ntcMosfet1Valid, m.ntcMosfet1TempC, 2);
+  w.fieldOptionalFixed("ntcMosfet2C", m.ntcMosfet2Valid, m.ntcMosfet2TempC, 2);
+  w.fieldBool("mosfet1OvertempActive", m.mosfet1OvertempActive);
+  w.fieldBool("mosfet2OvertempActive", m.mosfet2OvertempActive);
+  w.fieldBool("mosfet1OvertempLatched", m.mosfet1OvertempLatched);
+  w.fieldBool("mosfet2OvertempLatched", m.mosfet2OvertempLatched);
+  w.fieldOptionalFixed("mosfet1OvertempTripC", m.mosfet1TripValid, m.mosfet1TripTempC, 2);
+  w.fieldOptionalFixed("mosfet2OvertempTripC", m.mosfet2TripValid, m.mosfet2TripTempC, 2);
+  w.fieldFixed("mosfetOvertempLimitC", m.mosfetOvertempLimitC, 1);
+  w.fieldUint("batt1Cells", m.battery1CellCount);
+  w.fieldUint("batt1Chem", m.battery1Chemistry);
+  w.fieldFixed("batt1V", m.battery1PackVoltage, 2);
+  w.fieldFixed("batt1CellV", m.battery1CellVoltage, 2);
+  w.fieldUint("batt1Soc", m.battery1SocPercent);
+  w.fieldOptionalFixed("batt1SourceMohm", m.battery1SourceValid, m.battery1SourceMilliOhm, 0);
+  w.fieldBool("batt1Weak", m.battery1Weak);
+  w.fieldUint("batt2Cells", m.battery2CellCount);
+  w.fieldUint("batt2Chem", m.battery2Chemistry);
+  w.fieldFixed("batt2V", m.battery2PackVoltage, 2);
+  w.fieldFixed("batt2CellV", m.battery2CellVoltage, 2);
+  w.fieldUint("batt2Soc", m.battery2SocPercent);
+  w.fieldOptionalFixed("batt2SourceMohm", m.battery2SourceValid, m.battery2SourceMilliOhm, 0);
+  w.fieldBool("batt2Weak", m.battery2Weak);
+  w.fieldUint("manualToggleMaxOffMs", m.manualToggleMaxOffMs);
+  w.fieldUint("signalTimingPreset", m.signalTimingPreset);
+  w.fieldFixed("current1", m.displayTemp1, 2);
+  w.fieldFixed("current2", m.displayTemp2, 2);
+  w.fieldFixed("target1", m.targetTemp1, 1);
+  w.fieldFixed("target2", m.targetTemp2, 1);
+  w.fieldBool("swap", m.swapAssignment);
+  w.fieldUint("controlMode", m.controlMode);
+  w.fieldFixed("pidKp", m.pidKp, 4);
+  w.fieldFixed("pidKi", m.pidKi, 5);
+  w.fieldFixed("pidKd", m.pidKd, 3);
+  w.fieldUint("manualPowerMode", m.manualPowerMode);
+  w.fieldFixed("heaterOhm", m.heaterElementOhm, 2);
+  w.fieldFixed("manualW1", m.manualWatts1, 1);
+  w.fieldFixed("manualW2", m.manualWatts2, 1);
+  w.fieldUint("duty1", m.heater1DutyPermille);
+  w.fieldUint("duty2", m.heater2DutyPermille);
+  w.fieldFixed("energy1Wh", m.heater1EnergyWh, 3);
+  w.fieldFixed("energy2Wh", m.heater2EnergyWh, 3);
+  w.fieldFixed("power1W", m.heater1MeanWatts, 1);
+  w.fieldFixed("power2W", m.heater2MeanWatts, 1);
+  w.fieldOptionalFixed("runtimeLeft1Min", m.battery1RuntimeLeftValid, m.battery1RuntimeLeftMinutes, 0);
+  w.fieldOptionalFixed("runtimeLeft2Min", m.battery2RuntimeLeftValid, m.battery2RuntimeLeftMinutes, 0);
+  w.fieldUint("ctlPeriodUs", m.controlPeriodUs);
+  w.field("ssid", m.ssid);
+  w.field("apSsid", m.apSsid);
+  w.field("staIp", m.staIp);
+  w.fieldUint("apTimeoutMin", m.apAutoOffMinutes);
+  w.fieldBool("staConnected", m.staConnected);
+  w.fieldBool("apEnabled", m.apEnabled);
+  w.fieldBool("wifiRadiosDisabled", m.wifiRadiosDisabled);
+  w.fieldBool("h1", m.heater1On);
+  w.fieldBool("h2", m.heater2On);
+  w.field("totalRuntime", m.totalRuntime);
+  // Live fields last, so the digest indices of the others are the same with or without them.
+  if (!w.includeLive()) {
+    return;
+  }
+  w.fieldUint("ctlTicks", m.controlTicks);
+  w.fieldUint("ctlJitterMeanUs", m.controlJitterMeanUs);
+  w.fieldUint("ctlJitterMaxUs", m.controlJitterMaxUs);
+  w.fieldUint("ctlOverruns", m.controlOverruns);
+  w.fieldUint("ctlBusyMaxUs", m.controlBusyMaxUs);
+  w.field("currentRuntime", m.currentRuntime);
 }
 
 }  // namespace
 
-std::string buildStatusJson(const StatusMetrics &m) {
-  std::string json = "{";
-  json += "\"mode\":\"" + logic_helpers::jsonEscape(m.modeText) + "\"";
-  json += ",\"logLevel\":\"" + logic_helpers::jsonEscape(m.logLevelText) + "\"";
-  json += ",\"manualMode\":" + formatBool(m.manualMode);
-  json += ",\"manualPercent1\":" + std::to_string(m.manualPercent1);
-  json += ",\"manualPercent2\":" + std::to_string(m.manualPercent2);
-  json += ",\"manualH1Enabled\":" + formatBool(m.manualHeater1Enabled);
-  json += ",\"manualH2Enabled\":" + formatBool(m.manualHeater2Enabled);
-  json += ",\"bootPin\":\"" + logic_helpers::jsonEscape(m.bootPinText) + "\"";
-  json += ",\"adc1Mv\":" + std::to_string(m.adc1MilliVolts);
-  json += ",\"adc2Mv\":" + std::to_string(m.adc2MilliVolts);
-  json += ",\"ntcMosfet1Mv\":" + std::to_string(m.ntcMosfet1MilliVolts);
-  json += ",\"ntcMosfet2Mv\":" + std::to_string(m.ntcMosfet2MilliVolts);
-  json += ",\"ntcMosfet1C\":" + formatOptionalFloat(m.ntcMosfet1Valid, m.ntcMosfet1TempC, 2);
-  json += ",\"ntcMosfet2C\":" + formatOptionalFloat(m.ntcMosfet2Valid, m.ntcMosfet2TempC, 2);
-  json += ",\"mosfet1OvertempActive\":" + formatBool(m.mosfet1OvertempActive);
-  json += ",\"mosfet2OvertempActive\":" + formatBool(m.mosfet2OvertempActive);
-  json += ",\"mosfet1OvertempLatched\":" + formatBool(m.mosfet1OvertempLatched);
-  json += ",\"mosfet2OvertempLatched\":" + formatBool(m.mosfet2OvertempLatched);
-  json += ",\"mosfet1OvertempTripC\":" + formatOptionalFloat(m.mosfet1TripValid, m.mosfet1TripTempC, 2);
-  json += ",\"mosfet2OvertempTripC\":" + formatOptionalFloat(m.mosfet2TripValid, m.mosfet2TripTempC, 2);
-  json += ",\"mosfetOvertempLimitC\":" + formatFloat(m.mosfetOvertempLimitC, 1);
-  json += ",\"batt1Cells\":" + std::to_string(m.battery1CellCount);
-  json += ",\"batt1Chem\":" + std::to_string(m.battery1Chemistry);
-  json += ",\"batt1V\":" + formatFloat(m.battery1PackVoltage, 2);
-  json += ",\"batt1CellV\":" + formatFloat(m.battery1CellVoltage, 2);
-  json += ",\"batt1Soc\":" + std::to_string(m.battery1SocPercent);
-  json += ",\"batt2Cells\":" + std::to_string(m.battery2CellCount);
-  json += ",\"batt2Chem\":" + std::to_string(m.battery2Chemistry);
-  json += ",\"batt2V\":" + formatFloat(m.battery2PackVoltage, 2);
-  json += ",\"batt2CellV\":" + formatFloat(m.battery2CellVoltage, 2);
-  json += ",\"batt2Soc\":" + std::to_string(m.battery2SocPercent);
-  json += ",\"manualToggleMaxOffMs\":" + std::to_string(m.manualToggleMaxOffMs);
-  json += ",\"signalTimingPreset\":" + std::to_string(m.signalTimingPreset);
-  json += ",\"current1\":" + formatFloat(m.displayTemp1, 2);
-  json += ",\"current2\":" + formatFloat(m.displayTemp2, 2);
-  json += ",\"target1\":" + formatFloat(m.targetTemp1, 1);
-  json += ",\"target2\":" + formatFloat(m.targetTemp2, 1);
-  json += ",\"swap\":" + formatBool(m.swapAssignment);
-  json += ",\"ssid\":\"" + logic_helpers::jsonEscape(m.ssid) + "\"";
-  json += ",\"apSsid\":\"" + logic_helpers::jsonEscape(m.apSsid) + "\"";
-  json += ",\"staIp\":\"" + logic_helpers::jsonEscape(m.staIp) + "\"";
-  json += ",\"apTimeoutMin\":" + std::to_string(m.apAutoOffMinutes);
-  json += ",\"staConnected\":" + formatBool(m.staConnected);
-  json += ",\"apEnabled\":" + formatBool(m.apEnabled);
-  json += ",\"wifiRadiosDisabled\":" + formatBool(m.wifiRadiosDisabled);
-  json += ",\"h1\":" + formatBool(m.heater1On);
-  json += ",\"h2\":" + formatBool(m.heater2On);
-  json += ",\"totalRuntime\":\"" + logic_helpers::jsonEscape(m.totalRuntime) + "\"";
-  json += ",\"currentRuntime\":\"" + logic_helpers::jsonEscape(m.currentRuntime) + "\"";
-  json += "}";
-  return json;
+size_t writeStatusJson(const StatusMetrics &metrics, char *out, size_t capacity) {
+  JsonWriter writer(out, capacity);
+  StatusFieldWriter fields(writer, false, nullptr, nullptr);
+  writer.beginObject();
+  writeStatusFields(metrics, fields);
+  writer.endObject();
+  return writer.overflowed() ? 0U : writer.size();
+}
+
+size_t writeStatusJsonDelta(const StatusMetrics &metrics, StatusFieldDigest &digest, char *out, size_t capacity,
+                            uint8_t *changedFields) {
+  uint32_t hashes[STATUS_FIELD_COUNT] = {};
+  JsonWriter writer(out, capacity);
+  StatusFieldWriter fields(writer, true, &digest, hashes);
+  writer.beginObject();
+  writeStatusFields(metrics, fields);
+  writer.endObject();
+  if (changedFields != nullptr) {
+    *changedFields = writer.overflowed() ? 0U : fields.changedCount();
+  }
+  if (writer.overflowed()) {
+    return 0U;
+  }
+  // Only a document that fit updates the digest, so a dropped delta is resent next time.
+  for (uint8_t i = 0; i < STATUS_FIELD_COUNT; ++i) {
+    digest.hashes[i] = hashes[i];
+  }
+  digest.primed = true;
+  return writer.size();
+}
+
+std::string buildStatusJson(const StatusMetrics &metrics) {
+  char buffer[STATUS_JSON_MAX_BYTES];
+  const size_t length = writeStatusJson(metrics, buffer, sizeof(buffer));
+  return std::string(buffer, length);
 }
 
 }  // namespace HeatControl
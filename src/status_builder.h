@@ -1,19 +1,25 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <string>
 
 namespace HeatControl {
 
+// Text fields are filled in place so building the metrics never allocates; 33 bytes hold a
+// 32-character SSID, the longest of them.
+constexpr size_t STATUS_TEXT_BYTES = 33;
+
 struct StatusMetrics {
-  std::string modeText;
-  std::string logLevelText;
+  char modeText[STATUS_TEXT_BYTES] = "";
+  const char *logLevelText = "";
   bool manualMode = false;
   uint8_t manualPercent1 = 0;
   uint8_t manualPercent2 = 0;
   bool manualHeater1Enabled = false;
   bool manualHeater2Enabled = false;
-  std::string bootPinText;
+  const char *bootPinText = "";
   uint16_t adc1MilliVolts = 0;
   uint16_t adc2MilliVolts = 0;
   uint16_t ntcMosfet1MilliVolts = 0;
@@ -36,11 +42,17 @@ struct StatusMetrics {
   float battery1PackVoltage = 0.0F;
   float battery1CellVoltage = 0.0F;
   uint8_t battery1SocPercent = 0;
+  bool battery1SourceValid = false;  // sag-based source resistance of the pack, wiring and MOSFET
+  float battery1SourceMilliOhm = 0.0F;
+  bool battery1Weak = false;
   uint8_t battery2CellCount = 0;
   uint8_t battery2Chemistry = 0;
   float battery2PackVoltage = 0.0F;
   float battery2CellVoltage = 0.0F;
   uint8_t battery2SocPercent = 0;
+  bool battery2SourceValid = false;
+  float battery2SourceMilliOhm = 0.0F;
+  bool battery2Weak = false;
   uint16_t manualToggleMaxOffMs = 0;
   uint8_t signalTimingPreset = 1;
   float displayTemp1 = 0.0F;
@@ -48,19 +60,70 @@ struct StatusMetrics {
   float targetTemp1 = 0.0F;
   float targetTemp2 = 0.0F;
   bool swapAssignment = false;
-  std::string ssid;
-  std::string apSsid;
-  std::string staIp;
+  uint8_t controlMode = 0;
+  float pidKp = 0.0F;
+  float pidKi = 0.0F;
+  float pidKd = 0.0F;
+  uint8_t manualPowerMode = 0;
+  float heaterElementOhm = 0.0F;
+  float manualWatts1 = 0.0F;  // rated watts of the current manual step (constant-power mode)
+  float manualWatts2 = 0.0F;
+  uint16_t heater1DutyPermille = 0;
+  uint16_t heater2DutyPermille = 0;
+  float heater1EnergyWh = 0.0F;  // metered since the last runtime reset
+  float heater2EnergyWh = 0.0F;
+  float heater1MeanWatts = 0.0F;
+  float heater2MeanWatts = 0.0F;
+  bool battery1RuntimeLeftValid = false;
+  float battery1RuntimeLeftMinutes = 0.0F;
+  bool battery2RuntimeLeftValid = false;
+  float battery2RuntimeLeftMinutes = 0.0F;
+  uint32_t controlPeriodUs = 0;
+  uint32_t controlTicks = 0;
+  uint32_t controlJitterMeanUs = 0;
+  uint32_t controlJitterMaxUs = 0;
+  uint32_t controlOverruns = 0;
+  uint32_t controlBusyMaxUs = 0;
+  char ssid[STATUS_TEXT_BYTES] = "";
+  char apSsid[STATUS_TEXT_BYTES] = "";
+  char staIp[STATUS_TEXT_BYTES] = "";
   uint16_t apAutoOffMinutes = 0;
   bool staConnected = false;
   bool apEnabled = false;
   bool wifiRadiosDisabled = false;
   bool heater1On = false;
   bool heater2On = false;
-  std::string totalRuntime;
-  std::string currentRuntime;
+  char totalRuntime[STATUS_TEXT_BYTES] = "";
+  char currentRuntime[STATUS_TEXT_BYTES] = "";
+};
+
+// Copies `text` into a StatusMetrics text field, truncating it to fit.
+inline void setStatusText(char (&field)[STATUS_TEXT_BYTES], const char *text) {
+  std::strncpy(field, text != nullptr ? text : "", STATUS_TEXT_BYTES - 1U);
+  field[STATUS_TEXT_BYTES - 1U] = '\0';
+}
+
+constexpr size_t STATUS_JSON_MAX_BYTES = 2048;
+constexpr uint8_t STATUS_FIELD_COUNT = 75;
+// Counters that change on nearly every render (control tick stats, session runtime). They are
+// pushed over /ws only, so the cached /status document and its ETag stay put while nothing changes.
+constexpr uint8_t STATUS_LIVE_FIELD_COUNT = 6;
+
+// What one push subscriber was last sent: a hash of every rendered status field.
+struct StatusFieldDigest {
+  uint32_t hashes[STATUS_FIELD_COUNT];
+  bool primed;
 };
 
+// Writes the /status document (every field but the live ones) into `out` without allocating; returns
+// its length, or 0 if it did not fit.
+size_t writeStatusJson(const StatusMetrics &metrics, char *out, size_t capacity);
+// Like writeStatusJson() plus the live fields, but only with the fields that changed since `digest`
+// was last updated (all of them for an unprimed digest), then records the new state in `digest`.
+// `changedFields` receives the number of fields written; 0 means the document is "{}" and need not
+// be sent.
+size_t writeStatusJsonDelta(const StatusMetrics &metrics, StatusFieldDigest &digest, char *out, size_t capacity,
+                            uint8_t *changedFields = nullptr);
 std::string buildStatusJson(const StatusMetrics &metrics);
 
 }  // namespace HeatControl
@@ -0,0 +1,108 @@
+#include "status_cache.h"
+
+#include <cstring>
+
+namespace HeatControl {
+
+StatusDocumentCache::Lease::Lease(const Lease &other) : cache_(other.cache_), slot_(other.slot_) {
+  if (cache_ != nullptr) {
+    cache_->slots_[slot_].leases.fetch_add(1);
+  }
+}
+
+StatusDocumentCache::Lease &StatusDocumentCache::Lease::operator=(const Lease &other) {
+  if (this != &other) {
+    if (other.cache_ != nullptr) {
+      other.cache_->slots_[other.slot_].leases.fetch_add(1);
+    }
+    release();
+    cache_ = other.cache_;
+    slot_ = other.slot_;
+  }
+  return *this;
+}
+
+StatusDocumentCache::Lease::~Lease() {
+  release();
+}
+
+void StatusDocumentCache::Lease::release() {
+  if (cache_ != nullptr) {
+    cache_->slots_[slot_].leases.fetch_sub(1);
+    cache_ = nullptr;
+  }
+}
+
+const char *StatusDocumentCache::Lease::data() const {
+  return cache_ != nullptr ? cache_->slots_[slot_].data : "";
+}
+
+size_t StatusDocumentCache::Lease::size() const {
+  return cache_ != nullptr ? cache_->slots_[slot_].length : 0U;
+}
+
+uint32_t StatusDocumentCache::Lease::version() const {
+  return cache_ != nullptr ? cache_->slots_[slot_].version : 0U;
+}
+
+StatusDocumentCache::StatusDocumentCache() : current_(-1), version_(0) {
+  for (uint8_t i = 0; i < STATUS_DOC_SLOTS; ++i) {
+    slots_[i].data[0] = '\0';
+    slots_[i].length = 0;
+    slots_[i].version = 0;
+    slots_[i].leases.store(0);
+  }
+}
+
+char *StatusDocumentCache::beginRender() {
+  const int8_t current = current_.load();
+  rendering_ = -1;
+  for (uint8_t i = 0; i < STATUS_DOC_SLOTS; ++i) {
+    if (static_cast<int8_t>(i) != current && slots_[i].leases.load() == 0U) {
+      rendering_ = static_cast<int8_t>(i);
+      return slots_[i].data;
+    }
+  }
+  return nullptr;
+}
+
+bool StatusDocumentCache::commitRender(size_t length) {
+  if (rendering_ < 0) {
+    return false;
+  }
+  Slot &slot = slots_[rendering_];
+  const int8_t rendered = rendering_;
+  rendering_ = -1;
+  if (length == 0U || length >= STATUS_DOC_CAPACITY) {
+    return false;
+  }
+  // Same bytes as the current document: keep it and its version, so the ETag still matches.
+  const int8_t current = current_.load();
+  if (current >= 0 && slots_[current].length == length && memcmp(slots_[current].data, slot.data, length) == 0) {
+    return true;
+  }
+  slot.data[length] = '\0';
+  slot.length = length;
+  slot.version = version_.load() + 1U;
+  current_.store(rendered);
+  version_.store(slot.version);
+  return true;
+}
+
+StatusDocumentCache::Lease StatusDocumentCache::acquire() const {
+  for (;;) {
+    const int8_t current = current_.load();
+    if (current < 0) {
+      return Lease();
+    }
+    // Take the lease first, then confirm the slot is still current; otherwise the writer may
+    // already have picked it for the next render.
+    slots_[current].leases.fetch_add(1);
+    if (current_.load() == current) {
+      return Lease(this, static_cast<uint8_t>(current));
+    }
+    slots_[current].leases.fetch_sub(1);
+  }
+}
+
+}  // namespace HeatControl
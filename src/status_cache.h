@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace HeatControl {
+
+constexpr size_t STATUS_DOC_CAPACITY = 2048;  // worst case today is ~1.3 KB
+// One slot being rendered, one current, one still streaming to a slow client.
+constexpr uint8_t STATUS_DOC_SLOTS = 3;
+
+// Pre-rendered /status documents in fixed buffers. One writer renders into a free slot and
+// publishes it; any number of readers lease the current slot and stream it without copying.
+// A leased slot is never reused for rendering until every lease on it is released.
+class StatusDocumentCache {
+ public:
+  class Lease {
+   public:
+    Lease() = default;
+    Lease(const Lease &other);
+    Lease &operator=(const Lease &other);
+    ~Lease();
+
+    bool valid() const { return cache_ != nullptr; }
+    const char *data() const;
+    size_t size() const;
+    // Increments with every published document whose bytes differ; used as the HTTP ETag.
+    uint32_t version() const;
+
+   private:
+    friend class StatusDocumentCache;
+    Lease(const StatusDocumentCache *cache, uint8_t slot) : cache_(cache), slot_(slot) {}
+    void release();
+
+    const StatusDocumentCache *cache_ = nullptr;
+    uint8_t slot_ = 0;
+  };
+
+  StatusDocumentCache();
+
+  // Writer side. Returns nullptr when every non-current slot is still leased.
+  char *beginRender();
+  // Publishes the slot returned by beginRender(); a length of 0 or >= capacity discards it. A
+  // document identical to the current one is dropped too, leaving the current one and its version.
+  bool commitRender(size_t length);
+  size_t capacity() const { return STATUS_DOC_CAPACITY; }
+
+  // Reader side. Invalid until the first document was published.
+  Lease acquire() const;
+  uint32_t version() const { return version_.load(); }
+
+ private:
+  struct Slot {
+    char data[STATUS_DOC_CAPACITY];
+    size_t length;
+    uint32_t version;
+    mutable std::atomic<uint16_t> leases;
+  };
+
+  Slot slots_[STATUS_DOC_SLOTS];
+  std::atomic<int8_t> current_;
+  std::atomic<uint32_t> version_;
+  int8_t rendering_ = -1;
+};
+
+}  // namespace HeatControl
@@ -1,9 +1,18 @@
 #include "storage.h"
 
 #include <EEPROM.h>
+#include <LittleFS.h>
 #include <cmath>
+#include <cstring>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
 #include "app_state.h"
+#include "control.h"
+#include "logic_helpers.h"
+#include "persist_scheduler.h"
+#include "record_store.h"
 #include "storage_logic.h"
 
 namespace HeatControl {
@@ -11,58 +20,461 @@ namespace HeatControl {
 namespace {
 constexpr char DEFAULT_WIFI_SSID[] = "HeatControl";
 constexpr char DEFAULT_WIFI_PASSWORD[] = "HeatControl";
+constexpr size_t CREDENTIAL_MAX_CHARS = 31;
+
+constexpr char SETTINGS_PARTITION_LABEL[] = "settings";
+constexpr size_t FLASH_SECTOR_BYTES = 4096;
+// Fallback for partition tables without the settings partition (devices only ever updated over the air).
+constexpr char SETTINGS_FILE_PATH[] = "/settings.log";
+constexpr size_t SETTINGS_FILE_SECTORS = 4;
+// Quiet time before handed-over changes are written, and the longest a change may wait.
+constexpr uint32_t PERSIST_DEBOUNCE_MS = 1500UL;
+constexpr uint32_t PERSIST_MAX_DELAY_MS = 10000UL;
+
+// Record keys are persisted: never renumber, only append.
+enum class SettingKey : uint8_t {
+  BootMode = 0,
+  Temp1 = 1,
+  Temp2 = 2,
+  Swap = 3,
+  StaSsid = 4,
+  StaPassword = 5,
+  ApSsid = 6,
+  ApPassword = 7,
+  ApAutoOffMinutes = 8,
+  LogLevel = 9,
+  SignalTimingPreset = 10,
+  ControlMode = 11,
+  PidKp = 12,
+  PidKi = 13,
+  PidKd = 14,
+  ManualPower1 = 15,
+  ManualPower2 = 16,
+  ManualToggleOffMs = 17,
+  SensorRom1 = 18,
+  SensorRom2 = 19,
+  Battery1Cells = 20,
+  Battery2Cells = 21,
+  Battery1Chem = 22,
+  Battery2Chem = 23,
+  RuntimeMinutes = 24,
+  LastBatteryMask = 25,
+  Mosfet1OvertempFlag = 26,
+  Mosfet2OvertempFlag = 27,
+  Mosfet1TripTemp = 28,
+  Mosfet2TripTemp = 29,
+  ManualPowerMode = 30,
+  HeaterElementOhm = 31,
+  Heater1EnergyMilliWh = 32,
+  Heater2EnergyMilliWh = 33,
+};
+
+// Fixed-size values of the old byte-addressed EEPROM layout, copied over once on first boot.
+struct LegacySetting {
+  SettingKey key;
+  int addr;
+  uint8_t length;
+};
+
+constexpr LegacySetting LEGACY_SETTINGS[] = {
+    {SettingKey::BootMode, EEPROM_BOOT_MODE_ADDR, 1},
+    {SettingKey::Temp1, EEPROM_TEMP1_ADDR, 4},
+    {SettingKey::Temp2, EEPROM_TEMP2_ADDR, 4},
+    {SettingKey::Swap, EEPROM_SWAP_ADDR, 1},
+    {SettingKey::ApAutoOffMinutes, EEPROM_AP_AUTO_OFF_MINUTES_ADDR, 2},
+    {SettingKey::LogLevel, EEPROM_LOG_LEVEL_ADDR, 1},
+    {SettingKey::SignalTimingPreset, EEPROM_SIGNAL_TIMING_PRESET_ADDR, 1},
+    {SettingKey::ControlMode, EEPROM_CONTROL_MODE_ADDR, 1},
+    {SettingKey::PidKp, EEPROM_PID_KP_ADDR, 4},
+    {SettingKey::PidKi, EEPROM_PID_KI_ADDR, 4},
+    {SettingKey::PidKd, EEPROM_PID_KD_ADDR, 4},
+    {SettingKey::ManualPower1, EEPROM_MANUAL_POWER1_ADDR, 1},
+    {SettingKey::ManualPower2, EEPROM_MANUAL_POWER2_ADDR, 1},
+    {SettingKey::ManualToggleOffMs, EEPROM_MANUAL_TOGGLE_MS_ADDR, 2},
+    {SettingKey::SensorRom1, EEPROM_SENSOR_ROM1_ADDR, 8},
+    {SettingKey::SensorRom2, EEPROM_SENSOR_ROM2_ADDR, 8},
+    {SettingKey::Battery1Cells, EEPROM_BATTERY1_CELLS_ADDR, 1},
+    {SettingKey::Battery2Cells, EEPROM_BATTERY2_CELLS_ADDR, 1},
+    {SettingKey::Battery1Chem, EEPROM_BATTERY1_CHEM_ADDR, 1},
+    {SettingKey::Battery2Chem, EEPROM_BATTERY2_CHEM_ADDR, 1},
+    {SettingKey::RuntimeMinutes, EEPROM_RUNTIME_ADDR, 4},
+    {SettingKey::LastBatteryMask, EEPROM_LAST_BATTERY_MASK_ADDR, 1},
+    {SettingKey::Mosfet1OvertempFlag, EEPROM_MOSFET1_OVERTEMP_FLAG_ADDR, 1},
+    {SettingKey::Mosfet2OvertempFlag, EEPROM_MOSFET2_OVERTEMP_FLAG_ADDR, 1},
+    {SettingKey::Mosfet1TripTemp, EEPROM_MOSFET1_OVERTEMP_TEMP_ADDR, 4},
+    {SettingKey::Mosfet2TripTemp, EEPROM_MOSFET2_OVERTEMP_TEMP_ADDR, 4},
+};
+
+class PartitionFlashRegion : public logic::IFlashRegion {
+ public:
+  bool open() {
+    partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, SETTINGS_PARTITION_LABEL);
+    return partition_ != nullptr;
+  }
+  size_t sectorBytes() const override { return FLASH_SECTOR_BYTES; }
+  size_t sectorCount() const override {
+    if (partition_ == nullptr) {
+      return 0;
+    }
+    const size_t sectors = partition_->size / FLASH_SECTOR_BYTES;
+    return sectors < logic::RECORD_MAX_SECTORS ? sectors : logic::RECORD_MAX_SECTORS;
+  }
+  bool read(size_t offset, void *out, size_t length) override {
+    return esp_partition_read(partition_, offset, out, length) == ESP_OK;
+  }
+  bool write(size_t offset, const void *data, size_t length) override {
+    return esp_partition_write(partition_, offset, data, length) == ESP_OK;
+  }
+  bool eraseSector(size_t sector) override {
+    return esp_partition_erase_range(partition_, sector * FLASH_SECTOR_BYTES, FLASH_SECTOR_BYTES) == ESP_OK;
+  }
+
+ private:
+  const esp_partition_t *partition_ = nullptr;
+};
+
+// Same log inside a preallocated LittleFS file; the file system does its own wear levelling below it.
+class FileFlashRegion : public logic::IFlashRegion {
+ public:
+  bool open() {
+    const size_t totalBytes = SETTINGS_FILE_SECTORS * FLASH_SECTOR_BYTES;
+    file_ = LittleFS.open(SETTINGS_FILE_PATH, "r+");
+    if (file_ && file_.size() == totalBytes) {
+      return true;
+    }
+    file_.close();
+    File created = LittleFS.open(SETTINGS_FILE_PATH, "w");
+    if (!created) {
+      return false;
+    }
+    uint8_t erased[256];
+    std::memset(erased, 0xFF, sizeof(erased));
+    for (size_t written = 0; written < totalBytes; written += sizeof(erased)) {
+      if (created.write(erased, sizeof(erased)) != sizeof(erased)) {
+        created.close();
+        return false;
+      }
+    }
+    created.close();
+    file_ = LittleFS.open(SETTINGS_FILE_PATH, "r+");
+    return static_cast<bool>(file_);
+  }
+  size_t sectorBytes() const override { return FLASH_SECTOR_BYTES; }
+  size_t sectorCount() const override { return SETTINGS_FILE_SECTORS; }
+  bool read(size_t offset, void *out, size_t length) override {
+    return file_.seek(offset) && file_.read(static_cast<uint8_t *>(out), length) == length;
+  }
+  bool write(size_t offset, const void *data, size_t length) override {
+    if (!file_.seek(offset) || file_.write(static_cast<const uint8_t *>(data), length) != length) {
+      return false;
+    }
+    file_.flush();
+    return true;
+  }
+  bool eraseSector(size_t sector) override {
+    uint8_t erased[256];
+    std::memset(erased, 0xFF, sizeof(erased));
+    if (!file_.seek(sector * FLASH_SECTOR_BYTES)) {
+      return false;
+    }
+    for (size_t done = 0; done < FLASH_SECTOR_BYTES; done += sizeof(erased)) {
+      if (file_.write(erased, sizeof(erased)) != sizeof(erased)) {
+        return false;
+      }
+    }
+    file_.flush();
+    return true;
+  }
+
+ private:
+  File file_;
+};
+
+uint32_t storageClockUs() {
+  return static_cast<uint32_t>(micros());
+}
+
+PartitionFlashRegion partitionRegion;
+FileFlashRegion fileRegion;
+logic::IFlashRegion *activeRegion = &partitionRegion;
+const char *activeRegionName = "none";
+// Recursive so a SettingsBatch can hold it across several save*() calls.
+SemaphoreHandle_t storeMutex = nullptr;
+uint8_t batchDepth = 0;
+logic::PersistScheduler persistScheduler(PERSIST_DEBOUNCE_MS, PERSIST_MAX_DELAY_MS);
+portMUX_TYPE persistMux = portMUX_INITIALIZER_UNLOCKED;
+uint8_t pendingBootMode = 0;
+
+logic::RecordStore &store() {
+  static logic::RecordStore instance(*activeRegion, &storageClockUs);
+  return instance;
+}
+
+class StoreLock {
+ public:
+  StoreLock() {
+    if (storeMutex != nullptr) {
+      xSemaphoreTakeRecursive(storeMutex, portMAX_DELAY);
+    }
+  }
+  ~StoreLock() {
+    if (storeMutex != nullptr) {
+      xSemaphoreGiveRecursive(storeMutex);
+    }
+  }
+  StoreLock(const StoreLock &) = delete;
+  StoreLock &operator=(const StoreLock &) = delete;
+};
+
+template <typename T>
+bool readSetting(SettingKey key, T &value) {
+  StoreLock lock;
+  return store().get(static_cast<uint8_t>(key), &value, sizeof(T));
+}
+
+template <typename T>
+void stageSetting(SettingKey key, const T &value) {
+  StoreLock lock;
+  store().set(static_cast<uint8_t>(key), &value, sizeof(T));
+}
+
+void stageString(SettingKey key, const String &value) {
+  StoreLock lock;
+  const size_t length = value.length() < CREDENTIAL_MAX_CHARS ? value.length() : CREDENTIAL_MAX_CHARS;
+  store().set(static_cast<uint8_t>(key), value.c_str(), length);
+}
+
+bool readString(SettingKey key, String &value) {
+  char text[CREDENTIAL_MAX_CHARS + 1] = {0};
+  size_t length = 0;
+  {
+    StoreLock lock;
+    length = store().getBytes(static_cast<uint8_t>(key), text, CREDENTIAL_MAX_CHARS);
+  }
+  if (length == 0U || length > CREDENTIAL_MAX_CHARS) {
+    return false;
+  }
+  value = String(text);
+  return true;
+}
+
+// Writes staged values unless a SettingsBatch is open; the outermost batch commits when it closes.
+void commitSettings() {
+  StoreLock lock;
+  if (batchDepth > 0U || !store().dirty()) {
+    return;
+  }
+  if (!store().commit()) {
+    logf(LogLevel::Error, "Settings commit failed | backend=%s | flash_errors=%lu", activeRegionName,
+         static_cast<unsigned long>(store().stats().flashErrors));
+    return;
+  }
+  logf(LogLevel::Debug, "Settings committed | commit_us=%lu | sector=%u | used=%u",
+       static_cast<unsigned long>(store().stats().lastCommitUs), store().stats().activeSector,
+       store().stats().usedBytes);
+}
+
+void migrateLegacyEeprom() {
+  EEPROM.begin(EEPROM_SIZE);
+  uint8_t migrated = 0;
+  for (const LegacySetting &legacy : LEGACY_SETTINGS) {
+    uint8_t bytes[8];
+    bool blank = true;
+    for (uint8_t i = 0; i < legacy.length; ++i) {
+      bytes[i] = EEPROM.read(legacy.addr + i);
+      blank = blank && bytes[i] == 0xFFU;
+    }
+    // Never-written cells keep loading their defaults.
+    if (!blank) {
+      store().set(static_cast<uint8_t>(legacy.key), bytes, legacy.length);
+      ++migrated;
+    }
+  }
+
+  if (EEPROM.read(EEPROM_INIT_ADDR) == 0xAA) {
+    const struct {
+      SettingKey key;
+      int addr;
+    } credentials[] = {{SettingKey::StaSsid, EEPROM_SSID_ADDR},
+                       {SettingKey::StaPassword, EEPROM_PASS_ADDR},
+                       {SettingKey::ApSsid, EEPROM_AP_SSID_ADDR},
+                       {SettingKey::ApPassword, EEPROM_AP_PASS_ADDR}};
+    for (const auto &credential : credentials) {
+      char text[CREDENTIAL_MAX_CHARS + 1] = {0};
+      for (size_t i = 0; i < CREDENTIAL_MAX_CHARS; ++i) {
+        text[i] = static_cast<char>(EEPROM.read(credential.addr + static_cast<int>(i)));
+      }
+      if (text[0] != '\0' && static_cast<uint8_t>(text[0]) != 0xFFU) {
+        store().set(static_cast<uint8_t>(credential.key), text, std::strlen(text));
+        ++migrated;
+      }
+    }
+  }
+  EEPROM.end();
+
+  if (!store().commit()) {
+    logf(LogLevel::Error, "Settings migration failed | backend=%s", activeRegionName);
+    return;
+  }
+  logf("Settings migrated from EEPROM | values=%u | commit_us=%lu", migrated,
+       static_cast<unsigned long>(store().stats().lastCommitUs));
+}
+
+}  // namespace
 
-void writeFloatToEeprom(int addr, float value) {
-  uint8_t *bytes = reinterpret_cast<uint8_t *>(&value);
-  for (size_t i = 0; i < sizeof(float); ++i) {
-    EEPROM.write(addr + static_cast<int>(i), bytes[i]);
+void beginSettingsStore() {
+  storeMutex = xSemaphoreCreateRecursiveMutex();
+  if (partitionRegion.open()) {
+    activeRegion = &partitionRegion;
+    activeRegionName = "partition";
+  } else if (fileSystemReady && fileRegion.open()) {
+    activeRegion = &fileRegion;
+    activeRegionName = "littlefs";
+  }
+
+  StoreLock lock;
+  if (!store().mount()) {
+    logf(LogLevel::Error, "Settings store unavailable | backend=%s | settings stay in RAM", activeRegionName);
+    return;
   }
+  const logic::RecordStoreStats &stats = store().stats();
+  logf("Settings store | backend=%s | sectors=%u | generation=%lu | keys=%u | erases=%lu..%lu | mount_us=%lu%s",
+       activeRegionName, stats.sectors, static_cast<unsigned long>(stats.generation), stats.keys,
+       static_cast<unsigned long>(stats.minEraseCount), static_cast<unsigned long>(stats.maxEraseCount),
+       static_cast<unsigned long>(stats.mountUs), stats.droppedBatches > 0U ? " | dropped torn batch" : "");
+  if (store().empty()) {
+    migrateLegacyEeprom();
+  }
+}
+
+size_t renderSettingsStoreJson(char *out, size_t capacity) {
+  portENTER_CRITICAL(&persistMux);
+  const logic::PersistStats persistStats = persistScheduler.stats();
+  const uint32_t persistPending = persistScheduler.pending();
+  portEXIT_CRITICAL(&persistMux);
+
+  StoreLock lock;
+  JsonWriter w(out, capacity);
+  w.beginObject();
+  w.field("backend", activeRegionName);
+  logic::writeRecordStoreStatsFields(w, store().stats());
+  logic::writePersistStatsFields(w, persistStats, persistPending);
+  w.endObject();
+  return w.overflowed() ? 0U : w.size();
+}
+
+void requestPersist(uint32_t fields) {
+  const uint32_t nowMs = millis();
+  portENTER_CRITICAL(&persistMux);
+  persistScheduler.mark(fields, nowMs);
+  portEXIT_CRITICAL(&persistMux);
 }
 
-float readFloatFromEeprom(int addr) {
-  float value = 0.0F;
-  uint8_t *bytes = reinterpret_cast<uint8_t *>(&value);
-  for (size_t i = 0; i < sizeof(float); ++i) {
-    bytes[i] = EEPROM.read(addr + static_cast<int>(i));
+namespace {
+
+void writePersistFields(uint32_t fields) {
+  if (fields == 0U) {
+    return;
   }
-  return value;
+  const uint32_t startUs = storageClockUs();
+  {
+    SettingsBatch batch;
+    if ((fields & PERSIST_TEMPERATURE_TARGETS) != 0U) saveTemperatureTargets();
+    if ((fields & PERSIST_SWAP_ASSIGNMENT) != 0U) saveSwapAssignment();
+    if ((fields & PERSIST_MANUAL_POWER) != 0U) saveManualPowerPercents();
+    if ((fields & PERSIST_MANUAL_TOGGLE) != 0U) saveManualToggleOffMs();
+    if ((fields & PERSIST_BATTERY_CELLS) != 0U) saveBatteryCellCounts();
+    if ((fields & PERSIST_BATTERY_CHEMISTRY) != 0U) saveBatteryChemistries();
+    if ((fields & PERSIST_AP_AUTO_OFF) != 0U) saveApAutoOffMinutes();
+    if ((fields & PERSIST_LOG_LEVEL) != 0U) saveLogLevel();
+    if ((fields & PERSIST_SIGNAL_TIMING) != 0U) saveSignalTimingPreset();
+    if ((fields & PERSIST_CONTROL_SETTINGS) != 0U) saveControlSettings();
+    if ((fields & PERSIST_WIFI_CREDENTIALS) != 0U) saveWiFiCredentials(activeSsid, activePassword);
+    if ((fields & PERSIST_AP_CREDENTIALS) != 0U) saveApCredentials(activeApSsid, activeApPassword);
+    if ((fields & PERSIST_BOOT_MODE) != 0U) stageSetting(SettingKey::BootMode, pendingBootMode);
+    if ((fields & PERSIST_RUNTIME) != 0U) writeSavedRuntime(savedRuntimeMinutes);
+    if ((fields & PERSIST_OVERTEMP_EVENTS) != 0U) saveMosfetOvertempState();
+    if ((fields & PERSIST_HEATER_ENERGY) != 0U) saveHeaterEnergy();
+  }
+  const uint32_t elapsedUs = storageClockUs() - startUs;
+  portENTER_CRITICAL(&persistMux);
+  persistScheduler.recordFlush(elapsedUs);
+  portEXIT_CRITICAL(&persistMux);
+  logf(LogLevel::Debug, "Settings persisted | fields=0x%04lx | flush_us=%lu", static_cast<unsigned long>(fields),
+       static_cast<unsigned long>(elapsedUs));
 }
 
 }  // namespace
 
+void servicePersistence(uint32_t nowMs) {
+  portENTER_CRITICAL(&persistMux);
+  const uint32_t fields = persistScheduler.take(nowMs);
+  portEXIT_CRITICAL(&persistMux);
+  writePersistFields(fields);
+}
+
+void flushPersistence() {
+  portENTER_CRITICAL(&persistMux);
+  const uint32_t fields = persistScheduler.takeAll();
+  portEXIT_CRITICAL(&persistMux);
+  writePersistFields(fields);
+}
+
+SettingsBatch::SettingsBatch() {
+  if (storeMutex != nullptr) {
+    xSemaphoreTakeRecursive(storeMutex, portMAX_DELAY);
+  }
+  ++batchDepth;
+}
+
+SettingsBatch::~SettingsBatch() {
+  --batchDepth;
+  commitSettings();
+  if (storeMutex != nullptr) {
+    xSemaphoreGiveRecursive(storeMutex);
+  }
+}
+
 void setNextBootMode(uint8_t mode) {
-  EEPROM.write(EEPROM_BOOT_MODE_ADDR, mode);
-  EEPROM.commit();
+  pendingBootMode = mode;
+  requestPersist(PERSIST_BOOT_MODE);
 }
 
 uint8_t getAndClearBootMode() {
-  const uint8_t mode = EEPROM.read(EEPROM_BOOT_MODE_ADDR);
-  EEPROM.write(EEPROM_BOOT_MODE_ADDR, 0);
-  EEPROM.commit();
+  uint8_t mode = 0;
+  readSetting(SettingKey::BootMode, mode);
+  if (mode != 0U) {
+    stageSetting(SettingKey::BootMode, static_cast<uint8_t>(0));
+    commitSettings();
+  }
   return mode;
 }
 
 void loadTemperatureTargets() {
-  const float t1 = readFloatFromEeprom(EEPROM_TEMP1_ADDR);
-  const float t2 = readFloatFromEeprom(EEPROM_TEMP2_ADDR);
+  float t1 = NAN;
+  float t2 = NAN;
+  readSetting(SettingKey::Temp1, t1);
+  readSetting(SettingKey::Temp2, t2);
 
   targetTemp1 = (isnan(t1) || t1 < 10.0F || t1 > 45.0F) ? DEFAULT_TARGET_TEMP : t1;
   targetTemp2 = (isnan(t2) || t2 < 10.0F || t2 > 45.0F) ? DEFAULT_TARGET_TEMP : t2;
 }
 
 void saveTemperatureTargets() {
-  writeFloatToEeprom(EEPROM_TEMP1_ADDR, targetTemp1);
-  writeFloatToEeprom(EEPROM_TEMP2_ADDR, targetTemp2);
-  EEPROM.commit();
+  stageSetting(SettingKey::Temp1, targetTemp1);
+  stageSetting(SettingKey::Temp2, targetTemp2);
+  commitSettings();
 }
 
 void loadSwapAssignment() {
-  swapAssignment = EEPROM.read(EEPROM_SWAP_ADDR) == 1;
+  uint8_t raw = 0;
+  readSetting(SettingKey::Swap, raw);
+  swapAssignment = raw == 1;
 }
 
 void saveSwapAssignment() {
-  EEPROM.write(EEPROM_SWAP_ADDR, swapAssignment ? 1 : 0);
-  EEPROM.commit();
+  stageSetting(SettingKey::Swap, static_cast<uint8_t>(swapAssignment ? 1 : 0));
+  commitSettings();
 }
 
 void saveWiFiCredentials(const String &ssid, const String &password) {
@@ -70,47 +482,36 @@ void saveWiFiCredentials(const String &ssid, const String &password) {
     return;
   }
 
-  EEPROM.write(EEPROM_INIT_ADDR, 0xAA);
-  for (int i = 0; i < 32; ++i) {
-    EEPROM.write(EEPROM_SSID_ADDR + i, 0);
-  }
-  for (int i = 0; i < 32; ++i) {
-    EEPROM.write(EEPROM_PASS_ADDR + i, 0);
+  {
+    StoreLock lock;
+    stageString(SettingKey::StaSsid, ssid);
+    stageString(SettingKey::StaPassword, password);
+    commitSettings();
   }
+  activeSsid = ssid;
+  activePassword = password;
+}
 
-  for (size_t i = 0; i < ssid.length() && i < 31; ++i) {
-    EEPROM.write(EEPROM_SSID_ADDR + static_cast<int>(i), ssid[i]);
-  }
-  for (size_t i = 0; i < password.length() && i < 31; ++i) {
-    EEPROM.write(EEPROM_PASS_ADDR + static_cast<int>(i), password[i]);
+bool assignWiFiCredentials(const String &ssid, const String &password) {
+  if (ssid.isEmpty()) {
+    return false;
   }
-
-  EEPROM.commit();
   activeSsid = ssid;
   activePassword = password;
+  return true;
 }
 
 void loadWiFiCredentials() {
-  if (EEPROM.read(EEPROM_INIT_ADDR) != 0xAA) {
+  String ssid;
+  if (!readString(SettingKey::StaSsid, ssid)) {
     saveWiFiCredentials(DEFAULT_WIFI_SSID, DEFAULT_WIFI_PASSWORD);
-    saveApCredentials(DEFAULT_WIFI_SSID, DEFAULT_WIFI_PASSWORD);
     return;
   }
 
-  char ssid[32] = {0};
-  char pass[32] = {0};
-  for (int i = 0; i < 31; ++i) {
-    ssid[i] = static_cast<char>(EEPROM.read(EEPROM_SSID_ADDR + i));
-    pass[i] = static_cast<char>(EEPROM.read(EEPROM_PASS_ADDR + i));
-  }
-
-  if (ssid[0] == '\0' || static_cast<uint8_t>(ssid[0]) == 0xFF) {
-    saveWiFiCredentials(DEFAULT_WIFI_SSID, DEFAULT_WIFI_PASSWORD);
-    return;
-  }
-
-  activeSsid = String(ssid);
-  activePassword = String(pass);
+  String pass;
+  readString(SettingKey::StaPassword, pass);
+  activeSsid = ssid;
+  activePassword = pass;
 }
 
 void saveApCredentials(const String &ssid, const String &password) {
@@ -118,57 +519,42 @@ void saveApCredentials(const String &ssid, const String &password) {
     return;
   }
 
-  EEPROM.write(EEPROM_INIT_ADDR, 0xAA);
-  for (int i = 0; i < 32; ++i) {
-    EEPROM.write(EEPROM_AP_SSID_ADDR + i, 0);
-  }
-  for (int i = 0; i < 32; ++i) {
-    EEPROM.write(EEPROM_AP_PASS_ADDR + i, 0);
+  {
+    StoreLock lock;
+    stageString(SettingKey::ApSsid, ssid);
+    stageString(SettingKey::ApPassword, password);
+    commitSettings();
   }
+  activeApSsid = ssid;
+  activeApPassword = password;
+}
 
-  for (size_t i = 0; i < ssid.length() && i < 31; ++i) {
-    EEPROM.write(EEPROM_AP_SSID_ADDR + static_cast<int>(i), ssid[i]);
-  }
-  for (size_t i = 0; i < password.length() && i < 31; ++i) {
-    EEPROM.write(EEPROM_AP_PASS_ADDR + static_cast<int>(i), password[i]);
+bool assignApCredentials(const String &ssid, const String &password) {
+  if (ssid.isEmpty()) {
+    return false;
   }
-
-  EEPROM.commit();
   activeApSsid = ssid;
   activeApPassword = password;
+  return true;
 }
 
 void loadApCredentials() {
-  if (EEPROM.read(EEPROM_INIT_ADDR) != 0xAA) {
-    saveApCredentials(DEFAULT_WIFI_SSID, DEFAULT_WIFI_PASSWORD);
-    return;
-  }
-
-  char ssid[32] = {0};
-  char pass[32] = {0};
-  for (int i = 0; i < 31; ++i) {
-    ssid[i] = static_cast<char>(EEPROM.read(EEPROM_AP_SSID_ADDR + i));
-    pass[i] = static_cast<char>(EEPROM.read(EEPROM_AP_PASS_ADDR + i));
-  }
-
-  if (ssid[0] == '\0' || static_cast<uint8_t>(ssid[0]) == 0xFF) {
+  String ssid;
+  if (!readString(SettingKey::ApSsid, ssid)) {
     saveApCredentials(DEFAULT_WIFI_SSID, DEFAULT_WIFI_PASSWORD);
     return;
   }
 
-  activeApSsid = String(ssid);
-  activeApPassword = String(pass);
+  String pass;
+  readString(SettingKey::ApPassword, pass);
+  activeApSsid = ssid;
+  activeApPassword = pass;
 }
 
 void loadApAutoOffMinutes() {
   uint16_t stored = 0U;
-  uint8_t *bytes = reinterpret_cast<uint8_t *>(&stored);
-  for (size_t i = 0; i < sizeof(uint16_t); ++i) {
-    bytes[i] = EEPROM.read(EEPROM_AP_AUTO_OFF_MINUTES_ADDR + static_cast<int>(i));
-  }
-
-  // 0xFFFF means "not initialized yet" -> use default 10 minutes.
-  if (stored == 0xFFFFU) {
+  // Never saved -> use default 10 minutes.
+  if (!readSetting(SettingKey::ApAutoOffMinutes, stored) || stored == 0xFFFFU) {
     apAutoOffMinutes = 10U;
   } else {
     apAutoOffMinutes = clampApAutoOffMinutes(stored);
@@ -176,21 +562,13 @@ void loadApAutoOffMinutes() {
 }
 
 void saveApAutoOffMinutes() {
-  const uint16_t value = clampApAutoOffMinutes(apAutoOffMinutes);
-  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
-  for (size_t i = 0; i < sizeof(uint16_t); ++i) {
-    EEPROM.write(EEPROM_AP_AUTO_OFF_MINUTES_ADDR + static_cast<int>(i), bytes[i]);
-  }
-  EEPROM.commit();
+  stageSetting(SettingKey::ApAutoOffMinutes, clampApAutoOffMinutes(apAutoOffMinutes));
+  commitSettings();
 }
 
 void loadLogLevel() {
-  const uint8_t raw = EEPROM.read(EEPROM_LOG_LEVEL_ADDR);
-  if (raw == 0xFFU) {
-    currentLogLevel = LogLevel::Info;
-    return;
-  }
-
+  uint8_t raw = 0xFFU;
+  readSetting(SettingKey::LogLevel, raw);
   if (raw <= static_cast<uint8_t>(LogLevel::Debug)) {
     currentLogLevel = static_cast<LogLevel>(raw);
     return;
@@ -200,14 +578,13 @@ void loadLogLevel() {
 }
 
 void saveLogLevel() {
-  const uint8_t value = static_cast<uint8_t>(currentLogLevel);
-  EEPROM.write(EEPROM_LOG_LEVEL_ADDR, value);
-  EEPROM.commit();
+  stageSetting(SettingKey::LogLevel, static_cast<uint8_t>(currentLogLevel));
+  commitSettings();
 }
 
 void loadSignalTimingPreset() {
-  const uint8_t raw = EEPROM.read(EEPROM_SIGNAL_TIMING_PRESET_ADDR);
-  if (raw == 0xFFU) {
+  uint8_t raw = 0xFFU;
+  if (!readSetting(SettingKey::SignalTimingPreset, raw) || raw == 0xFFU) {
     signalTimingPreset = SignalTimingPreset::Middle;
     return;
   }
@@ -216,14 +593,54 @@ void loadSignalTimingPreset() {
 }
 
 void saveSignalTimingPreset() {
-  const uint8_t value = static_cast<uint8_t>(signalTimingPreset);
-  EEPROM.write(EEPROM_SIGNAL_TIMING_PRESET_ADDR, value);
-  EEPROM.commit();
+  stageSetting(SettingKey::SignalTimingPreset, static_cast<uint8_t>(signalTimingPreset));
+  commitSettings();
+}
+
+void loadControlSettings() {
+  uint8_t rawMode = 0xFFU;
+  if (!readSetting(SettingKey::ControlMode, rawMode) || rawMode == 0xFFU) {
+    // Never saved: the gains are not meaningful either.
+    controlMode = logic::ControlMode::BangBang;
+    pidGains = logic::DEFAULT_PID_GAINS;
+  } else {
+    float kp = NAN;
+    float ki = NAN;
+    float kd = NAN;
+    readSetting(SettingKey::PidKp, kp);
+    readSetting(SettingKey::PidKi, ki);
+    readSetting(SettingKey::PidKd, kd);
+    controlMode = logic::clampControlMode(rawMode);
+    pidGains.kp = clampPidGain(kp, PID_KP_MAX, logic::DEFAULT_PID_GAINS.kp);
+    pidGains.ki = clampPidGain(ki, PID_KI_MAX, logic::DEFAULT_PID_GAINS.ki);
+    pidGains.kd = clampPidGain(kd, PID_KD_MAX, logic::DEFAULT_PID_GAINS.kd);
+  }
+
+  // Added later than the PID settings, so read on their own: missing keys mean duty steps, 4 ohm.
+  uint8_t rawPowerMode = 0;
+  float elementOhm = NAN;
+  readSetting(SettingKey::ManualPowerMode, rawPowerMode);
+  readSetting(SettingKey::HeaterElementOhm, elementOhm);
+  manualPowerMode = logic::clampManualPowerMode(rawPowerMode);
+  heaterElementOhm = clampHeaterElementOhm(elementOhm);
+}
+
+void saveControlSettings() {
+  StoreLock lock;
+  stageSetting(SettingKey::ControlMode, static_cast<uint8_t>(controlMode));
+  stageSetting(SettingKey::PidKp, pidGains.kp);
+  stageSetting(SettingKey::PidKi, pidGains.ki);
+  stageSetting(SettingKey::PidKd, pidGains.kd);
+  stageSetting(SettingKey::ManualPowerMode, static_cast<uint8_t>(manualPowerMode));
+  stageSetting(SettingKey::HeaterElementOhm, heaterElementOhm);
+  commitSettings();
 }
 
 void loadManualPowerPercents() {
-  const uint8_t stored1 = EEPROM.read(EEPROM_MANUAL_POWER1_ADDR);
-  const uint8_t stored2 = EEPROM.read(EEPROM_MANUAL_POWER2_ADDR);
+  uint8_t stored1 = 0xFFU;
+  uint8_t stored2 = 0xFFU;
+  readSetting(SettingKey::ManualPower1, stored1);
+  readSetting(SettingKey::ManualPower2, stored2);
 
   manualPowerPercent1 = clampManualPowerPercent(stored1);
 
@@ -236,17 +653,15 @@ void loadManualPowerPercents() {
 }
 
 void saveManualPowerPercents() {
-  EEPROM.write(EEPROM_MANUAL_POWER1_ADDR, clampManualPowerPercent(manualPowerPercent1));
-  EEPROM.write(EEPROM_MANUAL_POWER2_ADDR, clampManualPowerPercent(manualPowerPercent2));
-  EEPROM.commit();
+  StoreLock lock;
+  stageSetting(SettingKey::ManualPower1, clampManualPowerPercent(manualPowerPercent1));
+  stageSetting(SettingKey::ManualPower2, clampManualPowerPercent(manualPowerPercent2));
+  commitSettings();
 }
 
 void loadManualToggleOffMs() {
   uint16_t stored = 0U;
-  uint8_t *bytes = reinterpret_cast<uint8_t *>(&stored);
-  for (size_t i = 0; i < sizeof(uint16_t); ++i) {
-    bytes[i] = EEPROM.read(EEPROM_MANUAL_TOGGLE_MS_ADDR + static_cast<int>(i));
-  }
+  readSetting(SettingKey::ManualToggleOffMs, stored);
 
   // 0xFFFF or 0 means "not initialized yet" -> use default 1500ms.
   if (stored == 0xFFFFU || stored == 0U) {
@@ -257,126 +672,160 @@ void loadManualToggleOffMs() {
 }
 
 void saveManualToggleOffMs() {
-  const uint16_t value = clampManualToggleOffMs(manualPowerToggleMaxOffMs);
-  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
-  for (size_t i = 0; i < sizeof(uint16_t); ++i) {
-    EEPROM.write(EEPROM_MANUAL_TOGGLE_MS_ADDR + static_cast<int>(i), bytes[i]);
-  }
-  EEPROM.commit();
+  stageSetting(SettingKey::ManualToggleOffMs, clampManualToggleOffMs(manualPowerToggleMaxOffMs));
+  commitSettings();
 }
 
 void cycleManualPowerPercent1() {
-  manualPowerPercent1 = nextManualPowerPercent(manualPowerPercent1);
-  saveManualPowerPercents();
+  {
+    ControlInputsUpdate update;
+    manualPowerPercent1 = nextManualPowerPercent(manualPowerPercent1);
+  }
+  requestPersist(PERSIST_MANUAL_POWER);
 }
 
 void cycleManualPowerPercent2() {
-  manualPowerPercent2 = nextManualPowerPercent(manualPowerPercent2);
-  saveManualPowerPercents();
+  {
+    ControlInputsUpdate update;
+    manualPowerPercent2 = nextManualPowerPercent(manualPowerPercent2);
+  }
+  requestPersist(PERSIST_MANUAL_POWER);
 }
 
 void cycleManualPowerPercents() {
-  manualPowerPercent1 = nextManualPowerPercent(manualPowerPercent1);
-  manualPowerPercent2 = nextManualPowerPercent(manualPowerPercent2);
-  saveManualPowerPercents();
+  {
+    ControlInputsUpdate update;
+    manualPowerPercent1 = nextManualPowerPercent(manualPowerPercent1);
+    manualPowerPercent2 = nextManualPowerPercent(manualPowerPercent2);
+  }
+  requestPersist(PERSIST_MANUAL_POWER);
+}
+
+void loadSensorRoms(logic::SensorRomTable &table) {
+  const SettingKey keys[logic::SENSOR_SLOT_COUNT] = {SettingKey::SensorRom1, SettingKey::SensorRom2};
+  logic::clearSensorRomTable(table);
+  for (uint8_t slot = 0; slot < logic::SENSOR_SLOT_COUNT; ++slot) {
+    logic::SensorRom rom;
+    if (readSetting(keys[slot], rom.bytes) && logic::isValidSensorRom(rom)) {
+      table.slots[slot] = rom;
+    }
+  }
+}
+
+void saveSensorRoms(const logic::SensorRomTable &table) {
+  const SettingKey keys[logic::SENSOR_SLOT_COUNT] = {SettingKey::SensorRom1, SettingKey::SensorRom2};
+  StoreLock lock;
+  for (uint8_t slot = 0; slot < logic::SENSOR_SLOT_COUNT; ++slot) {
+    stageSetting(keys[slot], table.slots[slot].bytes);
+  }
+  commitSettings();
 }
 
 void loadBatteryCellCounts() {
-  const uint8_t stored1 = EEPROM.read(EEPROM_BATTERY1_CELLS_ADDR);
-  const uint8_t stored2 = EEPROM.read(EEPROM_BATTERY2_CELLS_ADDR);
+  uint8_t stored1 = 0xFFU;
+  uint8_t stored2 = 0xFFU;
+  readSetting(SettingKey::Battery1Cells, stored1);
+  readSetting(SettingKey::Battery2Cells, stored2);
   battery1CellCount = clampBatteryCellCount(stored1);
   battery2CellCount = clampBatteryCellCount(stored2);
 }
 
 void saveBatteryCellCounts() {
-  EEPROM.write(EEPROM_BATTERY1_CELLS_ADDR, clampBatteryCellCount(battery1CellCount));
-  EEPROM.write(EEPROM_BATTERY2_CELLS_ADDR, clampBatteryCellCount(battery2CellCount));
-  EEPROM.commit();
+  StoreLock lock;
+  stageSetting(SettingKey::Battery1Cells, clampBatteryCellCount(battery1CellCount));
+  stageSetting(SettingKey::Battery2Cells, clampBatteryCellCount(battery2CellCount));
+  commitSettings();
 }
 
 void loadBatteryChemistries() {
-  const uint8_t stored1 = EEPROM.read(EEPROM_BATTERY1_CHEM_ADDR);
-  const uint8_t stored2 = EEPROM.read(EEPROM_BATTERY2_CHEM_ADDR);
+  uint8_t stored1 = 0xFFU;
+  uint8_t stored2 = 0xFFU;
+  readSetting(SettingKey::Battery1Chem, stored1);
+  readSetting(SettingKey::Battery2Chem, stored2);
   battery1Chemistry = clampBatteryChemistry(stored1);
   battery2Chemistry = clampBatteryChemistry(stored2);
 }
 
 void saveBatteryChemistries() {
-  EEPROM.write(EEPROM_BATTERY1_CHEM_ADDR, clampBatteryChemistry(battery1Chemistry));
-  EEPROM.write(EEPROM_BATTERY2_CHEM_ADDR, clampBatteryChemistry(battery2Chemistry));
-  EEPROM.commit();
+  StoreLock lock;
+  stageSetting(SettingKey::Battery1Chem, clampBatteryChemistry(battery1Chemistry));
+  stageSetting(SettingKey::Battery2Chem, clampBatteryChemistry(battery2Chemistry));
+  commitSettings();
 }
 
-void writeRuntimeToEeprom(uint32_t minutes) {
-  uint8_t *bytes = reinterpret_cast<uint8_t *>(&minutes);
-  for (size_t i = 0; i < sizeof(uint32_t); ++i) {
-    EEPROM.write(EEPROM_RUNTIME_ADDR + static_cast<int>(i), bytes[i]);
-  }
-  EEPROM.commit();
+void writeSavedRuntime(uint32_t minutes) {
+  stageSetting(SettingKey::RuntimeMinutes, minutes);
+  commitSettings();
 }
 
-uint32_t readRuntimeFromEeprom() {
-  uint32_t minutes = 0;
-  uint8_t *bytes = reinterpret_cast<uint8_t *>(&minutes);
-  for (size_t i = 0; i < sizeof(uint32_t); ++i) {
-    bytes[i] = EEPROM.read(EEPROM_RUNTIME_ADDR + static_cast<int>(i));
-  }
+uint32_t readSavedRuntime() {
+  uint32_t minutes = 0xFFFFFFFFUL;
+  readSetting(SettingKey::RuntimeMinutes, minutes);
   return minutes;
 }
 
 void loadSavedRuntime() {
-  savedRuntimeMinutes = readRuntimeFromEeprom();
+  savedRuntimeMinutes = readSavedRuntime();
   if (savedRuntimeMinutes == 0xFFFFFFFF) {
     savedRuntimeMinutes = 0;
-    writeRuntimeToEeprom(0);
+    writeSavedRuntime(0);
   }
 }
 
 void saveRuntimeMinute() {
   ++savedRuntimeMinutes;
-  writeRuntimeToEeprom(savedRuntimeMinutes);
+  requestPersist(PERSIST_RUNTIME);
+}
+
+void loadHeaterEnergy() {
+  // Firmware without energy metering never wrote the keys: start from zero.
+  uint32_t stored1 = 0;
+  uint32_t stored2 = 0;
+  readSetting(SettingKey::Heater1EnergyMilliWh, stored1);
+  readSetting(SettingKey::Heater2EnergyMilliWh, stored2);
+  heater1EnergyMilliWh = stored1;
+  heater2EnergyMilliWh = stored2;
+}
+
+void saveHeaterEnergy() {
+  StoreLock lock;
+  stageSetting(SettingKey::Heater1EnergyMilliWh, heater1EnergyMilliWh);
+  stageSetting(SettingKey::Heater2EnergyMilliWh, heater2EnergyMilliWh);
+  commitSettings();
 }
 
 String formatRuntime(unsigned long seconds, bool showSeconds) {
-  const unsigned long days = seconds / 86400;
-  seconds %= 86400;
-  const unsigned long hours = seconds / 3600;
-  seconds %= 3600;
-  const unsigned long minutes = seconds / 60;
-  seconds %= 60;
-
-  String result;
-  if (days > 0) result += String(days) + "d ";
-  if (hours > 0) result += String(hours) + "h ";
-  if (minutes > 0) result += String(minutes) + "m ";
-  if (showSeconds) result += String(seconds) + "s";
-  if (result.isEmpty()) result = showSeconds ? "0s" : "0m";
-  return result;
+  char text[32];
+  logic_helpers::formatRuntime(seconds, showSeconds, text, sizeof(text));
+  return String(text);
 }
 
 uint8_t loadLastBatteryMask() {
   // Bit0 = battery 1 present, bit1 = battery 2 present.
-  const uint8_t raw = EEPROM.read(EEPROM_LAST_BATTERY_MASK_ADDR);
-  if (raw == 0xFF) {
+  uint8_t raw = 0xFFU;
+  if (!readSetting(SettingKey::LastBatteryMask, raw) || raw == 0xFF) {
     return 0;
   }
   return static_cast<uint8_t>(raw & 0x03U);
 }
 
 void saveLastBatteryMask(uint8_t mask) {
-  const uint8_t clamped = static_cast<uint8_t>(mask & 0x03U);
-  EEPROM.write(EEPROM_LAST_BATTERY_MASK_ADDR, clamped);
-  EEPROM.commit();
+  stageSetting(SettingKey::LastBatteryMask, static_cast<uint8_t>(mask & 0x03U));
+  commitSettings();
 }
 
 void loadMosfetOvertempEvents() {
-  const uint8_t rawFlag1 = EEPROM.read(EEPROM_MOSFET1_OVERTEMP_FLAG_ADDR);
-  const uint8_t rawFlag2 = EEPROM.read(EEPROM_MOSFET2_OVERTEMP_FLAG_ADDR);
+  uint8_t rawFlag1 = 0U;
+  uint8_t rawFlag2 = 0U;
+  readSetting(SettingKey::Mosfet1OvertempFlag, rawFlag1);
+  readSetting(SettingKey::Mosfet2OvertempFlag, rawFlag2);
   mosfet1OvertempLatched = (rawFlag1 == 1U);
   mosfet2OvertempLatched = (rawFlag2 == 1U);
 
-  const float storedTrip1 = readFloatFromEeprom(EEPROM_MOSFET1_OVERTEMP_TEMP_ADDR);
-  const float storedTrip2 = readFloatFromEeprom(EEPROM_MOSFET2_OVERTEMP_TEMP_ADDR);
+  float storedTrip1 = NAN;
+  float storedTrip2 = NAN;
+  readSetting(SettingKey::Mosfet1TripTemp, storedTrip1);
+  readSetting(SettingKey::Mosfet2TripTemp, storedTrip2);
   const auto isPlausibleTrip = [](float value) { return !std::isnan(value) && value >= -50.0F && value <= 200.0F; };
 
   mosfet1OvertempTripTempC = (mosfet1OvertempLatched && isPlausibleTrip(storedTrip1)) ? storedTrip1 : NAN;
@@ -390,30 +839,36 @@ void saveMosfetOvertempEvent(uint8_t channel, float tripTempC) {
 
   const uint8_t clampedChannel = channel == 1U ? 1U : 2U;
   const float clampedTrip = (std::isnan(tripTempC) || tripTempC < -50.0F || tripTempC > 200.0F) ? NAN : tripTempC;
+  StoreLock lock;
   if (clampedChannel == 1U) {
-    EEPROM.write(EEPROM_MOSFET1_OVERTEMP_FLAG_ADDR, 1U);
-    writeFloatToEeprom(EEPROM_MOSFET1_OVERTEMP_TEMP_ADDR, clampedTrip);
+    stageSetting(SettingKey::Mosfet1OvertempFlag, static_cast<uint8_t>(1U));
+    stageSetting(SettingKey::Mosfet1TripTemp, clampedTrip);
     mosfet1OvertempLatched = true;
     mosfet1OvertempTripTempC = clampedTrip;
   } else {
-    EEPROM.write(EEPROM_MOSFET2_OVERTEMP_FLAG_ADDR, 1U);
-    writeFloatToEeprom(EEPROM_MOSFET2_OVERTEMP_TEMP_ADDR, clampedTrip);
+    stageSetting(SettingKey::Mosfet2OvertempFlag, static_cast<uint8_t>(1U));
+    stageSetting(SettingKey::Mosfet2TripTemp, clampedTrip);
     mosfet2OvertempLatched = true;
     mosfet2OvertempTripTempC = clampedTrip;
   }
-  EEPROM.commit();
+  commitSettings();
+}
+
+void saveMosfetOvertempState() {
+  StoreLock lock;
+  stageSetting(SettingKey::Mosfet1OvertempFlag, static_cast<uint8_t>(mosfet1OvertempLatched ? 1U : 0U));
+  stageSetting(SettingKey::Mosfet2OvertempFlag, static_cast<uint8_t>(mosfet2OvertempLatched ? 1U : 0U));
+  stageSetting(SettingKey::Mosfet1TripTemp, mosfet1OvertempTripTempC);
+  stageSetting(SettingKey::Mosfet2TripTemp, mosfet2OvertempTripTempC);
+  commitSettings();
 }
 
 void clearMosfetOvertempEvents() {
-  EEPROM.write(EEPROM_MOSFET1_OVERTEMP_FLAG_ADDR, 0U);
-  EEPROM.write(EEPROM_MOSFET2_OVERTEMP_FLAG_ADDR, 0U);
-  writeFloatToEeprom(EEPROM_MOSFET1_OVERTEMP_TEMP_ADDR, NAN);
-  writeFloatToEeprom(EEPROM_MOSFET2_OVERTEMP_TEMP_ADDR, NAN);
-  EEPROM.commit();
   mosfet1OvertempLatched = false;
   mosfet2OvertempLatched = false;
   mosfet1OvertempTripTempC = NAN;
   mosfet2OvertempTripTempC = NAN;
+  requestPersist(PERSIST_OVERTEMP_EVENTS);
 }
 
 }  // namespace HeatControl
@@ -2,10 +2,54 @@
 
 #include <Arduino.h>
 
+#include "sensor_bus.h"
 #include "storage_logic.h"
 
 namespace HeatControl {
 
+// Mounts the settings log (the "settings" flash partition, or a LittleFS file on partition tables
+// without it) and migrates the old EEPROM layout on first boot. Call before any load*() and after
+// LittleFS.begin().
+void beginSettingsStore();
+// Flash erase counts and commit latency as JSON for /storage/status; returns the length written.
+size_t renderSettingsStoreJson(char *out, size_t capacity);
+
+// Groups several save*() calls into one flash commit, written when the outermost batch closes.
+// Holds the settings lock meanwhile, so keep it to the handler that changes the values.
+class SettingsBatch {
+ public:
+  SettingsBatch();
+  ~SettingsBatch();
+  SettingsBatch(const SettingsBatch &) = delete;
+  SettingsBatch &operator=(const SettingsBatch &) = delete;
+};
+
+// Settings groups a web handler hands over to loop() instead of writing flash on the AsyncTCP task.
+constexpr uint32_t PERSIST_TEMPERATURE_TARGETS = 1UL << 0;
+constexpr uint32_t PERSIST_SWAP_ASSIGNMENT = 1UL << 1;
+constexpr uint32_t PERSIST_MANUAL_POWER = 1UL << 2;
+constexpr uint32_t PERSIST_MANUAL_TOGGLE = 1UL << 3;
+constexpr uint32_t PERSIST_BATTERY_CELLS = 1UL << 4;
+constexpr uint32_t PERSIST_BATTERY_CHEMISTRY = 1UL << 5;
+constexpr uint32_t PERSIST_AP_AUTO_OFF = 1UL << 6;
+constexpr uint32_t PERSIST_LOG_LEVEL = 1UL << 7;
+constexpr uint32_t PERSIST_SIGNAL_TIMING = 1UL << 8;
+constexpr uint32_t PERSIST_CONTROL_SETTINGS = 1UL << 9;
+constexpr uint32_t PERSIST_WIFI_CREDENTIALS = 1UL << 10;
+constexpr uint32_t PERSIST_AP_CREDENTIALS = 1UL << 11;
+constexpr uint32_t PERSIST_BOOT_MODE = 1UL << 12;
+constexpr uint32_t PERSIST_RUNTIME = 1UL << 13;
+constexpr uint32_t PERSIST_OVERTEMP_EVENTS = 1UL << 14;
+constexpr uint32_t PERSIST_HEATER_ENERGY = 1UL << 15;
+
+// Marks groups whose globals changed; never touches flash, so it is safe from web handlers.
+void requestPersist(uint32_t fields);
+// Writes the groups that are due (see logic::PersistScheduler) in one commit; called from loop().
+void servicePersistence(uint32_t nowMs);
+// Writes everything still pending; call right before ESP.restart().
+void flushPersistence();
+
+// Stored on the next persistence pass, like everything a web handler changes.
 void setNextBootMode(uint8_t mode);
 uint8_t getAndClearBootMode();
 
@@ -16,6 +60,9 @@ void loadSwapAssignment();
 void saveSwapAssignment();
 
 void saveWiFiCredentials(const String &ssid, const String &password);
+// Updates the active credentials without writing them (false for an empty SSID); pair with requestPersist().
+bool assignWiFiCredentials(const String &ssid, const String &password);
+bool assignApCredentials(const String &ssid, const String &password);
 void loadWiFiCredentials();
 void saveApCredentials(const String &ssid, const String &password);
 void loadApCredentials();
@@ -36,15 +83,25 @@ void saveManualToggleOffMs();
 void loadSignalTimingPreset();
 void saveSignalTimingPreset();
 
+void loadControlSettings();
+void saveControlSettings();
+
+// DS18B20 ROM codes per heater slot; invalid or blank entries load as empty slots.
+void loadSensorRoms(logic::SensorRomTable &table);
+void saveSensorRoms(const logic::SensorRomTable &table);
+
 void loadBatteryCellCounts();
 void saveBatteryCellCounts();
 void loadBatteryChemistries();
 void saveBatteryChemistries();
 
-void writeRuntimeToEeprom(uint32_t minutes);
-uint32_t readRuntimeFromEeprom();
+void writeSavedRuntime(uint32_t minutes);
+uint32_t readSavedRuntime();
 void loadSavedRuntime();
+// Counts one more minute of runtime and schedules it for persisting.
 void saveRuntimeMinute();
+void loadHeaterEnergy();
+void saveHeaterEnergy();
 
 String formatRuntime(unsigned long seconds, bool showSeconds);
 
@@ -53,6 +110,8 @@ uint8_t loadLastBatteryMask();
 void saveLastBatteryMask(uint8_t mask);
 void loadMosfetOvertempEvents();
 void saveMosfetOvertempEvent(uint8_t channel, float tripTempC);
+void saveMosfetOvertempState();
+// Clears the latched events now and persists that on the next pass.
 void clearMosfetOvertempEvents();
 
 }  // namespace HeatControl
@@ -8,6 +8,19 @@ float clampTarget(float value) {
   return value;
 }
 
+float clampPidGain(float value, float maxValue, float fallback) {
+  if (!(value >= 0.0F)) return fallback;
+  if (value > maxValue) return maxValue;
+  return value;
+}
+
+float clampHeaterElementOhm(float value) {
+  if (value != value) return HEATER_ELEMENT_OHM_DEFAULT;
+  if (value < HEATER_ELEMENT_OHM_MIN) return HEATER_ELEMENT_OHM_MIN;
+  if (value > HEATER_ELEMENT_OHM_MAX) return HEATER_ELEMENT_OHM_MAX;
+  return value;
+}
+
 uint8_t clampManualPowerPercent(uint8_t value) {
   if (value == 25 || value == 50 || value == 75 || value == 100) {
     return value;
@@ -10,7 +10,19 @@ constexpr uint8_t BATTERY_CHEMISTRY_LI_FE_PO4 = 2U;
 constexpr uint8_t BATTERY_CHEMISTRY_NI_MH = 3U;
 constexpr uint8_t BATTERY_CHEMISTRY_LEAD_GEL = 4U;
 
+constexpr float PID_KP_MAX = 10.0F;
+constexpr float PID_KI_MAX = 1.0F;
+constexpr float PID_KD_MAX = 1000.0F;
+
+constexpr float HEATER_ELEMENT_OHM_DEFAULT = 4.0F;
+constexpr float HEATER_ELEMENT_OHM_MIN = 0.5F;
+constexpr float HEATER_ELEMENT_OHM_MAX = 100.0F;
+
 float clampTarget(float value);
+// NaN or negative gains (e.g. never saved) fall back; values above maxValue are capped.
+float clampPidGain(float value, float maxValue, float fallback);
+// NaN (e.g. never saved) falls back to the default; other values are clamped to the range.
+float clampHeaterElementOhm(float value);
 uint8_t clampManualPowerPercent(uint8_t value);
 uint16_t clampManualToggleOffMs(uint16_t value);
 uint16_t clampApAutoOffMinutes(uint16_t value);
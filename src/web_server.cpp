@@ -5,40 +5,87 @@
 #include <Update.h>
 #include <WiFi.h>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <string>
 
 #include "app_state.h"
 #include "control.h"
 #include "generated/embedded_files_registry.h"
 #include "logic_helpers.h"
+#include "ota_update.h"
+#include "pack_resistance.h"
+#include "path_hash.h"
+#include "slow_pwm.h"
 #include "status_builder.h"
+#include "status_cache.h"
 #include "storage.h"
 
 namespace HeatControl {
 
 namespace {
 
-bool otaUploadStarted = false;
-bool otaUploadOk = false;
-String otaUploadMessage;
-size_t otaUploadBytes = 0;
-constexpr uint32_t kTempPersistDebounceMs = 1500UL;
+// Request whose multipart body feeds the current firmware upload.
+AsyncWebServerRequest *otaUploadOwner = nullptr;
 const IPAddress AP_IP(4, 3, 2, 1);
 const IPAddress AP_NETMASK(255, 255, 255, 0);
 constexpr uint8_t AP_CHANNEL = 1;
+// /status is rendered lazily on GET: a cached document younger than this is served as is, unless a
+// handler changed state since it was rendered. Concurrent pollers within that age share one render.
+constexpr unsigned long kStatusDocumentMaxAgeMs = 1000UL;
+
+StatusDocumentCache statusDocuments;
+unsigned long statusDocumentRenderedMs = 0;
+bool statusDocumentStale = true;
+uint32_t statusStaleSnapshotVersion = 0;
+uint32_t statusBootTag = 0;
+
+// Live status over /ws: a full document on connect, afterwards only the fields that changed.
+// Clients pick their own rate by sending "rate=<ms>"; "full" asks for a complete document again.
+constexpr uint8_t kStatusPushMaxClients = 4;
+constexpr uint32_t kStatusPushDefaultIntervalMs = 250UL;
+constexpr uint32_t kStatusPushMinIntervalMs = 100UL;  // one control tick
+constexpr uint32_t kStatusPushMaxIntervalMs = 10000UL;
+
+struct StatusSubscriber {
+  uint32_t clientId;  // 0 = free slot
+  uint32_t intervalMs;
+  unsigned long lastPushMs;
+  StatusFieldDigest digest;
+};
 
-bool sendEmbeddedFile(AsyncWebServerRequest *request, const String &path) {
-  String normalized = path;
-  if (!normalized.startsWith("/")) {
-    normalized = "/" + normalized;
-  }
+AsyncWebSocket statusSocket("/ws");
+// Slots change on the AsyncTCP task and are serviced from loop(); never held across socket calls.
+SemaphoreHandle_t statusSubscribersMutex = nullptr;
+StatusSubscriber statusSubscribers[kStatusPushMaxClients] = {};
+char statusPushBuffer[STATUS_JSON_MAX_BYTES];
 
-  const EmbeddedFile *file = findEmbeddedFile(normalized.c_str());
+bool sendEmbeddedFile(AsyncWebServerRequest *request, const char *path, size_t length) {
+  const EmbeddedFile *file = findEmbeddedFile(path, length);
   if (file == nullptr) {
     return false;
   }
 
-  AsyncWebServerResponse *response = request->beginResponse(200, file->content_type, file->data, file->size);
+  const bool sendGzip = file->gzip_size > 0U && request->hasHeader("Accept-Encoding") &&
+                        request->getHeader("Accept-Encoding")->value().indexOf("gzip") >= 0;
+  // Each encoding is its own representation and so gets its own strong ETag.
+  const char *etag = sendGzip ? file->gzip_etag : file->etag;
+  AsyncWebServerResponse *response = nullptr;
+  if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value().indexOf(etag) >= 0) {
+    response = request->beginResponse(304);
+  } else if (sendGzip) {
+    response = request->beginResponse(200, file->content_type, file->gzip_data, file->gzip_size);
+    response->addHeader("Content-Encoding", "gzip");
+  } else {
+    response = request->beginResponse(200, file->content_type, file->data, file->size);
+  }
+  response->addHeader("ETag", etag);
+  response->addHeader("Vary", "Accept-Encoding");
+  // Hashed paths never change content; everything else is revalidated against the ETag.
+  response->addHeader("Cache-Control", file->immutable ? "public, max-age=31536000, immutable" : "no-cache");
   request->send(response);
   return true;
 }
@@ -78,9 +125,13 @@ void sendCaptiveRedirect(AsyncWebServerRequest *request) {
   request->send(response);
 }
 
+bool sendEmbeddedFile(AsyncWebServerRequest *request, const char *path) {
+  return sendEmbeddedFile(request, path, strlen(path));
+}
+
 class CaptiveRequestHandler : public AsyncWebHandler {
  public:
-  bool canHandle(AsyncWebServerRequest *request) {
+  bool canHandle(AsyncWebServerRequest *request) const override {
     if (!apEnabled || !isFromLocalApSubnet(request)) {
       return false;
     }
@@ -91,11 +142,63 @@ class CaptiveRequestHandler : public AsyncWebHandler {
     return host.length() > 0;
   }
 
-  void handleRequest(AsyncWebServerRequest *request) {
+  void handleRequest(AsyncWebServerRequest *request) override {
     sendCaptiveRedirect(request);
   }
 };
 
+constexpr uint8_t kMaxFixedRoutes = 48;
+
+// All fixed-path API routes and captive-portal probes behind one handler. The server otherwise asks
+// every registered handler in turn; this answers with one perfect-hash lookup on the raw URL.
+// Paths match exactly (no "/path/..." prefix matching as with server.on()).
+class FixedRouteHandler : public AsyncWebHandler {
+ public:
+  void on(const char *path, WebRequestMethodComposite methods, ArRequestHandlerFunction handler) {
+    const int index = table_.add(path);
+    if (index < 0) {
+      logf(LogLevel::Error, "Route table full, %s not registered", path);
+      return;
+    }
+    routes_[index].methods = methods;
+    routes_[index].handler = handler;
+  }
+
+  bool build() { return table_.build(); }
+
+  bool canHandle(AsyncWebServerRequest *request) const override {
+    const Route *route = find(request);
+    return route != nullptr && (route->methods & request->method()) != 0U;
+  }
+
+  void handleRequest(AsyncWebServerRequest *request) override {
+    const Route *route = find(request);
+    if (route != nullptr && route->handler) {
+      route->handler(request);
+    }
+  }
+
+  // Lets the server parse form bodies for the POST handlers.
+  bool isRequestHandlerTrivial() const override { return false; }
+
+ private:
+  struct Route {
+    WebRequestMethodComposite methods;
+    ArRequestHandlerFunction handler;
+  };
+
+  const Route *find(AsyncWebServerRequest *request) const {
+    const String &url = request->url();
+    const int index = table_.find(url.c_str(), url.length());
+    return index < 0 ? nullptr : &routes_[index];
+  }
+
+  PerfectPathTable<kMaxFixedRoutes, 7> table_;
+  Route routes_[kMaxFixedRoutes];
+};
+
+FixedRouteHandler fixedRoutes;
+
 void scheduleRestart(uint32_t delayMs) {
   restartScheduled = true;
   restartAtMs = millis() + delayMs;
@@ -145,10 +248,249 @@ bool setApEnabledRuntime(bool enable, const String &clientIp) {
   return true;
 }
 
+// Returns the version of the control snapshot the metrics were built from.
+uint32_t fillStatusMetrics(StatusMetrics &metrics) {
+  // Built from exactly one control tick; only network and UI settings are read live.
+  ControlSnapshot snapshot;
+  const uint32_t snapshotVersion = readControlSnapshot(snapshot);
+  const ControlInputs &in = snapshot.inputs;
+  const HousekeepingState &hk = snapshot.housekeeping;
+  const float displayTemp1 = in.swapAssignment ? snapshot.currentTemp2 : snapshot.currentTemp1;
+  const float displayTemp2 = in.swapAssignment ? snapshot.currentTemp1 : snapshot.currentTemp2;
+  const uint32_t currentSessionSeconds = static_cast<uint32_t>((millis() - startTimeMs) / 1000UL);
+  const bool ntc1Valid = !std::isnan(snapshot.ntcMosfet1TempC);
+  const bool ntc2Valid = !std::isnan(snapshot.ntcMosfet2TempC);
+  const bool trip1Valid = !std::isnan(hk.mosfet1OvertempTripTempC);
+  const bool trip2Valid = !std::isnan(hk.mosfet2OvertempTripTempC);
+
+  // Formatted straight into the metrics: rendering /status allocates nothing.
+  if (in.manualMode) {
+    snprintf(metrics.modeText, sizeof(metrics.modeText), "MANUAL H1 %u%% / H2 %u%%",
+             static_cast<unsigned>(in.manualPowerPercent1), static_cast<unsigned>(in.manualPowerPercent2));
+  } else {
+    setStatusText(metrics.modeText, in.powerMode ? "POWER" : "NORMAL");
+  }
+  metrics.logLevelText = logLevelToText(currentLogLevel);
+  metrics.manualMode = in.manualMode;
+  metrics.manualPercent1 = in.manualPowerPercent1;
+  metrics.manualPercent2 = in.manualPowerPercent2;
+  metrics.manualHeater1Enabled = in.manualHeater1Enabled;
+  metrics.manualHeater2Enabled = in.manualHeater2Enabled;
+  metrics.bootPinText = (digitalRead(INPUT_PIN) == HIGH) ? "HIGH" : "LOW";
+  metrics.adc1MilliVolts = hk.adc1MilliVolts;
+  metrics.adc2MilliVolts = hk.adc2MilliVolts;
+  metrics.ntcMosfet1MilliVolts = snapshot.ntcMosfet1MilliVolts;
+  metrics.ntcMosfet2MilliVolts = snapshot.ntcMosfet2MilliVolts;
+  metrics.ntcMosfet1Valid = ntc1Valid;
+  metrics.ntcMosfet1TempC = snapshot.ntcMosfet1TempC;
+  metrics.ntcMosfet2Valid = ntc2Valid;
+  metrics.ntcMosfet2TempC = snapshot.ntcMosfet2TempC;
+  metrics.mosfet1OvertempActive = snapshot.mosfet1OvertempActive;
+  metrics.mosfet2OvertempActive = snapshot.mosfet2OvertempActive;
+  metrics.mosfet1OvertempLatched = hk.mosfet1OvertempLatched;
+  metrics.mosfet2OvertempLatched = hk.mosfet2OvertempLatched;
+  metrics.mosfet1TripValid = trip1Valid;
+  metrics.mosfet1TripTempC = hk.mosfet1OvertempTripTempC;
+  metrics.mosfet2TripValid = trip2Valid;
+  metrics.mosfet2TripTempC = hk.mosfet2OvertempTripTempC;
+  metrics.mosfetOvertempLimitC = MOSFET_OVERTEMP_LIMIT_C;
+  metrics.battery1CellCount = hk.battery1CellCount;
+  metrics.battery1Chemistry = hk.battery1Chemistry;
+  metrics.battery1PackVoltage = hk.battery1PackVoltage;
+  metrics.battery1CellVoltage = hk.battery1CellVoltage;
+  metrics.battery1SocPercent = hk.battery1SocPercent;
+  metrics.battery1SourceValid = hk.battery1SagValid;
+  metrics.battery1SourceMilliOhm = static_cast<float>(hk.battery1SagPpm) * in.heaterElementOhm / 1000.0F;
+  metrics.battery1Weak = hk.battery1SagValid && hk.battery1SagPpm >= logic::PACK_SAG_WEAK_PPM;
+  metrics.battery2CellCount = hk.battery2CellCount;
+  metrics.battery2Chemistry = hk.battery2Chemistry;
+  metrics.battery2PackVoltage = hk.battery2PackVoltage;
+  metrics.battery2CellVoltage = hk.battery2CellVoltage;
+  metrics.battery2SocPercent = hk.battery2SocPercent;
+  metrics.battery2SourceValid = hk.battery2SagValid;
+  metrics.battery2SourceMilliOhm = static_cast<float>(hk.battery2SagPpm) * in.heaterElementOhm / 1000.0F;
+  metrics.battery2Weak = hk.battery2SagValid && hk.battery2SagPpm >= logic::PACK_SAG_WEAK_PPM;
+  metrics.manualToggleMaxOffMs = manualPowerToggleMaxOffMs;
+  metrics.signalTimingPreset = static_cast<uint8_t>(signalTimingPreset);
+  metrics.displayTemp1 = displayTemp1;
+  metrics.displayTemp2 = displayTemp2;
+  metrics.targetTemp1 = in.targetTemp1;
+  metrics.targetTemp2 = in.targetTemp2;
+  metrics.swapAssignment = in.swapAssignment;
+  metrics.controlMode = static_cast<uint8_t>(in.controlMode);
+  metrics.pidKp = in.pidGains.kp;
+  metrics.pidKi = in.pidGains.ki;
+  metrics.pidKd = in.pidGains.kd;
+  metrics.manualPowerMode = static_cast<uint8_t>(in.manualPowerMode);
+  metrics.heaterElementOhm = in.heaterElementOhm;
+  metrics.manualWatts1 =
+      logic::manualStepWatts(in.manualPowerPercent1, hk.battery1CellCount, hk.battery1Chemistry, in.heaterElementOhm);
+  metrics.manualWatts2 =
+      logic::manualStepWatts(in.manualPowerPercent2, hk.battery2CellCount, hk.battery2Chemistry, in.heaterElementOhm);
+  metrics.heater1DutyPermille = snapshot.heater1DutyPermille;
+  metrics.heater2DutyPermille = snapshot.heater2DutyPermille;
+  metrics.heater1EnergyWh = static_cast<float>(snapshot.heater1EnergyMilliWh) / 1000.0F;
+  metrics.heater2EnergyWh = static_cast<float>(snapshot.heater2EnergyMilliWh) / 1000.0F;
+  metrics.heater1MeanWatts = static_cast<float>(snapshot.heater1MeanMilliWatts) / 1000.0F;
+  metrics.heater2MeanWatts = static_cast<float>(snapshot.heater2MeanMilliWatts) / 1000.0F;
+  metrics.battery1RuntimeLeftValid = snapshot.battery1RuntimeLeftValid;
+  metrics.battery1RuntimeLeftMinutes = static_cast<float>(snapshot.battery1RuntimeLeftMinutes);
+  metrics.battery2RuntimeLeftValid = snapshot.battery2RuntimeLeftValid;
+  metrics.battery2RuntimeLeftMinutes = static_cast<float>(snapshot.battery2RuntimeLeftMinutes);
+  metrics.controlPeriodUs = snapshot.stats.nominalPeriodUs;
+  metrics.controlTicks = snapshot.stats.ticks;
+  metrics.controlJitterMeanUs = snapshot.stats.meanAbsJitterUs;
+  metrics.controlJitterMaxUs = snapshot.stats.maxAbsJitterUs;
+  metrics.controlOverruns = snapshot.stats.overruns;
+  metrics.controlBusyMaxUs = snapshot.stats.maxBusyUs;
+  setStatusText(metrics.ssid, activeSsid.c_str());
+  setStatusText(metrics.apSsid, activeApSsid.c_str());
+  if (staConnected) {
+    const IPAddress ip = WiFi.localIP();
+    snprintf(metrics.staIp, sizeof(metrics.staIp), "%u.%u.%u.%u", static_cast<unsigned>(ip[0]),
+             static_cast<unsigned>(ip[1]), static_cast<unsigned>(ip[2]), static_cast<unsigned>(ip[3]));
+  } else {
+    metrics.staIp[0] = '\0';
+  }
+  metrics.apAutoOffMinutes = apAutoOffMinutes;
+  metrics.staConnected = staConnected;
+  metrics.apEnabled = apEnabled;
+  metrics.wifiRadiosDisabled = wifiRadiosDisabled;
+  metrics.heater1On = snapshot.heater1On;
+  metrics.heater2On = snapshot.heater2On;
+  logic_helpers::formatRuntime(hk.savedRuntimeMinutes * 60UL, false, metrics.totalRuntime,
+                               sizeof(metrics.totalRuntime));
+  logic_helpers::formatRuntime(currentSessionSeconds, true, metrics.currentRuntime, sizeof(metrics.currentRuntime));
+  return snapshotVersion;
+}
+
+// Handler changes reach the control snapshot on the next tick; keep re-rendering until they did.
+void invalidateStatusDocument() {
+  statusDocumentStale = true;
+  statusStaleSnapshotVersion = controlSnapshotVersion();
+}
+
+// Renders the status document into a free cache slot; runs on the AsyncTCP task only. A render
+// with the same bytes keeps the current version, so unchanged state still answers 304.
+void renderStatusDocument(unsigned long now) {
+  char *buffer = statusDocuments.beginRender();
+  if (buffer == nullptr) {
+    return;
+  }
+  StatusMetrics metrics;
+  const uint32_t snapshotVersion = fillStatusMetrics(metrics);
+  const size_t length = writeStatusJson(metrics, buffer, statusDocuments.capacity());
+  if (length == 0U) {
+    statusDocuments.commitRender(0);
+    logf(LogLevel::Error, "Status document too large | capacity=%u", static_cast<unsigned>(statusDocuments.capacity()));
+    return;
+  }
+  statusDocuments.commitRender(length);
+  statusDocumentRenderedMs = now;
+  if (snapshotVersion != statusStaleSnapshotVersion) {
+    statusDocumentStale = false;
+  }
+}
+
+void formatStatusEtag(uint32_t version, char *out, size_t outSize) {
+  snprintf(out, outSize, "\"%08lx-%lu\"", static_cast<unsigned long>(statusBootTag),
+           static_cast<unsigned long>(version));
+}
+
+void lockStatusSubscribers() {
+  xSemaphoreTake(statusSubscribersMutex, portMAX_DELAY);
+}
+
+void unlockStatusSubscribers() {
+  xSemaphoreGive(statusSubscribersMutex);
+}
+
+StatusSubscriber *findStatusSubscriber(uint32_t clientId) {
+  for (StatusSubscriber &subscriber : statusSubscribers) {
+    if (subscriber.clientId == clientId) {
+      return &subscriber;
+    }
+  }
+  return nullptr;
+}
+
+void handleStatusSubscriberMessage(uint32_t clientId, const char *message, size_t len) {
+  char text[24];
+  if (len >= sizeof(text)) {
+    return;
+  }
+  memcpy(text, message, len);
+  text[len] = '\0';
+
+  lockStatusSubscribers();
+  StatusSubscriber *subscriber = findStatusSubscriber(clientId);
+  if (subscriber != nullptr) {
+    if (strncmp(text, "rate=", 5) == 0) {
+      const unsigned long requested = strtoul(text + 5, nullptr, 10);
+      subscriber->intervalMs = static_cast<uint32_t>(
+          requested < kStatusPushMinIntervalMs ? kStatusPushMinIntervalMs
+                                               : (requested > kStatusPushMaxIntervalMs ? kStatusPushMaxIntervalMs
+                                                                                        : requested));
+    } else if (strcmp(text, "full") == 0) {
+      subscriber->digest.primed = false;
+    }
+  }
+  unlockStatusSubscribers();
+}
+
+void onStatusSocketEvent(AsyncWebSocket *socket, AsyncWebSocketClient *client, AwsEventType type, void *arg,
+                         uint8_t *data, size_t len) {
+  if (type == WS_EVT_CONNECT) {
+    lockStatusSubscribers();
+    StatusSubscriber *slot = findStatusSubscriber(0);
+    if (slot != nullptr) {
+      slot->clientId = client->id();
+      slot->intervalMs = kStatusPushDefaultIntervalMs;
+      slot->lastPushMs = 0;
+      slot->digest.primed = false;
+    }
+    unlockStatusSubscribers();
+    if (slot == nullptr) {
+      logf(LogLevel::Info, "Status push client rejected (limit %u) | ip=%s",
+           static_cast<unsigned int>(kStatusPushMaxClients), client->remoteIP().toString().c_str());
+      client->close();
+      return;
+    }
+    logf(LogLevel::Debug, "Status push client connected | id=%lu | ip=%s", static_cast<unsigned long>(client->id()),
+         client->remoteIP().toString().c_str());
+  } else if (type == WS_EVT_DISCONNECT) {
+    lockStatusSubscribers();
+    StatusSubscriber *slot = findStatusSubscriber(client->id());
+    if (slot != nullptr) {
+      slot->clientId = 0;
+    }
+    unlockStatusSubscribers();
+  } else if (type == WS_EVT_DATA) {
+    const AwsFrameInfo *info = static_cast<const AwsFrameInfo *>(arg);
+    // Commands are a few bytes; anything fragmented is not one of them.
+    if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
+      handleStatusSubscriberMessage(client->id(), reinterpret_cast<const char *>(data), len);
+    }
+  }
+}
+
 }  // namespace
 
 void setupWebServer() {
-  server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
+  statusBootTag = esp_random();
+  statusSubscribersMutex = xSemaphoreCreateMutex();
+  initOtaUpload();
+  statusSocket.handleHandshake([](AsyncWebServerRequest *request) {
+    if (!isAllowedWebClient(request)) {
+      logDeniedRequest("/ws", request);
+      return false;
+    }
+    return true;
+  });
+  statusSocket.onEvent(onStatusSocketEvent);
+  server.addHandler(&statusSocket);
+
+  fixedRoutes.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
     if (sendEmbeddedFile(request, "/index.html")) {
       return;
     }
@@ -160,132 +502,91 @@ void setupWebServer() {
     request->send(500, "text/plain", "Web UI not available (missing embedded /index.html).");
   });
 
-  server.on("/status", HTTP_GET, [](AsyncWebServerRequest *request) {
-    const float displayTemp1 = swapAssignment ? currentTemp2 : currentTemp1;
-    const float displayTemp2 = swapAssignment ? currentTemp1 : currentTemp2;
-    const uint32_t currentSessionSeconds = static_cast<uint32_t>((millis() - startTimeMs) / 1000UL);
-    const String modeText = manualMode ? ("MANUAL H1 " + String(manualPowerPercent1) + "% / H2 " + String(manualPowerPercent2) + "%")
-                                       : (powerMode ? "POWER" : "NORMAL");
-    const String bootPinText = (digitalRead(INPUT_PIN) == HIGH) ? "HIGH" : "LOW";
-    const bool heater1On = (digitalRead(SSR_PIN_1) == HIGH);
-    const bool heater2On = (digitalRead(SSR_PIN_2) == HIGH);
-    const bool ntc1Valid = !std::isnan(ntcMosfet1TempC);
-    const bool ntc2Valid = !std::isnan(ntcMosfet2TempC);
-    const bool trip1Valid = !std::isnan(mosfet1OvertempTripTempC);
-    const bool trip2Valid = !std::isnan(mosfet2OvertempTripTempC);
-    const String totalRuntime = formatRuntime(savedRuntimeMinutes * 60UL, false);
-    const String currentRuntime = formatRuntime(currentSessionSeconds, true);
-
-    StatusMetrics metrics;
-    metrics.modeText = modeText.c_str();
-    metrics.logLevelText = logLevelToText(currentLogLevel);
-    metrics.manualMode = manualMode;
-    metrics.manualPercent1 = manualPowerPercent1;
-    metrics.manualPercent2 = manualPowerPercent2;
-    metrics.manualHeater1Enabled = manualHeater1Enabled;
-    metrics.manualHeater2Enabled = manualHeater2Enabled;
-    metrics.bootPinText = bootPinText.c_str();
-    metrics.adc1MilliVolts = adc1MilliVolts;
-    metrics.adc2MilliVolts = adc2MilliVolts;
-    metrics.ntcMosfet1MilliVolts = ntcMosfet1MilliVolts;
-    metrics.ntcMosfet2MilliVolts = ntcMosfet2MilliVolts;
-    metrics.ntcMosfet1Valid = ntc1Valid;
-    metrics.ntcMosfet1TempC = ntcMosfet1TempC;
-    metrics.ntcMosfet2Valid = ntc2Valid;
-    metrics.ntcMosfet2TempC = ntcMosfet2TempC;
-    metrics.mosfet1OvertempActive = mosfet1OvertempActive;
-    metrics.mosfet2OvertempActive = mosfet2OvertempActive;
-    metrics.mosfet1OvertempLatched = mosfet1OvertempLatched;
-    metrics.mosfet2OvertempLatched = mosfet2OvertempLatched;
-    metrics.mosfet1TripValid = trip1Valid;
-    metrics.mosfet1TripTempC = mosfet1OvertempTripTempC;
-    metrics.mosfet2TripValid = trip2Valid;
-    metrics.mosfet2TripTempC = mosfet2OvertempTripTempC;
-    metrics.mosfetOvertempLimitC = MOSFET_OVERTEMP_LIMIT_C;
-    metrics.battery1CellCount = battery1CellCount;
-    metrics.battery1Chemistry = battery1Chemistry;
-    metrics.battery1PackVoltage = battery1PackVoltage;
-    metrics.battery1CellVoltage = battery1CellVoltage;
-    metrics.battery1SocPercent = battery1SocPercent;
-    metrics.battery2CellCount = battery2CellCount;
-    metrics.battery2Chemistry = battery2Chemistry;
-    metrics.battery2PackVoltage = battery2PackVoltage;
-    metrics.battery2CellVoltage = battery2CellVoltage;
-    metrics.battery2SocPercent = battery2SocPercent;
-    metrics.manualToggleMaxOffMs = manualPowerToggleMaxOffMs;
-    metrics.signalTimingPreset = static_cast<uint8_t>(signalTimingPreset);
-    metrics.displayTemp1 = displayTemp1;
-    metrics.displayTemp2 = displayTemp2;
-    metrics.targetTemp1 = targetTemp1;
-    metrics.targetTemp2 = targetTemp2;
-    metrics.swapAssignment = swapAssignment;
-    metrics.ssid = activeSsid.c_str();
-    metrics.apSsid = activeApSsid.c_str();
-    metrics.staIp = staConnected ? WiFi.localIP().toString().c_str() : "";
-    metrics.apAutoOffMinutes = apAutoOffMinutes;
-    metrics.staConnected = staConnected;
-    metrics.apEnabled = apEnabled;
-    metrics.wifiRadiosDisabled = wifiRadiosDisabled;
-    metrics.heater1On = heater1On;
-    metrics.heater2On = heater2On;
-    metrics.totalRuntime = totalRuntime.c_str();
-    metrics.currentRuntime = currentRuntime.c_str();
-
-    const std::string json = buildStatusJson(metrics);
-    request->send(200, "application/json", json.c_str());
+  fixedRoutes.on("/status", HTTP_GET, [](AsyncWebServerRequest *request) {
+    const unsigned long now = millis();
+    if (statusDocumentStale || (now - statusDocumentRenderedMs) >= kStatusDocumentMaxAgeMs) {
+      renderStatusDocument(now);
+    }
+    const StatusDocumentCache::Lease document = statusDocuments.acquire();
+    if (!document.valid()) {
+      request->send(503, "text/plain", "Status unavailable");
+      return;
+    }
+
+    char etag[24];
+    formatStatusEtag(document.version(), etag, sizeof(etag));
+    AsyncWebServerResponse *response = nullptr;
+    if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == etag) {
+      response = request->beginResponse(304);
+    } else {
+      // Streams straight from the cache slot; the captured lease keeps it from being re-rendered meanwhile.
+      response = request->beginResponse("application/json", document.size(),
+                                        [document](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                                          const size_t remaining = document.size() - index;
+                                          const size_t chunk = remaining < maxLen ? remaining : maxLen;
+                                          memcpy(buffer, document.data() + index, chunk);
+                                          return chunk;
+                                        });
+    }
+    response->addHeader("ETag", etag);
+    // Overrides the no-store default so browsers revalidate with If-None-Match.
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
   });
 
-  server.on("/setBattery1", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/setBattery1", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/setBattery1", request);
       request->send(403, "text/plain", "Forbidden");
       return;
     }
-    bool changed = false;
+    // Applied and persisted by loop(), which owns the battery state.
+    BatterySettingsChange change;
     if (request->hasParam("cells", true)) {
-      battery1CellCount = clampBatteryCellCount(static_cast<uint8_t>(request->getParam("cells", true)->value().toInt()));
-      changed = true;
+      change.setCells = true;
+      change.cells = clampBatteryCellCount(static_cast<uint8_t>(request->getParam("cells", true)->value().toInt()));
     }
     if (request->hasParam("chem", true)) {
-      battery1Chemistry = clampBatteryChemistry(static_cast<uint8_t>(request->getParam("chem", true)->value().toInt()));
-      changed = true;
+      change.setChemistry = true;
+      change.chemistry = clampBatteryChemistry(static_cast<uint8_t>(request->getParam("chem", true)->value().toInt()));
     }
-    if (changed) {
-      saveBatteryCellCounts();
-      saveBatteryChemistries();
-      battery1SocSmoothingInitialized = false;
+    if (change.setCells || change.setChemistry) {
+      requestBatterySettingsChange(1, change);
       logf("HTTP /setBattery1 | client=%s | batt1_cells=%u | batt1_chem=%u", clientIpText(request).c_str(),
-           battery1CellCount, battery1Chemistry);
+           change.setCells ? change.cells : battery1CellCount,
+           change.setChemistry ? change.chemistry : battery1Chemistry);
     }
+    invalidateStatusDocument();
     request->redirect("/");
   });
 
-  server.on("/setBattery2", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/setBattery2", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/setBattery2", request);
       request->send(403, "text/plain", "Forbidden");
       return;
     }
-    bool changed = false;
+    // Applied and persisted by loop(), which owns the battery state.
+    BatterySettingsChange change;
     if (request->hasParam("cells", true)) {
-      battery2CellCount = clampBatteryCellCount(static_cast<uint8_t>(request->getParam("cells", true)->value().toInt()));
-      changed = true;
+      change.setCells = true;
+      change.cells = clampBatteryCellCount(static_cast<uint8_t>(request->getParam("cells", true)->value().toInt()));
     }
     if (request->hasParam("chem", true)) {
-      battery2Chemistry = clampBatteryChemistry(static_cast<uint8_t>(request->getParam("chem", true)->value().toInt()));
-      changed = true;
+      change.setChemistry = true;
+      change.chemistry = clampBatteryChemistry(static_cast<uint8_t>(request->getParam("chem", true)->value().toInt()));
     }
-    if (changed) {
-      saveBatteryCellCounts();
-      saveBatteryChemistries();
-      battery2SocSmoothingInitialized = false;
+    if (change.setCells || change.setChemistry) {
+      requestBatterySettingsChange(2, change);
       logf("HTTP /setBattery2 | client=%s | batt2_cells=%u | batt2_chem=%u", clientIpText(request).c_str(),
-           battery2CellCount, battery2Chemistry);
+           change.setCells ? change.cells : battery2CellCount,
+           change.setChemistry ? change.chemistry : battery2Chemistry);
     }
+    invalidateStatusDocument();
     request->redirect("/");
   });
 
-  server.on("/setManualToggle", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/setManualToggle", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/setManualToggle", request);
       request->send(403, "text/plain", "Forbidden");
@@ -295,14 +596,15 @@ void setupWebServer() {
       const uint16_t value =
           static_cast<uint16_t>(request->getParam("windowMs", true)->value().toInt());
       manualPowerToggleMaxOffMs = clampManualToggleOffMs(value);
-      saveManualToggleOffMs();
+      requestPersist(PERSIST_MANUAL_TOGGLE);
       logf("HTTP /setManualToggle | client=%s | window_ms=%u", clientIpText(request).c_str(),
            static_cast<unsigned int>(manualPowerToggleMaxOffMs));
     }
+    invalidateStatusDocument();
     request->redirect("/");
   });
 
-  server.on("/cycleManualPower", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/cycleManualPower", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/cycleManualPower", request);
       request->send(403, "text/plain", "Forbidden");
@@ -325,6 +627,7 @@ void setupWebServer() {
       signalManualPowerChange(manualPowerPercent1);
       logf("HTTP /cycleManualPower | client=%s | channel=1 | manual_power_1=%u", clientIpText(request).c_str(),
            manualPowerPercent1);
+      invalidateStatusDocument();
       request->send(200, "text/plain", "OK");
       return;
     }
@@ -333,6 +636,7 @@ void setupWebServer() {
       signalManualPowerChange(manualPowerPercent2);
       logf("HTTP /cycleManualPower | client=%s | channel=2 | manual_power_2=%u", clientIpText(request).c_str(),
            manualPowerPercent2);
+      invalidateStatusDocument();
       request->send(200, "text/plain", "OK");
       return;
     }
@@ -342,14 +646,14 @@ void setupWebServer() {
     request->send(400, "text/plain", "Invalid channel");
   });
 
-  server.on("/runtime", HTTP_GET, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/runtime", HTTP_GET, [](AsyncWebServerRequest *request) {
     const uint32_t currentSessionSeconds = static_cast<uint32_t>((millis() - startTimeMs) / 1000UL);
     String json = "{\"total\":\"" + formatRuntime(savedRuntimeMinutes * 60UL, false) +
                   "\",\"current\":\"" + formatRuntime(currentSessionSeconds, true) + "\"}";
     request->send(200, "application/json", json);
   });
 
-  server.on("/setLogLevel", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/setLogLevel", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/setLogLevel", request);
       request->send(403, "text/plain", "Forbidden");
@@ -368,12 +672,13 @@ void setupWebServer() {
     }
 
     setLogLevel(parsed);
-    saveLogLevel();
+    requestPersist(PERSIST_LOG_LEVEL);
     logf("HTTP /setLogLevel | client=%s | level=%s", clientIpText(request).c_str(), logLevelToText(parsed));
+    invalidateStatusDocument();
     request->send(200, "text/plain", "OK");
   });
 
-  server.on("/setApEnabled", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/setApEnabled", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/setApEnabled", request);
       request->send(403, "text/plain", "Forbidden");
@@ -393,40 +698,45 @@ void setupWebServer() {
       request->send(500, "text/plain", "AP operation failed");
       return;
     }
+    invalidateStatusDocument();
     request->send(200, "text/plain", "OK");
   });
 
-  server.on("/setTemp", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/setTemp", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/setTemp", request);
       request->send(403, "text/plain", "Forbidden");
       return;
     }
     bool changed = false;
-    if (request->hasParam("temp1", true)) {
-      const float newTarget1 = clampTarget(request->getParam("temp1", true)->value().toFloat());
-      if (std::fabs(newTarget1 - targetTemp1) >= 0.05F) {
-        targetTemp1 = newTarget1;
-        changed = true;
+    {
+      ControlInputsUpdate update;
+      if (request->hasParam("temp1", true)) {
+        const float newTarget1 = clampTarget(request->getParam("temp1", true)->value().toFloat());
+        if (std::fabs(newTarget1 - targetTemp1) >= 0.05F) {
+          targetTemp1 = newTarget1;
+          changed = true;
+        }
       }
-    }
-    if (request->hasParam("temp2", true)) {
-      const float newTarget2 = clampTarget(request->getParam("temp2", true)->value().toFloat());
-      if (std::fabs(newTarget2 - targetTemp2) >= 0.05F) {
-        targetTemp2 = newTarget2;
-        changed = true;
+      if (request->hasParam("temp2", true)) {
+        const float newTarget2 = clampTarget(request->getParam("temp2", true)->value().toFloat());
+        if (std::fabs(newTarget2 - targetTemp2) >= 0.05F) {
+          targetTemp2 = newTarget2;
+          changed = true;
+        }
       }
     }
     if (changed) {
-      pendingTempPersist = true;
-      pendingTempPersistAtMs = millis() + kTempPersistDebounceMs;
+      // Slider drags arrive as bursts; the scheduler writes once they settle.
+      requestPersist(PERSIST_TEMPERATURE_TARGETS);
     }
-    logf(LogLevel::Debug, "HTTP /setTemp | client=%s | target1=%.1f | target2=%.1f | changed=%d | persist_due_ms=%lu",
-         clientIpText(request).c_str(), targetTemp1, targetTemp2, changed ? 1 : 0, pendingTempPersistAtMs);
+    logf(LogLevel::Debug, "HTTP /setTemp | client=%s | target1=%.1f | target2=%.1f | changed=%d",
+         clientIpText(request).c_str(), targetTemp1, targetTemp2, changed ? 1 : 0);
+    invalidateStatusDocument();
     request->send(200, "text/plain", "OK");
   });
 
-  server.on("/saveSettings", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/saveSettings", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/saveSettings", request);
       request->send(403, "text/plain", "Forbidden");
@@ -440,116 +750,169 @@ void setupWebServer() {
     bool batteryChemChanged = false;
     bool apTimeoutChanged = false;
     bool signalTimingChanged = false;
+    bool controlChanged = false;
+
+    {
+      // Targets, swap and control settings change together for the control task.
+      ControlInputsUpdate update;
+      if (request->hasParam("temp1", true)) {
+        targetTemp1 = clampTarget(request->getParam("temp1", true)->value().toFloat());
+        tempChanged = true;
+      }
+      if (request->hasParam("temp2", true)) {
+        targetTemp2 = clampTarget(request->getParam("temp2", true)->value().toFloat());
+        tempChanged = true;
+      }
 
-    if (request->hasParam("temp1", true)) {
-      targetTemp1 = clampTarget(request->getParam("temp1", true)->value().toFloat());
-      tempChanged = true;
-    }
-    if (request->hasParam("temp2", true)) {
-      targetTemp2 = clampTarget(request->getParam("temp2", true)->value().toFloat());
-      tempChanged = true;
-    }
+      if (request->hasParam("swap", true)) {
+        String swapRaw = request->getParam("swap", true)->value();
+        swapRaw.toLowerCase();
+        swapAssignment = (swapRaw == "1" || swapRaw == "true" || swapRaw == "on" || swapRaw == "yes");
+        swapChanged = true;
+      }
 
-    if (request->hasParam("swap", true)) {
-      String swapRaw = request->getParam("swap", true)->value();
-      swapRaw.toLowerCase();
-      swapAssignment = (swapRaw == "1" || swapRaw == "true" || swapRaw == "on" || swapRaw == "yes");
-      swapChanged = true;
-    }
+      if (request->hasParam("windowMs", true)) {
+        const uint16_t value = static_cast<uint16_t>(request->getParam("windowMs", true)->value().toInt());
+        manualPowerToggleMaxOffMs = clampManualToggleOffMs(value);
+        manualWindowChanged = true;
+      }
+      if (request->hasParam("apTimeoutMin", true)) {
+        const uint16_t value = static_cast<uint16_t>(request->getParam("apTimeoutMin", true)->value().toInt());
+        apAutoOffMinutes = clampApAutoOffMinutes(value);
+        apTimeoutChanged = true;
+      }
 
-    if (request->hasParam("windowMs", true)) {
-      const uint16_t value = static_cast<uint16_t>(request->getParam("windowMs", true)->value().toInt());
-      manualPowerToggleMaxOffMs = clampManualToggleOffMs(value);
-      manualWindowChanged = true;
-    }
-    if (request->hasParam("apTimeoutMin", true)) {
-      const uint16_t value = static_cast<uint16_t>(request->getParam("apTimeoutMin", true)->value().toInt());
-      apAutoOffMinutes = clampApAutoOffMinutes(value);
-      apTimeoutChanged = true;
-    }
-
-    if (request->hasParam("signalTiming", true)) {
-      String raw = request->getParam("signalTiming", true)->value();
-      raw.trim();
-      raw.toLowerCase();
-      if (raw == "short") {
-        signalTimingPreset = SignalTimingPreset::Short;
-        signalTimingChanged = true;
-      } else if (raw == "fast") {
-        signalTimingPreset = SignalTimingPreset::Fast;
-        signalTimingChanged = true;
-      } else if (raw == "middle") {
-        signalTimingPreset = SignalTimingPreset::Middle;
-        signalTimingChanged = true;
-      } else {
-        const uint8_t value = static_cast<uint8_t>(raw.toInt());
-        signalTimingPreset = clampSignalTimingPreset(value);
-        signalTimingChanged = true;
+      if (request->hasParam("signalTiming", true)) {
+        String raw = request->getParam("signalTiming", true)->value();
+        raw.trim();
+        raw.toLowerCase();
+        if (raw == "short") {
+          signalTimingPreset = SignalTimingPreset::Short;
+          signalTimingChanged = true;
+        } else if (raw == "fast") {
+          signalTimingPreset = SignalTimingPreset::Fast;
+          signalTimingChanged = true;
+        } else if (raw == "middle") {
+          signalTimingPreset = SignalTimingPreset::Middle;
+          signalTimingChanged = true;
+        } else {
+          const uint8_t value = static_cast<uint8_t>(raw.toInt());
+          signalTimingPreset = clampSignalTimingPreset(value);
+          signalTimingChanged = true;
+        }
       }
-    }
 
-    if (request->hasParam("batt1Cells", true)) {
-      battery1CellCount = clampBatteryCellCount(static_cast<uint8_t>(request->getParam("batt1Cells", true)->value().toInt()));
-      batteryChanged = true;
-    }
-    if (request->hasParam("batt2Cells", true)) {
-      battery2CellCount = clampBatteryCellCount(static_cast<uint8_t>(request->getParam("batt2Cells", true)->value().toInt()));
-      batteryChanged = true;
-    }
-    if (request->hasParam("batt1Chem", true)) {
-      battery1Chemistry = clampBatteryChemistry(static_cast<uint8_t>(request->getParam("batt1Chem", true)->value().toInt()));
-      batteryChemChanged = true;
-    }
-    if (request->hasParam("batt2Chem", true)) {
-      battery2Chemistry = clampBatteryChemistry(static_cast<uint8_t>(request->getParam("batt2Chem", true)->value().toInt()));
-      batteryChemChanged = true;
+      if (request->hasParam("controlMode", true)) {
+        String raw = request->getParam("controlMode", true)->value();
+        raw.trim();
+        raw.toLowerCase();
+        if (raw == "pid") {
+          controlMode = logic::ControlMode::Pid;
+        } else if (raw == "bangbang") {
+          controlMode = logic::ControlMode::BangBang;
+        } else {
+          controlMode = logic::clampControlMode(static_cast<uint8_t>(raw.toInt()));
+        }
+        controlChanged = true;
+      }
+      if (request->hasParam("pidKp", true)) {
+        pidGains.kp = clampPidGain(request->getParam("pidKp", true)->value().toFloat(), PID_KP_MAX, pidGains.kp);
+        controlChanged = true;
+      }
+      if (request->hasParam("pidKi", true)) {
+        pidGains.ki = clampPidGain(request->getParam("pidKi", true)->value().toFloat(), PID_KI_MAX, pidGains.ki);
+        controlChanged = true;
+      }
+      if (request->hasParam("pidKd", true)) {
+        pidGains.kd = clampPidGain(request->getParam("pidKd", true)->value().toFloat(), PID_KD_MAX, pidGains.kd);
+        controlChanged = true;
+      }
+      if (request->hasParam("manualPowerMode", true)) {
+        String raw = request->getParam("manualPowerMode", true)->value();
+        raw.trim();
+        raw.toLowerCase();
+        if (raw == "watts") {
+          manualPowerMode = logic::ManualPowerMode::ConstantPower;
+        } else if (raw == "duty") {
+          manualPowerMode = logic::ManualPowerMode::Duty;
+        } else {
+          manualPowerMode = logic::clampManualPowerMode(static_cast<uint8_t>(raw.toInt()));
+        }
+        controlChanged = true;
+      }
+      if (request->hasParam("heaterOhm", true)) {
+        heaterElementOhm = clampHeaterElementOhm(request->getParam("heaterOhm", true)->value().toFloat());
+        controlChanged = true;
+      }
+
+      // Applied and persisted by loop(), which owns the battery state.
+      BatterySettingsChange batteryChanges[2];
+      const char *const cellParams[2] = {"batt1Cells", "batt2Cells"};
+      const char *const chemParams[2] = {"batt1Chem", "batt2Chem"};
+      for (uint8_t i = 0; i < 2; ++i) {
+        if (request->hasParam(cellParams[i], true)) {
+          batteryChanges[i].setCells = true;
+          batteryChanges[i].cells =
+              clampBatteryCellCount(static_cast<uint8_t>(request->getParam(cellParams[i], true)->value().toInt()));
+        }
+        if (request->hasParam(chemParams[i], true)) {
+          batteryChanges[i].setChemistry = true;
+          batteryChanges[i].chemistry =
+              clampBatteryChemistry(static_cast<uint8_t>(request->getParam(chemParams[i], true)->value().toInt()));
+        }
+        batteryChanged = batteryChanged || batteryChanges[i].setCells;
+        batteryChemChanged = batteryChemChanged || batteryChanges[i].setChemistry;
+        requestBatterySettingsChange(static_cast<uint8_t>(i + 1U), batteryChanges[i]);
+      }
     }
 
+    uint32_t persistFields = 0;
     if (tempChanged) {
-      saveTemperatureTargets();
-      pendingTempPersist = false;
+      persistFields |= PERSIST_TEMPERATURE_TARGETS;
     }
     if (swapChanged) {
-      saveSwapAssignment();
+      persistFields |= PERSIST_SWAP_ASSIGNMENT;
     }
     if (manualWindowChanged) {
-      saveManualToggleOffMs();
-    }
-    if (batteryChanged) {
-      saveBatteryCellCounts();
-    }
-    if (batteryChemChanged) {
-      saveBatteryChemistries();
-      battery1SocSmoothingInitialized = false;
-      battery2SocSmoothingInitialized = false;
+      persistFields |= PERSIST_MANUAL_TOGGLE;
     }
     if (apTimeoutChanged) {
-      saveApAutoOffMinutes();
+      persistFields |= PERSIST_AP_AUTO_OFF;
     }
     if (signalTimingChanged) {
-      saveSignalTimingPreset();
+      persistFields |= PERSIST_SIGNAL_TIMING;
+    }
+    if (controlChanged) {
+      persistFields |= PERSIST_CONTROL_SETTINGS;
     }
+    requestPersist(persistFields);
 
-    logf("HTTP /saveSettings | client=%s | temp=%d | swap=%d | manual_window=%d | battery=%d | battery_chem=%d | ap_timeout=%d | signal_timing=%d",
+    logf("HTTP /saveSettings | client=%s | temp=%d | swap=%d | manual_window=%d | battery=%d | battery_chem=%d | ap_timeout=%d | signal_timing=%d | control=%d",
          clientIpText(request).c_str(), tempChanged ? 1 : 0, swapChanged ? 1 : 0, manualWindowChanged ? 1 : 0,
-         batteryChanged ? 1 : 0, batteryChemChanged ? 1 : 0, apTimeoutChanged ? 1 : 0, signalTimingChanged ? 1 : 0);
+         batteryChanged ? 1 : 0, batteryChemChanged ? 1 : 0, apTimeoutChanged ? 1 : 0, signalTimingChanged ? 1 : 0,
+         controlChanged ? 1 : 0);
+    invalidateStatusDocument();
     request->send(200, "text/plain", "OK");
   });
 
 
-  server.on("/swapSensors", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/swapSensors", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/swapSensors", request);
       request->send(403, "text/plain", "Forbidden");
       return;
     }
-    swapAssignment = request->hasParam("swap", true);
-    saveSwapAssignment();
+    {
+      ControlInputsUpdate update;
+      swapAssignment = request->hasParam("swap", true);
+    }
+    requestPersist(PERSIST_SWAP_ASSIGNMENT);
     logf("HTTP /swapSensors | client=%s | swap=%d", clientIpText(request).c_str(), swapAssignment ? 1 : 0);
+    invalidateStatusDocument();
     request->redirect("/");
   });
 
-  server.on("/setWiFi", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/setWiFi", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/setWiFi", request);
       request->send(403, "text/plain", "Forbidden");
@@ -566,8 +929,7 @@ void setupWebServer() {
           newStaPassword = submittedStaPassword;
         }
       }
-      saveWiFiCredentials(newStaSsid, newStaPassword);
-      staChanged = true;
+      staChanged = assignWiFiCredentials(newStaSsid, newStaPassword);
     } else if (request->hasParam("ssid", true)) {
       // Backward compatibility for older web UIs.
       const String legacySsid = request->getParam("ssid", true)->value();
@@ -578,8 +940,7 @@ void setupWebServer() {
           legacyPassword = submittedLegacyPassword;
         }
       }
-      saveWiFiCredentials(legacySsid, legacyPassword);
-      staChanged = true;
+      staChanged = assignWiFiCredentials(legacySsid, legacyPassword);
     }
 
     if (request->hasParam("apSsid", true)) {
@@ -591,14 +952,14 @@ void setupWebServer() {
           newApPassword = submittedApPassword;
         }
       }
-      saveApCredentials(newApSsid, newApPassword);
-      apChanged = true;
+      apChanged = assignApCredentials(newApSsid, newApPassword);
     }
     if (request->hasParam("apTimeoutMin", true)) {
       const uint16_t value = static_cast<uint16_t>(request->getParam("apTimeoutMin", true)->value().toInt());
       apAutoOffMinutes = clampApAutoOffMinutes(value);
-      saveApAutoOffMinutes();
+      requestPersist(PERSIST_AP_AUTO_OFF);
     }
+    requestPersist((staChanged ? PERSIST_WIFI_CREDENTIALS : 0U) | (apChanged ? PERSIST_AP_CREDENTIALS : 0U));
     logf("HTTP /setWiFi | client=%s | sta_changed=%d | ap_changed=%d | sta_ssid=%s | ap_ssid=%s | ap_timeout_min=%u",
          clientIpText(request).c_str(), staChanged ? 1 : 0, apChanged ? 1 : 0, activeSsid.c_str(), activeApSsid.c_str(),
          static_cast<unsigned int>(apAutoOffMinutes));
@@ -606,7 +967,7 @@ void setupWebServer() {
     scheduleRestart(600);
   });
 
-  server.on("/restart", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/restart", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/restart", request);
       request->send(403, "text/plain", "Forbidden");
@@ -619,7 +980,7 @@ void setupWebServer() {
     scheduleRestart(600);
   });
 
-  server.on("/signalTest", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/signalTest", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/signalTest", request);
       request->send(403, "text/plain", "Forbidden");
@@ -630,29 +991,52 @@ void setupWebServer() {
     request->send(200, "text/plain", "OK");
   });
 
-  server.on("/logs", HTTP_GET, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/logs", HTTP_GET, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/logs", request);
       request->send(403, "text/plain", "Forbidden");
       return;
     }
-    request->send(200, "text/plain; charset=utf-8", String(serialLogBuffer));
+    // ?since=<seq> returns only lines from that sequence number on; X-Log-Next is the cursor for
+    // the following call and X-Log-First shows whether lines were dropped in between.
+    const bool hasSince = request->hasParam("since");
+    const uint32_t since =
+        hasSince ? static_cast<uint32_t>(strtoul(request->getParam("since")->value().c_str(), nullptr, 10)) : 0U;
+    lockLogBuffer();
+    uint32_t position = serialLog.positionOf(hasSince ? since : serialLog.firstSeq());
+    const uint32_t end = serialLog.endPosition();
+    const uint32_t firstSeq = serialLog.firstSeq();
+    const uint32_t nextSeq = serialLog.nextSeq();
+    unlockLogBuffer();
+
+    // Streams straight out of the ring; lines logged after this request are left for the next one.
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+        "text/plain; charset=utf-8", [position, end](uint8_t *buffer, size_t maxLen, size_t) mutable -> size_t {
+          lockLogBuffer();
+          const size_t copied = serialLog.read(position, end, reinterpret_cast<char *>(buffer), maxLen);
+          unlockLogBuffer();
+          return copied;
+        });
+    response->addHeader("X-Log-First", String(firstSeq));
+    response->addHeader("X-Log-Next", String(nextSeq));
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
   });
 
-  server.on("/resetRuntime", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/resetRuntime", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/resetRuntime", request);
       request->send(403, "text/plain", "Forbidden");
       return;
     }
-    savedRuntimeMinutes = 0;
-    writeRuntimeToEeprom(0);
-    startTimeMs = millis();
+    // Applied by loop(), which owns the runtime counter.
+    requestRuntimeReset();
     logf("HTTP /resetRuntime | client=%s", clientIpText(request).c_str());
+    invalidateStatusDocument();
     request->redirect("/");
   });
 
-  server.on("/resetOvertemp", HTTP_POST, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/resetOvertemp", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/resetOvertemp", request);
       request->send(403, "text/plain", "Forbidden");
@@ -660,63 +1044,34 @@ void setupWebServer() {
     }
     clearMosfetOvertempEvents();
     logf("HTTP /resetOvertemp | client=%s", clientIpText(request).c_str());
+    invalidateStatusDocument();
     request->send(200, "text/plain", "OK");
   });
 
-  server.on("/version.txt", HTTP_GET, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/version.txt", HTTP_GET, [](AsyncWebServerRequest *request) {
     if (!sendEmbeddedFile(request, "/version.txt")) {
       request->send(404, "text/plain", "Not found");
     }
   });
 
-  server.on("/update", HTTP_GET, [](AsyncWebServerRequest *request) {
+  fixedRoutes.on("/update", HTTP_GET, [](AsyncWebServerRequest *request) {
     if (!isAllowedWebClient(request)) {
       logDeniedRequest("/update:GET", request);
       request->send(403, "text/plain", "Forbidden");
       return;
     }
-    logf("HTTP /update:GET | client=%s", clientIpText(request).c_str());
-    String page;
-    page.reserve(6200);
-    page += F(
-        "<!DOCTYPE html><html lang='de'><head><meta charset='UTF-8'><meta name='viewport' content='width=device-width, initial-scale=1'>"
-        "<title>HeatControl OTA</title><style>"
-        ":root{--bg-0:#0f1419;--bg-1:#151c24;--panel-0:#1c252f;--panel-1:#26323e;--line:#3b4a59;--text:#eaf2f7;--muted:#9db0bf;--warm:#ffb65c;--shadow:rgba(0,0,0,.44)}"
-        "*{box-sizing:border-box}"
-        "body{margin:0;min-height:100vh;font-family:Bahnschrift,'Segoe UI',sans-serif;color:var(--text);background:radial-gradient(120% 90% at 0% 0%,rgba(94,199,255,.16),transparent 58%),radial-gradient(120% 110% at 100% 100%,rgba(255,182,92,.12),transparent 62%),repeating-linear-gradient(90deg,rgba(255,255,255,.03) 0 1px,transparent 1px 22px),linear-gradient(180deg,var(--bg-0),var(--bg-1));padding:14px}"
-        ".app{max-width:460px;margin:0 auto;display:grid;gap:12px}"
-        ".card{border:1px solid var(--line);border-radius:16px;background:linear-gradient(180deg,var(--panel-0),var(--panel-1));box-shadow:inset 0 1px 0 rgba(255,255,255,.08),0 10px 24px var(--shadow);padding:14px}"
-        ".logo-wrap{text-align:center;margin-bottom:8px}"
-        ".hero-logo{width:min(84%,320px);max-width:320px;height:auto;object-fit:contain;filter:drop-shadow(0 8px 16px rgba(0,0,0,.38))}"
-        ".title{margin:0 0 8px;text-transform:uppercase;letter-spacing:.06em;font-size:.74rem;color:#d1dbe3;font-weight:700}"
-        ".hint{border:1px dashed #566777;border-radius:9px;background:#1a232b;color:#c2cdd6;padding:8px;font-size:.74rem;line-height:1.35;margin:0 0 10px}"
-        ".file-picker{position:relative;display:block;width:100%;border:1px solid #566777;border-radius:12px;background:#1a232b;color:#e3eaf0;padding:14px;text-align:center;cursor:pointer}"
-        ".file-picker strong{display:block;font-size:.86rem;margin-bottom:4px}"
-        ".file-picker span{display:block;font-size:.72rem;color:var(--muted)}"
-        ".file-picker input{position:absolute;inset:0;border:0;opacity:0;width:100%;height:100%;cursor:pointer}"
-        ".file-name{margin-top:6px;text-align:center;font-size:.72rem;color:var(--muted)}"
-        ".actions{display:grid;grid-template-columns:repeat(auto-fit,minmax(140px,1fr));gap:8px;margin-top:10px}"
-        ".btn,.btn-link{border:1px solid #5d6f81;border-radius:10px;background:linear-gradient(180deg,#394450,#2b333d);color:var(--text);font-size:.8rem;padding:10px;min-height:40px;text-decoration:none;display:inline-flex;align-items:center;justify-content:center;cursor:pointer}"
-        ".btn-primary{border-color:rgba(255,182,92,.68);background:linear-gradient(180deg,rgba(255,182,92,.28),rgba(146,87,42,.56));color:#ffe7c7;font-weight:700}"
-        ".note{margin-top:10px;color:var(--muted);font-size:.73rem;line-height:1.35}"
-        "</style></head><body><main class='app'><section class='card'><div class='logo-wrap'><img class='hero-logo' src='/LOGO.png' alt='HeatControl Logo'></div>"
-        "<div class='title'>Firmware Update (OTA)</div>"
-        "<p class='hint'>Waehle eine passende <b>firmware.bin</b> aus einem HeatControl-Release und starte danach das Flashen.</p>"
-        "<form method='POST' action='/update' enctype='multipart/form-data'>"
-        "<label class='file-picker'>"
-        "<strong>Datei auswaehlen</strong>"
-        "<span>Firmware (.bin) aus dem aktuellen Release</span>"
-        "<input type='file' id='firmwareFileInput' name='firmware' accept='.bin' required>"
-        "</label>"
-        "<p class='file-name' id='firmwareFileName'>Keine Datei ausgewaehlt.</p>"
-        "<div class='actions'><button class='btn btn-primary' type='submit'>Upload und Flashen</button><a class='btn-link' href='/'>Zurueck zur Konsole</a>"
-        "<a class='btn-link' href='https://github.com/BubTec/HeatControl/releases/latest' target='_blank' rel='noopener'>Neueste Version (GitHub)</a></div>"
-        "</form>"
-        "<div class='note'>Wichtig: Versorgung waehrend des Updates nicht unterbrechen. Das Geraet startet danach automatisch neu.</div>"
-        "</section></main><script>document.addEventListener('DOMContentLoaded',function(){var input=document.getElementById('firmwareFileInput');var nameEl=document.getElementById('firmwareFileName');if(!input||!nameEl){return;}var updateName=function(){if(input.files&&input.files.length){nameEl.textContent=input.files[0].name;}else{nameEl.textContent='Keine Datei ausgewaehlt.';}};input.addEventListener('change',updateName);});</script></body></html>");
-    request->send(200, "text/html", page);
+    // Straight from flash (gzip, ETag); nothing here touches the heap beyond the response object.
+    const IPAddress ip = request->client()->remoteIP();
+    logf("HTTP /update:GET | client=%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    if (!sendEmbeddedFile(request, "/update.html")) {
+      request->send(500, "text/plain", "OTA page not available (missing embedded /update.html).");
+    }
   });
 
+  // Clients pass the upload size and, when they can compute it, its SHA-256 in the query string:
+  // POST /update?size=<bytes>&sha256=<hex>. Both are optional; without them a raw image is only
+  // checked by Update itself (a compressed one carries the image digest in its header). Progress and
+  // throughput are served by /ota/status.
   server.on(
       "/update", HTTP_POST,
       [](AsyncWebServerRequest *request) {
@@ -725,28 +1080,29 @@ void setupWebServer() {
           request->send(403, "text/plain", "Forbidden");
           return;
         }
-        if (!otaUploadStarted) {
+        if (request != otaUploadOwner) {
           logf("OTA finalize rejected | client=%s | reason=no_upload", clientIpText(request).c_str());
           request->send(400, "text/plain", "No upload received.");
           return;
         }
-
-        if (!otaUploadOk) {
-          const String msg = otaUploadMessage.isEmpty() ? String("Update failed.") : otaUploadMessage;
-          logf("OTA finalize failed | client=%s | bytes=%u | msg=%s", clientIpText(request).c_str(),
-               static_cast<unsigned int>(otaUploadBytes), msg.c_str());
-          otaUploadStarted = false;
-          otaUploadOk = false;
-          otaUploadMessage = "";
-          request->send(500, "text/plain", msg);
+        otaUploadOwner = nullptr;
+
+        logic::OtaProgress progress = otaUploadProgress();
+        if (progress.state != logic::OtaState::Succeeded) {
+          otaFailUpload("Upload ended without a final chunk.");
+          progress = otaUploadProgress();
+          char message[128];
+          snprintf(message, sizeof(message), "Update failed: %s (error %d)", progress.message, progress.sinkError);
+          logf("OTA finalize failed | client=%s | bytes=%lu | msg=%s", clientIpText(request).c_str(),
+               static_cast<unsigned long>(progress.receivedBytes), message);
+          request->send(500, "text/plain", message);
           return;
         }
 
-        otaUploadStarted = false;
-        otaUploadOk = false;
-        otaUploadMessage = "";
-        logf("OTA finalize success | client=%s | bytes=%u", clientIpText(request).c_str(),
-             static_cast<unsigned int>(otaUploadBytes));
+        logf("OTA finalize success | client=%s | bytes=%lu | bytes_per_s=%lu | chunk_max_us=%lu | sha256=%s",
+             clientIpText(request).c_str(), static_cast<unsigned long>(progress.receivedBytes),
+             static_cast<unsigned long>(progress.bytesPerSecond), static_cast<unsigned long>(progress.chunkMaxUs),
+             progress.checksumVerified ? "verified" : "not_supplied");
         request->send(200, "text/plain", "Update successful. Device will reboot.");
         scheduleRestart(1200);
       },
@@ -758,72 +1114,105 @@ void setupWebServer() {
           return;
         }
         if (index == 0) {
-          otaUploadStarted = true;
-          otaUploadOk = false;
-          otaUploadMessage = "";
-          otaUploadBytes = 0;
+          if (otaUploadOwner != nullptr && otaUploadOwner != request &&
+              otaUploadProgress().state == logic::OtaState::Receiving && !otaUploadStalled()) {
+            logf("OTA upload rejected | client=%s | reason=busy", clientIpText(request).c_str());
+            return;
+          }
+          otaUploadOwner = request;
+          // The request is freed right after this; a client gone mid-upload must not leave it as owner.
+          request->onDisconnect([request]() {
+            if (otaUploadOwner != request) {
+              return;
+            }
+            otaUploadOwner = nullptr;
+            otaFailUpload("Client disconnected.");
+          });
           logf("OTA upload started | client=%s | file=%s", clientIpText(request).c_str(), filename.c_str());
 
-          if (!filename.endsWith(".bin")) {
-            otaUploadMessage = "Only .bin firmware files are accepted.";
+          // .bin.hs: heatshrink-compressed image from tools/release/compress_firmware.py.
+          if (!filename.endsWith(".bin") && !filename.endsWith(".bin.hs")) {
+            otaRejectUpload("Only .bin or .bin.hs firmware files are accepted.");
             logf("OTA upload rejected | client=%s | reason=invalid_extension", clientIpText(request).c_str());
             return;
           }
 
-          if (!Update.begin(UPDATE_SIZE_UNKNOWN, U_FLASH)) {
-            otaUploadMessage = "Update begin failed. Error code: " + String(Update.getError());
-            logf("OTA upload begin failed | client=%s | err=%d", clientIpText(request).c_str(), Update.getError());
+          const uint32_t declaredBytes =
+              request->hasParam("size")
+                  ? static_cast<uint32_t>(strtoul(request->getParam("size")->value().c_str(), nullptr, 10))
+                  : 0U;
+          const char *sha256Hex = request->hasParam("sha256") ? request->getParam("sha256")->value().c_str() : nullptr;
+          if (!otaBeginUpload(declaredBytes, sha256Hex)) {
+            const logic::OtaProgress progress = otaUploadProgress();
+            logf("OTA upload begin failed | client=%s | size=%lu | msg=%s | err=%d", clientIpText(request).c_str(),
+                 static_cast<unsigned long>(declaredBytes), progress.message, progress.sinkError);
             return;
           }
         }
-
-        if (!otaUploadMessage.isEmpty()) {
+        if (request != otaUploadOwner || otaUploadProgress().state != logic::OtaState::Receiving) {
           return;
         }
 
-        const size_t written = Update.write(data, len);
-        if (written != len) {
-          otaUploadMessage = "Write failed. Error code: " + String(Update.getError());
-          logf("OTA write failed | client=%s | err=%d", clientIpText(request).c_str(), Update.getError());
+        if (!otaWriteUpload(data, len)) {
+          const logic::OtaProgress progress = otaUploadProgress();
+          logf("OTA write failed | client=%s | bytes=%lu | msg=%s | err=%d", clientIpText(request).c_str(),
+               static_cast<unsigned long>(progress.receivedBytes), progress.message, progress.sinkError);
           return;
         }
-        otaUploadBytes += written;
-
-        if (final) {
-          constexpr size_t kMinFirmwareBytes = 100U * 1024U;
-          if (otaUploadBytes < kMinFirmwareBytes) {
-            Update.abort();
-            otaUploadMessage = "Firmware image too small (" + String(otaUploadBytes) + " bytes). Aborting update.";
-            logf("OTA upload aborted | client=%s | reason=image_too_small | bytes=%u", clientIpText(request).c_str(),
-                 static_cast<unsigned int>(otaUploadBytes));
-            return;
-          }
-          if (!Update.end(true)) {
-            otaUploadMessage = "Finalize failed. Error code: " + String(Update.getError());
-            logf("OTA finalize write phase failed | client=%s | err=%d", clientIpText(request).c_str(), Update.getError());
-            return;
-          }
-          otaUploadOk = true;
-          otaUploadMessage = "OK";
+        if (final && !otaFinishUpload()) {
+          const logic::OtaProgress progress = otaUploadProgress();
+          logf("OTA upload aborted | client=%s | bytes=%lu | msg=%s | err=%d", clientIpText(request).c_str(),
+               static_cast<unsigned long>(progress.receivedBytes), progress.message, progress.sinkError);
         }
       });
 
+  fixedRoutes.on("/ota/status", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (!isAllowedWebClient(request)) {
+      logDeniedRequest("/ota/status", request);
+      request->send(403, "text/plain", "Forbidden");
+      return;
+    }
+    char json[448];
+    renderOtaStatusJson(json, sizeof(json));
+    AsyncWebServerResponse *response = request->beginResponse(200, "application/json", json);
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+  });
+
+  fixedRoutes.on("/storage/status", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (!isAllowedWebClient(request)) {
+      logDeniedRequest("/storage/status", request);
+      request->send(403, "text/plain", "Forbidden");
+      return;
+    }
+    char json[384];
+    renderSettingsStoreJson(json, sizeof(json));
+    AsyncWebServerResponse *response = request->beginResponse(200, "application/json", json);
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+  });
+
   // Known captive portal probes (Android / iOS / Windows): always redirect to portal root.
-  server.on("/generate_204", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
-  server.on("/gen_204", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
-  server.on("/hotspot-detect.html", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
-  server.on("/library/test/success.html", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
-  server.on("/success.txt", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
-  server.on("/ncsi.txt", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
-  server.on("/connecttest.txt", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
-  server.on("/connecttest.txt.gz", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
-  server.on("/connecttest.txt/index.htm", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
-  server.on("/connecttest.txt/index.htm.gz", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
-  server.on("/redirect", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
-  server.on("/fwlink", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
+  fixedRoutes.on("/generate_204", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
+  fixedRoutes.on("/gen_204", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
+  fixedRoutes.on("/hotspot-detect.html", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
+  fixedRoutes.on("/library/test/success.html", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
+  fixedRoutes.on("/success.txt", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
+  fixedRoutes.on("/ncsi.txt", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
+  fixedRoutes.on("/connecttest.txt", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
+  fixedRoutes.on("/connecttest.txt.gz", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
+  fixedRoutes.on("/connecttest.txt/index.htm", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
+  fixedRoutes.on("/connecttest.txt/index.htm.gz", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
+  fixedRoutes.on("/redirect", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
+  fixedRoutes.on("/fwlink", HTTP_ANY, [](AsyncWebServerRequest *request) { sendCaptiveRedirect(request); });
+
+  if (!fixedRoutes.build()) {
+    logf(LogLevel::Error, "Route table has duplicate paths; fixed routes disabled");
+  }
+  server.addHandler(&fixedRoutes);
 
   server.onNotFound([](AsyncWebServerRequest *request) {
-    if (sendEmbeddedFile(request, request->url())) {
+    if (sendEmbeddedFile(request, request->url().c_str(), request->url().length())) {
       return;
     }
 
@@ -851,4 +1240,68 @@ void setupWebServer() {
   logf("HTTP server started | ap_enabled=%d | fs_ready=%d", apEnabled ? 1 : 0, fileSystemReady ? 1 : 0);
 }
 
+void serviceOtaUpload(unsigned long now) {
+  static unsigned long lastCheckMs = 0;
+  if ((now - lastCheckMs) < 1000UL) {
+    return;
+  }
+  lastCheckMs = now;
+  if (otaAbortStalledUpload()) {
+    logf(LogLevel::Error, "OTA upload stalled, aborted | bytes=%lu",
+         static_cast<unsigned long>(otaUploadProgress().receivedBytes));
+  }
+}
+
+void serviceStatusPush(unsigned long now) {
+  static unsigned long lastCleanupMs = 0;
+  if ((now - lastCleanupMs) >= 1000UL) {
+    lastCleanupMs = now;
+    statusSocket.cleanupClients(kStatusPushMaxClients);
+  }
+  if (statusSocket.count() == 0U) {
+    return;
+  }
+
+  StatusMetrics metrics;
+  bool metricsFilled = false;
+  for (uint8_t i = 0; i < kStatusPushMaxClients; ++i) {
+    lockStatusSubscribers();
+    const StatusSubscriber subscriber = statusSubscribers[i];
+    unlockStatusSubscribers();
+    if (subscriber.clientId == 0U) {
+      continue;
+    }
+    const bool due = !subscriber.digest.primed || (now - subscriber.lastPushMs) >= subscriber.intervalMs;
+    // A client that has not drained its queue gets the accumulated changes on a later pass.
+    if (!due || !statusSocket.availableForWrite(subscriber.clientId)) {
+      continue;
+    }
+    if (!metricsFilled) {
+      fillStatusMetrics(metrics);
+      metricsFilled = true;
+    }
+
+    StatusFieldDigest digest = subscriber.digest;
+    uint8_t changedFields = 0;
+    const size_t length =
+        writeStatusJsonDelta(metrics, digest, statusPushBuffer, sizeof(statusPushBuffer), &changedFields);
+    if (length == 0U) {
+      logf(LogLevel::Error, "Status push document too large | capacity=%u", static_cast<unsigned>(sizeof(statusPushBuffer)));
+      continue;
+    }
+    const bool sent = changedFields == 0U || statusSocket.text(subscriber.clientId, statusPushBuffer, length);
+
+    lockStatusSubscribers();
+    StatusSubscriber &slot = statusSubscribers[i];
+    // The client may have gone away or asked for a full document while this was being sent.
+    if (slot.clientId == subscriber.clientId) {
+      slot.lastPushMs = now;
+      if (sent && slot.digest.primed == subscriber.digest.primed) {
+        slot.digest = digest;
+      }
+    }
+    unlockStatusSubscribers();
+  }
+}
+
 }  // namespace HeatControl
@@ -3,5 +3,9 @@
 namespace HeatControl {
 
 void setupWebServer();
+// Sends due status updates to /ws subscribers; called from loop().
+void serviceStatusPush(unsigned long now);
+// Aborts a firmware upload whose client stopped sending; called from loop().
+void serviceOtaUpload(unsigned long now);
 
 }  // namespace HeatControl
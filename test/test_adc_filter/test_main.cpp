@@ -0,0 +1,116 @@
+#include <chrono>
+#include <cstdio>
+
+#include <unity.h>
+
+#include "adc_filter.h"
+
+using namespace HeatControl::logic;
+
+void setUp() {}
+void tearDown() {}
+
+void test_oversampling_averages_blocks() {
+  AdcFilter filter(AdcFilterConfig{4, 1, 0});
+  TEST_ASSERT_FALSE(filter.push(1000));
+  TEST_ASSERT_FALSE(filter.push(1002));
+  TEST_ASSERT_FALSE(filter.push(1004));
+  TEST_ASSERT_EQUAL_UINT32(0, filter.steps());
+  TEST_ASSERT_TRUE(filter.push(1006));
+  TEST_ASSERT_EQUAL_UINT32(1, filter.steps());
+  TEST_ASSERT_EQUAL_UINT16(1003, filter.output());
+
+  for (int i = 0; i < 4; ++i) {
+    filter.push(2000);
+  }
+  TEST_ASSERT_EQUAL_UINT16(2000, filter.output());
+}
+
+void test_median_drops_single_spikes() {
+  AdcFilter filter(AdcFilterConfig{1, 5, 0});
+  const uint16_t samples[] = {1200, 1201, 3300, 1199, 1200, 0, 1202, 1201};
+  for (uint16_t sample : samples) {
+    filter.push(sample);
+    if (filter.steps() >= 3U) {
+      TEST_ASSERT_UINT32_WITHIN(3, 1200, filter.output());
+    }
+  }
+}
+
+void test_iir_step_response_settles() {
+  AdcFilter filter(AdcFilterConfig{1, 1, 3});
+  filter.push(0);
+  TEST_ASSERT_EQUAL_UINT16(0, filter.output());
+
+  filter.push(800);
+  TEST_ASSERT_EQUAL_UINT16(100, filter.output());
+  uint16_t previous = filter.output();
+  for (int i = 0; i < 80; ++i) {
+    filter.push(800);
+    TEST_ASSERT_TRUE(filter.output() >= previous);
+    previous = filter.output();
+  }
+  TEST_ASSERT_EQUAL_UINT16(800, filter.output());
+
+  // First step seeds the state, so a freshly reset filter starts at the input instead of 0.
+  filter.reset();
+  filter.push(2500);
+  TEST_ASSERT_EQUAL_UINT16(2500, filter.output());
+}
+
+void test_config_is_clamped() {
+  AdcFilter filter(AdcFilterConfig{0, 4, 20});
+  const AdcFilterConfig config = filter.config();
+  TEST_ASSERT_EQUAL_UINT8(1, config.oversample);
+  TEST_ASSERT_EQUAL_UINT8(5, config.medianWindow);
+  TEST_ASSERT_EQUAL_UINT8(ADC_FILTER_MAX_IIR_SHIFT, config.iirShift);
+
+  AdcFilter wide(AdcFilterConfig{200, 15, 0});
+  TEST_ASSERT_EQUAL_UINT8(ADC_FILTER_MAX_OVERSAMPLE, wide.config().oversample);
+  TEST_ASSERT_EQUAL_UINT8(ADC_FILTER_MAX_MEDIAN, wide.config().medianWindow);
+}
+
+void test_full_chain_tracks_noisy_input() {
+  AdcFilter filter(AdcFilterConfig{16, 5, 2});
+  uint32_t noise = 12345U;
+  for (int i = 0; i < 16 * 40; ++i) {
+    noise = noise * 1103515245U + 12345U;
+    // +-40 counts of noise plus a switching spike every 97 samples.
+    uint16_t sample = static_cast<uint16_t>(1500 + static_cast<int>((noise >> 16) % 81U) - 40);
+    if (i % 97 == 0) {
+      sample = 4095;
+    }
+    filter.push(sample);
+  }
+  TEST_ASSERT_EQUAL_UINT32(40, filter.steps());
+  TEST_ASSERT_UINT32_WITHIN(12, 1500, filter.output());
+}
+
+void test_filter_benchmark() {
+  AdcFilter filter(AdcFilterConfig{16, 5, 3});
+  constexpr uint32_t samples = 20U * 1000U * 1000U;
+  uint32_t noise = 1U;
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < samples; ++i) {
+    noise = noise * 1664525U + 1013904223U;
+    filter.push(static_cast<uint16_t>(noise >> 20));
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  TEST_ASSERT_EQUAL_UINT32(samples / 16U, filter.steps());
+
+  char message[128];
+  snprintf(message, sizeof(message), "adc filter (x16, median 5, iir 1/8): %.2f ns/sample, output %u",
+           seconds * 1e9 / samples, static_cast<unsigned>(filter.output()));
+  TEST_MESSAGE(message);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_oversampling_averages_blocks);
+  RUN_TEST(test_median_drops_single_spikes);
+  RUN_TEST(test_iir_step_response_settles);
+  RUN_TEST(test_config_is_clamped);
+  RUN_TEST(test_full_chain_tracks_noisy_input);
+  RUN_TEST(test_filter_benchmark);
+  return UNITY_END();
+}
@@ -1,5 +1,6 @@
-#include <map>
-#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 
 #include <unity.h>
 
@@ -10,44 +11,94 @@ extern "C" void tearDown(void) {}
 
 namespace {
 
-class MockGpio : public HeatControl::logic::IGpio {
+// Models DS18B20 bus timing on a virtual clock: reading a scratchpad before the conversion has
+// finished would force the caller to wait for the remainder, which is accounted in blockedMs.
+class TimedMockSensors : public HeatControl::logic::ITemperatureSensors {
  public:
-  void writePin(int pin, int level) override {
-    pinLevels[pin] = level;
-    writes.push_back({pin, level});
+  void requestTemperatures() override {
+    requestCount++;
+    conversionDoneAtMs = nowMs + conversionMs;
   }
 
-  int readPin(int pin) const override {
-    auto it = pinLevels.find(pin);
-    if (it == pinLevels.end()) {
-      return HeatControl::logic::PIN_HIGH;
+  float getTempCByIndex(int index) override {
+    readCount++;
+    if (nowMs < conversionDoneAtMs) {
+      blockedMs += conversionDoneAtMs - nowMs;
+      nowMs = conversionDoneAtMs;
     }
-    return it->second;
+    return index == 0 ? temp0 : temp1;
   }
 
-  std::map<int, int> pinLevels;
-  struct PinWrite {
-    int pin;
-    int level;
-  };
-  std::vector<PinWrite> writes;
+  unsigned long nowMs = 0;
+  unsigned long conversionMs = 750;
+  unsigned long conversionDoneAtMs = 0;
+  unsigned long blockedMs = 0;
+  int requestCount = 0;
+  int readCount = 0;
+  float temp0 = 21.5F;
+  float temp1 = 22.5F;
 };
 
-class MockSensors : public HeatControl::logic::ITemperatureSensors {
- public:
-  void requestTemperatures() override { requestCount++; }
-
-  float getTempCByIndex(int index) override {
-    if (index == 0) return temp0;
-    if (index == 1) return temp1;
-    return -127.0F;
+// First-order model of a heated suit layer in cold water, read through a lagging DS18B20
+// (12-bit quantisation). Duty is applied as average power over each 1 s control step.
+struct ThermalPlant {
+  float ambientC = 10.0F;
+  float heaterW = 10.0F;
+  float riseAtFullPowerC = 35.0F;
+  float tauS = 120.0F;
+  float sensorTauS = 20.0F;
+  float tempC = 10.0F;
+  float sensorC = 10.0F;
+
+  void step(float duty, float dtS) {
+    const int substeps = 10;
+    const float h = dtS / substeps;
+    for (int i = 0; i < substeps; ++i) {
+      const float equilibriumC = ambientC + riseAtFullPowerC * duty;
+      tempC += (equilibriumC - tempC) * h / tauS;
+      sensorC += (tempC - sensorC) * h / sensorTauS;
+    }
   }
 
-  int requestCount = 0;
-  float temp0 = 20.0F;
-  float temp1 = 20.0F;
+  float reading() const { return std::floor(sensorC * 16.0F) / 16.0F; }
+};
+
+struct ClosedLoopResult {
+  float overshootC;
+  float holdErrorC;       // Mean absolute error of the plant while holding.
+  float whPerDegreeHour;  // Energy while holding per degC of target rise and hour.
+  int dutyChanges;
 };
 
+ClosedLoopResult runClosedLoop(HeatControl::logic::ControlMode mode, float targetC) {
+  const int warmupS = 1800;
+  const int holdS = 3600;
+  ThermalPlant plant;
+  HeatControl::logic::PidController pid;
+  ClosedLoopResult result = {0.0F, 0.0F, 0.0F, 0};
+  float holdEnergyWs = 0.0F;
+  uint16_t lastDuty = 0;
+  for (int t = 0; t < warmupS + holdS; ++t) {
+    const uint16_t duty = HeatControl::logic::temperatureDutyPermille(mode, pid, false, plant.reading(), targetC, 1.0F);
+    const float dutyFraction = static_cast<float>(duty) / HeatControl::logic::HEATER_DUTY_MAX;
+    plant.step(dutyFraction, 1.0F);
+    if (plant.tempC - targetC > result.overshootC) {
+      result.overshootC = plant.tempC - targetC;
+    }
+    if (t >= warmupS) {
+      holdEnergyWs += plant.heaterW * dutyFraction;
+      result.holdErrorC += std::fabs(plant.tempC - targetC);
+      if (duty != lastDuty) {
+        result.dutyChanges++;
+      }
+    }
+    lastDuty = duty;
+  }
+  result.holdErrorC /= holdS;
+  result.whPerDegreeHour = (holdEnergyWs / 3600.0F) / ((targetC - plant.ambientC) * (holdS / 3600.0F));
+  return result;
+}
+
 void test_should_turn_on_when_force_on() {
   TEST_ASSERT_TRUE(HeatControl::logic::shouldHeaterBeOn(true, 100.0F, 10.0F));
 }
@@ -73,141 +124,219 @@ void test_should_turn_on_based_on_temperature_delta() {
   TEST_ASSERT_FALSE(HeatControl::logic::shouldHeaterBeOn(false, 25.0F, 23.0F));
 }
 
-void test_control_heater_sets_active_high_output() {
-  MockGpio gpio;
-  HeatControl::logic::controlHeater(gpio, 4, false, 20.0F, 23.0F);
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_HIGH, gpio.readPin(4));
-
-  HeatControl::logic::controlHeater(gpio, 4, false, 24.0F, 23.0F);
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_LOW, gpio.readPin(4));
+void test_heater_state_text_from_level() {
+  TEST_ASSERT_EQUAL_STRING("ON", HeatControl::logic::heaterStateTextFromLevel(HeatControl::logic::PIN_HIGH));
+  TEST_ASSERT_EQUAL_STRING("OFF", HeatControl::logic::heaterStateTextFromLevel(HeatControl::logic::PIN_LOW));
 }
 
-void test_update_sensors_and_heaters_without_swap() {
-  MockGpio gpio;
-  MockSensors sensors;
-  sensors.temp0 = 21.0F;
-  sensors.temp1 = 26.0F;
-
-  float current0 = 0.0F;
-  float current1 = 0.0F;
-
-  HeatControl::logic::updateSensorsAndHeaters(sensors, gpio, false, false, 25, 25, true, true, false, 23.0F, 23.0F,
-                                              current0, current1, 4, 5, 0);
+void test_pipeline_hands_over_readings_on_later_tick() {
+  TimedMockSensors sensors;
+  HeatControl::logic::TemperatureConversionPipeline pipeline(750);
+  float temp1 = -127.0F;
+  float temp2 = -127.0F;
 
+  TEST_ASSERT_FALSE(pipeline.update(sensors, 0, temp1, temp2));
+  TEST_ASSERT_TRUE(pipeline.conversionPending());
   TEST_ASSERT_EQUAL_INT(1, sensors.requestCount);
-  TEST_ASSERT_EQUAL_FLOAT(21.0F, current0);
-  TEST_ASSERT_EQUAL_FLOAT(26.0F, current1);
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_HIGH, gpio.readPin(4));
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_LOW, gpio.readPin(5));
+  TEST_ASSERT_EQUAL_INT(0, sensors.readCount);
+  TEST_ASSERT_EQUAL_FLOAT(-127.0F, temp1);
+
+  sensors.nowMs = 500;
+  TEST_ASSERT_FALSE(pipeline.update(sensors, 500, temp1, temp2));
+  TEST_ASSERT_EQUAL_INT(0, sensors.readCount);
+
+  sensors.nowMs = 1000;
+  TEST_ASSERT_TRUE(pipeline.update(sensors, 1000, temp1, temp2));
+  TEST_ASSERT_EQUAL_FLOAT(21.5F, temp1);
+  TEST_ASSERT_EQUAL_FLOAT(22.5F, temp2);
+  TEST_ASSERT_EQUAL_INT(2, sensors.requestCount);  // Next conversion started immediately.
+  TEST_ASSERT_EQUAL_UINT32(0U, sensors.blockedMs);
 }
 
-void test_update_sensors_and_heaters_power_mode_forces_on() {
-  MockGpio gpio;
-  MockSensors sensors;
-  sensors.temp0 = 35.0F;
-  sensors.temp1 = 36.0F;
-
-  float current0 = 0.0F;
-  float current1 = 0.0F;
+void test_pipeline_full_cycles_never_block_the_loop() {
+  TimedMockSensors sensors;
+  HeatControl::logic::TemperatureConversionPipeline pipeline(750);
+  float temp1 = -127.0F;
+  float temp2 = -127.0F;
+  int handovers = 0;
+
+  constexpr int kTicks = 600;
+  const auto start = std::chrono::steady_clock::now();
+  for (int tick = 0; tick < kTicks; ++tick) {
+    sensors.nowMs = static_cast<unsigned long>(tick) * 1000UL;
+    if (pipeline.update(sensors, sensors.nowMs, temp1, temp2)) {
+      ++handovers;
+    }
+  }
+  const auto elapsedUs =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
 
-  HeatControl::logic::updateSensorsAndHeaters(sensors, gpio, true, false, 0, 0, true, true, false, 20.0F, 20.0F,
-                                              current0, current1, 6, 7, 0);
+  TEST_ASSERT_EQUAL_INT(kTicks - 1, handovers);
+  TEST_ASSERT_EQUAL_UINT32(0U, sensors.blockedMs);
 
-  TEST_ASSERT_EQUAL_INT(1, sensors.requestCount);
-  TEST_ASSERT_EQUAL_FLOAT(35.0F, current0);
-  TEST_ASSERT_EQUAL_FLOAT(36.0F, current1);
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_HIGH, gpio.readPin(6));
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_HIGH, gpio.readPin(7));
-  TEST_ASSERT_EQUAL_UINT32(2U, gpio.writes.size());
+  char message[96];
+  snprintf(message, sizeof(message), "pipeline: %.3f us/tick host time, 0 ms bus wait per cycle",
+           static_cast<double>(elapsedUs) / kTicks);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(elapsedUs < static_cast<long long>(kTicks) * 50LL);
 }
 
-void test_update_sensors_and_heaters_with_swap() {
-  MockGpio gpio;
-  MockSensors sensors;
-  sensors.temp0 = 26.0F;
-  sensors.temp1 = 21.0F;
-
-  float current0 = 0.0F;
-  float current1 = 0.0F;
-
-  HeatControl::logic::updateSensorsAndHeaters(sensors, gpio, false, false, 25, 25, true, true, true, 23.0F, 23.0F,
-                                              current0, current1, 4, 5, 0);
-
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_HIGH, gpio.readPin(4));
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_LOW, gpio.readPin(5));
+void test_pipeline_respects_conversion_time_change() {
+  TimedMockSensors sensors;
+  sensors.conversionMs = 94;  // 9-bit resolution.
+  HeatControl::logic::TemperatureConversionPipeline pipeline(750);
+  pipeline.setConversionMs(94);
+  float temp1 = 0.0F;
+  float temp2 = 0.0F;
+
+  pipeline.update(sensors, 0, temp1, temp2);
+  sensors.nowMs = 93;
+  TEST_ASSERT_FALSE(pipeline.update(sensors, 93, temp1, temp2));
+  sensors.nowMs = 94;
+  TEST_ASSERT_TRUE(pipeline.update(sensors, 94, temp1, temp2));
+  TEST_ASSERT_EQUAL_UINT32(0U, sensors.blockedMs);
 }
 
-void test_update_sensors_and_heaters_with_swap_and_distinct_targets() {
-  MockGpio gpio;
-  MockSensors sensors;
-  sensors.temp0 = 26.0F;
-  sensors.temp1 = 21.0F;
-
-  float current0 = 0.0F;
-  float current1 = 0.0F;
-
-  HeatControl::logic::updateSensorsAndHeaters(sensors, gpio, false, false, 25, 25, true, true, true, 25.0F, 22.0F,
-                                              current0, current1, 8, 9, 0);
-
-  TEST_ASSERT_EQUAL_FLOAT(26.0F, current0);
-  TEST_ASSERT_EQUAL_FLOAT(21.0F, current1);
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_HIGH, gpio.readPin(8));
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_LOW, gpio.readPin(9));
+void test_pid_output_is_proportional_and_clamped() {
+  HeatControl::logic::PidController pid({0.1F, 0.0F, 0.0F});
+  TEST_ASSERT_EQUAL_UINT16(500, pid.update(30.0F, 25.0F, 1.0F));
+  TEST_ASSERT_EQUAL_UINT16(1000, pid.update(30.0F, 10.0F, 1.0F));
+  TEST_ASSERT_EQUAL_UINT16(0, pid.update(30.0F, 35.0F, 1.0F));
+  TEST_ASSERT_EQUAL_UINT16(0, pid.update(30.0F, -127.0F, 1.0F));
 }
 
-void test_heater_state_text_from_level() {
-  TEST_ASSERT_EQUAL_STRING("ON", HeatControl::logic::heaterStateTextFromLevel(HeatControl::logic::PIN_HIGH));
-  TEST_ASSERT_EQUAL_STRING("OFF", HeatControl::logic::heaterStateTextFromLevel(HeatControl::logic::PIN_LOW));
+void test_pid_integrator_does_not_wind_up_while_saturated() {
+  HeatControl::logic::PidController pid({0.1F, 0.01F, 0.0F});
+  // 20 minutes far below target: output saturated the whole time.
+  for (int i = 0; i < 1200; ++i) {
+    TEST_ASSERT_EQUAL_UINT16(1000, pid.update(30.0F, 10.0F, 1.0F));
+  }
+  TEST_ASSERT_TRUE(pid.integralTerm() < 0.01F);
+  // At the setpoint the output drops straight away instead of unwinding a huge integral.
+  TEST_ASSERT_LESS_THAN_UINT16(100, pid.update(30.0F, 30.0F, 1.0F));
 }
 
-void test_manual_pwm_decision() {
-  TEST_ASSERT_FALSE(HeatControl::logic::shouldManualHeaterBeOn(0, 0));
-  TEST_ASSERT_FALSE(HeatControl::logic::shouldManualHeaterBeOn(24, 500));
-  TEST_ASSERT_TRUE(HeatControl::logic::shouldManualHeaterBeOn(25, 0));
-  TEST_ASSERT_TRUE(HeatControl::logic::shouldManualHeaterBeOn(25, 249));
-  TEST_ASSERT_FALSE(HeatControl::logic::shouldManualHeaterBeOn(25, 250));
-
-  TEST_ASSERT_TRUE(HeatControl::logic::shouldManualHeaterBeOn(50, 499));
-  TEST_ASSERT_FALSE(HeatControl::logic::shouldManualHeaterBeOn(50, 500));
-  TEST_ASSERT_TRUE(HeatControl::logic::shouldManualHeaterBeOn(50, 1499));
-  TEST_ASSERT_FALSE(HeatControl::logic::shouldManualHeaterBeOn(50, 1500));
-
-  TEST_ASSERT_TRUE(HeatControl::logic::shouldManualHeaterBeOn(75, 749));
-  TEST_ASSERT_FALSE(HeatControl::logic::shouldManualHeaterBeOn(75, 750));
+void test_pid_zero_dt_does_not_integrate() {
+  HeatControl::logic::PidController pid({0.0F, 0.01F, 0.0F});
+  pid.update(30.0F, 29.0F, 1.0F);
+  const float integral = pid.integralTerm();
+  for (int i = 0; i < 10; ++i) {
+    pid.update(30.0F, 29.0F, 0.0F);
+  }
+  TEST_ASSERT_EQUAL_FLOAT(integral, pid.integralTerm());
+}
 
-  TEST_ASSERT_TRUE(HeatControl::logic::shouldManualHeaterBeOn(100, 999));
-  TEST_ASSERT_TRUE(HeatControl::logic::shouldManualHeaterBeOn(130, 5432));
+void test_pid_derivative_acts_on_measurement_only() {
+  HeatControl::logic::PidController pid({0.0F, 0.0F, 10.0F});
+  pid.update(30.0F, 25.0F, 1.0F);
+  // Setpoint jump: no derivative kick.
+  TEST_ASSERT_EQUAL_UINT16(0, pid.update(40.0F, 25.0F, 1.0F));
+  // Falling temperature pushes the output up.
+  TEST_ASSERT_GREATER_THAN_UINT16(0, pid.update(40.0F, 24.95F, 1.0F));
 }
 
-void test_update_sensors_and_heaters_manual_mode() {
-  MockGpio gpio;
-  MockSensors sensors;
-  sensors.temp0 = 22.0F;
-  sensors.temp1 = 24.0F;
+void test_temperature_duty_modes() {
+  HeatControl::logic::PidController pid;
+  TEST_ASSERT_EQUAL_UINT16(1000, HeatControl::logic::temperatureDutyPermille(HeatControl::logic::ControlMode::BangBang,
+                                                                              pid, false, 29.9F, 30.0F, 1.0F));
+  TEST_ASSERT_EQUAL_UINT16(0, HeatControl::logic::temperatureDutyPermille(HeatControl::logic::ControlMode::BangBang, pid,
+                                                                           false, 30.0F, 30.0F, 1.0F));
+  TEST_ASSERT_EQUAL_UINT16(1000, HeatControl::logic::temperatureDutyPermille(HeatControl::logic::ControlMode::Pid, pid,
+                                                                              true, -127.0F, 30.0F, 1.0F));
+  const uint16_t pidDuty =
+      HeatControl::logic::temperatureDutyPermille(HeatControl::logic::ControlMode::Pid, pid, false, 29.9F, 30.0F, 1.0F);
+  TEST_ASSERT_TRUE(pidDuty > 0 && pidDuty < 1000);
+  TEST_ASSERT_EQUAL(HeatControl::logic::ControlMode::Pid, HeatControl::logic::clampControlMode(1));
+  TEST_ASSERT_EQUAL(HeatControl::logic::ControlMode::BangBang, HeatControl::logic::clampControlMode(7));
+}
 
-  float current0 = 0.0F;
-  float current1 = 0.0F;
+void test_pid_beats_bang_bang_on_thermal_plant() {
+  const ClosedLoopResult bangBang = runClosedLoop(HeatControl::logic::ControlMode::BangBang, 30.0F);
+  const ClosedLoopResult pid = runClosedLoop(HeatControl::logic::ControlMode::Pid, 30.0F);
+
+  char message[200];
+  snprintf(message, sizeof(message),
+           "bang-bang: overshoot=%.2fC hold_err=%.2fC %.3f Wh/(C*h) | pid: overshoot=%.2fC hold_err=%.2fC %.3f Wh/(C*h)",
+           static_cast<double>(bangBang.overshootC), static_cast<double>(bangBang.holdErrorC),
+           static_cast<double>(bangBang.whPerDegreeHour), static_cast<double>(pid.overshootC),
+           static_cast<double>(pid.holdErrorC), static_cast<double>(pid.whPerDegreeHour));
+  TEST_MESSAGE(message);
+
+  TEST_ASSERT_TRUE(pid.overshootC < bangBang.overshootC);
+  TEST_ASSERT_TRUE(pid.overshootC < 0.5F);
+  TEST_ASSERT_TRUE(pid.holdErrorC < bangBang.holdErrorC);
+  // Holding the same mean temperature costs the same energy in a linear plant; PID must not cost more.
+  TEST_ASSERT_TRUE(pid.whPerDegreeHour <= bangBang.whPerDegreeHour * 1.01F);
+}
 
-  HeatControl::logic::updateSensorsAndHeaters(sensors, gpio, false, true, 25, 75, true, false, false, 23.0F, 23.0F,
-                                              current0, current1, 4, 5, 300);
+void test_overtemp_guard_trips_and_clears_with_hysteresis() {
+  HeatControl::logic::OvertempGuard guard(85.0F, 75.0F);
+  HeatControl::logic::OvertempEvent event = guard.update(true, 84.9F);
+  TEST_ASSERT_FALSE(event.tripped);
+  TEST_ASSERT_FALSE(guard.active());
+
+  event = guard.update(true, 86.5F);
+  TEST_ASSERT_TRUE(event.tripped);
+  TEST_ASSERT_TRUE(guard.active());
+  TEST_ASSERT_FLOAT_WITHIN(0.001F, 86.5F, guard.tripTempC());
+
+  // Still above the reset threshold: stays tripped without a second event.
+  event = guard.update(true, 80.0F);
+  TEST_ASSERT_FALSE(event.tripped || event.cleared);
+  TEST_ASSERT_TRUE(guard.active());
+
+  // A lost NTC reading neither trips nor releases the guard.
+  event = guard.update(false, 20.0F);
+  TEST_ASSERT_FALSE(event.cleared);
+  TEST_ASSERT_TRUE(guard.active());
+
+  event = guard.update(true, 75.0F);
+  TEST_ASSERT_TRUE(event.cleared);
+  TEST_ASSERT_FALSE(guard.active());
+}
 
-  TEST_ASSERT_EQUAL_INT(1, sensors.requestCount);
-  TEST_ASSERT_EQUAL_FLOAT(22.0F, current0);
-  TEST_ASSERT_EQUAL_FLOAT(24.0F, current1);
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_LOW, gpio.readPin(4));  // 25% at t=300ms -> OFF
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_LOW, gpio.readPin(5));
+void test_jitter_tracker_nominal_periods_have_no_jitter() {
+  HeatControl::logic::PeriodJitterTracker tracker(100000U);
+  for (uint32_t i = 0; i <= 10; ++i) {
+    tracker.recordTickStart(5000U + i * 100000U);
+  }
+  TEST_ASSERT_EQUAL_UINT32(10, tracker.samples());
+  TEST_ASSERT_EQUAL_UINT32(100000, tracker.minPeriodUs());
+  TEST_ASSERT_EQUAL_UINT32(100000, tracker.maxPeriodUs());
+  TEST_ASSERT_EQUAL_UINT32(0, tracker.maxAbsJitterUs());
+  TEST_ASSERT_EQUAL_UINT32(0, tracker.meanAbsJitterUs());
+  TEST_ASSERT_EQUAL_UINT32(0, tracker.overruns());
+}
 
-  HeatControl::logic::updateSensorsAndHeaters(sensors, gpio, false, true, 25, 75, true, false, false, 23.0F, 23.0F,
-                                              current0, current1, 4, 5, 100);
-  TEST_ASSERT_EQUAL_INT(2, sensors.requestCount);
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_HIGH, gpio.readPin(4));   // 25% at t=100ms -> ON
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_LOW, gpio.readPin(5));    // Disabled channel stays OFF
+void test_jitter_tracker_records_late_ticks_and_overruns() {
+  HeatControl::logic::PeriodJitterTracker tracker(100000U);
+  tracker.recordTickStart(0U);
+  tracker.recordTickStart(102000U);  // 2 ms late
+  tracker.recordTickStart(200000U);  // 2 ms early (vTaskDelayUntil catches up)
+  tracker.recordTickStart(360000U);  // 60 ms late: counts as an overrun
+  tracker.recordBusy(1200U);
+  tracker.recordBusy(800U);
+
+  TEST_ASSERT_EQUAL_UINT32(3, tracker.samples());
+  TEST_ASSERT_EQUAL_UINT32(98000, tracker.minPeriodUs());
+  TEST_ASSERT_EQUAL_UINT32(160000, tracker.maxPeriodUs());
+  TEST_ASSERT_EQUAL_UINT32(60000, tracker.maxAbsJitterUs());
+  TEST_ASSERT_EQUAL_UINT32(21333, tracker.meanAbsJitterUs());
+  TEST_ASSERT_EQUAL_UINT32(1, tracker.overruns());
+  TEST_ASSERT_EQUAL_UINT32(1200, tracker.maxBusyUs());
+
+  tracker.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, tracker.samples());
+  TEST_ASSERT_EQUAL_UINT32(0, tracker.maxBusyUs());
+}
 
-  HeatControl::logic::updateSensorsAndHeaters(sensors, gpio, false, true, 80, 100, false, true, false, 23.0F, 23.0F,
-                                              current0, current1, 4, 5, 50);
-  TEST_ASSERT_EQUAL_INT(3, sensors.requestCount);
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_LOW, gpio.readPin(4));    // Disabled heater stays OFF
-  TEST_ASSERT_EQUAL_INT(HeatControl::logic::PIN_HIGH, gpio.readPin(5));   // Enabled heater with 100% power stays ON
+void test_jitter_tracker_handles_timer_wraparound() {
+  HeatControl::logic::PeriodJitterTracker tracker(100000U);
+  tracker.recordTickStart(0xFFFFFFFFU - 49999U);
+  tracker.recordTickStart(50000U);
+  TEST_ASSERT_EQUAL_UINT32(1, tracker.samples());
+  TEST_ASSERT_EQUAL_UINT32(100000, tracker.maxPeriodUs());
+  TEST_ASSERT_EQUAL_UINT32(0, tracker.maxAbsJitterUs());
 }
 
 }  // namespace
@@ -218,13 +347,19 @@ int main() {
   RUN_TEST(test_is_sensor_error_boundaries);
   RUN_TEST(test_should_turn_on_for_sensor_error);
   RUN_TEST(test_should_turn_on_based_on_temperature_delta);
-  RUN_TEST(test_control_heater_sets_active_high_output);
-  RUN_TEST(test_update_sensors_and_heaters_without_swap);
-  RUN_TEST(test_update_sensors_and_heaters_power_mode_forces_on);
-  RUN_TEST(test_update_sensors_and_heaters_with_swap);
-  RUN_TEST(test_update_sensors_and_heaters_with_swap_and_distinct_targets);
   RUN_TEST(test_heater_state_text_from_level);
-  RUN_TEST(test_manual_pwm_decision);
-  RUN_TEST(test_update_sensors_and_heaters_manual_mode);
+  RUN_TEST(test_pipeline_hands_over_readings_on_later_tick);
+  RUN_TEST(test_pipeline_full_cycles_never_block_the_loop);
+  RUN_TEST(test_pipeline_respects_conversion_time_change);
+  RUN_TEST(test_pid_output_is_proportional_and_clamped);
+  RUN_TEST(test_pid_integrator_does_not_wind_up_while_saturated);
+  RUN_TEST(test_pid_zero_dt_does_not_integrate);
+  RUN_TEST(test_pid_derivative_acts_on_measurement_only);
+  RUN_TEST(test_temperature_duty_modes);
+  RUN_TEST(test_pid_beats_bang_bang_on_thermal_plant);
+  RUN_TEST(test_overtemp_guard_trips_and_clears_with_hysteresis);
+  RUN_TEST(test_jitter_tracker_nominal_periods_have_no_jitter);
+  RUN_TEST(test_jitter_tracker_records_late_ticks_and_overruns);
+  RUN_TEST(test_jitter_tracker_handles_timer_wraparound);
   return UNITY_END();
 }
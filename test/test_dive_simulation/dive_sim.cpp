@@ -0,0 +1,505 @@
+#include "dive_sim.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "adc_filter.h"
+#include "control_cycle.h"
+#include "logic_helpers.h"
+#include "pack_resistance.h"
+#include "persist_scheduler.h"
+#include "record_store.h"
+#include "slow_pwm.h"
+#include "storage_logic.h"
+
+namespace HeatControl {
+namespace sim {
+
+namespace {
+
+// Firmware constants the glue below mirrors (app_state.h, main.cpp, adc_input.cpp, storage.cpp).
+constexpr int SSR_PINS[2] = {2, 5};
+constexpr uint32_t PWM_PERIOD_MS = 1000;
+constexpr uint16_t PWM_STEPS = 100;
+constexpr uint32_t STEP_MS = PWM_PERIOD_MS / PWM_STEPS;  // simulation step = one slow-PWM tick
+constexpr uint32_t CONTROL_PERIOD_MS = 100;
+constexpr uint32_t LOOP_PERIOD_MS = logic::MANUAL_TOGGLE_CHECK_MS;
+constexpr uint32_t DS18B20_CONVERSION_MS = 750;
+constexpr float MOSFET_LIMIT_C = 80.0F;
+constexpr float MOSFET_RESET_C = 75.0F;
+constexpr float DIVIDER_RATIO = 4.0F;
+constexpr uint16_t BATTERY_OFF_MV = 80;
+constexpr uint16_t BATTERY_ON_MV = 300;
+constexpr uint8_t BATTERY_STABLE_SAMPLES = 2;
+constexpr uint32_t PERSIST_DEBOUNCE_MS = 1500;
+constexpr uint32_t PERSIST_MAX_DELAY_MS = 10000;
+constexpr uint32_t PERSIST_RUNTIME = 1UL << 0;
+constexpr uint8_t RUNTIME_KEY = 0;
+// The acquisition task hands the filters 16x averaged blocks; the simulation feeds one block per
+// step with correspondingly reduced noise, so only the median and IIR stages run here.
+constexpr logic::AdcFilterConfig BATTERY_FILTER = {1, 5, 1};
+constexpr logic::AdcFilterConfig NTC_FILTER = {1, 5, 4};
+constexpr float ADC_BLOCK_NOISE_MV = 4.0F;
+
+uint32_t virtualNowUs = 0;
+uint32_t virtualClockUs() { return virtualNowUs; }
+
+// Deterministic noise source (LCG), uniform in [-1, 1].
+class Noise {
+ public:
+  explicit Noise(uint32_t seed) : state_(seed != 0U ? seed : 1U) {}
+  float next() {
+    state_ = state_ * 1664525U + 1013904223U;
+    return static_cast<float>(state_ >> 8) / 8388608.0F - 1.0F;
+  }
+
+ private:
+  uint32_t state_;
+};
+
+class SimGpio : public logic::IGpio {
+ public:
+  void writePin(int pin, int level) override {
+    if (pin >= 0 && pin < 32) {
+      levels_[pin] = level;
+    }
+  }
+  int readPin(int pin) const override { return pin >= 0 && pin < 32 ? levels_[pin] : logic::PIN_LOW; }
+
+ private:
+  int levels_[32] = {};
+};
+
+// DS18B20 pair: a conversion latches the zone temperatures at 1/16 degC resolution.
+class SimSensors : public logic::ITemperatureSensors {
+ public:
+  explicit SimSensors(const float *zoneTemps) : zoneTemps_(zoneTemps) {}
+  void requestTemperatures() override {
+    for (int i = 0; i < 2; ++i) {
+      latched_[i] = std::round(zoneTemps_[i] * 16.0F) / 16.0F;
+    }
+  }
+  float getTempCByIndex(int index) override { return index >= 0 && index < 2 ? latched_[index] : -127.0F; }
+
+ private:
+  const float *zoneTemps_;
+  float latched_[2] = {-127.0F, -127.0F};
+};
+
+class RamFlash : public logic::IFlashRegion {
+ public:
+  RamFlash() : bytes_(SECTORS * SECTOR_BYTES, 0xFF) {}
+  size_t sectorBytes() const override { return SECTOR_BYTES; }
+  size_t sectorCount() const override { return SECTORS; }
+  bool read(size_t offset, void *out, size_t length) override {
+    std::memcpy(out, bytes_.data() + offset, length);
+    return true;
+  }
+  bool write(size_t offset, const void *data, size_t length) override {
+    const uint8_t *in = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < length; ++i) {
+      bytes_[offset + i] &= in[i];
+    }
+    return true;
+  }
+  bool eraseSector(size_t sector) override {
+    std::fill(bytes_.begin() + static_cast<long>(sector * SECTOR_BYTES),
+              bytes_.begin() + static_cast<long>((sector + 1U) * SECTOR_BYTES), 0xFF);
+    return true;
+  }
+
+ private:
+  static constexpr size_t SECTORS = 4;
+  static constexpr size_t SECTOR_BYTES = 4096;
+  std::vector<uint8_t> bytes_;
+};
+
+// Open-circuit cell voltage of the simulated cells, independent of the firmware's SoC curves.
+float cellOpenCircuitVolts(uint8_t chemistry, float soc) {
+  static const float SOC_POINTS[] = {0.0F, 0.1F, 0.2F, 0.4F, 0.6F, 0.8F, 1.0F};
+  static const float LI_ION_VOLTS[] = {3.00F, 3.45F, 3.55F, 3.68F, 3.80F, 3.95F, 4.15F};
+  static const float LI_PO_VOLTS[] = {3.00F, 3.50F, 3.62F, 3.74F, 3.85F, 4.00F, 4.18F};
+  static const float LI_FE_PO4_VOLTS[] = {2.60F, 3.05F, 3.20F, 3.26F, 3.29F, 3.32F, 3.42F};
+  static const float NI_MH_VOLTS[] = {1.00F, 1.15F, 1.19F, 1.23F, 1.26F, 1.30F, 1.38F};
+  static const float LEAD_GEL_VOLTS[] = {1.90F, 1.94F, 1.97F, 2.01F, 2.05F, 2.09F, 2.13F};
+  const float *volts = LI_ION_VOLTS;
+  switch (chemistry) {
+    case BATTERY_CHEMISTRY_LI_PO:
+      volts = LI_PO_VOLTS;
+      break;
+    case BATTERY_CHEMISTRY_LI_FE_PO4:
+      volts = LI_FE_PO4_VOLTS;
+      break;
+    case BATTERY_CHEMISTRY_NI_MH:
+      volts = NI_MH_VOLTS;
+      break;
+    case BATTERY_CHEMISTRY_LEAD_GEL:
+      volts = LEAD_GEL_VOLTS;
+      break;
+    default:
+      break;
+  }
+  if (soc <= 0.0F) {
+    return volts[0];
+  }
+  for (size_t i = 1; i < sizeof(SOC_POINTS) / sizeof(SOC_POINTS[0]); ++i) {
+    if (soc <= SOC_POINTS[i]) {
+      const float t = (soc - SOC_POINTS[i - 1]) / (SOC_POINTS[i] - SOC_POINTS[i - 1]);
+      return volts[i - 1] + t * (volts[i] - volts[i - 1]);
+    }
+  }
+  return volts[6];
+}
+
+// Board divider: 3.3 V -> NTC (10k, B3950) -> ADC node -> 10k -> GND.
+float ntcNodeMilliVolts(float tempC) {
+  const float ntcOhm = logic_helpers::NTC_NOMINAL_RESISTANCE_OHM *
+                       std::exp(logic_helpers::NTC_BETA * (1.0F / (tempC + 273.15F) -
+                                                          1.0F / (logic_helpers::NTC_NOMINAL_TEMP_C + 273.15F)));
+  return logic_helpers::NTC_VCC_MV * logic_helpers::NTC_SERIES_RESISTOR_OHM /
+         (ntcOhm + logic_helpers::NTC_SERIES_RESISTOR_OHM);
+}
+
+uint16_t toAdcMilliVolts(float milliVolts) {
+  return static_cast<uint16_t>(std::min(std::max(milliVolts, 0.0F), 3300.0F) + 0.5F);
+}
+
+class DiveSimulator {
+ public:
+  explicit DiveSimulator(const DiveScenario &scenario)
+      : s_(scenario),
+        noise_(scenario.seed),
+        sensors_(zoneTempC_),
+        outputs_(SSR_PINS[0], SSR_PINS[1], PWM_PERIOD_MS, PWM_STEPS),
+        control_(DS18B20_CONVERSION_MS, MOSFET_LIMIT_C, MOSFET_RESET_C),
+        housekeeping_(BATTERY_OFF_MV, BATTERY_ON_MV, BATTERY_STABLE_SAMPLES),
+        batteryFilters_{logic::AdcFilter(BATTERY_FILTER), logic::AdcFilter(BATTERY_FILTER)},
+        ntcFilters_{logic::AdcFilter(NTC_FILTER), logic::AdcFilter(NTC_FILTER)},
+        persist_(PERSIST_DEBOUNCE_MS, PERSIST_MAX_DELAY_MS),
+        store_(flash_, &virtualClockUs) {
+    std::memset(&metrics_, 0, sizeof(metrics_));
+    for (int i = 0; i < 2; ++i) {
+      zoneTempC_[i] = s_.waterTempC;
+      mosfetTempC_[i] = s_.waterTempC;
+      soc_[i] = s_.batteries[i].initialSoc;
+      manualPercent_[i] = clampManualPowerPercent(s_.manualPowerPercent[i]);
+      metrics_.minZoneTempC[i] = zoneTempC_[i];
+      metrics_.maxZoneTempC[i] = zoneTempC_[i];
+      metrics_.maxMosfetTempC[i] = mosfetTempC_[i];
+    }
+    virtualNowUs = 0;
+    store_.mount();
+  }
+
+  DiveResult run() {
+    DiveResult result;
+    uint32_t inBandSteps[2] = {0, 0};
+    uint32_t bandSteps = 0;
+    for (nowMs_ = STEP_MS; nowMs_ <= s_.durationMs; nowMs_ += STEP_MS) {
+      virtualNowUs = nowMs_ * 1000U;
+      stepPlant();
+      sampleAdc();
+      outputs_.tick(gpio_);
+      if (nowMs_ % CONTROL_PERIOD_MS == 0U) {
+        controlTick();
+      }
+      if (nowMs_ % LOOP_PERIOD_MS == 0U) {
+        loopPass();
+      }
+      if (nowMs_ >= s_.settleMs) {
+        ++bandSteps;
+        for (int i = 0; i < 2; ++i) {
+          if (std::fabs(zoneTempC_[i] - s_.targetTempC[i]) <= s_.bandC) {
+            ++inBandSteps[i];
+          }
+        }
+      }
+      if (s_.traceIntervalMs != 0U && nowMs_ % s_.traceIntervalMs == 0U) {
+        result.trace.push_back(tracePoint());
+      }
+    }
+
+    // Power cut at the end of the dive: whatever the scheduler had not handed out yet is lost.
+    RecordStore reread(flash_, &virtualClockUs);
+    uint32_t persisted = 0;
+    if (reread.mount()) {
+      reread.get(RUNTIME_KEY, &persisted, sizeof(persisted));
+    }
+    for (int i = 0; i < 2; ++i) {
+      metrics_.meteredWh[i] = static_cast<float>(control_.energy().microJoules(static_cast<uint8_t>(i))) / 3.6e9F;
+      metrics_.timeInBandPct[i] = bandSteps > 0U ? 100.0F * static_cast<float>(inBandSteps[i]) / bandSteps : 0.0F;
+      metrics_.finalManualPercent[i] = manualPercent_[i];
+      metrics_.finalTrueSoc[i] = soc_[i];
+      metrics_.finalSocPercent[i] = socPercent_[i];
+      metrics_.sourceMilliOhm[i] = sourceMilliOhm(i);
+      metrics_.sagEdges[i] = packEstimators_[i].edges();
+      metrics_.packWeak[i] = packEstimators_[i].weak();
+    }
+    metrics_.runtimeMinutes = runtimeMinutes_;
+    metrics_.persistedRuntimeMinutes = persisted;
+    metrics_.flashCommits = store_.stats().commits;
+    result.metrics = metrics_;
+    return result;
+  }
+
+ private:
+  typedef logic::RecordStore RecordStore;
+
+  bool batteryConnected(int battery) const {
+    for (const BatteryToggle &toggle : s_.toggles) {
+      if (toggle.battery == battery && nowMs_ >= toggle.atMs && nowMs_ < toggle.atMs + toggle.offMs) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void stepPlant() {
+    const float dtS = STEP_MS / 1000.0F;
+    for (int i = 0; i < 2; ++i) {
+      const BatteryModel &battery = s_.batteries[i];
+      const float openVolts = battery.cells * cellOpenCircuitVolts(battery.chemistry, soc_[i]);
+      const bool connected = batteryConnected(i);
+      const bool heating = connected && gpio_.readPin(SSR_PINS[i]) == logic::PIN_HIGH;
+      const float amps = heating ? openVolts / (s_.zones[i].heaterOhm + battery.internalOhm + s_.mosfets[i].rdsOnOhm) : 0.0F;
+      packVolts_[i] = connected ? openVolts - amps * battery.internalOhm : 0.0F;
+
+      const float heaterWatts = amps * amps * s_.zones[i].heaterOhm;
+      soc_[i] = std::max(0.0F, soc_[i] - amps * dtS / (battery.capacityAh * 3600.0F));
+      metrics_.energyWh[i] += heaterWatts * dtS / 3600.0F;
+
+      const ZoneModel &zone = s_.zones[i];
+      const float zoneSteady = s_.waterTempC + heaterWatts * zone.thermalResistanceKPerW;
+      zoneTempC_[i] += (zoneSteady - zoneTempC_[i]) * dtS / zone.timeConstantS;
+
+      const MosfetModel &mosfet = s_.mosfets[i];
+      const float mosfetSteady = s_.waterTempC + amps * amps * mosfet.rdsOnOhm * mosfet.thermalResistanceKPerW;
+      mosfetTempC_[i] += (mosfetSteady - mosfetTempC_[i]) * dtS / mosfet.timeConstantS;
+
+      metrics_.minZoneTempC[i] = std::min(metrics_.minZoneTempC[i], zoneTempC_[i]);
+      metrics_.maxZoneTempC[i] = std::max(metrics_.maxZoneTempC[i], zoneTempC_[i]);
+      metrics_.maxMosfetTempC[i] = std::max(metrics_.maxMosfetTempC[i], mosfetTempC_[i]);
+    }
+  }
+
+  void sampleAdc() {
+    for (int i = 0; i < 2; ++i) {
+      const float batteryMv = packVolts_[i] * 1000.0F / DIVIDER_RATIO + ADC_BLOCK_NOISE_MV * noise_.next();
+      batteryFilters_[i].push(toAdcMilliVolts(batteryMv));
+      // adc_input.cpp tags every battery filter step with the SSR state it was taken under.
+      packEstimators_[i].push(batteryFilters_[i].output(), gpio_.readPin(SSR_PINS[i]) == logic::PIN_HIGH);
+      const float ntcMv = ntcNodeMilliVolts(mosfetTempC_[i]) + ADC_BLOCK_NOISE_MV * noise_.next();
+      ntcFilters_[i].push(toAdcMilliVolts(ntcMv));
+    }
+  }
+
+  // control.cpp controlTaskMain(): the measurements it reads, then the shared tick.
+  void controlTick() {
+    ++metrics_.controlTicks;
+    logic::ControlMeasurements measurements;
+    for (int i = 0; i < 2; ++i) {
+      const uint32_t packMv = static_cast<uint32_t>(batteryFilters_[i].output() * DIVIDER_RATIO + 0.5F);
+      measurements.packMilliVolts[i] = static_cast<uint16_t>(std::min<uint32_t>(packMv, 0xFFFFU));
+      measurements.ntcMilliVolts[i] = ntcFilters_[i].output();
+      measurements.supplies[i] = {measuredPackVolts_[i], s_.batteries[i].cells, s_.batteries[i].chemistry};
+      measurements.socCenti[i] = static_cast<int32_t>(socSmoothed_[i] * 100.0F);
+    }
+    const logic::ControlTickResult result = control_.tick(nowMs_, controlInputs(), measurements, sensors_, outputs_);
+    for (int i = 0; i < 2; ++i) {
+      measuredTempC_[i] = control_.currentTemp(static_cast<uint8_t>(i));
+      metrics_.overtempTrips[i] += result.overtemp[i].tripped ? 1U : 0U;
+      metrics_.overtempClears[i] += result.overtemp[i].cleared ? 1U : 0U;
+    }
+  }
+
+  ControlInputs controlInputs() const {
+    ControlInputs inputs;
+    inputs.powerMode = s_.powerMode;
+    inputs.manualMode = s_.manualMode;
+    inputs.manualPowerPercent1 = manualPercent_[0];
+    inputs.manualPowerPercent2 = manualPercent_[1];
+    inputs.manualHeater1Enabled = true;
+    inputs.manualHeater2Enabled = true;
+    inputs.targetTemp1 = s_.targetTempC[0];
+    inputs.targetTemp2 = s_.targetTempC[1];
+    inputs.controlMode = s_.controlMode;
+    inputs.pidGains = s_.pidGains;
+    inputs.manualPowerMode = s_.manualPowerMode;
+    inputs.heaterElementOhm = s_.heaterElementOhm;
+    return inputs;
+  }
+
+  // main.cpp loop(): battery state on the shared cadence with the OFF/ON stepping in manual mode,
+  // runtime minutes and the persistence pass.
+  void loopPass() {
+    if (housekeeping_.batteryDue(nowMs_, s_.manualMode)) {
+      for (int i = 0; i < 2; ++i) {
+        const uint16_t adcMv = batteryFilters_[i].output();
+        float cellV = 0.0F;
+        const uint16_t restMv = s_.sagCorrection ? packEstimators_[i].restMilliVolts() : 0U;
+        logic_helpers::updateBatteryFromAdc(adcMv, s_.batteries[i].cells, DIVIDER_RATIO, measuredPackVolts_[i], cellV,
+                                            s_.batteries[i].chemistry, socSmoothed_[i], socInitialized_[i],
+                                            socPercent_[i], restMv);
+        if (s_.manualMode) {
+          const logic::ManualToggleResult toggle =
+              housekeeping_.detectToggle(static_cast<uint8_t>(i), adcMv, nowMs_, s_.manualToggleMaxOffMs);
+          if (toggle.step) {
+            manualPercent_[i] = nextManualPowerPercent(manualPercent_[i]);
+            ++metrics_.manualSteps[i];
+          }
+        }
+      }
+    }
+
+    if (housekeeping_.runtimeMinuteDue(nowMs_)) {
+      ++runtimeMinutes_;
+      persist_.mark(PERSIST_RUNTIME, nowMs_);
+    }
+    if ((persist_.take(nowMs_) & PERSIST_RUNTIME) != 0U) {
+      store_.set(RUNTIME_KEY, &runtimeMinutes_, sizeof(runtimeMinutes_));
+      store_.commit();
+    }
+  }
+
+  // As reported in /status: the sag ratio times the configured element, -1 while not valid.
+  int32_t sourceMilliOhm(int i) const {
+    const uint32_t elementMilliOhm = static_cast<uint32_t>(s_.heaterElementOhm * 1000.0F + 0.5F);
+    return packEstimators_[i].valid() ? static_cast<int32_t>(packEstimators_[i].sourceMilliOhm(elementMilliOhm)) : -1;
+  }
+
+  TracePoint tracePoint() const {
+    TracePoint point = {};
+    point.timeMs = nowMs_;
+    for (int i = 0; i < 2; ++i) {
+      point.zoneTempC[i] = zoneTempC_[i];
+      point.measuredTempC[i] = measuredTempC_[i];
+      point.dutyPermille[i] = outputs_.dutyPermille(static_cast<uint8_t>(i));
+      point.packVolts[i] = packVolts_[i];
+      point.openVolts[i] = s_.batteries[i].cells * cellOpenCircuitVolts(s_.batteries[i].chemistry, soc_[i]);
+      point.restVolts[i] = packEstimators_[i].restMilliVolts() * DIVIDER_RATIO / 1000.0F;
+      point.sourceMilliOhm[i] = sourceMilliOhm(i);
+      point.energyWh[i] = metrics_.energyWh[i];
+      const uint8_t channel = static_cast<uint8_t>(i);
+      point.meteredWh[i] = static_cast<float>(control_.energy().microJoules(channel)) / 3.6e9F;
+      point.runtimeLeftMinutes[i] =
+          control_.predictor(channel).valid() ? static_cast<int32_t>(control_.predictor(channel).minutesLeft()) : -1;
+      point.trueSoc[i] = soc_[i];
+      point.socPercent[i] = socPercent_[i];
+      point.mosfetTempC[i] = mosfetTempC_[i];
+      point.overtemp[i] = control_.guard(channel).active();
+    }
+    return point;
+  }
+
+  const DiveScenario &s_;
+  Noise noise_;
+  SimGpio gpio_;
+  float zoneTempC_[2] = {0.0F, 0.0F};
+  float mosfetTempC_[2];
+  float packVolts_[2] = {0.0F, 0.0F};
+  float measuredPackVolts_[2] = {0.0F, 0.0F};  // firmware estimate, as published to the control task
+  float soc_[2];
+  SimSensors sensors_;
+  logic::SlowPwmOutput outputs_;
+  logic::HeaterControlCycle control_;
+  logic::HousekeepingCycle housekeeping_;
+  logic::AdcFilter batteryFilters_[2];
+  logic::AdcFilter ntcFilters_[2];
+  logic::PackResistanceEstimator packEstimators_[2];
+  logic::PersistScheduler persist_;
+  RamFlash flash_;
+  RecordStore store_;
+  DiveMetrics metrics_;
+
+  uint32_t nowMs_ = 0;
+  float measuredTempC_[2] = {-127.0F, -127.0F};
+  uint8_t manualPercent_[2];
+  float socSmoothed_[2] = {0.0F, 0.0F};
+  bool socInitialized_[2] = {false, false};
+  uint8_t socPercent_[2] = {0, 0};
+  uint32_t runtimeMinutes_ = 0;
+};
+
+}  // namespace
+
+DiveScenario defaultDiveScenario() {
+  DiveScenario s;
+  s.durationMs = 3UL * 60UL * 60UL * 1000UL;
+  s.waterTempC = 4.0F;
+  s.powerMode = false;
+  s.manualMode = false;
+  s.manualPowerPercent[0] = 50;
+  s.manualPowerPercent[1] = 50;
+  s.manualPowerMode = logic::ManualPowerMode::Duty;
+  s.heaterElementOhm = 4.0F;
+  s.sagCorrection = true;
+  s.manualToggleMaxOffMs = 1500;
+  s.targetTempC[0] = 30.0F;
+  s.targetTempC[1] = 30.0F;
+  s.controlMode = logic::ControlMode::Pid;
+  s.pidGains = logic::DEFAULT_PID_GAINS;
+  for (int i = 0; i < 2; ++i) {
+    s.zones[i] = ZoneModel{4.0F, 1.0F, 600.0F};
+    s.batteries[i] = BatteryModel{3, BATTERY_CHEMISTRY_LI_ION, 10.0F, 0.12F, 1.0F};
+    s.mosfets[i] = MosfetModel{0.01F, 40.0F, 30.0F};
+  }
+  s.bandC = 1.0F;
+  s.settleMs = 20UL * 60UL * 1000UL;
+  s.traceIntervalMs = 10000;
+  s.seed = 1;
+  return s;
+}
+
+DiveResult runDive(const DiveScenario &scenario) {
+  DiveSimulator simulator(scenario);
+  return simulator.run();
+}
+
+bool writeTraceCsv(const std::vector<TracePoint> &trace, const char *path) {
+  FILE *file = std::fopen(path, "w");
+  if (file == nullptr) {
+    return false;
+  }
+  std::fprintf(file,
+               "time_s,zone1_c,zone2_c,measured1_c,measured2_c,duty1,duty2,pack1_v,pack2_v,open1_v,open2_v,rest1_v,"
+               "rest2_v,source1_mohm,source2_mohm,energy1_wh,energy2_wh,metered1_wh,metered2_wh,runtime_left1_min,"
+               "runtime_left2_min,soc1,soc2,soc1_pct,soc2_pct,mosfet1_c,mosfet2_c,overtemp1,overtemp2\n");
+  for (const TracePoint &p : trace) {
+    std::fprintf(file,
+                 "%.1f,%.3f,%.3f,%.4f,%.4f,%u,%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%ld,%ld,%.3f,%.3f,%.3f,%.3f,%ld,%ld,"
+                 "%.4f,%.4f,%u,%u,%.2f,%.2f,%d,%d\n",
+                 p.timeMs / 1000.0, p.zoneTempC[0], p.zoneTempC[1], p.measuredTempC[0], p.measuredTempC[1],
+                 p.dutyPermille[0], p.dutyPermille[1], p.packVolts[0], p.packVolts[1], p.openVolts[0], p.openVolts[1],
+                 p.restVolts[0], p.restVolts[1], static_cast<long>(p.sourceMilliOhm[0]),
+                 static_cast<long>(p.sourceMilliOhm[1]), p.energyWh[0], p.energyWh[1],
+                 p.meteredWh[0], p.meteredWh[1], static_cast<long>(p.runtimeLeftMinutes[0]),
+                 static_cast<long>(p.runtimeLeftMinutes[1]), p.trueSoc[0], p.trueSoc[1], p.socPercent[0],
+                 p.socPercent[1], p.mosfetTempC[0], p.mosfetTempC[1], p.overtemp[0] ? 1 : 0, p.overtemp[1] ? 1 : 0);
+  }
+  return std::fclose(file) == 0;
+}
+
+std::string formatMetrics(const DiveMetrics &m) {
+  char text[640];
+  std::snprintf(text, sizeof(text),
+                "energy %.1f/%.1f Wh (metered %.1f/%.1f) | in band %.1f/%.1f %% | zone %.1f..%.1f/%.1f..%.1f C | "
+                "mosfet max %.1f/%.1f C | trips %u/%u | manual steps %u/%u | soc true %.0f/%.0f %% est %u/%u %% | "
+                "source %ld/%ld mOhm (%u/%u edges%s) | runtime %u min (flash %u, %u commits)",
+                m.energyWh[0], m.energyWh[1], m.meteredWh[0], m.meteredWh[1], m.timeInBandPct[0], m.timeInBandPct[1],
+                m.minZoneTempC[0], m.maxZoneTempC[0], m.minZoneTempC[1], m.maxZoneTempC[1], m.maxMosfetTempC[0],
+                m.maxMosfetTempC[1],
+                static_cast<unsigned>(m.overtempTrips[0]), static_cast<unsigned>(m.overtempTrips[1]),
+                static_cast<unsigned>(m.manualSteps[0]), static_cast<unsigned>(m.manualSteps[1]),
+                m.finalTrueSoc[0] * 100.0F, m.finalTrueSoc[1] * 100.0F, m.finalSocPercent[0], m.finalSocPercent[1],
+                static_cast<long>(m.sourceMilliOhm[0]), static_cast<long>(m.sourceMilliOhm[1]),
+                static_cast<unsigned>(m.sagEdges[0]), static_cast<unsigned>(m.sagEdges[1]),
+                m.packWeak[0] || m.packWeak[1] ? ", weak" : "",
+                static_cast<unsigned>(m.runtimeMinutes), static_cast<unsigned>(m.persistedRuntimeMinutes),
+                static_cast<unsigned>(m.flashCommits));
+  return std::string(text);
+}
+
+}  // namespace sim
+}  // namespace HeatControl
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "control_logic.h"
+
+namespace HeatControl {
+namespace sim {
+
+// Host-side stand-in for the board: a virtual clock, plant models for two heated zones, their
+// batteries and MOSFETs, driving the firmware's own control tick and loop cadence
+// (HeaterControlCycle, HousekeepingCycle) plus SlowPwmOutput, AdcFilter, PersistScheduler,
+// RecordStore and PackResistanceEstimator. Everything is deterministic
+// for a given scenario, so metrics can be compared between runs.
+
+struct ZoneModel {
+  float heaterOhm;
+  float thermalResistanceKPerW;  // zone to water
+  float timeConstantS;
+};
+
+struct BatteryModel {
+  uint8_t cells;
+  uint8_t chemistry;  // BATTERY_CHEMISTRY_*: the cells' open-circuit curve and the firmware setting
+  float capacityAh;
+  float internalOhm;  // whole pack
+  float initialSoc;   // 0..1
+};
+
+struct MosfetModel {
+  float rdsOnOhm;
+  float thermalResistanceKPerW;  // junction to housing (at water temperature)
+  float timeConstantS;
+};
+
+// The diver switches a battery off and on again, e.g. to step the manual power.
+struct BatteryToggle {
+  uint32_t atMs;
+  uint32_t offMs;
+  uint8_t battery;
+};
+
+struct DiveScenario {
+  uint32_t durationMs;
+  float waterTempC;
+  bool powerMode;
+  bool manualMode;
+  uint8_t manualPowerPercent[2];
+  logic::ManualPowerMode manualPowerMode;
+  float heaterElementOhm;  // as configured in the firmware
+  bool sagCorrection;      // SoC from the sag-corrected rest voltage (false: from the loaded reading)
+  uint16_t manualToggleMaxOffMs;
+  float targetTempC[2];
+  logic::ControlMode controlMode;
+  logic::PidGains pidGains;
+  ZoneModel zones[2];
+  BatteryModel batteries[2];
+  MosfetModel mosfets[2];
+  std::vector<BatteryToggle> toggles;
+  float bandC;           // time-in-band tolerance around the target
+  uint32_t settleMs;     // time-in-band ignores the warm-up
+  uint32_t traceIntervalMs;  // 0 = no trace
+  uint32_t seed;         // ADC and sensor noise
+};
+
+// Two 36 W zones on 3S Li-ion packs in 4 degC water, PID to 30 degC, for 3 hours.
+DiveScenario defaultDiveScenario();
+
+struct TracePoint {
+  uint32_t timeMs;
+  float zoneTempC[2];
+  float measuredTempC[2];
+  uint16_t dutyPermille[2];
+  float packVolts[2];
+  float openVolts[2];  // the model's open-circuit voltage
+  float restVolts[2];  // the firmware's sag-corrected estimate of it
+  int32_t sourceMilliOhm[2];  // PackResistanceEstimator, -1 while it has none
+  float energyWh[2];  // delivered into the heater since the start
+  float meteredWh[2];  // the firmware's EnergyMeter total
+  int32_t runtimeLeftMinutes[2];  // RuntimePredictor estimate, -1 while it has none
+  float trueSoc[2];
+  uint8_t socPercent[2];
+  float mosfetTempC[2];
+  bool overtemp[2];
+};
+
+struct DiveMetrics {
+  float energyWh[2];
+  float meteredWh[2];
+  float timeInBandPct[2];
+  float minZoneTempC[2];
+  float maxZoneTempC[2];
+  float maxMosfetTempC[2];
+  uint32_t overtempTrips[2];
+  uint32_t overtempClears[2];
+  uint32_t manualSteps[2];
+  uint8_t finalManualPercent[2];
+  float finalTrueSoc[2];
+  uint8_t finalSocPercent[2];
+  int32_t sourceMilliOhm[2];
+  uint32_t sagEdges[2];
+  bool packWeak[2];
+  uint32_t runtimeMinutes;
+  // Read back from the simulated flash after the dive ends without a final flush (power cut).
+  uint32_t persistedRuntimeMinutes;
+  uint32_t flashCommits;
+  uint32_t controlTicks;
+};
+
+struct DiveResult {
+  DiveMetrics metrics;
+  std::vector<TracePoint> trace;
+};
+
+DiveResult runDive(const DiveScenario &scenario);
+
+bool writeTraceCsv(const std::vector<TracePoint> &trace, const char *path);
+std::string formatMetrics(const DiveMetrics &metrics);
+
+}  // namespace sim
+}  // namespace HeatControl
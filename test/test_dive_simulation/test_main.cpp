@@ -0,0 +1,311 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <unity.h>
+
+#include "dive_sim.h"
+#include "logic_helpers.h"
+#include "slow_pwm.h"
+#include "storage_logic.h"
+
+using namespace HeatControl::sim;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+constexpr uint32_t MINUTE_MS = 60UL * 1000UL;
+
+void report(const char *name, const DiveMetrics &metrics) {
+  char message[640];
+  snprintf(message, sizeof(message), "%s: %s", name, formatMetrics(metrics).c_str());
+  TEST_MESSAGE(message);
+}
+
+}  // namespace
+
+void test_pid_dive_holds_band_and_persists_runtime() {
+  const DiveScenario scenario = defaultDiveScenario();
+  const auto start = std::chrono::steady_clock::now();
+  const DiveResult result = runDive(scenario);
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const DiveMetrics &m = result.metrics;
+  report("3 h PID dive", m);
+
+  char message[96];
+  snprintf(message, sizeof(message), "3 h dive simulated in %.3f s (%u trace points)", seconds,
+           static_cast<unsigned>(result.trace.size()));
+  TEST_MESSAGE(message);
+  // Set HEATCONTROL_SIM_TRACE=<file.csv> to keep the trace for plotting or diffing against a baseline.
+  const char *tracePath = std::getenv("HEATCONTROL_SIM_TRACE");
+  if (tracePath != nullptr) {
+    TEST_ASSERT_TRUE(writeTraceCsv(result.trace, tracePath));
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(scenario.durationMs / scenario.traceIntervalMs, result.trace.size());
+  TEST_ASSERT_EQUAL_UINT32(scenario.durationMs / 100U, m.controlTicks);
+  for (int i = 0; i < 2; ++i) {
+    TEST_ASSERT_TRUE(m.timeInBandPct[i] > 95.0F);
+    TEST_ASSERT_TRUE(m.maxZoneTempC[i] < scenario.targetTempC[i] + 2.0F);
+    TEST_ASSERT_EQUAL_UINT32(0, m.overtempTrips[i]);
+    // Holding 26 K over the water through a 1 K/W zone takes ~26 W, i.e. 70-90 Wh in 3 h.
+    TEST_ASSERT_TRUE(m.energyWh[i] > 60.0F && m.energyWh[i] < 100.0F);
+    TEST_ASSERT_TRUE(m.finalTrueSoc[i] > 0.05F && m.finalTrueSoc[i] < 0.6F);
+    TEST_ASSERT_UINT32_WITHIN(15, static_cast<uint32_t>(m.finalTrueSoc[i] * 100.0F + 0.5F), m.finalSocPercent[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT32(180, m.runtimeMinutes);
+  // The last minute may still sit in the persistence debounce when the power goes.
+  TEST_ASSERT_TRUE(m.persistedRuntimeMinutes >= 179U && m.persistedRuntimeMinutes <= 180U);
+  TEST_ASSERT_TRUE(m.flashCommits >= 179U);
+  TEST_ASSERT_TRUE(seconds < 2.0);
+}
+
+void test_weak_mosfet_trips_and_recovers() {
+  DiveScenario scenario = defaultDiveScenario();
+  scenario.durationMs = 30U * MINUTE_MS;
+  scenario.powerMode = true;
+  scenario.mosfets[0].rdsOnOhm = 0.6F;  // heater 1 on a failing MOSFET, heater 2 healthy
+  const DiveMetrics m = runDive(scenario).metrics;
+  report("power mode, weak MOSFET 1", m);
+
+  TEST_ASSERT_TRUE(m.overtempTrips[0] >= 2U);
+  TEST_ASSERT_TRUE(m.overtempClears[0] >= 1U);
+  TEST_ASSERT_TRUE(m.overtempTrips[0] - m.overtempClears[0] <= 1U);
+  // Filter and tick lag let the junction overshoot the limit a little, but not run away.
+  TEST_ASSERT_TRUE(m.maxMosfetTempC[0] > 80.0F && m.maxMosfetTempC[0] < 84.0F);
+  TEST_ASSERT_EQUAL_UINT32(0, m.overtempTrips[1]);
+  TEST_ASSERT_TRUE(m.energyWh[0] < m.energyWh[1]);
+}
+
+void test_manual_toggle_window() {
+  DiveScenario scenario = defaultDiveScenario();
+  scenario.durationMs = 10U * MINUTE_MS;
+  scenario.manualMode = true;
+  scenario.manualPowerPercent[0] = 50;
+  scenario.manualPowerPercent[1] = 50;
+  scenario.toggles.push_back(BatteryToggle{60000U, 400U, 0});    // short flick: one step
+  scenario.toggles.push_back(BatteryToggle{120000U, 1200U, 0});  // still inside 1.5 s: one step
+  scenario.toggles.push_back(BatteryToggle{180000U, 4000U, 0});  // battery swap: ignored
+  scenario.toggles.push_back(BatteryToggle{240000U, 40U, 1});    // contact bounce: too short to register
+  const DiveMetrics m = runDive(scenario).metrics;
+  report("manual toggles", m);
+
+  TEST_ASSERT_EQUAL_UINT32(2, m.manualSteps[0]);
+  TEST_ASSERT_EQUAL_UINT8(HeatControl::nextManualPowerPercent(HeatControl::nextManualPowerPercent(50)),
+                          m.finalManualPercent[0]);
+  TEST_ASSERT_EQUAL_UINT32(0, m.manualSteps[1]);
+  TEST_ASSERT_EQUAL_UINT8(50, m.finalManualPercent[1]);
+}
+
+namespace {
+
+// Mean heater power of zone `zone` between two trace times, from the cumulative energy.
+float meanWatts(const std::vector<TracePoint> &trace, int zone, uint32_t fromMs, uint32_t toMs) {
+  float fromWh = 0.0F;
+  float toWh = 0.0F;
+  for (const TracePoint &p : trace) {
+    if (p.timeMs == fromMs) fromWh = p.energyWh[zone];
+    if (p.timeMs == toMs) toWh = p.energyWh[zone];
+  }
+  return (toWh - fromWh) * 3600.0F * 1000.0F / static_cast<float>(toMs - fromMs);
+}
+
+}  // namespace
+
+void test_constant_power_manual_mode_holds_watts_through_the_dive() {
+  DiveScenario scenario = defaultDiveScenario();
+  scenario.manualMode = true;
+  const DiveResult duty = runDive(scenario);
+  scenario.manualPowerMode = HeatControl::logic::ManualPowerMode::ConstantPower;
+  const DiveResult constant = runDive(scenario);
+  report("manual 50 %, duty steps", duty.metrics);
+  report("manual 50 %, constant power", constant.metrics);
+
+  const uint32_t early = 10U * MINUTE_MS;
+  const uint32_t late = 150U * MINUTE_MS;
+  const float window = 30U * MINUTE_MS;
+  const float dutyEarly = meanWatts(duty.trace, 0, early, early + window);
+  const float dutyLate = meanWatts(duty.trace, 0, late, late + window);
+  const float constantEarly = meanWatts(constant.trace, 0, early, early + window);
+  const float constantLate = meanWatts(constant.trace, 0, late, late + window);
+  char message[160];
+  snprintf(message, sizeof(message), "heater 1 mean power: duty %.2f -> %.2f W | constant power %.2f -> %.2f W",
+           dutyEarly, dutyLate, constantEarly, constantLate);
+  TEST_MESSAGE(message);
+
+  // Half of the 4 ohm element's 29.2 W at 10.8 V, less the share lost in the pack and MOSFET.
+  const float ratedWatts = HeatControl::logic::manualStepWatts(50, 3, HeatControl::BATTERY_CHEMISTRY_LI_ION, 4.0F);
+  TEST_ASSERT_TRUE(constantEarly > ratedWatts * 0.9F && constantEarly < ratedWatts * 1.02F);
+  TEST_ASSERT_TRUE(constantLate > constantEarly * 0.97F && constantLate < constantEarly * 1.03F);
+  TEST_ASSERT_TRUE(dutyLate < dutyEarly * 0.9F);
+  // Holding the rated power instead of the fresh pack's surplus leaves more charge.
+  TEST_ASSERT_TRUE(constant.metrics.finalTrueSoc[0] > duty.metrics.finalTrueSoc[0]);
+}
+
+void test_pack_chemistry_is_a_scenario_parameter() {
+  // 4S LiFePO4 on heater 1, 6S lead gel on heater 2: the firmware is told the same chemistry.
+  DiveScenario scenario = defaultDiveScenario();
+  scenario.durationMs = 60U * MINUTE_MS;
+  scenario.manualMode = true;
+  scenario.manualPowerMode = HeatControl::logic::ManualPowerMode::ConstantPower;
+  scenario.batteries[0].cells = 4;
+  scenario.batteries[0].chemistry = HeatControl::BATTERY_CHEMISTRY_LI_FE_PO4;
+  scenario.batteries[1].cells = 6;
+  scenario.batteries[1].chemistry = HeatControl::BATTERY_CHEMISTRY_LEAD_GEL;
+  scenario.batteries[1].initialSoc = 0.8F;
+  const DiveResult result = runDive(scenario);
+  report("LiFePO4 4S / lead gel 6S, constant power", result.metrics);
+
+  const uint8_t percent = scenario.manualPowerPercent[0];
+  for (int i = 0; i < 2; ++i) {
+    const BatteryModel &battery = scenario.batteries[i];
+    const float ratedWatts = HeatControl::logic::manualStepWatts(percent, battery.cells, battery.chemistry, 4.0F);
+    const float watts = meanWatts(result.trace, i, 10U * MINUTE_MS, 50U * MINUTE_MS);
+    char message[96];
+    snprintf(message, sizeof(message), "heater %d: %.2f W of %.2f W rated", i + 1, watts, ratedWatts);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(watts > ratedWatts * 0.85F && watts < ratedWatts * 1.02F);
+  }
+  // LiFePO4's flat plateau leaves the voltage-based SoC tens of percent off; lead gel tracks.
+  TEST_ASSERT_UINT32_WITHIN(15, static_cast<uint32_t>(result.metrics.finalTrueSoc[1] * 100.0F + 0.5F),
+                            result.metrics.finalSocPercent[1]);
+}
+
+void test_energy_meter_and_runtime_prediction() {
+  DiveScenario scenario = defaultDiveScenario();
+  scenario.durationMs = 300U * MINUTE_MS;  // long enough to run the packs flat
+  // The simulated cells' open-circuit curve sits up to 10 % SoC below the firmware's Li-ion curve
+  // near empty; the loaded reading happens to cancel that, the sag-corrected one shows it. Feed
+  // the predictor the loaded SoC so this test measures the predictor, not the curve mismatch.
+  scenario.sagCorrection = false;
+  const DiveResult result = runDive(scenario);
+  const DiveMetrics &m = result.metrics;
+  report("5 h PID dive", m);
+
+  // duty * V^2 / R from the filtered pack voltage, against the plant's heater energy.
+  for (int i = 0; i < 2; ++i) {
+    TEST_ASSERT_FLOAT_WITHIN(m.energyWh[i] * 0.03F, m.energyWh[i], m.meteredWh[i]);
+  }
+
+  uint32_t emptyMs = 0;
+  for (const TracePoint &p : result.trace) {
+    if (p.trueSoc[0] <= 0.0F) {
+      emptyMs = p.timeMs;
+      break;
+    }
+  }
+  TEST_ASSERT_TRUE(emptyMs > 0U);
+  for (const TracePoint &p : result.trace) {
+    if (p.timeMs % (15U * MINUTE_MS) != 0U || p.timeMs >= emptyMs) {
+      continue;
+    }
+    const int32_t actual = static_cast<int32_t>((emptyMs - p.timeMs) / MINUTE_MS);
+    const int32_t predicted = p.runtimeLeftMinutes[0];
+    char message[160];
+    snprintf(message, sizeof(message), "t=%3u min: soc %3u %% (true %2.0f %%) | %5.1f Wh | left %4ld min, actual %4ld",
+             static_cast<unsigned>(p.timeMs / MINUTE_MS), p.socPercent[0], p.trueSoc[0] * 100.0F, p.meteredWh[0],
+             static_cast<long>(predicted), static_cast<long>(actual));
+    TEST_MESSAGE(message);
+    if (p.timeMs < 60U * MINUTE_MS) {
+      continue;
+    }
+    // The voltage-based SoC is the weak input: its curve is not the simulated cells' and it moves
+    // with the load. Estimates stay in the right range and converge as the pack runs down.
+    TEST_ASSERT_TRUE(predicted >= 0);
+    TEST_ASSERT_INT32_WITHIN(actual * 6 / 10 + 15, actual, predicted);
+    if (actual <= 30) {
+      TEST_ASSERT_INT32_WITHIN(20, actual, predicted);
+    }
+  }
+}
+
+void test_pack_resistance_and_sag_corrected_soc() {
+  // Manual mode reads the batteries every 50 ms, so the SoC sees both plateaus of every period
+  // (the 1 Hz reading in the other modes stays phase-locked to the 1 s slow-PWM period here).
+  DiveScenario scenario = defaultDiveScenario();
+  scenario.manualMode = true;
+  const DiveResult corrected = runDive(scenario);
+  scenario.sagCorrection = false;
+  const DiveResult loaded = runDive(scenario);
+  report("manual 50 %, SoC from the loaded reading", loaded.metrics);
+
+  // Sag ratio 0.12 / 4.01 ohm times the configured 4 ohm element.
+  for (int i = 0; i < 2; ++i) {
+    TEST_ASSERT_INT32_WITHIN(8, 120, corrected.metrics.sourceMilliOhm[i]);
+    TEST_ASSERT_TRUE(corrected.metrics.sagEdges[i] > 10000U);
+    TEST_ASSERT_FALSE(corrected.metrics.packWeak[i]);
+  }
+
+  // Against the firmware's own curve at the true open-circuit voltage.
+  float restErrorV = 0.0F;
+  float socError[2] = {0.0F, 0.0F};
+  uint32_t points = 0;
+  for (size_t n = 0; n < corrected.trace.size(); ++n) {
+    const TracePoint &c = corrected.trace[n];
+    if (c.timeMs < 30U * MINUTE_MS) {
+      continue;
+    }
+    const float cellOpen = c.openVolts[0] / 3.0F;
+    const float curveSoc =
+        HeatControl::logic_helpers::voltageToSocFloat(cellOpen, HeatControl::BATTERY_CHEMISTRY_LI_ION);
+    restErrorV += std::fabs(c.restVolts[0] - c.openVolts[0]);
+    socError[0] += std::fabs(static_cast<float>(c.socPercent[0]) - curveSoc);
+    socError[1] += std::fabs(static_cast<float>(loaded.trace[n].socPercent[0]) - curveSoc);
+    ++points;
+  }
+  restErrorV /= static_cast<float>(points);
+  socError[0] /= static_cast<float>(points);
+  socError[1] /= static_cast<float>(points);
+  char message[160];
+  snprintf(message, sizeof(message),
+           "rest voltage error %.3f V | SoC error vs curve: corrected %.2f %%, loaded %.2f %%", restErrorV,
+           socError[0], socError[1]);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(restErrorV < 0.05F);
+  TEST_ASSERT_TRUE(socError[0] < 1.5F);
+  TEST_ASSERT_TRUE(socError[1] > socError[0] * 2.0F);
+
+  // A worn pack: five times the source resistance, 15 % sag under the heater.
+  scenario = defaultDiveScenario();
+  scenario.durationMs = 20U * MINUTE_MS;
+  scenario.manualMode = true;  // the PID would hold it full on through the whole warm-up: no edges
+  scenario.batteries[0].internalOhm = 0.6F;
+  const DiveMetrics worn = runDive(scenario).metrics;
+  report("worn pack 1", worn);
+  TEST_ASSERT_INT32_WITHIN(30, 600, worn.sourceMilliOhm[0]);
+  TEST_ASSERT_TRUE(worn.packWeak[0]);
+  TEST_ASSERT_FALSE(worn.packWeak[1]);
+}
+
+void test_simulation_is_deterministic() {
+  DiveScenario scenario = defaultDiveScenario();
+  scenario.durationMs = 20U * MINUTE_MS;
+  scenario.traceIntervalMs = 1000;
+  const DiveResult first = runDive(scenario);
+  const DiveResult second = runDive(scenario);
+  TEST_ASSERT_EQUAL_UINT32(first.trace.size(), second.trace.size());
+  for (size_t i = 0; i < first.trace.size(); ++i) {
+    TEST_ASSERT_EQUAL_MEMORY(&first.trace[i], &second.trace[i], sizeof(TracePoint));
+  }
+  TEST_ASSERT_EQUAL_MEMORY(&first.metrics, &second.metrics, sizeof(DiveMetrics));
+
+  scenario.seed = 7;
+  const DiveResult reseeded = runDive(scenario);
+  TEST_ASSERT_UINT32_WITHIN(1, first.metrics.persistedRuntimeMinutes, reseeded.metrics.persistedRuntimeMinutes);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_pid_dive_holds_band_and_persists_runtime);
+  RUN_TEST(test_weak_mosfet_trips_and_recovers);
+  RUN_TEST(test_manual_toggle_window);
+  RUN_TEST(test_constant_power_manual_mode_holds_watts_through_the_dive);
+  RUN_TEST(test_pack_chemistry_is_a_scenario_parameter);
+  RUN_TEST(test_energy_meter_and_runtime_prediction);
+  RUN_TEST(test_pack_resistance_and_sag_corrected_soc);
+  RUN_TEST(test_simulation_is_deterministic);
+  return UNITY_END();
+}
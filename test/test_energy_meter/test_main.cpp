@@ -0,0 +1,171 @@
+#include <cstdint>
+#include <cstdio>
+
+#include <unity.h>
+
+#include "energy_meter.h"
+
+using namespace HeatControl::logic;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+constexpr uint32_t TICK_MS = 100;
+
+// Pack with a linear SoC: `capacityMicroJoules` of heater energy from 100 % to 0 %.
+int32_t linearSocCenti(uint64_t usedMicroJoules, uint64_t capacityMicroJoules) {
+  if (usedMicroJoules >= capacityMicroJoules) {
+    return 0;
+  }
+  return static_cast<int32_t>(10000ULL - usedMicroJoules * 10000ULL / capacityMicroJoules);
+}
+
+}  // namespace
+
+void test_energy_is_exact_for_constant_power() {
+  EnergyMeter meter;
+  // 12 V into 4 ohm at half duty: 18 W, i.e. 18 Wh after an hour of 100 ms ticks.
+  for (uint32_t t = 0; t < 3600U * 1000U; t += TICK_MS) {
+    meter.add(0, 500, 12000, 4000, TICK_MS);
+  }
+  TEST_ASSERT_EQUAL_UINT64(18ULL * 3600ULL * 1000000ULL, meter.microJoules(0));
+  TEST_ASSERT_EQUAL_UINT32(18000, meter.milliWattHours(0));
+  TEST_ASSERT_EQUAL_UINT32(18000, meter.milliWatts(0));
+  TEST_ASSERT_EQUAL_UINT64(0, meter.microJoules(1));
+}
+
+void test_remainder_is_carried_between_ticks() {
+  EnergyMeter meter;
+  // 1.234 V, 0.3 % duty, 4.7 ohm: 97.19 uJ per tick, so a per-tick floor would lose 0.2 %.
+  const uint32_t ticks = 10000;
+  for (uint32_t i = 0; i < ticks; ++i) {
+    meter.add(1, 3, 1234, 4700, TICK_MS);
+  }
+  const uint64_t numerator = 1234ULL * 1234ULL * 3ULL * TICK_MS * ticks;
+  TEST_ASSERT_EQUAL_UINT64(numerator / 4700000ULL, meter.microJoules(1));
+}
+
+void test_energy_matches_float_integration() {
+  EnergyMeter meter;
+  double referenceJoules = 0.0;
+  uint32_t state = 12345;
+  for (uint32_t i = 0; i < 100000; ++i) {
+    state = state * 1664525U + 1013904223U;
+    const uint16_t duty = static_cast<uint16_t>((state >> 8) % 1001U);
+    const uint16_t milliVolts = static_cast<uint16_t>(9000U + (state >> 16) % 4000U);
+    const uint32_t dtMs = 90U + (state >> 4) % 21U;  // a little tick jitter
+    meter.add(0, duty, milliVolts, 3900, dtMs);
+    const double volts = milliVolts / 1000.0;
+    referenceJoules += volts * volts / 3.9 * duty / 1000.0 * dtMs / 1000.0;
+  }
+  const double meteredJoules = static_cast<double>(meter.microJoules(0)) / 1.0e6;
+  TEST_ASSERT_TRUE(meteredJoules <= referenceJoules + 1.0e-3);
+  TEST_ASSERT_TRUE(referenceJoules - meteredJoules < referenceJoules * 1.0e-9 + 1.0e-6);
+}
+
+void test_zero_inputs_restore_and_reset() {
+  EnergyMeter meter;
+  meter.add(0, 1000, 12000, 4000, TICK_MS);
+  const uint64_t afterOneTick = meter.microJoules(0);
+  meter.add(0, 0, 12000, 4000, TICK_MS);
+  meter.add(0, 1000, 0, 4000, TICK_MS);
+  meter.add(0, 1000, 12000, 0, TICK_MS);  // resistance not configured
+  meter.add(7, 1000, 12000, 4000, TICK_MS);
+  TEST_ASSERT_EQUAL_UINT64(afterOneTick, meter.microJoules(0));
+  TEST_ASSERT_EQUAL_UINT32(0, meter.milliWatts(0));
+
+  meter.restore(1, 123456);
+  TEST_ASSERT_EQUAL_UINT32(123456, meter.milliWattHours(1));
+  meter.add(1, 1000, 12000, 4000, 3600U * 1000U);  // 36 W for an hour
+  TEST_ASSERT_EQUAL_UINT32(123456 + 36000, meter.milliWattHours(1));
+
+  meter.reset();
+  TEST_ASSERT_EQUAL_UINT64(0, meter.microJoules(0));
+  TEST_ASSERT_EQUAL_UINT64(0, meter.microJoules(1));
+}
+
+void test_prediction_on_a_linear_pack() {
+  // 100 Wh pack, 20 W heater: 300 min from full.
+  const uint64_t capacity = 100ULL * 3600ULL * 1000000ULL;
+  EnergyMeter meter;
+  RuntimePredictor predictor;
+  uint32_t firstValidMs = 0;
+  for (uint32_t t = 0; t <= 300U * 60000U; t += TICK_MS) {
+    meter.add(0, 500, 12649, 4000, TICK_MS);  // 12.649^2 / 4 / 2 = 20.0 W
+    predictor.update(t, meter.microJoules(0), linearSocCenti(meter.microJoules(0), capacity));
+    if (predictor.valid() && firstValidMs == 0U) {
+      firstValidMs = t;
+    }
+    if (t % (30U * 60000U) == 0U && t >= 30U * 60000U) {
+      const uint32_t expected = 300U - t / 60000U;
+      TEST_ASSERT_TRUE(predictor.valid());
+      TEST_ASSERT_UINT32_WITHIN(2, expected, predictor.minutesLeft());
+      TEST_ASSERT_UINT32_WITHIN(20, 20000, predictor.averageMilliWatts());
+    }
+  }
+  // 5 % of the pack before the first estimate: 15 min at 20 W.
+  TEST_ASSERT_UINT32_WITHIN(RUNTIME_SAMPLE_MS, 15U * 60000U, firstValidMs);
+  TEST_ASSERT_EQUAL_UINT32(0, predictor.minutesLeft());
+}
+
+void test_prediction_follows_a_power_change() {
+  const uint64_t capacity = 100ULL * 3600ULL * 1000000ULL;
+  EnergyMeter meter;
+  RuntimePredictor predictor;
+  uint32_t t = 0;
+  for (; t < 60U * 60000U; t += TICK_MS) {  // 1 h at 20 W: 80 Wh left
+    meter.add(0, 500, 12649, 4000, TICK_MS);
+    predictor.update(t, meter.microJoules(0), linearSocCenti(meter.microJoules(0), capacity));
+  }
+  for (const uint32_t end = t + 30U * 60000U; t < end; t += TICK_MS) {  // 30 min at 10 W: 75 Wh left
+    meter.add(0, 250, 12649, 4000, TICK_MS);
+    predictor.update(t, meter.microJoules(0), linearSocCenti(meter.microJoules(0), capacity));
+  }
+  // Six power time constants later the mean has settled: 75 Wh at 10 W.
+  TEST_ASSERT_TRUE(predictor.valid());
+  TEST_ASSERT_UINT32_WITHIN(5, 450, predictor.minutesLeft());
+}
+
+void test_prediction_restarts_on_idle_new_pack_and_meter_reset() {
+  RuntimePredictor predictor;
+  // Idle heater: nothing to extrapolate, however far the (self-discharging) SoC falls.
+  for (uint32_t t = 0; t <= 60U * 60000U; t += RUNTIME_SAMPLE_MS) {
+    predictor.update(t, 0, static_cast<int32_t>(9000U - t / 6000U));
+  }
+  TEST_ASSERT_FALSE(predictor.valid());
+
+  // 36 W while the SoC falls 0.48 % per minute: 76.4 % left after 20 min is ~159 min.
+  uint64_t energy = 0;
+  uint32_t t = 60U * 60000U + RUNTIME_SAMPLE_MS;
+  int32_t soc = 8400;
+  for (const uint32_t end = t + 20U * 60000U; t < end; t += RUNTIME_SAMPLE_MS) {
+    energy += 36000ULL * RUNTIME_SAMPLE_MS;
+    soc -= 8;
+    predictor.update(t, energy, soc);
+  }
+  TEST_ASSERT_TRUE(predictor.valid());
+  TEST_ASSERT_UINT32_WITHIN(2, 159, predictor.minutesLeft());
+
+  // A fresh pack: the old energy per percent no longer applies.
+  predictor.update(t, energy + 36000ULL * RUNTIME_SAMPLE_MS, 10000);
+  TEST_ASSERT_FALSE(predictor.valid());
+
+  // The meter was reset (counter cleared from the web UI).
+  predictor.update(t + RUNTIME_SAMPLE_MS, 0, 9900);
+  TEST_ASSERT_FALSE(predictor.valid());
+  TEST_ASSERT_EQUAL_UINT32(0, predictor.averageMilliWatts());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_energy_is_exact_for_constant_power);
+  RUN_TEST(test_remainder_is_carried_between_ticks);
+  RUN_TEST(test_energy_matches_float_integration);
+  RUN_TEST(test_zero_inputs_restore_and_reset);
+  RUN_TEST(test_prediction_on_a_linear_pack);
+  RUN_TEST(test_prediction_follows_a_power_change);
+  RUN_TEST(test_prediction_restarts_on_idle_new_pack_and_meter_reset);
+  return UNITY_END();
+}
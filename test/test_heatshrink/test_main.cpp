@@ -0,0 +1,217 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <unity.h>
+
+#include "heatshrink.h"
+
+using namespace HeatControl::logic;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+// tools/release/compress_firmware.py output (window 8, lookahead 4, header stripped) for referenceInput().
+const uint8_t REFERENCE_STREAM[] = {
+    0x80, 0x00, 0x06, 0x03, 0x02, 0x81, 0xc1, 0x60, 0xf0, 0x98, 0x5c, 0x3a, 0x23, 0x14, 0x8c, 0x47, 0x24, 0x12, 0x49,
+    0x4c, 0xba, 0x67, 0x39, 0x9f, 0xd1, 0x69, 0x75, 0x2a, 0xcd, 0x82, 0xd1, 0x70, 0xbc, 0x60, 0x31, 0x39, 0x2c, 0xde,
+    0x97, 0x5f, 0xb9, 0xe1, 0xf3, 0xbb, 0x34, 0x8b, 0x2d, 0x86, 0xe9, 0x43, 0xb7, 0xdb, 0xae, 0x97, 0x2b, 0x7d, 0xb2,
+    0x41, 0x68, 0x05, 0x95, 0xce, 0xd1, 0x72, 0xb4, 0xdb, 0xad, 0x72, 0x0b, 0x95, 0x96, 0xcd, 0x65, 0x01, 0x8d, 0xba,
+    0xc7, 0x65, 0x90, 0x08, 0x08, 0x41, 0xe2, 0x0f, 0x10, 0x78, 0x83, 0xc4, 0x1e, 0x20, 0xf0,
+};
+
+std::vector<uint8_t> referenceInput() {
+  std::vector<uint8_t> data;
+  for (int i = 0; i < 40; ++i) {
+    data.push_back(static_cast<uint8_t>((i * i / 7) & 0xFF));
+  }
+  const char *text = "HeatControl heatshrink reference ";
+  for (int i = 0; i < 4; ++i) {
+    data.insert(data.end(), text, text + std::strlen(text));
+  }
+  return data;
+}
+
+// Firmware-like test data: runs of code-ish bytes, repeated strings and zero padding.
+std::vector<uint8_t> makeImage(size_t size) {
+  std::vector<uint8_t> data;
+  uint32_t x = 0xC0FFEEUL;
+  while (data.size() < size) {
+    x = x * 1103515245UL + 12345UL;
+    const uint32_t kind = (x >> 16) % 4U;
+    if (kind == 0U) {
+      const char *s = "HTTP /status | client=%u.%u.%u.%u ";
+      data.insert(data.end(), s, s + std::strlen(s));
+    } else if (kind == 1U) {
+      data.insert(data.end(), (x >> 8) % 64U, 0);
+    } else {
+      for (uint32_t i = 0; i < 24U; ++i) {
+        x = x * 1103515245UL + 12345UL;
+        data.push_back(static_cast<uint8_t>(x >> 24));
+      }
+    }
+  }
+  data.resize(size);
+  return data;
+}
+
+// Greedy reference encoder; slow but obviously right.
+std::vector<uint8_t> encode(const std::vector<uint8_t> &data, uint8_t windowBits, uint8_t lookaheadBits) {
+  std::vector<uint8_t> out;
+  uint32_t acc = 0;
+  int bits = 0;
+  const auto put = [&](uint32_t value, int count) {
+    for (int i = count - 1; i >= 0; --i) {
+      acc = (acc << 1) | ((value >> i) & 1U);
+      if (++bits == 8) {
+        out.push_back(static_cast<uint8_t>(acc));
+        acc = 0;
+        bits = 0;
+      }
+    }
+  };
+  const size_t window = 1U << windowBits;
+  const size_t maxLength = 1U << lookaheadBits;
+  size_t i = 0;
+  while (i < data.size()) {
+    size_t bestLength = 0;
+    size_t bestDistance = 0;
+    for (size_t candidate = i > window ? i - window : 0; candidate < i; ++candidate) {
+      size_t length = 0;
+      while (length < maxLength && i + length < data.size() && data[candidate + length] == data[i + length]) {
+        ++length;
+      }
+      if (length >= bestLength) {
+        bestLength = length;
+        bestDistance = i - candidate;
+      }
+    }
+    if (bestLength * 9U > 1U + windowBits + lookaheadBits) {
+      put(0, 1);
+      put(static_cast<uint32_t>(bestDistance - 1U), windowBits);
+      put(static_cast<uint32_t>(bestLength - 1U), lookaheadBits);
+      i += bestLength;
+    } else {
+      put(1, 1);
+      put(data[i], 8);
+      ++i;
+    }
+  }
+  if (bits > 0) {
+    out.push_back(static_cast<uint8_t>(acc << (8 - bits)));
+  }
+  return out;
+}
+
+// Feeds `stream` in `inChunk` pieces and drains output in `outChunk` pieces.
+std::vector<uint8_t> decodeAll(const std::vector<uint8_t> &stream, uint8_t windowBits, uint8_t lookaheadBits,
+                               size_t inChunk, size_t outChunk, size_t expected) {
+  std::vector<uint8_t> window(1U << windowBits);
+  HeatshrinkDecoder decoder;
+  TEST_ASSERT_TRUE(decoder.reset(window.data(), windowBits, lookaheadBits));
+  std::vector<uint8_t> out;
+  std::vector<uint8_t> buffer(outChunk);
+  size_t offset = 0;
+  while (out.size() < expected) {
+    const size_t take = stream.size() - offset < inChunk ? stream.size() - offset : inChunk;
+    const uint8_t *input = stream.data() + offset;
+    size_t inputLength = take;
+    size_t produced = 0;
+    do {
+      produced = decoder.decode(input, inputLength, buffer.data(), buffer.size());
+      out.insert(out.end(), buffer.begin(), buffer.begin() + static_cast<long>(produced));
+    } while (produced == buffer.size());
+    TEST_ASSERT_EQUAL_UINT32(0U, inputLength);
+    offset += take;
+    if (take == 0U) {
+      break;
+    }
+  }
+  return out;
+}
+
+}  // namespace
+
+void test_decodes_reference_stream_in_any_chunking() {
+  const std::vector<uint8_t> expected = referenceInput();
+  const std::vector<uint8_t> stream(REFERENCE_STREAM, REFERENCE_STREAM + sizeof(REFERENCE_STREAM));
+  const size_t inChunks[] = {1, 3, 91};
+  const size_t outChunks[] = {1, 5, 4096};
+  for (size_t in : inChunks) {
+    for (size_t outChunk : outChunks) {
+      const std::vector<uint8_t> out = decodeAll(stream, 8, 4, in, outChunk, expected.size());
+      TEST_ASSERT_EQUAL_UINT32(expected.size(), out.size());
+      TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), out.data(), expected.size());
+    }
+  }
+}
+
+void test_round_trips_firmware_like_data() {
+  const std::vector<uint8_t> image = makeImage(48000);
+  const std::vector<uint8_t> stream = encode(image, 10, 4);
+  TEST_ASSERT_TRUE(stream.size() < image.size() * 3U / 4U);
+  const std::vector<uint8_t> out = decodeAll(stream, 10, 4, 1436, 4096, image.size());
+  TEST_ASSERT_EQUAL_UINT32(image.size(), out.size());
+  TEST_ASSERT_TRUE(out == image);
+}
+
+void test_rejects_unsupported_parameters() {
+  uint8_t window[256];
+  HeatshrinkDecoder decoder;
+  TEST_ASSERT_FALSE(decoder.reset(nullptr, 8, 4));
+  TEST_ASSERT_FALSE(decoder.reset(window, 7, 4));
+  TEST_ASSERT_FALSE(decoder.reset(window, 16, 4));
+  TEST_ASSERT_FALSE(decoder.reset(window, 8, 8));
+  TEST_ASSERT_FALSE(decoder.reset(window, 8, 2));
+  TEST_ASSERT_TRUE(decoder.reset(window, 8, 4));
+
+  // An un-reset decoder produces nothing instead of touching a null window.
+  HeatshrinkDecoder fresh;
+  const uint8_t input[] = {0xFF};
+  const uint8_t *cursor = input;
+  size_t length = sizeof(input);
+  uint8_t out[4];
+  TEST_ASSERT_EQUAL_UINT32(0U, fresh.decode(cursor, length, out, sizeof(out)));
+}
+
+void test_decode_benchmark() {
+  const std::vector<uint8_t> image = makeImage(256U * 1024U);
+  const std::vector<uint8_t> stream = encode(image, 10, 4);
+  std::vector<uint8_t> window(1U << 10);
+  std::vector<uint8_t> block(4096);
+  HeatshrinkDecoder decoder;
+
+  constexpr int rounds = 8;
+  size_t total = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; ++r) {
+    decoder.reset(window.data(), 10, 4);
+    const uint8_t *input = stream.data();
+    size_t inputLength = stream.size();
+    size_t produced = 0;
+    do {
+      produced = decoder.decode(input, inputLength, block.data(), block.size());
+      total += produced;
+    } while (produced > 0U);
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  TEST_ASSERT_EQUAL_UINT32(image.size() * rounds, total);
+
+  char message[128];
+  snprintf(message, sizeof(message), "heatshrink decode: %.1f MB/s output, stream %.1f %% of image",
+           static_cast<double>(total) / seconds / 1e6, 100.0 * stream.size() / image.size());
+  TEST_MESSAGE(message);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_decodes_reference_stream_in_any_chunking);
+  RUN_TEST(test_round_trips_firmware_like_data);
+  RUN_TEST(test_rejects_unsupported_parameters);
+  RUN_TEST(test_decode_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,113 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <unity.h>
+
+#include "json_writer.h"
+
+using namespace HeatControl;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+// Reference for fieldFixed(): the formatting status_builder used before the writer existed.
+void printfFixed(float value, int decimals, char *out, size_t outSize) {
+  const float scale = std::pow(10.0F, static_cast<float>(decimals));
+  const float rounded = std::round(value * scale) / scale;
+  snprintf(out, outSize, "%.*f", decimals, static_cast<double>(rounded));
+}
+
+}  // namespace
+
+void test_object_with_mixed_fields() {
+  char buffer[128];
+  JsonWriter w(buffer, sizeof(buffer));
+  w.beginObject();
+  w.field("s", "a\"b\\c\nd\re");
+  w.fieldBool("on", true);
+  w.fieldBool("off", false);
+  w.fieldUint("u", 4294967295U);
+  w.fieldInt("i", -2147483647 - 1);
+  w.fieldFixed("f", 23.456F, 1);
+  w.fieldNull("n");
+  w.endObject();
+  TEST_ASSERT_FALSE(w.overflowed());
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"s\":\"a\\\"b\\\\c\\nd\\re\",\"on\":1,\"off\":0,\"u\":4294967295,\"i\":-2147483648,\"f\":23.5,\"n\":null}",
+      buffer);
+  TEST_ASSERT_EQUAL(std::strlen(buffer), w.size());
+}
+
+void test_rollback_drops_fields_and_separators() {
+  char buffer[64];
+  JsonWriter w(buffer, sizeof(buffer));
+  w.beginObject();
+  const JsonWriter::Mark first = w.mark();
+  w.fieldUint("a", 1);
+  w.rollback(first);
+  w.fieldUint("b", 2);
+  const JsonWriter::Mark second = w.mark();
+  w.field("c", "x");
+  w.rollback(second);
+  w.fieldBool("d", true);
+  w.endObject();
+  TEST_ASSERT_EQUAL_STRING("{\"b\":2,\"d\":1}", buffer);
+  TEST_ASSERT_EQUAL(std::strlen(buffer), w.size());
+}
+
+void test_fixed_point_matches_printf_rounding() {
+  const float values[] = {0.0F,    -0.0F,   0.005F,  -0.004F, 1.005F,  2.675F,  23.45F,   -127.0F,
+                          42.5F,   81.23F,  0.001F,  0.1F,    9.99999F, 3.14159F, -3.14159F, 1234.5678F,
+                          80.0F,   11.5F,   0.00005F, 99.995F, -0.5F,   0.49999997F, 65535.25F, 4.2F};
+  char expected[48];
+  char actual[64];
+  for (float value : values) {
+    for (uint8_t decimals = 0; decimals <= 5; ++decimals) {
+      // Past 2^23 a float has no digits left at that decimal; both variants only print noise there.
+      if (std::fabs(value) * std::pow(10.0F, static_cast<float>(decimals)) >= 8388608.0F) {
+        continue;
+      }
+      printfFixed(value, decimals, expected, sizeof(expected));
+      JsonWriter w(actual, sizeof(actual));
+      w.fieldFixed("v", value, decimals);
+      TEST_ASSERT_EQUAL_STRING(expected, actual + 4);
+    }
+  }
+}
+
+void test_non_finite_and_huge_values_become_null() {
+  char buffer[64];
+  JsonWriter w(buffer, sizeof(buffer));
+  w.fieldFixed("a", NAN, 2);
+  w.fieldFixed("b", INFINITY, 1);
+  w.fieldFixed("c", 1.0e17F, 2);
+  TEST_ASSERT_EQUAL_STRING("\"a\":null,\"b\":null,\"c\":null", buffer);
+}
+
+void test_overflow_truncates_and_reports() {
+  char buffer[12];
+  JsonWriter w(buffer, sizeof(buffer));
+  w.beginObject();
+  w.field("key", "a long value");
+  w.endObject();
+  TEST_ASSERT_TRUE(w.overflowed());
+  TEST_ASSERT_EQUAL(sizeof(buffer) - 1, w.size());
+  TEST_ASSERT_EQUAL(sizeof(buffer) - 1, std::strlen(buffer));
+
+  JsonWriter none(nullptr, 0);
+  none.fieldUint("x", 1);
+  TEST_ASSERT_TRUE(none.overflowed());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_object_with_mixed_fields);
+  RUN_TEST(test_rollback_drops_fields_and_separators);
+  RUN_TEST(test_fixed_point_matches_printf_rounding);
+  RUN_TEST(test_non_finite_and_huge_values_become_null);
+  RUN_TEST(test_overflow_truncates_and_reports);
+  return UNITY_END();
+}
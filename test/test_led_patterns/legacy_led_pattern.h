@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+
+#include "control_logic.h"
+#include "signal_sequencer.h"
+
+// The hand-written LED state machine that StatusOutputs replaced, kept as the reference for the
+// equivalence tests. Only the pin access (IGpio) and the preset source (argument) differ, and
+// refresh() rewrites the cached level at once: the original deferred that to the next phase
+// change, which could leave an LED dark for one phase after a signal pattern.
+class LegacyLedPattern {
+ public:
+  LegacyLedPattern(int pin, HeatControl::logic::IGpio &gpio) : pin_(pin), gpio_(gpio) {}
+
+  void refresh() { gpio_.writePin(pin_, outputOn_ ? HeatControl::logic::PIN_HIGH : HeatControl::logic::PIN_LOW); }
+
+  void setBaseOn(bool on) { baseOn_ = on; }
+
+  void setTripLatched(bool latched) {
+    if (tripLatched_ == latched) {
+      return;
+    }
+    tripLatched_ = latched;
+    sosPulseIndex_ = 0;
+    sosPhaseOn_ = false;
+    sosPhaseUntilMs_ = 0;
+  }
+
+  void triggerManualPowerStepFromPercent(uint8_t manualPowerPercent) {
+    stepBlinksRemaining_ = HeatControl::manualPowerStepPulses(manualPowerPercent);
+    stepPhaseOn_ = false;
+    stepPhaseUntilMs_ = 0;
+  }
+
+  void update(unsigned long nowMs, HeatControl::SignalTimingPreset preset) {
+    if (tripLatched_) {
+      updateTrip(nowMs);
+      return;
+    }
+    if (stepBlinksRemaining_ > 0) {
+      updateStepBlink(nowMs, preset);
+      return;
+    }
+    setOutput(baseOn_);
+  }
+
+ private:
+  void setOutput(bool on) {
+    if (outputOn_ == on) {
+      return;
+    }
+    outputOn_ = on;
+    gpio_.writePin(pin_, on ? HeatControl::logic::PIN_HIGH : HeatControl::logic::PIN_LOW);
+  }
+
+  void updateStepBlink(unsigned long nowMs, HeatControl::SignalTimingPreset preset) {
+    if (stepPhaseUntilMs_ != 0 && nowMs < stepPhaseUntilMs_) {
+      return;
+    }
+    if (!stepPhaseOn_) {
+      stepPhaseOn_ = true;
+      setOutput(true);
+      stepPhaseUntilMs_ = nowMs + HeatControl::scaleSignalMs(130, preset);
+      return;
+    }
+    stepPhaseOn_ = false;
+    setOutput(false);
+    stepPhaseUntilMs_ = nowMs + HeatControl::scaleSignalMs(130, preset);
+    if (stepBlinksRemaining_ > 0) {
+      --stepBlinksRemaining_;
+    }
+    if (stepBlinksRemaining_ == 0) {
+      stepPhaseUntilMs_ = nowMs + HeatControl::scaleSignalMs(600, preset);
+    }
+  }
+
+  void updateTrip(unsigned long nowMs) {
+    if (sosPhaseUntilMs_ != 0 && nowMs < sosPhaseUntilMs_) {
+      return;
+    }
+    if (sosPulseIndex_ >= 9) {
+      sosPulseIndex_ = 0;
+      sosPhaseOn_ = false;
+      setOutput(false);
+      sosPhaseUntilMs_ = nowMs + 800;
+      return;
+    }
+    if (!sosPhaseOn_) {
+      sosPhaseOn_ = true;
+      setOutput(true);
+      sosPhaseUntilMs_ = nowMs + ((sosPulseIndex_ >= 3 && sosPulseIndex_ <= 5) ? 450 : 150);
+      return;
+    }
+    sosPhaseOn_ = false;
+    setOutput(false);
+    sosPhaseUntilMs_ = nowMs + 150;
+    ++sosPulseIndex_;
+  }
+
+  int pin_;
+  HeatControl::logic::IGpio &gpio_;
+  bool baseOn_ = false;
+  bool tripLatched_ = false;
+  bool outputOn_ = false;
+  uint8_t stepBlinksRemaining_ = 0;
+  bool stepPhaseOn_ = false;
+  unsigned long stepPhaseUntilMs_ = 0;
+  uint8_t sosPulseIndex_ = 0;
+  bool sosPhaseOn_ = false;
+  unsigned long sosPhaseUntilMs_ = 0;
+};
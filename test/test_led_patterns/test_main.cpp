@@ -0,0 +1,289 @@
+#include <chrono>
+#include <cstdio>
+
+#include <unity.h>
+
+#include "led_patterns.h"
+#include "legacy_led_pattern.h"
+
+using namespace HeatControl;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+constexpr int LED1 = 8;
+constexpr int LED2 = 9;
+constexpr int SIGNAL = 6;
+constexpr SignalTimingPreset ALL_PRESETS[] = {SignalTimingPreset::Short, SignalTimingPreset::Middle,
+                                              SignalTimingPreset::Fast};
+
+class RecordingGpio : public logic::IGpio {
+ public:
+  RecordingGpio() {
+    levels[LED1] = logic::PIN_LOW;
+    levels[LED2] = logic::PIN_LOW;
+    levels[SIGNAL] = logic::PIN_HIGH;
+  }
+  void writePin(int pin, int level) override {
+    levels[pin] = level;
+    ++writes;
+  }
+  int readPin(int pin) const override { return levels[pin]; }
+
+  int levels[16] = {};
+  uint32_t writes = 0;
+};
+
+// The loop() glue before the pattern engine: the signal sequencer wrote all three pins on level
+// changes and the LED patterns paused while it ran, rewriting their state afterwards.
+class LegacyOutputs {
+ public:
+  LegacyOutputs() : led1_(LED1, gpio), led2_(LED2, gpio) {}
+
+  LegacyLedPattern &led(uint8_t index) { return index == 0 ? led1_ : led2_; }
+
+  void loop(unsigned long nowMs, SignalTimingPreset preset, bool signalActive, bool signalOn) {
+    if (signalOn != signalOutputOn_) {
+      signalOutputOn_ = signalOn;
+      gpio.writePin(SIGNAL, signalOn ? logic::PIN_LOW : logic::PIN_HIGH);
+      gpio.writePin(LED1, signalOn ? logic::PIN_HIGH : logic::PIN_LOW);
+      gpio.writePin(LED2, signalOn ? logic::PIN_HIGH : logic::PIN_LOW);
+    }
+    if (!signalActive) {
+      if (signalWasActive_) {
+        led1_.refresh();
+        led2_.refresh();
+      }
+      led1_.update(nowMs, preset);
+      led2_.update(nowMs, preset);
+    }
+    signalWasActive_ = signalActive;
+  }
+
+  RecordingGpio gpio;
+
+ private:
+  LegacyLedPattern led1_;
+  LegacyLedPattern led2_;
+  bool signalOutputOn_ = false;
+  bool signalWasActive_ = false;
+};
+
+struct Rig {
+  Rig() : outputs(LED1, LED2, SIGNAL) { outputs.begin(gpio); }
+
+  void setBaseOn(uint8_t led, bool on) {
+    legacy.led(led).setBaseOn(on);
+    outputs.setBaseOn(led, on);
+  }
+  void setTripLatched(uint8_t led, bool latched) {
+    legacy.led(led).setTripLatched(latched);
+    outputs.setTripLatched(led, latched);
+  }
+  void triggerStep(uint8_t led, uint8_t percent) {
+    legacy.led(led).triggerManualPowerStepFromPercent(percent);
+    outputs.triggerManualPowerStepFromPercent(led, percent);
+  }
+
+  // One loop() pass on both implementations; fails on the first differing pin.
+  void loop(unsigned long nowMs, SignalTimingPreset preset) {
+    bool signalOn = signals.update(nowMs);
+    const bool signalActive = signals.active();
+    legacy.loop(nowMs, preset, signalActive, signalOn);
+    outputs.setSignal(signalActive, signalOn);
+    outputs.tick(nowMs, preset, gpio);
+    const int pins[] = {LED1, LED2, SIGNAL};
+    for (int pin : pins) {
+      if (legacy.gpio.levels[pin] != gpio.levels[pin]) {
+        char message[96];
+        snprintf(message, sizeof(message), "pin %d differs at %lu ms: legacy %d, engine %d", pin, nowMs,
+                 legacy.gpio.levels[pin], gpio.levels[pin]);
+        TEST_FAIL_MESSAGE(message);
+      }
+    }
+  }
+
+  void run(unsigned long fromMs, unsigned long toMs, SignalTimingPreset preset) {
+    for (unsigned long t = fromMs; t < toMs; ++t) {
+      loop(t, preset);
+    }
+  }
+
+  LegacyOutputs legacy;
+  RecordingGpio gpio;
+  StatusOutputs outputs;
+  SignalSequencer signals;
+};
+
+uint32_t nextRandom(uint32_t &state) {
+  state = state * 1664525UL + 1013904223UL;
+  return state >> 8;
+}
+
+}  // namespace
+
+void test_step_blinks_match_legacy_for_every_preset() {
+  const uint8_t percents[] = {25, 50, 75, 100};
+  for (SignalTimingPreset preset : ALL_PRESETS) {
+    for (uint8_t percent : percents) {
+      for (int base = 0; base < 2; ++base) {
+        Rig rig;
+        rig.setBaseOn(0, base != 0);
+        rig.run(0, 100, preset);
+        rig.triggerStep(0, percent);
+        rig.run(100, 2000, preset);
+        // Retriggered in the middle of a blink.
+        rig.triggerStep(0, 100);
+        rig.run(2000, 2100, preset);
+        rig.triggerStep(0, percent);
+        rig.run(2100, 4000, preset);
+      }
+    }
+  }
+}
+
+void test_trip_sos_matches_legacy_and_pauses_steps() {
+  Rig rig;
+  rig.setBaseOn(0, true);
+  rig.setBaseOn(1, true);
+  rig.run(0, 50, SignalTimingPreset::Middle);
+  rig.setTripLatched(0, true);
+  rig.run(50, 12000, SignalTimingPreset::Middle);
+  // A step requested while tripped plays once the trip clears.
+  rig.triggerStep(0, 75);
+  rig.triggerStep(1, 50);
+  rig.run(12000, 12200, SignalTimingPreset::Middle);
+  rig.setTripLatched(1, true);
+  rig.run(12200, 15000, SignalTimingPreset::Middle);
+  rig.setTripLatched(0, false);
+  rig.setTripLatched(1, false);
+  rig.run(15000, 17000, SignalTimingPreset::Middle);
+  TEST_ASSERT_TRUE(rig.outputs.ledOn(0));
+  TEST_ASSERT_TRUE(rig.outputs.ledOn(1));
+}
+
+void test_signal_patterns_own_all_outputs_and_hand_back() {
+  for (SignalTimingPreset preset : ALL_PRESETS) {
+    Rig rig;
+    rig.setBaseOn(1, true);
+    rig.run(0, 10, preset);
+    TEST_ASSERT_TRUE(enqueueStartupSignal(rig.signals, true, true, 100, preset));
+    rig.triggerStep(0, 50);
+    rig.run(10, 20, preset);
+    TEST_ASSERT_TRUE(rig.outputs.signalOn());
+    TEST_ASSERT_EQUAL_INT(logic::PIN_LOW, rig.gpio.levels[SIGNAL]);
+    rig.run(20, 4000, preset);
+    TEST_ASSERT_TRUE(enqueueTestPulse(rig.signals, preset));
+    rig.setTripLatched(1, true);
+    rig.run(4000, 8000, preset);
+    TEST_ASSERT_FALSE(rig.outputs.signalOn());
+    TEST_ASSERT_EQUAL_INT(logic::PIN_HIGH, rig.gpio.levels[SIGNAL]);
+  }
+}
+
+void test_random_event_sequences_match_legacy() {
+  for (uint32_t seed = 1; seed <= 8; ++seed) {
+    Rig rig;
+    uint32_t state = seed;
+    SignalTimingPreset preset = SignalTimingPreset::Middle;
+    unsigned long now = 0;
+    while (now < 10UL * 60UL * 1000UL) {
+      // loop() passes are irregular: mostly back to back, sometimes stalled by WiFi or flash work.
+      const uint32_t gap = nextRandom(state) % 100U;
+      now += (gap < 90U) ? 1U + gap % 3U : 5U + nextRandom(state) % 60U;
+      const uint32_t event = nextRandom(state) % 4000U;
+      const uint8_t led = static_cast<uint8_t>(nextRandom(state) & 1U);
+      if (event < 8U) {
+        rig.setBaseOn(led, (nextRandom(state) & 1U) != 0U);
+      } else if (event < 10U) {
+        rig.setTripLatched(led, (nextRandom(state) % 3U) == 0U);
+      } else if (event < 16U) {
+        rig.triggerStep(led, static_cast<uint8_t>(25U * (1U + nextRandom(state) % 4U)));
+      } else if (event < 18U) {
+        enqueueManualPowerSignal(rig.signals, 50, (nextRandom(state) & 1U) != 0U, preset);
+      } else if (event < 19U) {
+        enqueueTestPulse(rig.signals, preset);
+      } else if (event < 20U) {
+        preset = clampSignalTimingPreset(static_cast<uint8_t>(nextRandom(state) % 3U));
+      }
+      rig.loop(now, preset);
+    }
+  }
+}
+
+void test_vm_repeat_loop_and_layer_handover() {
+  static constexpr logic::PatternOp ops[] = {
+      logic::patternOn(10), logic::patternOff(10), logic::patternRepeat(0, 2),
+      logic::patternOn(5),  logic::patternEnd(),
+  };
+  static constexpr logic::PatternProgram program = logic::patternProgram(ops, false);
+  logic::PatternScheduler scheduler;
+  TEST_ASSERT_EQUAL_INT(0, scheduler.addOutput(1, false));
+  RecordingGpio gpio;
+  scheduler.begin(gpio);
+  scheduler.hold(0, 3, true);
+  scheduler.play(0, 1, program);
+
+  // on 0-10, off 10-20, on 20-30, off 30-40, on 40-45, then the held base level in the same tick.
+  const bool expected[] = {true, false, true, false, true};
+  for (unsigned long t = 0; t < 45; ++t) {
+    scheduler.tick(t, SignalTimingPreset::Middle, gpio);
+    TEST_ASSERT_EQUAL(expected[t / 10], scheduler.outputOn(0));
+  }
+  TEST_ASSERT_TRUE(scheduler.playing(0, 1));
+  const uint32_t writes = gpio.writes;
+  scheduler.tick(45, SignalTimingPreset::Middle, gpio);
+  TEST_ASSERT_FALSE(scheduler.playing(0, 1));
+  TEST_ASSERT_TRUE(scheduler.outputOn(0));
+  TEST_ASSERT_EQUAL_UINT32(writes, gpio.writes);  // on -> on: no pin write
+
+  // Holding the same level again does not restart anything; a loop without a wait ends the program.
+  scheduler.hold(0, 3, true);
+  static constexpr logic::PatternOp spin[] = {logic::patternLoop(0)};
+  scheduler.play(0, 0, logic::patternProgram(spin, false));
+  scheduler.tick(46, SignalTimingPreset::Middle, gpio);
+  TEST_ASSERT_FALSE(scheduler.playing(0, 0));
+  TEST_ASSERT_TRUE(scheduler.outputOn(0));
+  TEST_ASSERT_EQUAL_UINT32(writes, gpio.writes);
+
+  for (int i = 1; i < logic::PATTERN_MAX_OUTPUTS; ++i) {
+    TEST_ASSERT_EQUAL_INT(i, scheduler.addOutput(i + 1, false));
+  }
+  TEST_ASSERT_EQUAL_INT(-1, scheduler.addOutput(10, false));
+}
+
+void test_tick_cost() {
+  StatusOutputs outputs(LED1, LED2, SIGNAL);
+  RecordingGpio gpio;
+  outputs.begin(gpio);
+  outputs.setBaseOn(0, true);
+  outputs.setTripLatched(1, true);
+  const unsigned long ticks = 2000000;
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned long t = 0; t < ticks; ++t) {
+    if ((t % 5000U) == 0U) {
+      outputs.triggerManualPowerStepFromPercent(0, 100);
+    }
+    outputs.setSignal(false, false);
+    outputs.tick(t, SignalTimingPreset::Middle, gpio);
+  }
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  char message[96];
+  snprintf(message, sizeof(message), "status outputs: %.1f ns/tick for 3 outputs, %u pin writes", ns / ticks,
+           static_cast<unsigned>(gpio.writes));
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(gpio.writes < ticks / 50U);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_step_blinks_match_legacy_for_every_preset);
+  RUN_TEST(test_trip_sos_matches_legacy_and_pauses_steps);
+  RUN_TEST(test_signal_patterns_own_all_outputs_and_hand_back);
+  RUN_TEST(test_random_event_sequences_match_legacy);
+  RUN_TEST(test_vm_repeat_loop_and_layer_handover);
+  RUN_TEST(test_tick_cost);
+  return UNITY_END();
+}
@@ -1,3 +1,5 @@
+#include <chrono>
+#include <cstdio>
 #include <string>
 
 #include <unity.h>
@@ -100,6 +102,28 @@ void test_soc_smoothing_uses_ema() {
   TEST_ASSERT_TRUE(socPercent < 100);
 }
 
+void test_soc_uses_rest_voltage_but_reports_measured_pack() {
+  float packV = 0.0F;
+  float cellV = 0.0F;
+  uint8_t loadedPercent = 0;
+  uint8_t restPercent = 0;
+  float loadedSoc = 0.0F;
+  float restSoc = 0.0F;
+  bool loadedInitialized = false;
+  bool restInitialized = false;
+
+  // 10.8 V under load, 11.1 V once the sag is added back.
+  const float loadedRaw = updateBatteryFromAdc(2700U, 3, 4.0F, packV, cellV, HeatControl::BATTERY_CHEMISTRY_LI_ION,
+                                               loadedSoc, loadedInitialized, loadedPercent);
+  const float restRaw = updateBatteryFromAdc(2700U, 3, 4.0F, packV, cellV, HeatControl::BATTERY_CHEMISTRY_LI_ION,
+                                             restSoc, restInitialized, restPercent, 2775U);
+  TEST_ASSERT_FLOAT_WITHIN(0.001F, 10.8F, packV);
+  TEST_ASSERT_FLOAT_WITHIN(0.001F, 3.6F, cellV);
+  TEST_ASSERT_FLOAT_WITHIN(0.01F, voltageToSocFloat(3.7F, HeatControl::BATTERY_CHEMISTRY_LI_ION), restRaw);
+  TEST_ASSERT_TRUE(restRaw > loadedRaw);
+  TEST_ASSERT_TRUE(restPercent > loadedPercent);
+}
+
 void test_ntc_rejects_invalid_ranges() {
   float temp = 0.0F;
   TEST_ASSERT_FALSE(ntcMilliVoltsToTempC(0U, 3300.0F, 10000.0F, 10000.0F, 3950.0F, 25.0F, temp));
@@ -121,29 +145,180 @@ void test_ntc_high_voltage_value() {
   TEST_ASSERT_FLOAT_WITHIN(0.5F, 69.56F, temp);
 }
 
-void test_log_buffer_within_bounds() {
-  char buffer[32] = {0};
-  size_t len = 0;
-  appendLineToRollingBuffer(buffer, sizeof(buffer), len, "Hello", 5);
-  appendLineToRollingBuffer(buffer, sizeof(buffer), len, "\n", 1);
-  TEST_ASSERT_EQUAL_STRING("Hello\n", buffer);
+void test_ntc_fixed_point_matches_float() {
+  int32_t centi = 0;
+  TEST_ASSERT_FALSE(ntcMilliVoltsToCentiC(0U, centi));
+  TEST_ASSERT_FALSE(ntcMilliVoltsToCentiC(3300U, centi));
+  TEST_ASSERT_TRUE(ntcMilliVoltsToCentiC(1650U, centi));
+  TEST_ASSERT_INT32_WITHIN(5, 2500, centi);
+
+  for (uint16_t mv = 100; mv <= 3000; ++mv) {
+    float temp = 0.0F;
+    TEST_ASSERT_TRUE(ntcMilliVoltsToTempC(mv, NTC_VCC_MV, NTC_SERIES_RESISTOR_OHM, NTC_NOMINAL_RESISTANCE_OHM, NTC_BETA,
+                                          NTC_NOMINAL_TEMP_C, temp));
+    TEST_ASSERT_TRUE(ntcMilliVoltsToCentiC(mv, centi));
+    TEST_ASSERT_INT32_WITHIN(5, static_cast<int32_t>(temp * 100.0F + (temp < 0.0F ? -0.5F : 0.5F)), centi);
+  }
+  TEST_ASSERT_TRUE(ntcMilliVoltsToCentiC(3299U, centi));
+  TEST_ASSERT_TRUE(centi > 30000);
+}
+
+void test_soc_fixed_point_matches_float() {
+  TEST_ASSERT_EQUAL_INT32(7300, voltageToSocCenti(3900U, HeatControl::BATTERY_CHEMISTRY_LI_ION));
+  TEST_ASSERT_EQUAL_INT32(10000, voltageToSocCenti(4500U, HeatControl::BATTERY_CHEMISTRY_LI_ION));
+  TEST_ASSERT_EQUAL_INT32(-262, voltageToSocCenti(2700U, HeatControl::BATTERY_CHEMISTRY_LI_ION));
+
+  for (uint8_t chemistry = 0; chemistry <= HeatControl::BATTERY_CHEMISTRY_LEAD_GEL; ++chemistry) {
+    for (uint16_t mv = 500; mv <= 4500; ++mv) {
+      const float soc = voltageToSocFloat(static_cast<float>(mv) / 1000.0F, chemistry);
+      TEST_ASSERT_INT32_WITHIN(1, static_cast<int32_t>(soc * 100.0F + (soc < 0.0F ? -0.5F : 0.5F)),
+                               voltageToSocCenti(mv, chemistry));
+    }
+  }
+}
+
+template <typename F>
+double nanosPerOp(F op) {
+  constexpr int rounds = 200;
+  const auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; ++r) {
+    for (uint16_t mv = 1; mv < 3300; ++mv) {
+      op(mv);
+    }
+  }
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (rounds * 3299.0);
+}
+
+void test_conversion_kernel_benchmark() {
+  volatile float floatSink = 0.0F;
+  volatile int32_t fixedSink = 0;
+  const double ntcFloat = nanosPerOp([&](uint16_t mv) {
+    float temp = 0.0F;
+    ntcMilliVoltsToTempC(mv, NTC_VCC_MV, NTC_SERIES_RESISTOR_OHM, NTC_NOMINAL_RESISTANCE_OHM, NTC_BETA,
+                         NTC_NOMINAL_TEMP_C, temp);
+    floatSink = temp;
+  });
+  const double ntcFixed = nanosPerOp([&](uint16_t mv) {
+    int32_t centi = 0;
+    ntcMilliVoltsToCentiC(mv, centi);
+    fixedSink = centi;
+  });
+  const double socFloat = nanosPerOp([&](uint16_t mv) {
+    floatSink = voltageToSocFloat(static_cast<float>(mv + 1000U) / 1000.0F, HeatControl::BATTERY_CHEMISTRY_LI_ION);
+  });
+  const double socFixed = nanosPerOp([&](uint16_t mv) {
+    fixedSink = voltageToSocCenti(static_cast<uint16_t>(mv + 1000U), HeatControl::BATTERY_CHEMISTRY_LI_ION);
+  });
+
+  char message[160];
+  snprintf(message, sizeof(message), "ntc: float %.1f ns/op, fixed %.1f ns/op; soc: float %.1f ns/op, fixed %.1f ns/op",
+           ntcFloat, ntcFixed, socFloat, socFixed);
+  TEST_MESSAGE(message);
+}
+
+std::string readAll(const LogRing &ring, uint32_t position) {
+  std::string out;
+  char chunk[5];
+  const uint32_t end = ring.endPosition();
+  size_t n = 0;
+  while ((n = ring.read(position, end, chunk, sizeof(chunk))) > 0U) {
+    out.append(chunk, n);
+  }
+  return out;
+}
+
+void test_log_ring_within_bounds() {
+  char storage[32];
+  LogRing ring(storage, sizeof(storage));
+  ring.append("Hello", 5);
+  ring.append("World", 5);
+  TEST_ASSERT_EQUAL_STRING("Hello\nWorld\n", readAll(ring, ring.positionOf(0)).c_str());
+  TEST_ASSERT_EQUAL_UINT32(0, ring.firstSeq());
+  TEST_ASSERT_EQUAL_UINT32(2, ring.nextSeq());
+}
+
+void test_log_ring_overflow_discards_oldest_lines() {
+  char storage[16];
+  LogRing ring(storage, sizeof(storage));
+  ring.append("123456", 6);
+  ring.append("ABCDEF", 6);
+  ring.append("xyz", 3);
+  // Only whole lines are dropped: "123456\n" had to go to fit "xyz\n".
+  TEST_ASSERT_EQUAL_UINT32(1, ring.firstSeq());
+  TEST_ASSERT_EQUAL_UINT32(11, ring.size());
+  TEST_ASSERT_EQUAL_STRING("ABCDEF\nxyz\n", readAll(ring, ring.positionOf(0)).c_str());
+}
+
+void test_log_ring_keeps_tail_of_oversized_line() {
+  char storage[8];
+  LogRing ring(storage, sizeof(storage));
+  ring.append("old", 3);
+  ring.append("ABCDEFGHIJKLMNOPQRSTUVWXYZ", 26);
+  TEST_ASSERT_EQUAL_STRING("TUVWXYZ\n", readAll(ring, ring.positionOf(0)).c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, ring.firstSeq());
+  TEST_ASSERT_EQUAL_UINT32(2, ring.nextSeq());
+}
+
+void test_log_ring_wraparound_and_cursor() {
+  char storage[20];
+  LogRing ring(storage, sizeof(storage));
+  char line[8];
+  for (int i = 0; i < 50; ++i) {
+    const int len = snprintf(line, sizeof(line), "L%02d", i);
+    ring.append(line, static_cast<size_t>(len));
+  }
+  // 4 bytes per line, so the last 5 lines fit.
+  TEST_ASSERT_EQUAL_UINT32(45, ring.firstSeq());
+  TEST_ASSERT_EQUAL_UINT32(50, ring.nextSeq());
+  TEST_ASSERT_EQUAL_STRING("L45\nL46\nL47\nL48\nL49\n", readAll(ring, ring.positionOf(45)).c_str());
+  TEST_ASSERT_EQUAL_STRING("L48\nL49\n", readAll(ring, ring.positionOf(48)).c_str());
+  // A cursor older than the ring resolves to the oldest line, a current one to nothing new.
+  TEST_ASSERT_EQUAL_STRING("L45\nL46\nL47\nL48\nL49\n", readAll(ring, ring.positionOf(3)).c_str());
+  TEST_ASSERT_EQUAL_STRING("", readAll(ring, ring.positionOf(ring.nextSeq())).c_str());
+  TEST_ASSERT_EQUAL_STRING("", readAll(ring, ring.positionOf(ring.nextSeq() + 7U)).c_str());
+}
+
+void test_log_ring_reader_skips_overwritten_bytes() {
+  char storage[9];
+  LogRing ring(storage, sizeof(storage));
+  ring.append("aa", 2);
+  ring.append("bb", 2);
+  uint32_t position = ring.positionOf(0);
+  char out[4];
+  TEST_ASSERT_EQUAL(2, ring.read(position, ring.endPosition(), out, 2));
+
+  ring.append("cccc", 4);  // drops "aa" while the reader is inside it
+  const uint32_t end = ring.endPosition();
+  std::string rest;
+  size_t n = 0;
+  while ((n = ring.read(position, end, out, sizeof(out))) > 0U) {
+    rest.append(out, n);
+  }
+  TEST_ASSERT_EQUAL_STRING("bb\ncccc\n", rest.c_str());
 }
 
-void test_log_buffer_overflow_discards_oldest() {
-  char buffer[16] = {0};
-  size_t len = 0;
-  appendLineToRollingBuffer(buffer, sizeof(buffer), len, "1234567890", 10);
-  appendLineToRollingBuffer(buffer, sizeof(buffer), len, "ABCDEFGHIJ", 10);
-  TEST_ASSERT_EQUAL_UINT32(15U, static_cast<uint32_t>(len));
-  TEST_ASSERT_EQUAL_STRING("67890ABCDEFGHIJ", buffer);
+void test_log_ring_flattens_embedded_newlines() {
+  char storage[16];
+  LogRing ring(storage, sizeof(storage));
+  ring.append("a\nb", 3);
+  TEST_ASSERT_EQUAL_UINT32(1, ring.nextSeq());
+  TEST_ASSERT_EQUAL_STRING("a b\n", readAll(ring, ring.positionOf(0)).c_str());
 }
 
-void test_log_buffer_overwrites_when_line_exceeds_capacity() {
-  char buffer[8] = {0};
-  size_t len = 0;
-  appendLineToRollingBuffer(buffer, sizeof(buffer), len, "ABCDEFGHIJKLMNOPQRSTUVWXYZ", 26);
-  TEST_ASSERT_EQUAL_UINT32(7U, static_cast<uint32_t>(len));
-  TEST_ASSERT_EQUAL_STRING("TUVWXYZ", buffer);
+void test_format_runtime_into_buffer() {
+  char text[24];
+  TEST_ASSERT_EQUAL_UINT32(2, formatRuntime(0, true, text, sizeof(text)));
+  TEST_ASSERT_EQUAL_STRING("0s", text);
+  formatRuntime(0, false, text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("0m", text);
+  formatRuntime(12UL * 3600UL + 3UL * 60UL, false, text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("12h 3m ", text);
+  formatRuntime(86400UL + 62UL, true, text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("1d 1m 2s", text);
+  // Truncated, still terminated.
+  char small[5];
+  TEST_ASSERT_EQUAL_UINT32(4, formatRuntime(86400UL * 123UL + 3600UL, true, small, sizeof(small)));
+  TEST_ASSERT_EQUAL_STRING("123d", small);
 }
 
 void test_json_escape() {
@@ -167,12 +342,20 @@ int main() {
   RUN_TEST(test_update_battery_from_adc_custom_cells);
   RUN_TEST(test_update_battery_from_adc_chemistry_changes_soc);
   RUN_TEST(test_soc_smoothing_uses_ema);
+  RUN_TEST(test_soc_uses_rest_voltage_but_reports_measured_pack);
   RUN_TEST(test_ntc_rejects_invalid_ranges);
   RUN_TEST(test_ntc_valid_values);
   RUN_TEST(test_ntc_high_voltage_value);
-  RUN_TEST(test_log_buffer_within_bounds);
-  RUN_TEST(test_log_buffer_overflow_discards_oldest);
-  RUN_TEST(test_log_buffer_overwrites_when_line_exceeds_capacity);
+  RUN_TEST(test_ntc_fixed_point_matches_float);
+  RUN_TEST(test_soc_fixed_point_matches_float);
+  RUN_TEST(test_conversion_kernel_benchmark);
+  RUN_TEST(test_log_ring_within_bounds);
+  RUN_TEST(test_log_ring_overflow_discards_oldest_lines);
+  RUN_TEST(test_log_ring_keeps_tail_of_oversized_line);
+  RUN_TEST(test_log_ring_wraparound_and_cursor);
+  RUN_TEST(test_log_ring_reader_skips_overwritten_bytes);
+  RUN_TEST(test_log_ring_flattens_embedded_newlines);
+  RUN_TEST(test_format_runtime_into_buffer);
   RUN_TEST(test_json_escape);
   RUN_TEST(test_json_escape_plain_text_remains_same);
   return UNITY_END();
@@ -0,0 +1,402 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include "ota_session.h"
+
+using namespace HeatControl::logic;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+uint32_t fakeNowUs = 0;
+uint32_t fakeClock() { return fakeNowUs; }
+
+std::string toHex(const uint8_t *digest) {
+  char hex[2 * SHA256_DIGEST_BYTES + 1];
+  for (size_t i = 0; i < SHA256_DIGEST_BYTES; ++i) {
+    snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+  }
+  return std::string(hex);
+}
+
+std::string sha256Hex(const std::string &data) {
+  Sha256 hash;
+  hash.update(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+  uint8_t digest[SHA256_DIGEST_BYTES];
+  hash.finish(digest);
+  return toHex(digest);
+}
+
+class FakeFirmwareSink : public IFirmwareSink {
+ public:
+  bool begin(uint32_t imageBytes) override {
+    begun = true;
+    declared = imageBytes;
+    return imageBytes <= partitionBytes;
+  }
+  uint8_t *acquireBlock() override { return block; }
+  uint8_t *windowBuffer() override { return window; }
+  bool commitBlock(size_t length) override {
+    commitLengths.push_back(length);
+    if (failCommitAt >= 0 && static_cast<int>(commitLengths.size()) > failCommitAt) {
+      return false;
+    }
+    image.append(reinterpret_cast<const char *>(block), length);
+    fakeNowUs += 2000;  // flash erase + write
+    return true;
+  }
+  bool end() override {
+    ended = true;
+    return true;
+  }
+  void abort() override { aborts++; }
+  int errorCode() const override { return 7; }
+
+  uint32_t partitionBytes = 1310720UL;
+  uint32_t declared = 0;
+  int failCommitAt = -1;
+  bool begun = false;
+  bool ended = false;
+  int aborts = 0;
+  std::vector<size_t> commitLengths;
+  std::string image;
+  uint8_t block[OTA_BLOCK_BYTES];
+  uint8_t window[OTA_BLOCK_BYTES];
+};
+
+std::string makeImage(size_t size) {
+  std::string image(size, '\0');
+  uint32_t x = 0x12345678UL;
+  for (size_t i = 0; i < size; ++i) {
+    x = x * 1103515245UL + 12345UL;
+    image[i] = static_cast<char>(x >> 24);
+  }
+  image[0] = static_cast<char>(0xE9);  // ESP image magic
+  return image;
+}
+
+// Compressed upload as produced by tools/release/compress_firmware.py: literals, with runs of a
+// repeated byte as distance-1 back-references (enough to exercise both symbol kinds).
+std::string compressImage(const std::string &image, uint8_t windowBits = 12) {
+  constexpr uint8_t lookaheadBits = 4;
+  std::string out;
+  uint32_t acc = 0;
+  int bits = 0;
+  const auto put = [&](uint32_t value, int count) {
+    for (int i = count - 1; i >= 0; --i) {
+      acc = (acc << 1) | ((value >> i) & 1U);
+      if (++bits == 8) {
+        out.push_back(static_cast<char>(acc));
+        acc = 0;
+        bits = 0;
+      }
+    }
+  };
+  size_t i = 0;
+  while (i < image.size()) {
+    size_t run = 0;
+    while (i > 0 && run < 16U && i + run < image.size() && image[i + run] == image[i - 1]) {
+      ++run;
+    }
+    if (run >= 2U) {
+      put(0, 1);
+      put(0, windowBits);
+      put(static_cast<uint32_t>(run - 1U), lookaheadBits);
+      i += run;
+    } else {
+      put(1, 1);
+      put(static_cast<uint8_t>(image[i]), 8);
+      ++i;
+    }
+  }
+  if (bits > 0) {
+    out.push_back(static_cast<char>(acc << (8 - bits)));
+  }
+
+  Sha256 hash;
+  hash.update(reinterpret_cast<const uint8_t *>(image.data()), image.size());
+  uint8_t digest[SHA256_DIGEST_BYTES];
+  hash.finish(digest);
+  const uint32_t size = static_cast<uint32_t>(image.size());
+  std::string header("HCHS");
+  header.push_back(static_cast<char>(windowBits));
+  header.push_back(static_cast<char>(lookaheadBits));
+  header.append(2, '\0');
+  for (int b = 0; b < 4; ++b) {
+    header.push_back(static_cast<char>(size >> (8 * b)));
+  }
+  header.append(reinterpret_cast<const char *>(digest), sizeof(digest));
+  return header + out;
+}
+
+// Feeds the image in TCP-segment-like chunks of varying size.
+bool upload(OtaSession &session, const std::string &image) {
+  const size_t chunkSizes[] = {1436, 536, 2872, 1, 4096, 733};
+  size_t offset = 0;
+  size_t n = 0;
+  while (offset < image.size()) {
+    size_t length = chunkSizes[n++ % 6];
+    if (length > image.size() - offset) {
+      length = image.size() - offset;
+    }
+    fakeNowUs += 500;
+    if (!session.write(reinterpret_cast<const uint8_t *>(image.data()) + offset, length)) {
+      return false;
+    }
+    offset += length;
+  }
+  return true;
+}
+
+}  // namespace
+
+void test_sha256_known_vectors() {
+  TEST_ASSERT_EQUAL_STRING("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", sha256Hex("").c_str());
+  TEST_ASSERT_EQUAL_STRING("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", sha256Hex("abc").c_str());
+  TEST_ASSERT_EQUAL_STRING("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+                           sha256Hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq").c_str());
+  TEST_ASSERT_EQUAL_STRING("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+                           sha256Hex(std::string(1000000, 'a')).c_str());
+
+  // Chunking must not change the digest.
+  const std::string image = makeImage(10000);
+  Sha256 hash;
+  for (size_t offset = 0; offset < image.size(); offset += 97) {
+    const size_t length = image.size() - offset < 97 ? image.size() - offset : 97;
+    hash.update(reinterpret_cast<const uint8_t *>(image.data()) + offset, length);
+  }
+  uint8_t digest[SHA256_DIGEST_BYTES];
+  hash.finish(digest);
+  TEST_ASSERT_EQUAL_STRING(sha256Hex(image).c_str(), toHex(digest).c_str());
+}
+
+void test_parse_sha256_hex() {
+  uint8_t digest[SHA256_DIGEST_BYTES];
+  TEST_ASSERT_TRUE(parseSha256Hex("BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD", digest));
+  TEST_ASSERT_EQUAL_HEX8(0xBA, digest[0]);
+  TEST_ASSERT_EQUAL_HEX8(0xAD, digest[31]);
+  TEST_ASSERT_FALSE(parseSha256Hex("ba7816bf", digest));
+  TEST_ASSERT_FALSE(parseSha256Hex("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad0", digest));
+  TEST_ASSERT_FALSE(parseSha256Hex("zz7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", digest));
+  TEST_ASSERT_FALSE(parseSha256Hex(nullptr, digest));
+}
+
+void test_streams_sector_blocks_and_verifies_digest() {
+  FakeFirmwareSink sink;
+  OtaSession session(sink, fakeClock);
+  const std::string image = makeImage(200000);
+
+  TEST_ASSERT_TRUE(session.begin(static_cast<uint32_t>(image.size()), sha256Hex(image).c_str()));
+  TEST_ASSERT_TRUE(upload(session, image));
+  TEST_ASSERT_TRUE(session.finish());
+  TEST_ASSERT_EQUAL_UINT32(image.size(), sink.declared);
+
+  TEST_ASSERT_TRUE(sink.ended);
+  TEST_ASSERT_EQUAL_INT(0, sink.aborts);
+  TEST_ASSERT_TRUE(sink.image == image);
+  // Every block but the tail is a full sector.
+  TEST_ASSERT_EQUAL_UINT32((image.size() + OTA_BLOCK_BYTES - 1) / OTA_BLOCK_BYTES, sink.commitLengths.size());
+  for (size_t i = 0; i + 1 < sink.commitLengths.size(); ++i) {
+    TEST_ASSERT_EQUAL_UINT32(OTA_BLOCK_BYTES, sink.commitLengths[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT32(image.size() % OTA_BLOCK_BYTES, sink.commitLengths.back());
+
+  const OtaProgress &p = session.progress();
+  TEST_ASSERT_TRUE(p.state == OtaState::Succeeded);
+  TEST_ASSERT_TRUE(p.checksumVerified);
+  TEST_ASSERT_EQUAL_UINT32(image.size(), p.receivedBytes);
+  TEST_ASSERT_TRUE(p.bytesPerSecond > 0U);
+  TEST_ASSERT_TRUE(p.chunkMaxUs >= 2000U);  // a chunk that completed a block waited for the flash write
+  TEST_ASSERT_TRUE(p.chunkMeanUs < p.chunkMaxUs);
+  TEST_ASSERT_EQUAL_STRING(sha256Hex(image).c_str(), toHex(session.digest()).c_str());
+}
+
+void test_digest_mismatch_aborts_before_end() {
+  FakeFirmwareSink sink;
+  OtaSession session(sink, fakeClock);
+  std::string image = makeImage(150000);
+  const std::string expected = sha256Hex(image);
+  image[70000] ^= 0x01;
+
+  TEST_ASSERT_TRUE(session.begin(static_cast<uint32_t>(image.size()), expected.c_str()));
+  TEST_ASSERT_TRUE(upload(session, image));
+  TEST_ASSERT_FALSE(session.finish());
+  TEST_ASSERT_FALSE(sink.ended);
+  TEST_ASSERT_EQUAL_INT(1, sink.aborts);
+  TEST_ASSERT_TRUE(session.progress().state == OtaState::Failed);
+  TEST_ASSERT_EQUAL_STRING("SHA-256 mismatch.", session.progress().message);
+}
+
+void test_fails_early_on_bad_declarations() {
+  FakeFirmwareSink sink;
+  OtaSession session(sink, fakeClock);
+
+  // Rejected before the sink (and the flash) is touched.
+  const std::string image = makeImage(120000);
+  const uint8_t *firstChunk = reinterpret_cast<const uint8_t *>(image.data());
+  TEST_ASSERT_FALSE(session.begin(200000, "not-a-digest"));
+  TEST_ASSERT_TRUE(session.begin(50000, nullptr));
+  TEST_ASSERT_FALSE(session.write(firstChunk, 1436));
+  TEST_ASSERT_EQUAL_STRING("Firmware image too small.", session.progress().message);
+  session.reject("Only .bin firmware files are accepted.");
+  TEST_ASSERT_TRUE(session.progress().state == OtaState::Failed);
+  TEST_ASSERT_FALSE(sink.begun);
+  TEST_ASSERT_FALSE(session.write(firstChunk, 1));
+
+  // The partition check happens on the first chunk, before anything is written.
+  sink.partitionBytes = 1000000UL;
+  TEST_ASSERT_TRUE(session.begin(2000000UL, nullptr));
+  TEST_ASSERT_FALSE(session.write(firstChunk, 1436));
+  TEST_ASSERT_EQUAL_INT(7, session.progress().sinkError);
+  TEST_ASSERT_TRUE(sink.commitLengths.empty());
+
+  // More data than declared stops at the first chunk that overshoots.
+  TEST_ASSERT_TRUE(session.begin(110000, ""));
+  TEST_ASSERT_FALSE(upload(session, image));
+  TEST_ASSERT_EQUAL_INT(1, sink.aborts);
+  TEST_ASSERT_TRUE(session.progress().receivedBytes <= 110000U);
+  TEST_ASSERT_EQUAL_STRING("Upload is larger than the declared image size.", session.progress().message);
+}
+
+void test_size_checks_and_unknown_size() {
+  FakeFirmwareSink sink;
+  OtaSession session(sink, fakeClock);
+
+  // Truncated upload.
+  const std::string image = makeImage(130000);
+  TEST_ASSERT_TRUE(session.begin(140000, nullptr));
+  TEST_ASSERT_TRUE(upload(session, image));
+  TEST_ASSERT_FALSE(session.finish());
+  TEST_ASSERT_EQUAL_STRING("Upload ended before the declared image size.", session.progress().message);
+
+  // Unknown size still rejects tiny images at the end.
+  TEST_ASSERT_TRUE(session.begin(0, nullptr));
+  TEST_ASSERT_TRUE(upload(session, makeImage(5000)));
+  TEST_ASSERT_FALSE(session.finish());
+  TEST_ASSERT_EQUAL_STRING("Firmware image too small.", session.progress().message);
+
+  sink.image.clear();
+  TEST_ASSERT_TRUE(session.begin(0, nullptr));
+  TEST_ASSERT_TRUE(upload(session, image));
+  TEST_ASSERT_TRUE(session.finish());
+  TEST_ASSERT_FALSE(session.progress().checksumVerified);
+  TEST_ASSERT_TRUE(sink.image == image);
+}
+
+void test_sink_failure_and_stall() {
+  FakeFirmwareSink sink;
+  OtaSession session(sink, fakeClock);
+  sink.failCommitAt = 3;
+  TEST_ASSERT_TRUE(session.begin(0, nullptr));
+  TEST_ASSERT_FALSE(upload(session, makeImage(120000)));
+  TEST_ASSERT_EQUAL_STRING("Write failed.", session.progress().message);
+  TEST_ASSERT_EQUAL_INT(7, session.progress().sinkError);
+  TEST_ASSERT_FALSE(session.finish());
+  TEST_ASSERT_EQUAL_INT(1, sink.aborts);
+
+  sink.failCommitAt = -1;
+  TEST_ASSERT_TRUE(session.begin(0, nullptr));
+  TEST_ASSERT_TRUE(session.write(reinterpret_cast<const uint8_t *>("abc"), 3));
+  TEST_ASSERT_FALSE(session.stalled(10000000UL));
+  fakeNowUs += 10000001UL;
+  TEST_ASSERT_TRUE(session.stalled(10000000UL));
+  session.fail("Upload timed out.");
+  TEST_ASSERT_EQUAL_INT(2, sink.aborts);
+  TEST_ASSERT_FALSE(session.stalled(10000000UL));
+}
+
+void test_inflates_compressed_upload() {
+  FakeFirmwareSink sink;
+  OtaSession session(sink, fakeClock);
+  std::string image = makeImage(180000);
+  image.replace(20000, 30000, 30000, '\xFF');  // erased-flash padding compresses well
+  const std::string upload_ = compressImage(image);
+  TEST_ASSERT_TRUE(upload_.size() < image.size());
+
+  TEST_ASSERT_TRUE(session.begin(static_cast<uint32_t>(upload_.size()), sha256Hex(upload_).c_str()));
+  TEST_ASSERT_TRUE(upload(session, upload_));
+  TEST_ASSERT_TRUE(session.finish());
+  TEST_ASSERT_EQUAL_UINT32(image.size(), sink.declared);
+  TEST_ASSERT_TRUE(sink.image == image);
+  for (size_t i = 0; i + 1 < sink.commitLengths.size(); ++i) {
+    TEST_ASSERT_EQUAL_UINT32(OTA_BLOCK_BYTES, sink.commitLengths[i]);
+  }
+
+  const OtaProgress &p = session.progress();
+  TEST_ASSERT_TRUE(p.format == OtaFormat::Heatshrink);
+  TEST_ASSERT_TRUE(p.checksumVerified);
+  TEST_ASSERT_EQUAL_UINT32(upload_.size(), p.receivedBytes);
+  TEST_ASSERT_EQUAL_UINT32(image.size(), p.imageBytes);
+  TEST_ASSERT_EQUAL_UINT32(image.size(), p.writtenBytes);
+
+  // Without an upload digest the header digest alone still guards the image.
+  TEST_ASSERT_TRUE(session.begin(0, nullptr));
+  TEST_ASSERT_TRUE(upload(session, upload_));
+  TEST_ASSERT_TRUE(session.finish());
+  TEST_ASSERT_TRUE(session.progress().checksumVerified);
+}
+
+void test_rejects_corrupt_compressed_upload() {
+  FakeFirmwareSink sink;
+  OtaSession session(sink, fakeClock);
+  const std::string image = makeImage(150000);
+  std::string corrupt = compressImage(image);
+  corrupt[OTA_COMPRESSED_HEADER_BYTES + 90000] ^= 0x10;
+
+  TEST_ASSERT_TRUE(session.begin(0, nullptr));
+  const bool streamed = upload(session, corrupt);
+  TEST_ASSERT_FALSE(streamed && session.finish());
+  TEST_ASSERT_FALSE(sink.ended);
+  TEST_ASSERT_EQUAL_INT(1, sink.aborts);
+
+  std::string wideWindow = compressImage(image, 13);
+  TEST_ASSERT_TRUE(session.begin(0, nullptr));
+  TEST_ASSERT_FALSE(upload(session, wideWindow));
+  TEST_ASSERT_EQUAL_STRING("Compression window too large for this device.", session.progress().message);
+
+  std::string badMagic = compressImage(image);
+  badMagic[2] = 'X';
+  TEST_ASSERT_TRUE(session.begin(0, nullptr));
+  TEST_ASSERT_FALSE(upload(session, badMagic));
+  TEST_ASSERT_EQUAL_STRING("Unknown firmware image format.", session.progress().message);
+}
+
+void test_status_json() {
+  FakeFirmwareSink sink;
+  OtaSession session(sink, fakeClock);
+  char json[512];
+  TEST_ASSERT_TRUE(writeOtaStatusJson(session.progress(), session.digest(), json, sizeof(json)) > 0U);
+  TEST_ASSERT_NOT_NULL(std::strstr(json, "\"state\":\"idle\""));
+  TEST_ASSERT_NOT_NULL(std::strstr(json, "\"progressPermille\":null"));
+
+  const std::string image = makeImage(102400);
+  TEST_ASSERT_TRUE(session.begin(204800, nullptr));
+  TEST_ASSERT_TRUE(upload(session, image));
+  TEST_ASSERT_TRUE(writeOtaStatusJson(session.progress(), session.digest(), json, sizeof(json)) > 0U);
+  TEST_ASSERT_NOT_NULL(std::strstr(json, "\"state\":\"receiving\""));
+  TEST_ASSERT_NOT_NULL(std::strstr(json, "\"format\":\"raw\""));
+  TEST_ASSERT_NOT_NULL(std::strstr(json, "\"progressPermille\":500"));
+  TEST_ASSERT_NOT_NULL(std::strstr(json, "\"sha256\":null"));
+  TEST_ASSERT_EQUAL_UINT32(0U, writeOtaStatusJson(session.progress(), session.digest(), json, 40));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sha256_known_vectors);
+  RUN_TEST(test_parse_sha256_hex);
+  RUN_TEST(test_streams_sector_blocks_and_verifies_digest);
+  RUN_TEST(test_digest_mismatch_aborts_before_end);
+  RUN_TEST(test_fails_early_on_bad_declarations);
+  RUN_TEST(test_size_checks_and_unknown_size);
+  RUN_TEST(test_sink_failure_and_stall);
+  RUN_TEST(test_inflates_compressed_upload);
+  RUN_TEST(test_rejects_corrupt_compressed_upload);
+  RUN_TEST(test_status_json);
+  return UNITY_END();
+}
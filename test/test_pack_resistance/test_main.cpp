@@ -0,0 +1,138 @@
+#include <cstdint>
+
+#include <unity.h>
+
+#include "adc_filter.h"
+#include "pack_resistance.h"
+
+using namespace HeatControl::logic;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+void pushSteps(PackResistanceEstimator &estimator, uint16_t milliVolts, bool loadOn, uint32_t steps) {
+  for (uint32_t i = 0; i < steps; ++i) {
+    estimator.push(milliVolts, loadOn);
+  }
+}
+
+// Slow-PWM periods of 100 filter steps (1 s at the simulated 10 ms per step) at `onSteps` duty.
+void pushPeriods(PackResistanceEstimator &estimator, uint16_t unloaded, uint16_t loaded, uint32_t onSteps,
+                 uint32_t periods) {
+  for (uint32_t p = 0; p < periods; ++p) {
+    pushSteps(estimator, loaded, true, onSteps);
+    pushSteps(estimator, unloaded, false, 100U - onSteps);
+  }
+}
+
+}  // namespace
+
+void test_sag_ratio_from_clean_edges() {
+  PackResistanceEstimator estimator;
+  pushSteps(estimator, 3000, false, 20);
+  TEST_ASSERT_EQUAL_UINT16(3000, estimator.restMilliVolts());
+  pushPeriods(estimator, 3000, 2910, 60, 2);
+  // Both edges of both periods; the first off phase has no edge in front of it.
+  TEST_ASSERT_EQUAL_UINT32(4, estimator.edges());
+  TEST_ASSERT_TRUE(estimator.valid());
+  TEST_ASSERT_UINT32_WITHIN(1, 90ULL * 1000000ULL / 2910ULL, estimator.sagPpm());
+  // 3.09 % of a 4 ohm element: 124 mOhm in the pack, wiring and MOSFET.
+  TEST_ASSERT_EQUAL_UINT32(124, estimator.sourceMilliOhm(4000));
+  TEST_ASSERT_FALSE(estimator.weak());
+
+  pushSteps(estimator, 2910, true, 20);
+  TEST_ASSERT_UINT32_WITHIN(1, 3000, estimator.restMilliVolts());
+}
+
+void test_rest_voltage_holds_while_settling_and_until_valid() {
+  PackResistanceEstimator estimator;
+  pushSteps(estimator, 3000, false, 20);
+  pushSteps(estimator, 2900, true, PACK_SAG_SETTLE_STEPS);
+  TEST_ASSERT_EQUAL_UINT16(3000, estimator.restMilliVolts());
+  // Settled but only one edge: the loaded reading is all there is.
+  estimator.push(2900, true);
+  TEST_ASSERT_EQUAL_UINT32(1, estimator.edges());
+  TEST_ASSERT_FALSE(estimator.valid());
+  TEST_ASSERT_EQUAL_UINT16(2900, estimator.restMilliVolts());
+}
+
+void test_short_pulses_and_full_on_add_no_edges() {
+  PackResistanceEstimator estimator;
+  pushSteps(estimator, 3000, false, 20);
+  // Low duty: every on pulse ends before it settles, so neither of its edges yields a pair.
+  pushPeriods(estimator, 3000, 2900, PACK_SAG_SETTLE_STEPS - 1U, 10);
+  TEST_ASSERT_EQUAL_UINT32(0, estimator.edges());
+  pushSteps(estimator, 2900, true, 1000);  // full on
+  TEST_ASSERT_EQUAL_UINT32(1, estimator.edges());
+}
+
+void test_pulled_pack_and_rising_load_voltage_are_rejected() {
+  PackResistanceEstimator estimator;
+  pushSteps(estimator, 3000, false, 20);
+  pushPeriods(estimator, 3000, 2940, 50, 4);
+  const uint32_t ppm = estimator.sagPpm();
+  const uint32_t edges = estimator.edges();
+
+  pushPeriods(estimator, 3000, 1000, 50, 2);  // battery pulled while the heater is on
+  pushPeriods(estimator, 3000, 3100, 50, 2);  // reading jumped up under load
+  pushPeriods(estimator, 0, 0, 50, 2);        // no pack at all
+  TEST_ASSERT_EQUAL_UINT32(edges, estimator.edges());
+  TEST_ASSERT_EQUAL_UINT32(ppm, estimator.sagPpm());
+
+  // A little rise is noise around a near-zero sag and pulls the mean down.
+  pushSteps(estimator, 3000, false, 20);
+  pushPeriods(estimator, 3000, 3010, 50, 1);
+  TEST_ASSERT_EQUAL_UINT32(edges + 2U, estimator.edges());
+  TEST_ASSERT_TRUE(estimator.sagPpm() < ppm);
+}
+
+void test_running_filter_follows_an_ageing_pack() {
+  PackResistanceEstimator estimator;
+  pushSteps(estimator, 3000, false, 20);
+  pushPeriods(estimator, 3000, 2940, 50, 50);
+  TEST_ASSERT_UINT32_WITHIN(5, 20408, estimator.sagPpm());
+  // The source resistance triples (cold pack, corroded contact): 6.4 %, and a weak pack at 12 %.
+  pushPeriods(estimator, 3000, 2820, 50, 50);
+  TEST_ASSERT_UINT32_WITHIN(100, 63830, estimator.sagPpm());
+  TEST_ASSERT_FALSE(estimator.weak());
+  pushPeriods(estimator, 3000, 2680, 50, 50);
+  TEST_ASSERT_TRUE(estimator.weak());
+
+  estimator.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, estimator.edges());
+  TEST_ASSERT_EQUAL_UINT32(0, estimator.sagPpm());
+  TEST_ASSERT_FALSE(estimator.weak());
+}
+
+void test_estimate_through_the_battery_filter_with_noise() {
+  // The firmware chain: 16x blocks into median 5 / IIR 1/2, one filter step per 8 ms frame.
+  AdcFilter filter(AdcFilterConfig{1, 5, 1});
+  PackResistanceEstimator estimator;
+  uint32_t state = 99;
+  const float unloaded = 3050.0F;
+  const float loaded = unloaded * 4.0F / 4.12F;  // 120 mOhm source under a 4 ohm element
+  for (uint32_t step = 0; step < 125U * 120U; ++step) {
+    const bool on = (step % 125U) < 80U;  // 1 s period at 64 % duty
+    state = state * 1664525U + 1013904223U;
+    const float noise = 4.0F * (static_cast<float>(state >> 8) / 8388608.0F - 1.0F);
+    filter.push(static_cast<uint16_t>((on ? loaded : unloaded) + noise + 0.5F));
+    estimator.push(filter.output(), on);
+  }
+  TEST_ASSERT_TRUE(estimator.edges() >= 200U);
+  TEST_ASSERT_UINT32_WITHIN(10, 120, estimator.sourceMilliOhm(4000));
+  estimator.push(filter.output(), false);
+  TEST_ASSERT_UINT32_WITHIN(8, 3050, estimator.restMilliVolts());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sag_ratio_from_clean_edges);
+  RUN_TEST(test_rest_voltage_holds_while_settling_and_until_valid);
+  RUN_TEST(test_short_pulses_and_full_on_add_no_edges);
+  RUN_TEST(test_pulled_pack_and_rising_load_voltage_are_rejected);
+  RUN_TEST(test_running_filter_follows_an_ageing_pack);
+  RUN_TEST(test_estimate_through_the_battery_filter_with_noise);
+  return UNITY_END();
+}
@@ -0,0 +1,149 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <unity.h>
+
+#include "path_hash.h"
+
+using namespace HeatControl;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+const char *const ROUTES[] = {
+    "/",
+    "/status",
+    "/setBattery1",
+    "/setBattery2",
+    "/setManualToggle",
+    "/cycleManualPower",
+    "/runtime",
+    "/setLogLevel",
+    "/setApEnabled",
+    "/setTemp",
+    "/saveSettings",
+    "/swapSensors",
+    "/setWiFi",
+    "/restart",
+    "/signalTest",
+    "/logs",
+    "/resetRuntime",
+    "/resetOvertemp",
+    "/version.txt",
+    "/update",
+    "/generate_204",
+    "/gen_204",
+    "/hotspot-detect.html",
+    "/library/test/success.html",
+    "/success.txt",
+    "/ncsi.txt",
+    "/connecttest.txt",
+    "/connecttest.txt.gz",
+    "/connecttest.txt/index.htm",
+    "/connecttest.txt/index.htm.gz",
+    "/redirect",
+    "/fwlink",
+};
+constexpr size_t ROUTE_COUNT = sizeof(ROUTES) / sizeof(ROUTES[0]);
+
+const char *const MISSES[] = {"/statu", "/status/", "/Status", "/favicon.ico", "/setTemp2", "/generate_204x", ""};
+
+int linearFind(const char *path, size_t length) {
+  for (size_t i = 0; i < ROUTE_COUNT; ++i) {
+    if (std::strlen(ROUTES[i]) == length && std::memcmp(ROUTES[i], path, length) == 0) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+}  // namespace
+
+void test_hash_matches_generator() {
+  // Same values as embed_webfiles.path_hash(); the generated registry depends on both agreeing.
+  TEST_ASSERT_EQUAL_UINT32(1165777521UL, pathHash("/index.html", 11, 0));
+  TEST_ASSERT_EQUAL_UINT32(3906683379UL, pathHash("/index.html", 11, 2));
+  TEST_ASSERT_EQUAL_UINT32(2166136258UL, pathHash("", 0, 7));
+}
+
+void test_table_finds_every_route_and_rejects_misses() {
+  PerfectPathTable<48, 7> table;
+  for (size_t i = 0; i < ROUTE_COUNT; ++i) {
+    TEST_ASSERT_EQUAL_INT(static_cast<int>(i), table.add(ROUTES[i]));
+  }
+  TEST_ASSERT_TRUE(table.build());
+
+  for (size_t i = 0; i < ROUTE_COUNT; ++i) {
+    TEST_ASSERT_EQUAL_INT(static_cast<int>(i), table.find(ROUTES[i], std::strlen(ROUTES[i])));
+  }
+  for (const char *miss : MISSES) {
+    TEST_ASSERT_EQUAL_INT(-1, table.find(miss, std::strlen(miss)));
+  }
+  // Only `length` bytes count, so a path inside a larger buffer works without copying.
+  TEST_ASSERT_EQUAL_INT(1, table.find("/status?x=1", 7));
+  TEST_ASSERT_EQUAL_INT(-1, table.find(nullptr, 0));
+}
+
+void test_table_rejects_duplicates_and_overflow() {
+  PerfectPathTable<4, 3> table;
+  TEST_ASSERT_EQUAL_INT(-1, table.find("/a", 2));
+  table.add("/a");
+  table.add("/b");
+  table.add("/a");
+  TEST_ASSERT_FALSE(table.build());
+
+  PerfectPathTable<2, 2> small;
+  TEST_ASSERT_EQUAL_INT(0, small.add("/a"));
+  TEST_ASSERT_EQUAL_INT(1, small.add("/b"));
+  TEST_ASSERT_EQUAL_INT(-1, small.add("/c"));
+  TEST_ASSERT_TRUE(small.build());
+  TEST_ASSERT_EQUAL_INT(-1, small.add("/d"));
+  TEST_ASSERT_EQUAL_INT(1, small.find("/b", 2));
+}
+
+void test_lookup_benchmark() {
+  PerfectPathTable<48, 7> table;
+  for (size_t i = 0; i < ROUTE_COUNT; ++i) {
+    table.add(ROUTES[i]);
+  }
+  TEST_ASSERT_TRUE(table.build());
+
+  size_t lengths[ROUTE_COUNT];
+  for (size_t i = 0; i < ROUTE_COUNT; ++i) {
+    lengths[i] = std::strlen(ROUTES[i]);
+  }
+  constexpr int rounds = 20000;
+  long sink = 0;
+  const auto time = [&](bool hits, bool perfect) -> double {
+    const auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+      for (size_t i = 0; i < ROUTE_COUNT; ++i) {
+        // A miss is the route with its last character dropped: shares a prefix with a real path.
+        const size_t length = hits ? lengths[i] : lengths[i] - 1U;
+        sink += perfect ? table.find(ROUTES[i], length) : linearFind(ROUTES[i], length);
+      }
+    }
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    return static_cast<double>(ns.count()) / (static_cast<double>(rounds) * ROUTE_COUNT);
+  };
+
+  char message[160];
+  snprintf(message, sizeof(message),
+           "path lookup (%u routes): hit %.1f ns vs %.1f ns linear | miss %.1f ns vs %.1f ns linear",
+           static_cast<unsigned>(ROUTE_COUNT), time(true, true), time(true, false), time(false, true),
+           time(false, false));
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(sink != 0);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_hash_matches_generator);
+  RUN_TEST(test_table_finds_every_route_and_rejects_misses);
+  RUN_TEST(test_table_rejects_duplicates_and_overflow);
+  RUN_TEST(test_lookup_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,160 @@
+#include <cstring>
+#include <vector>
+
+#include <unity.h>
+
+#include "persist_scheduler.h"
+#include "record_store.h"
+
+using namespace HeatControl::logic;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+constexpr uint32_t DEBOUNCE_MS = 1500;
+constexpr uint32_t MAX_DELAY_MS = 10000;
+
+uint32_t fakeNowUs = 0;
+uint32_t fakeClock() { return fakeNowUs; }
+
+class CountingFlash : public IFlashRegion {
+ public:
+  CountingFlash() : bytes(4 * 4096, 0xFF) {}
+  size_t sectorBytes() const override { return 4096; }
+  size_t sectorCount() const override { return 4; }
+  bool read(size_t offset, void *out, size_t length) override {
+    std::memcpy(out, bytes.data() + offset, length);
+    return true;
+  }
+  bool write(size_t offset, const void *data, size_t length) override {
+    ++writes;
+    const uint8_t *in = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < length; ++i) {
+      bytes[offset + i] &= in[i];
+    }
+    return true;
+  }
+  bool eraseSector(size_t sector) override {
+    ++erases;
+    std::memset(bytes.data() + sector * 4096, 0xFF, 4096);
+    return true;
+  }
+
+  std::vector<uint8_t> bytes;
+  int writes = 0;
+  int erases = 0;
+};
+
+}  // namespace
+
+void test_rapid_changes_coalesce_into_one_flash_write() {
+  CountingFlash flash;
+  RecordStore store(flash, fakeClock);
+  TEST_ASSERT_TRUE(store.mount());
+  uint8_t values[8] = {0};
+  for (uint8_t key = 0; key < 8; ++key) {
+    store.set(key, &values[key], 1);
+  }
+  TEST_ASSERT_TRUE(store.commit());
+  const int writesBefore = flash.writes;
+
+  // 24 edits over 2.3 s (sliders, several settings): the handler side only updates values and marks.
+  PersistScheduler scheduler(DEBOUNCE_MS, MAX_DELAY_MS);
+  uint32_t now = 5000;
+  int flushes = 0;
+  for (uint32_t step = 0; step < 400; ++step, now += 10) {
+    if (step % 10 == 0 && step < 240) {
+      const uint8_t field = static_cast<uint8_t>((step / 10) % 8);
+      ++values[field];
+      scheduler.mark(1U << field, now);
+    }
+    // loop() side.
+    const uint32_t due = scheduler.take(now);
+    if (due != 0U) {
+      ++flushes;
+      for (uint8_t key = 0; key < 8; ++key) {
+        if ((due & (1U << key)) != 0U) {
+          store.set(key, &values[key], 1);
+        }
+      }
+      TEST_ASSERT_TRUE(store.commit());
+    }
+  }
+
+  TEST_ASSERT_EQUAL_INT(1, flushes);
+  TEST_ASSERT_EQUAL_INT(writesBefore + 1, flash.writes);
+  TEST_ASSERT_EQUAL_UINT32(24U, scheduler.stats().marks);
+  TEST_ASSERT_EQUAL_UINT32(0xFFU, scheduler.stats().lastFields);
+  uint8_t stored = 0;
+  TEST_ASSERT_TRUE(store.get(7, &stored, 1));
+  TEST_ASSERT_EQUAL_UINT8(values[7], stored);
+}
+
+void test_waits_for_quiet_period() {
+  PersistScheduler scheduler(DEBOUNCE_MS, MAX_DELAY_MS);
+  TEST_ASSERT_EQUAL_UINT32(0U, scheduler.take(0));
+  scheduler.mark(0x4, 1000);
+  TEST_ASSERT_EQUAL_UINT32(0U, scheduler.take(2000));
+  scheduler.mark(0x1, 2000);
+  TEST_ASSERT_EQUAL_UINT32(0U, scheduler.take(3499));
+  TEST_ASSERT_EQUAL_UINT32(0x5U, scheduler.take(3500));
+  TEST_ASSERT_EQUAL_UINT32(0U, scheduler.pending());
+  TEST_ASSERT_EQUAL_UINT32(0U, scheduler.take(9000));
+  scheduler.mark(0, 9000);
+  TEST_ASSERT_EQUAL_UINT32(0U, scheduler.pending());
+}
+
+void test_steady_edits_still_flush_after_max_delay() {
+  PersistScheduler scheduler(DEBOUNCE_MS, MAX_DELAY_MS);
+  uint32_t flushedAt = 0;
+  for (uint32_t now = 0; now <= 20000; now += 500) {
+    scheduler.mark(0x2, now);
+    if (scheduler.take(now) != 0U && flushedAt == 0U) {
+      flushedAt = now;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(MAX_DELAY_MS, flushedAt);
+}
+
+void test_take_all_before_restart_and_millis_wrap() {
+  PersistScheduler scheduler(DEBOUNCE_MS, MAX_DELAY_MS);
+  const uint32_t beforeWrap = 0xFFFFFF00UL;
+  scheduler.mark(0x8, beforeWrap);
+  TEST_ASSERT_EQUAL_UINT32(0U, scheduler.take(0x00000100UL));
+  TEST_ASSERT_EQUAL_UINT32(0x8U, scheduler.take(beforeWrap + DEBOUNCE_MS));
+
+  scheduler.mark(0x10, 50);
+  TEST_ASSERT_EQUAL_UINT32(0x10U, scheduler.takeAll());
+  TEST_ASSERT_EQUAL_UINT32(0U, scheduler.takeAll());
+  TEST_ASSERT_EQUAL_UINT32(2U, scheduler.stats().flushes);
+  scheduler.recordFlush(900);
+  scheduler.recordFlush(300);
+  TEST_ASSERT_EQUAL_UINT32(300U, scheduler.stats().lastFlushUs);
+  TEST_ASSERT_EQUAL_UINT32(900U, scheduler.stats().maxFlushUs);
+}
+
+void test_mark_newer_than_now_still_debounces() {
+  // loop() captures `now` at the top of its pass; a handler on another task may mark afterwards.
+  PersistScheduler scheduler(DEBOUNCE_MS, MAX_DELAY_MS);
+  scheduler.mark(0x1, 5005);
+  TEST_ASSERT_EQUAL_UINT32(0U, scheduler.take(5000));
+  TEST_ASSERT_EQUAL_UINT32(0U, scheduler.take(6504));
+  TEST_ASSERT_EQUAL_UINT32(0x1U, scheduler.take(6505));
+
+  // Same across the millis() wrap.
+  scheduler.mark(0x2, 0x00000010UL);
+  TEST_ASSERT_EQUAL_UINT32(0U, scheduler.take(0xFFFFFFF0UL));
+  TEST_ASSERT_EQUAL_UINT32(0x2U, scheduler.take(0x00000010UL + DEBOUNCE_MS));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_rapid_changes_coalesce_into_one_flash_write);
+  RUN_TEST(test_waits_for_quiet_period);
+  RUN_TEST(test_steady_edits_still_flush_after_max_delay);
+  RUN_TEST(test_take_all_before_restart_and_millis_wrap);
+  RUN_TEST(test_mark_newer_than_now_still_debounces);
+  return UNITY_END();
+}
@@ -0,0 +1,255 @@
+#include <cstring>
+#include <vector>
+
+#include <unity.h>
+
+#include "record_store.h"
+
+using HeatControl::JsonWriter;
+using namespace HeatControl::logic;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+uint32_t fakeNowUs = 0;
+uint32_t fakeClock() { return fakeNowUs; }
+
+// NOR flash in RAM: writes can only clear bits, and a write can be cut short to simulate power loss.
+class FakeFlash : public IFlashRegion {
+ public:
+  explicit FakeFlash(size_t sectors = 4, size_t sectorSize = 4096)
+      : sectorSize_(sectorSize), sectors_(sectors), bytes(sectors * sectorSize, 0xFF), erases(sectors, 0) {}
+
+  size_t sectorBytes() const override { return sectorSize_; }
+  size_t sectorCount() const override { return sectors_; }
+  bool read(size_t offset, void *out, size_t length) override {
+    std::memcpy(out, bytes.data() + offset, length);
+    return true;
+  }
+  bool write(size_t offset, const void *data, size_t length) override {
+    ++writes;
+    const uint8_t *in = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < length; ++i) {
+      if (writeBudget == 0U) {
+        return false;
+      }
+      if (writeBudget > 0) {
+        --writeBudget;
+      }
+      bytes[offset + i] &= in[i];
+    }
+    fakeNowUs += 100;
+    return true;
+  }
+  bool eraseSector(size_t sector) override {
+    std::memset(bytes.data() + sector * sectorSize_, 0xFF, sectorSize_);
+    ++erases[sector];
+    fakeNowUs += 30000;
+    return true;
+  }
+
+  size_t sectorSize_;
+  size_t sectors_;
+  std::vector<uint8_t> bytes;
+  std::vector<uint32_t> erases;
+  int writes = 0;
+  long writeBudget = -1;  // bytes left before the "power fails", -1 = unlimited
+};
+
+void putU32(RecordStore &store, uint8_t key, uint32_t value) {
+  TEST_ASSERT_TRUE(store.set(key, &value, sizeof(value)));
+}
+
+uint32_t getU32(const RecordStore &store, uint8_t key) {
+  uint32_t value = 0;
+  TEST_ASSERT_TRUE(store.get(key, &value, sizeof(value)));
+  return value;
+}
+
+}  // namespace
+
+void test_first_mount_is_empty_and_values_survive_remount() {
+  FakeFlash flash;
+  RecordStore store(flash, fakeClock);
+  TEST_ASSERT_TRUE(store.mount());
+  TEST_ASSERT_TRUE(store.empty());
+  uint32_t value = 0;
+  TEST_ASSERT_FALSE(store.get(3, &value, sizeof(value)));
+
+  putU32(store, 3, 0x12345678UL);
+  const char ssid[] = "HeatControl";
+  TEST_ASSERT_TRUE(store.set(10, ssid, std::strlen(ssid)));
+  TEST_ASSERT_TRUE(store.commit());
+  TEST_ASSERT_FALSE(store.empty());
+
+  RecordStore reloaded(flash, fakeClock);
+  TEST_ASSERT_TRUE(reloaded.mount());
+  TEST_ASSERT_EQUAL_HEX32(0x12345678UL, getU32(reloaded, 3));
+  char text[RECORD_MAX_VALUE_BYTES + 1] = {0};
+  TEST_ASSERT_EQUAL_UINT32(std::strlen(ssid), reloaded.getBytes(10, text, sizeof(text)));
+  TEST_ASSERT_EQUAL_STRING(ssid, text);
+  // A fixed-size read of a value with another length fails instead of returning half of it.
+  uint16_t narrow = 0;
+  TEST_ASSERT_FALSE(reloaded.get(3, &narrow, sizeof(narrow)));
+  TEST_ASSERT_EQUAL_UINT32(2U, reloaded.stats().keys);
+}
+
+void test_batch_writes_once_and_unchanged_values_stay_clean() {
+  FakeFlash flash;
+  RecordStore store(flash, fakeClock);
+  TEST_ASSERT_TRUE(store.mount());
+  putU32(store, 1, 1);
+  TEST_ASSERT_TRUE(store.commit());
+
+  const int writesBefore = flash.writes;
+  for (uint8_t key = 2; key < 9; ++key) {
+    putU32(store, key, key * 100U);
+  }
+  TEST_ASSERT_TRUE(store.commit());
+  TEST_ASSERT_EQUAL_INT(writesBefore + 1, flash.writes);
+
+  putU32(store, 4, 400U);
+  TEST_ASSERT_FALSE(store.dirty());
+  TEST_ASSERT_TRUE(store.commit());
+  TEST_ASSERT_EQUAL_INT(writesBefore + 1, flash.writes);
+  TEST_ASSERT_EQUAL_UINT32(2U, store.stats().commits);
+}
+
+void test_wear_is_spread_over_every_sector() {
+  FakeFlash flash(4, 4096);
+  RecordStore store(flash, fakeClock);
+  TEST_ASSERT_TRUE(store.mount());
+  const char password[] = "a-fairly-long-wifi-password";
+  TEST_ASSERT_TRUE(store.set(20, password, std::strlen(password)));
+  for (uint32_t minute = 1; minute <= 5000U; ++minute) {
+    putU32(store, 7, minute);
+    TEST_ASSERT_TRUE(store.commit());
+  }
+
+  uint32_t minErases = flash.erases[0];
+  uint32_t maxErases = flash.erases[0];
+  for (size_t sector = 0; sector < flash.sectorCount(); ++sector) {
+    minErases = flash.erases[sector] < minErases ? flash.erases[sector] : minErases;
+    maxErases = flash.erases[sector] > maxErases ? flash.erases[sector] : maxErases;
+    TEST_ASSERT_EQUAL_UINT32(flash.erases[sector], store.eraseCount(sector));
+  }
+  TEST_ASSERT_TRUE(minErases > 0U);
+  TEST_ASSERT_TRUE(maxErases - minErases <= 1U);
+  TEST_ASSERT_EQUAL_UINT32(maxErases, store.stats().maxEraseCount);
+
+  RecordStore reloaded(flash, fakeClock);
+  TEST_ASSERT_TRUE(reloaded.mount());
+  TEST_ASSERT_EQUAL_UINT32(5000U, getU32(reloaded, 7));
+  char text[RECORD_MAX_VALUE_BYTES] = {0};
+  TEST_ASSERT_EQUAL_UINT32(std::strlen(password), reloaded.getBytes(20, text, sizeof(text)));
+  TEST_ASSERT_EQUAL_UINT32(store.stats().generation, reloaded.stats().generation);
+  TEST_ASSERT_EQUAL_UINT32(store.stats().maxEraseCount, reloaded.stats().maxEraseCount);
+}
+
+void test_torn_batch_is_dropped_and_next_commit_moves_on() {
+  FakeFlash flash;
+  RecordStore store(flash, fakeClock);
+  TEST_ASSERT_TRUE(store.mount());
+  putU32(store, 5, 111U);
+  TEST_ASSERT_TRUE(store.commit());
+
+  flash.writeBudget = 6;  // the batch header makes it, the value does not
+  putU32(store, 5, 222U);
+  TEST_ASSERT_FALSE(store.commit());
+  flash.writeBudget = -1;
+
+  RecordStore reloaded(flash, fakeClock);
+  TEST_ASSERT_TRUE(reloaded.mount());
+  TEST_ASSERT_EQUAL_UINT32(111U, getU32(reloaded, 5));
+  TEST_ASSERT_EQUAL_UINT32(1U, reloaded.stats().droppedBatches);
+
+  const uint16_t before = reloaded.stats().activeSector;
+  putU32(reloaded, 5, 333U);
+  TEST_ASSERT_TRUE(reloaded.commit());
+  TEST_ASSERT_TRUE(reloaded.stats().activeSector != before);
+
+  RecordStore again(flash, fakeClock);
+  TEST_ASSERT_TRUE(again.mount());
+  TEST_ASSERT_EQUAL_UINT32(333U, getU32(again, 5));
+  TEST_ASSERT_EQUAL_UINT32(0U, again.stats().droppedBatches);
+}
+
+void test_interrupted_compaction_keeps_previous_sector() {
+  FakeFlash flash(2, 4096);
+  RecordStore store(flash, fakeClock);
+  TEST_ASSERT_TRUE(store.mount());
+  putU32(store, 2, 42U);
+  TEST_ASSERT_TRUE(store.commit());
+  uint32_t value = 0;
+  while (store.stats().usedBytes + 16U <= flash.sectorBytes()) {
+    putU32(store, 3, ++value);
+    TEST_ASSERT_TRUE(store.commit());
+  }
+
+  // The next commit compacts; power fails after the snapshot, before the sector header.
+  flash.writeBudget = 24;
+  putU32(store, 3, ++value);
+  TEST_ASSERT_FALSE(store.commit());
+  flash.writeBudget = -1;
+
+  RecordStore reloaded(flash, fakeClock);
+  TEST_ASSERT_TRUE(reloaded.mount());
+  TEST_ASSERT_EQUAL_UINT32(42U, getU32(reloaded, 2));
+  TEST_ASSERT_EQUAL_UINT32(value - 1U, getU32(reloaded, 3));
+  TEST_ASSERT_EQUAL_UINT32(1U, reloaded.stats().generation);
+}
+
+void test_rejects_bad_keys_and_geometry() {
+  FakeFlash flash;
+  RecordStore store(flash, fakeClock);
+  TEST_ASSERT_FALSE(store.commit());
+  TEST_ASSERT_TRUE(store.mount());
+  uint8_t big[RECORD_MAX_VALUE_BYTES + 1] = {0};
+  TEST_ASSERT_FALSE(store.set(RECORD_KEY_COUNT, big, 1));
+  TEST_ASSERT_FALSE(store.set(1, big, sizeof(big)));
+  TEST_ASSERT_FALSE(store.dirty());
+
+  FakeFlash single(1, 4096);
+  RecordStore one(single, fakeClock);
+  TEST_ASSERT_FALSE(one.mount());
+  FakeFlash tiny(4, 256);
+  RecordStore small(tiny, fakeClock);
+  TEST_ASSERT_FALSE(small.mount());
+}
+
+void test_commit_latency_is_reported() {
+  FakeFlash flash;
+  RecordStore store(flash, fakeClock);
+  TEST_ASSERT_TRUE(store.mount());
+  putU32(store, 1, 1);
+  TEST_ASSERT_TRUE(store.commit());  // first commit erases a sector
+  TEST_ASSERT_TRUE(store.stats().lastCommitUs >= 30000U);
+  putU32(store, 1, 2);
+  TEST_ASSERT_TRUE(store.commit());
+  TEST_ASSERT_EQUAL_UINT32(100U, store.stats().lastCommitUs);
+  TEST_ASSERT_TRUE(store.stats().maxCommitUs >= 30000U);
+  TEST_ASSERT_EQUAL_UINT32(1U, store.stats().compactions);
+
+  char json[512];
+  JsonWriter w(json, sizeof(json));
+  w.beginObject();
+  writeRecordStoreStatsFields(w, store.stats());
+  w.endObject();
+  TEST_ASSERT_FALSE(w.overflowed());
+  TEST_ASSERT_NOT_NULL(std::strstr(json, "\"lastCommitUs\":100,"));
+  TEST_ASSERT_NOT_NULL(std::strstr(json, "\"maxEraseCount\":1,"));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_mount_is_empty_and_values_survive_remount);
+  RUN_TEST(test_batch_writes_once_and_unchanged_values_stay_clean);
+  RUN_TEST(test_wear_is_spread_over_every_sector);
+  RUN_TEST(test_torn_batch_is_dropped_and_next_commit_moves_on);
+  RUN_TEST(test_interrupted_compaction_keeps_previous_sector);
+  RUN_TEST(test_rejects_bad_keys_and_geometry);
+  RUN_TEST(test_commit_latency_is_reported);
+  return UNITY_END();
+}
@@ -0,0 +1,286 @@
+#include <utility>
+#include <vector>
+
+#include <unity.h>
+
+#include "sensor_bus.h"
+
+using namespace HeatControl::logic;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+SensorRom makeRom(uint8_t serial) {
+  SensorRom rom = {{0x28, serial, 0x11, 0x22, 0x33, 0x44, 0x55, 0x00}};
+  rom.bytes[7] = dallasCrc8(rom.bytes, 7);
+  return rom;
+}
+
+void makeScratchpad(float tempC, uint8_t *scratchpad) {
+  const int16_t raw = static_cast<int16_t>(tempC * 16.0F);
+  scratchpad[0] = static_cast<uint8_t>(raw & 0xFF);
+  scratchpad[1] = static_cast<uint8_t>((raw >> 8) & 0xFF);
+  scratchpad[2] = 0x4B;
+  scratchpad[3] = 0x46;
+  scratchpad[4] = 0x7F;  // 12 bit
+  scratchpad[5] = 0xFF;
+  scratchpad[6] = 0x0C;
+  scratchpad[7] = 0x10;
+  scratchpad[8] = dallasCrc8(scratchpad, 8);
+}
+
+struct FakeDevice {
+  SensorRom rom;
+  float tempC;
+  bool present;
+  int corruptReads;  // Next N scratchpad reads return a bad CRC.
+};
+
+class MockSensorBus : public ISensorBus {
+ public:
+  void startConversion() override { conversions++; }
+
+  bool readScratchpad(const SensorRom &rom, uint8_t *scratchpad) override {
+    reads++;
+    for (FakeDevice &device : devices) {
+      if (!device.present || !sameSensorRom(device.rom, rom)) {
+        continue;
+      }
+      makeScratchpad(device.tempC, scratchpad);
+      if (device.corruptReads > 0) {
+        device.corruptReads--;
+        scratchpad[0] ^= 0x01;
+      }
+      return true;
+    }
+    // Nobody answers: the bus floats high.
+    for (size_t i = 0; i < SENSOR_SCRATCHPAD_BYTES; ++i) {
+      scratchpad[i] = 0xFF;
+    }
+    return true;
+  }
+
+  uint8_t search(SensorRom *out, uint8_t maxCount) override {
+    searches++;
+    uint8_t count = 0;
+    for (const FakeDevice &device : devices) {
+      if (device.present && count < maxCount) {
+        out[count++] = device.rom;
+      }
+    }
+    return count;
+  }
+
+  std::vector<FakeDevice> devices;
+  int conversions = 0;
+  int reads = 0;
+  int searches = 0;
+};
+
+SensorRomTable emptyTable() {
+  SensorRomTable table;
+  clearSensorRomTable(table);
+  return table;
+}
+
+}  // namespace
+
+void test_crc8_matches_maxim_reference() {
+  // ROM example from Maxim application note 27.
+  const uint8_t rom[] = {0x02, 0x1C, 0xB8, 0x01, 0x00, 0x00, 0x00};
+  TEST_ASSERT_EQUAL_HEX8(0xA2, dallasCrc8(rom, sizeof(rom)));
+}
+
+void test_rom_validation() {
+  TEST_ASSERT_TRUE(isValidSensorRom(makeRom(1)));
+
+  SensorRom badCrc = makeRom(1);
+  badCrc.bytes[7] ^= 0x01;
+  TEST_ASSERT_FALSE(isValidSensorRom(badCrc));
+
+  SensorRom otherFamily = {{0x10, 1, 2, 3, 4, 5, 6, 0}};
+  otherFamily.bytes[7] = dallasCrc8(otherFamily.bytes, 7);
+  TEST_ASSERT_FALSE(isValidSensorRom(otherFamily));
+
+  SensorRom blank;
+  for (size_t i = 0; i < SENSOR_ROM_BYTES; ++i) {
+    blank.bytes[i] = 0xFF;
+  }
+  TEST_ASSERT_FALSE(isValidSensorRom(blank));
+}
+
+void test_decode_scratchpad() {
+  uint8_t scratchpad[SENSOR_SCRATCHPAD_BYTES];
+  float tempC = 0.0F;
+
+  makeScratchpad(23.5F, scratchpad);
+  TEST_ASSERT_TRUE(decodeScratchpadTempC(scratchpad, tempC));
+  TEST_ASSERT_FLOAT_WITHIN(0.001F, 23.5F, tempC);
+
+  makeScratchpad(-10.125F, scratchpad);
+  TEST_ASSERT_TRUE(decodeScratchpadTempC(scratchpad, tempC));
+  TEST_ASSERT_FLOAT_WITHIN(0.001F, -10.125F, tempC);
+
+  scratchpad[0] ^= 0x01;
+  TEST_ASSERT_FALSE(decodeScratchpadTempC(scratchpad, tempC));
+
+  uint8_t zeros[SENSOR_SCRATCHPAD_BYTES] = {0};
+  TEST_ASSERT_FALSE(decodeScratchpadTempC(zeros, tempC));
+}
+
+void test_decode_masks_undefined_bits_at_low_resolution() {
+  uint8_t scratchpad[SENSOR_SCRATCHPAD_BYTES];
+  makeScratchpad(20.0625F, scratchpad);
+  scratchpad[4] = 0x1F;  // 9 bit: the three lowest bits are undefined.
+  scratchpad[8] = dallasCrc8(scratchpad, 8);
+
+  float tempC = 0.0F;
+  TEST_ASSERT_TRUE(decodeScratchpadTempC(scratchpad, tempC));
+  TEST_ASSERT_FLOAT_WITHIN(0.001F, 20.0F, tempC);
+}
+
+void test_assign_keeps_persisted_slots_regardless_of_bus_order() {
+  SensorRomTable persisted = emptyTable();
+  persisted.slots[0] = makeRom(2);
+  persisted.slots[1] = makeRom(1);
+
+  const SensorRom found[] = {makeRom(1), makeRom(2)};
+  SensorRomTable slots;
+  TEST_ASSERT_FALSE(assignSensorSlots(persisted, found, 2, slots));
+  TEST_ASSERT_TRUE(sameSensorRom(makeRom(2), slots.slots[0]));
+  TEST_ASSERT_TRUE(sameSensorRom(makeRom(1), slots.slots[1]));
+}
+
+void test_assign_fills_free_slot_with_replacement_sensor() {
+  SensorRomTable persisted = emptyTable();
+  persisted.slots[0] = makeRom(1);
+  persisted.slots[1] = makeRom(2);
+
+  const SensorRom found[] = {makeRom(3), makeRom(2)};
+  SensorRomTable slots;
+  TEST_ASSERT_TRUE(assignSensorSlots(persisted, found, 2, slots));
+  TEST_ASSERT_TRUE(sameSensorRom(makeRom(3), slots.slots[0]));
+  TEST_ASSERT_TRUE(sameSensorRom(makeRom(2), slots.slots[1]));
+}
+
+void test_reads_by_address_without_searching() {
+  MockSensorBus bus;
+  bus.devices.push_back({makeRom(1), 21.0F, true, 0});
+  bus.devices.push_back({makeRom(2), 34.5F, true, 0});
+
+  RomAddressedSensors sensors(bus);
+  sensors.enumerate(emptyTable());
+  TEST_ASSERT_EQUAL(1, bus.searches);
+  TEST_ASSERT_EQUAL_UINT8(2, sensors.sensorCount());
+  TEST_ASSERT_TRUE(sensors.consumeSlotsChanged());
+  TEST_ASSERT_FALSE(sensors.consumeSlotsChanged());
+
+  for (int cycle = 0; cycle < 100; ++cycle) {
+    sensors.requestTemperatures();
+    TEST_ASSERT_FLOAT_WITHIN(0.001F, 21.0F, sensors.getTempCByIndex(0));
+    TEST_ASSERT_FLOAT_WITHIN(0.001F, 34.5F, sensors.getTempCByIndex(1));
+  }
+  TEST_ASSERT_EQUAL(1, bus.searches);
+  TEST_ASSERT_EQUAL(100, bus.conversions);
+  TEST_ASSERT_EQUAL(200, bus.reads);
+}
+
+void test_crc_error_is_retried() {
+  MockSensorBus bus;
+  bus.devices.push_back({makeRom(1), 21.0F, true, 2});
+  bus.devices.push_back({makeRom(2), 34.5F, true, 0});
+
+  RomAddressedSensors sensors(bus);
+  sensors.enumerate(emptyTable());
+  sensors.requestTemperatures();
+  TEST_ASSERT_FLOAT_WITHIN(0.001F, 21.0F, sensors.getTempCByIndex(0));
+  TEST_ASSERT_EQUAL_UINT32(2, sensors.crcRetries());
+
+  bus.devices[0].corruptReads = SENSOR_READ_ATTEMPTS;
+  TEST_ASSERT_EQUAL_FLOAT(SENSOR_DISCONNECTED_C, sensors.getTempCByIndex(0));
+  TEST_ASSERT_EQUAL_UINT32(2 + SENSOR_READ_ATTEMPTS, sensors.crcRetries());
+}
+
+void test_swap_follows_physical_sensor_across_restart() {
+  MockSensorBus bus;
+  bus.devices.push_back({makeRom(1), 21.0F, true, 0});
+  bus.devices.push_back({makeRom(2), 34.5F, true, 0});
+
+  RomAddressedSensors first(bus);
+  first.enumerate(emptyTable());
+  const SensorRomTable persisted = first.slots();
+
+  // Next boot the bus search returns the sensors in the opposite order.
+  std::swap(bus.devices[0], bus.devices[1]);
+  RomAddressedSensors second(bus);
+  second.enumerate(persisted);
+  TEST_ASSERT_FALSE(second.consumeSlotsChanged());
+  second.requestTemperatures();
+  TEST_ASSERT_FLOAT_WITHIN(0.001F, 21.0F, second.getTempCByIndex(0));
+  TEST_ASSERT_FLOAT_WITHIN(0.001F, 34.5F, second.getTempCByIndex(1));
+}
+
+void test_failing_sensor_triggers_rescan_for_replacement() {
+  MockSensorBus bus;
+  bus.devices.push_back({makeRom(1), 21.0F, true, 0});
+  bus.devices.push_back({makeRom(2), 34.5F, true, 0});
+
+  RomAddressedSensors sensors(bus);
+  sensors.enumerate(emptyTable());
+  sensors.consumeSlotsChanged();
+
+  // Sensor 1 is unplugged and replaced by a new one.
+  bus.devices[0].present = false;
+  bus.devices.push_back({makeRom(7), 19.0F, true, 0});
+
+  float temp1 = 0.0F;
+  for (int cycle = 0; cycle < SENSOR_RESCAN_AFTER_CYCLES + 1; ++cycle) {
+    sensors.requestTemperatures();
+    temp1 = sensors.getTempCByIndex(0);
+    sensors.getTempCByIndex(1);
+  }
+  TEST_ASSERT_EQUAL(2, bus.searches);
+  TEST_ASSERT_EQUAL_UINT32(1, sensors.rescanCount());
+  TEST_ASSERT_TRUE(sensors.consumeSlotsChanged());
+  TEST_ASSERT_FLOAT_WITHIN(0.001F, 19.0F, temp1);
+  TEST_ASSERT_FLOAT_WITHIN(0.001F, 34.5F, sensors.getTempCByIndex(1));
+}
+
+void test_empty_slot_picks_up_hot_plugged_sensor() {
+  MockSensorBus bus;
+  bus.devices.push_back({makeRom(1), 21.0F, true, 0});
+
+  RomAddressedSensors sensors(bus);
+  sensors.enumerate(emptyTable());
+  TEST_ASSERT_EQUAL_UINT8(1, sensors.sensorCount());
+  TEST_ASSERT_EQUAL_FLOAT(SENSOR_DISCONNECTED_C, sensors.getTempCByIndex(1));
+
+  bus.devices.push_back({makeRom(2), 34.5F, true, 0});
+  int cycles = 0;
+  while (sensors.sensorCount() < 2 && cycles < 100) {
+    sensors.requestTemperatures();
+    cycles++;
+  }
+  TEST_ASSERT_EQUAL_UINT8(2, sensors.sensorCount());
+  // Empty slots are probed far less often than failing ones.
+  TEST_ASSERT_GREATER_THAN(SENSOR_RESCAN_AFTER_CYCLES, cycles);
+  TEST_ASSERT_FLOAT_WITHIN(0.001F, 34.5F, sensors.getTempCByIndex(1));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc8_matches_maxim_reference);
+  RUN_TEST(test_rom_validation);
+  RUN_TEST(test_decode_scratchpad);
+  RUN_TEST(test_decode_masks_undefined_bits_at_low_resolution);
+  RUN_TEST(test_assign_keeps_persisted_slots_regardless_of_bus_order);
+  RUN_TEST(test_assign_fills_free_slot_with_replacement_sensor);
+  RUN_TEST(test_reads_by_address_without_searching);
+  RUN_TEST(test_crc_error_is_retried);
+  RUN_TEST(test_swap_follows_physical_sensor_across_restart);
+  RUN_TEST(test_failing_sensor_triggers_rescan_for_replacement);
+  RUN_TEST(test_empty_slot_picks_up_hot_plugged_sensor);
+  return UNITY_END();
+}
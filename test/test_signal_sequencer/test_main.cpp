@@ -0,0 +1,183 @@
+#include <unity.h>
+
+#include <vector>
+
+#include "signal_sequencer.h"
+
+using namespace HeatControl;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+constexpr SignalTimingPreset ALL_PRESETS[] = {SignalTimingPreset::Short, SignalTimingPreset::Middle,
+                                              SignalTimingPreset::Fast};
+
+struct Edge {
+  unsigned long atMs;
+  bool on;
+};
+
+// Polls the sequencer every `stepMs` from `startMs` until it goes idle and records each level change.
+std::vector<Edge> play(SignalSequencer &sequencer, unsigned long startMs, unsigned long stepMs) {
+  std::vector<Edge> edges;
+  bool level = false;
+  for (unsigned long now = startMs; now < startMs + 60000UL; now += stepMs) {
+    const bool on = sequencer.update(now);
+    if (on != level) {
+      edges.push_back(Edge{now, on});
+      level = on;
+    }
+    if (!sequencer.active()) {
+      break;
+    }
+  }
+  return edges;
+}
+
+// Expected level changes for on/off durations (Middle ms) played back to back from `startMs`.
+std::vector<Edge> expectedEdges(const std::vector<unsigned long> &durationsMs, SignalTimingPreset preset,
+                                unsigned long startMs) {
+  std::vector<Edge> edges;
+  unsigned long t = startMs;
+  for (size_t i = 0; i < durationsMs.size(); ++i) {
+    edges.push_back(Edge{t, (i % 2U) == 0U});
+    t += scaleSignalMs(durationsMs[i], preset);
+  }
+  if ((durationsMs.size() % 2U) == 1U) {
+    edges.push_back(Edge{t, false});
+  }
+  return edges;
+}
+
+void assertEdges(const std::vector<Edge> &expected, const std::vector<Edge> &actual) {
+  TEST_ASSERT_EQUAL_UINT32(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    TEST_ASSERT_EQUAL_UINT32(expected[i].atMs, actual[i].atMs);
+    TEST_ASSERT_EQUAL(expected[i].on, actual[i].on);
+  }
+}
+
+}  // namespace
+
+void test_manual_power_pattern_timing_for_every_preset() {
+  const uint8_t percents[] = {25, 50, 75, 100};
+  for (SignalTimingPreset preset : ALL_PRESETS) {
+    for (uint8_t percent : percents) {
+      for (int intro = 0; intro < 2; ++intro) {
+        SignalSequencer sequencer;
+        TEST_ASSERT_TRUE(enqueueManualPowerSignal(sequencer, percent, intro != 0, preset));
+        std::vector<unsigned long> durations;
+        if (intro != 0) {
+          durations.push_back(500);
+          durations.push_back(220);
+        }
+        for (uint8_t i = 0; i < manualPowerStepPulses(percent); ++i) {
+          durations.push_back(130);
+          durations.push_back(130);
+        }
+        assertEdges(expectedEdges(durations, preset, 1000), play(sequencer, 1000, 1));
+      }
+    }
+  }
+}
+
+void test_startup_pattern_timing_for_every_preset() {
+  for (SignalTimingPreset preset : ALL_PRESETS) {
+    SignalSequencer sequencer;
+    TEST_ASSERT_TRUE(enqueueStartupSignal(sequencer, false, false, 0, preset));
+    assertEdges(expectedEdges({300, 200}, preset, 0), play(sequencer, 0, 1));
+
+    TEST_ASSERT_TRUE(enqueueStartupSignal(sequencer, true, false, 0, preset));
+    assertEdges(expectedEdges({300, 200, 300, 200}, preset, 5000), play(sequencer, 5000, 1));
+
+    // Manual mode starts with the intro pulse followed by the step pulses.
+    TEST_ASSERT_TRUE(enqueueStartupSignal(sequencer, true, true, 75, preset));
+    assertEdges(expectedEdges({500, 220, 130, 130, 130, 130, 130, 130}, preset, 9000), play(sequencer, 9000, 1));
+  }
+}
+
+void test_test_pulse_timing_for_every_preset() {
+  for (SignalTimingPreset preset : ALL_PRESETS) {
+    SignalSequencer sequencer;
+    TEST_ASSERT_TRUE(enqueueTestPulse(sequencer, preset));
+    assertEdges(expectedEdges({120}, preset, 42), play(sequencer, 42, 1));
+  }
+}
+
+void test_late_updates_do_not_stretch_the_pattern() {
+  SignalSequencer sequencer;
+  TEST_ASSERT_TRUE(enqueueManualPowerSignal(sequencer, 100, true, SignalTimingPreset::Middle));
+  // Polled every 7 ms, every edge is seen at most 6 ms late and the lateness does not accumulate.
+  const std::vector<Edge> expected =
+      expectedEdges({500, 220, 130, 130, 130, 130, 130, 130, 130, 130}, SignalTimingPreset::Middle, 0);
+  const std::vector<Edge> actual = play(sequencer, 0, 7);
+  TEST_ASSERT_EQUAL_UINT32(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    TEST_ASSERT_UINT32_WITHIN(6, expected[i].atMs + 3U, actual[i].atMs);
+    TEST_ASSERT_TRUE(actual[i].atMs >= expected[i].atMs);
+    TEST_ASSERT_EQUAL(expected[i].on, actual[i].on);
+  }
+
+  // An update that skips whole steps lands on the step that is due now.
+  TEST_ASSERT_TRUE(enqueueStartupSignal(sequencer, true, false, 0, SignalTimingPreset::Middle));
+  TEST_ASSERT_TRUE(sequencer.update(10000));
+  TEST_ASSERT_TRUE(sequencer.update(10500 + 10));  // second pulse
+  TEST_ASSERT_FALSE(sequencer.update(10800 + 10));
+  TEST_ASSERT_TRUE(sequencer.active());
+  TEST_ASSERT_FALSE(sequencer.update(11000));
+  TEST_ASSERT_FALSE(sequencer.active());
+}
+
+void test_requests_queue_behind_a_running_pattern() {
+  SignalSequencer sequencer;
+  TEST_ASSERT_TRUE(enqueueStartupSignal(sequencer, false, false, 0, SignalTimingPreset::Middle));
+  TEST_ASSERT_TRUE(sequencer.update(0));
+  TEST_ASSERT_TRUE(sequencer.update(50));
+  // Queued mid-pulse with its own preset: starts where the startup pattern ends, not at the request.
+  TEST_ASSERT_TRUE(enqueueManualPowerSignal(sequencer, 25, false, SignalTimingPreset::Fast));
+  const std::vector<Edge> actual = play(sequencer, 51, 1);
+  TEST_ASSERT_EQUAL_UINT32(4, actual.size());
+  TEST_ASSERT_EQUAL_UINT32(51, actual[0].atMs);  // still inside the startup pulse
+  TEST_ASSERT_TRUE(actual[0].on);
+  TEST_ASSERT_EQUAL_UINT32(300, actual[1].atMs);
+  TEST_ASSERT_FALSE(actual[1].on);
+  TEST_ASSERT_EQUAL_UINT32(500, actual[2].atMs);
+  TEST_ASSERT_TRUE(actual[2].on);
+  TEST_ASSERT_EQUAL_UINT32(565, actual[3].atMs);
+  TEST_ASSERT_FALSE(actual[3].on);
+  TEST_ASSERT_FALSE(sequencer.active());
+}
+
+void test_full_queue_rejects_whole_requests() {
+  SignalSequencer sequencer;
+  uint8_t queued = 0;
+  while (enqueueManualPowerSignal(sequencer, 100, true, SignalTimingPreset::Middle)) {
+    ++queued;
+  }
+  TEST_ASSERT_EQUAL_UINT8(3, queued);  // 10 steps each in a 32-step queue
+  TEST_ASSERT_EQUAL_UINT8(30, sequencer.queuedSteps());
+  TEST_ASSERT_FALSE(enqueueManualPowerSignal(sequencer, 25, true, SignalTimingPreset::Middle));
+  TEST_ASSERT_EQUAL_UINT8(30, sequencer.queuedSteps());
+  TEST_ASSERT_TRUE(enqueueManualPowerSignal(sequencer, 25, false, SignalTimingPreset::Middle));
+  TEST_ASSERT_EQUAL_UINT8(32, sequencer.queuedSteps());
+  TEST_ASSERT_FALSE(enqueueTestPulse(sequencer, SignalTimingPreset::Middle));
+
+  sequencer.clear();
+  TEST_ASSERT_FALSE(sequencer.active());
+  TEST_ASSERT_FALSE(sequencer.update(0));
+  TEST_ASSERT_TRUE(enqueueTestPulse(sequencer, SignalTimingPreset::Middle));
+  TEST_ASSERT_TRUE(sequencer.update(1));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_manual_power_pattern_timing_for_every_preset);
+  RUN_TEST(test_startup_pattern_timing_for_every_preset);
+  RUN_TEST(test_test_pulse_timing_for_every_preset);
+  RUN_TEST(test_late_updates_do_not_stretch_the_pattern);
+  RUN_TEST(test_requests_queue_behind_a_running_pattern);
+  RUN_TEST(test_full_queue_rejects_whole_requests);
+  return UNITY_END();
+}
@@ -0,0 +1,316 @@
+#include <map>
+
+#include <unity.h>
+
+#include "control_logic.h"
+#include "logic_helpers.h"
+#include "slow_pwm.h"
+#include "storage_logic.h"
+
+using namespace HeatControl::logic;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+constexpr int PIN_1 = 2;
+constexpr int PIN_2 = 5;
+const HeaterSupply NO_SUPPLY = {0.0F, 0, HeatControl::BATTERY_CHEMISTRY_LI_ION};
+
+// Records the on-time per pin against a virtual microsecond clock.
+class TimingGpio : public IGpio {
+ public:
+  void writePin(int pin, int level) override {
+    settle(pin);
+    levels[pin] = level;
+    writes[pin]++;
+  }
+
+  int readPin(int pin) const override {
+    auto it = levels.find(pin);
+    return it == levels.end() ? PIN_LOW : it->second;
+  }
+
+  void advance(uint64_t us) { nowUs += us; }
+
+  void settle(int pin) {
+    if (readPin(pin) == PIN_HIGH) {
+      onUs[pin] += nowUs - lastChangeUs[pin];
+    }
+    lastChangeUs[pin] = nowUs;
+  }
+
+  std::map<int, int> levels;
+  std::map<int, int> writes;
+  std::map<int, uint64_t> onUs;
+  std::map<int, uint64_t> lastChangeUs;
+  uint64_t nowUs = 0;
+};
+
+// Drives the engine like the periodic timer does and returns the delivered duty in percent per pin.
+void runPeriods(SlowPwmOutput &pwm, TimingGpio &gpio, int periods, float &duty1Percent, float &duty2Percent) {
+  const uint64_t startUs = gpio.nowUs;
+  gpio.onUs.clear();
+  gpio.lastChangeUs[PIN_1] = startUs;
+  gpio.lastChangeUs[PIN_2] = startUs;
+  const int ticks = periods * pwm.steps();
+  for (int i = 0; i < ticks; ++i) {
+    pwm.tick(gpio);
+    gpio.advance(pwm.tickIntervalUs());
+  }
+  gpio.settle(PIN_1);
+  gpio.settle(PIN_2);
+  const float totalUs = static_cast<float>(gpio.nowUs - startUs);
+  duty1Percent = 100.0F * static_cast<float>(gpio.onUs[PIN_1]) / totalUs;
+  duty2Percent = 100.0F * static_cast<float>(gpio.onUs[PIN_2]) / totalUs;
+}
+
+}  // namespace
+
+void test_tick_interval_follows_period_and_resolution() {
+  SlowPwmOutput pwm(PIN_1, PIN_2, 1000, 100);
+  TEST_ASSERT_EQUAL_UINT32(10000, pwm.tickIntervalUs());
+  pwm.configure(2000, 250);
+  TEST_ASSERT_EQUAL_UINT32(8000, pwm.tickIntervalUs());
+  pwm.configure(0, 0);
+  TEST_ASSERT_EQUAL_UINT32(1000, pwm.tickIntervalUs());
+}
+
+void test_delivered_duty_within_one_percent() {
+  const uint16_t requested[] = {0, 10, 250, 333, 500, 667, 750, 995, 1000};
+  for (uint16_t duty : requested) {
+    SlowPwmOutput pwm(PIN_1, PIN_2, 1000, 100);
+    TimingGpio gpio;
+    pwm.setDutyPermille(0, duty);
+    pwm.setDutyPermille(1, static_cast<uint16_t>(SLOW_PWM_DUTY_MAX - duty));
+
+    float delivered1 = 0.0F;
+    float delivered2 = 0.0F;
+    runPeriods(pwm, gpio, 20, delivered1, delivered2);
+    TEST_ASSERT_FLOAT_WITHIN(1.0F, duty / 10.0F, delivered1);
+    TEST_ASSERT_FLOAT_WITHIN(1.0F, (SLOW_PWM_DUTY_MAX - duty) / 10.0F, delivered2);
+  }
+}
+
+void test_manual_steps_are_honoured() {
+  const uint8_t percents[] = {25, 50, 75};
+  for (uint8_t percent : percents) {
+    SlowPwmOutput pwm(PIN_1, PIN_2, 1000, 100);
+    TimingGpio gpio;
+    pwm.setDutyPermille(0, manualDutyPermille(percent));
+
+    float delivered1 = 0.0F;
+    float delivered2 = 0.0F;
+    runPeriods(pwm, gpio, 10, delivered1, delivered2);
+    TEST_ASSERT_FLOAT_WITHIN(1.0F, static_cast<float>(percent), delivered1);
+  }
+}
+
+void test_pins_are_written_only_on_edges() {
+  SlowPwmOutput pwm(PIN_1, PIN_2, 1000, 100);
+  TimingGpio gpio;
+  pwm.setDutyPermille(0, 500);
+  pwm.setDutyPermille(1, 0);
+
+  float delivered1 = 0.0F;
+  float delivered2 = 0.0F;
+  runPeriods(pwm, gpio, 10, delivered1, delivered2);
+  // One initial write, then a rising and a falling edge per period (the first rise is the initial write).
+  TEST_ASSERT_EQUAL(20, gpio.writes[PIN_1]);
+  TEST_ASSERT_EQUAL(1, gpio.writes[PIN_2]);
+}
+
+void test_duty_change_is_latched_at_period_start() {
+  SlowPwmOutput pwm(PIN_1, PIN_2, 1000, 100);
+  TimingGpio gpio;
+  pwm.setDutyPermille(0, 200);
+  for (int i = 0; i < 50; ++i) {
+    pwm.tick(gpio);
+  }
+  TEST_ASSERT_FALSE(pwm.outputOn(0));
+
+  // Raising the duty mid-period must not add a second pulse to the running period.
+  pwm.setDutyPermille(0, 800);
+  for (int i = 50; i < 100; ++i) {
+    pwm.tick(gpio);
+    TEST_ASSERT_FALSE(pwm.outputOn(0));
+  }
+  pwm.tick(gpio);
+  TEST_ASSERT_TRUE(pwm.outputOn(0));
+}
+
+void test_inhibit_forces_output_off_immediately() {
+  SlowPwmOutput pwm(PIN_1, PIN_2, 1000, 100);
+  TimingGpio gpio;
+  pwm.setDutyPermille(0, 1000);
+  pwm.setDutyPermille(1, 1000);
+  pwm.tick(gpio);
+  TEST_ASSERT_EQUAL(PIN_HIGH, gpio.readPin(PIN_1));
+
+  pwm.setInhibited(0, true);
+  pwm.tick(gpio);
+  TEST_ASSERT_EQUAL(PIN_LOW, gpio.readPin(PIN_1));
+  TEST_ASSERT_EQUAL(PIN_HIGH, gpio.readPin(PIN_2));
+
+  float delivered1 = 0.0F;
+  float delivered2 = 0.0F;
+  runPeriods(pwm, gpio, 3, delivered1, delivered2);
+  TEST_ASSERT_EQUAL_FLOAT(0.0F, delivered1);
+  TEST_ASSERT_FLOAT_WITHIN(0.01F, 100.0F, delivered2);
+}
+
+void test_duty_is_clamped() {
+  SlowPwmOutput pwm(PIN_1, PIN_2, 1000, 100);
+  pwm.setDutyPermille(0, 5000);
+  TEST_ASSERT_EQUAL_UINT16(SLOW_PWM_DUTY_MAX, pwm.dutyPermille(0));
+  pwm.setDutyPermille(7, 500);
+  TEST_ASSERT_EQUAL_UINT16(0, pwm.dutyPermille(7));
+}
+
+void test_compute_heater_duties() {
+  uint16_t duty1 = 0;
+  uint16_t duty2 = 0;
+  PidController pid1;
+  PidController pid2;
+
+  computeHeaterDuties(false, true, ManualPowerMode::Duty, 50, 100, true, false, NO_SUPPLY, NO_SUPPLY, 4.0F, false,
+                      30.0F, 30.0F, 20.0F, 20.0F, ControlMode::BangBang, pid1, pid2, 1.0F, duty1, duty2);
+  TEST_ASSERT_EQUAL_UINT16(500, duty1);
+  TEST_ASSERT_EQUAL_UINT16(0, duty2);
+
+  computeHeaterDuties(false, true, ManualPowerMode::Duty, 20, 75, true, true, NO_SUPPLY, NO_SUPPLY, 4.0F, false,
+                      30.0F, 30.0F, 20.0F, 20.0F, ControlMode::BangBang, pid1, pid2, 1.0F, duty1, duty2);
+  TEST_ASSERT_EQUAL_UINT16(0, duty1);
+  TEST_ASSERT_EQUAL_UINT16(750, duty2);
+
+  // Constant-power steps follow each heater's own pack; disabled heaters stay off.
+  const HeaterSupply full = {12.6F, 3, HeatControl::BATTERY_CHEMISTRY_LI_ION};
+  const HeaterSupply nominal = {10.8F, 3, HeatControl::BATTERY_CHEMISTRY_LI_ION};
+  computeHeaterDuties(false, true, ManualPowerMode::ConstantPower, 50, 50, true, true, full, nominal, 4.0F, false,
+                      30.0F, 30.0F, 20.0F, 20.0F, ControlMode::BangBang, pid1, pid2, 1.0F, duty1, duty2);
+  TEST_ASSERT_TRUE(duty1 < 500);
+  TEST_ASSERT_EQUAL_UINT16(500, duty2);
+  computeHeaterDuties(false, true, ManualPowerMode::ConstantPower, 50, 50, false, true, full, NO_SUPPLY, 4.0F, false,
+                      30.0F, 30.0F, 20.0F, 20.0F, ControlMode::BangBang, pid1, pid2, 1.0F, duty1, duty2);
+  TEST_ASSERT_EQUAL_UINT16(0, duty1);
+  TEST_ASSERT_EQUAL_UINT16(500, duty2);
+
+  // Temperature mode with swapped sensors: sensor 2 controls heater 1.
+  computeHeaterDuties(false, false, ManualPowerMode::Duty, 0, 0, false, false, NO_SUPPLY, NO_SUPPLY, 4.0F, true,
+                      25.0F, 25.0F, 30.0F, 20.0F, ControlMode::BangBang, pid1, pid2, 1.0F, duty1, duty2);
+  TEST_ASSERT_EQUAL_UINT16(SLOW_PWM_DUTY_MAX, duty1);
+  TEST_ASSERT_EQUAL_UINT16(0, duty2);
+
+  computeHeaterDuties(false, false, ManualPowerMode::Duty, 0, 0, false, false, NO_SUPPLY, NO_SUPPLY, 4.0F, false,
+                      25.0F, 25.0F, -127.0F, 20.0F, ControlMode::BangBang, pid1, pid2, 1.0F, duty1, duty2);
+  TEST_ASSERT_EQUAL_UINT16(0, duty1);
+  TEST_ASSERT_EQUAL_UINT16(SLOW_PWM_DUTY_MAX, duty2);
+
+  computeHeaterDuties(true, false, ManualPowerMode::Duty, 0, 0, false, false, NO_SUPPLY, NO_SUPPLY, 4.0F, false,
+                      25.0F, 25.0F, -127.0F, 40.0F, ControlMode::BangBang, pid1, pid2, 1.0F, duty1, duty2);
+  TEST_ASSERT_EQUAL_UINT16(SLOW_PWM_DUTY_MAX, duty1);
+  TEST_ASSERT_EQUAL_UINT16(SLOW_PWM_DUTY_MAX, duty2);
+
+  // PID mode yields proportional duties instead of full on/off.
+  computeHeaterDuties(false, false, ManualPowerMode::Duty, 0, 0, false, false, NO_SUPPLY, NO_SUPPLY, 4.0F, false,
+                      25.0F, 25.0F, 23.0F, -127.0F, ControlMode::Pid, pid1, pid2, 1.0F, duty1, duty2);
+  TEST_ASSERT_TRUE(duty1 > 0 && duty1 < SLOW_PWM_DUTY_MAX);
+  TEST_ASSERT_EQUAL_UINT16(0, duty2);
+}
+
+void test_constant_power_duty() {
+  // 3S Li-ion at 10.8 V nominal into 4 ohm: 29.16 W rated.
+  TEST_ASSERT_FLOAT_WITHIN(0.01F, 29.16F, manualStepWatts(100, 3, HeatControl::BATTERY_CHEMISTRY_LI_ION, 4.0F));
+  TEST_ASSERT_FLOAT_WITHIN(0.01F, 14.58F, manualStepWatts(50, 3, HeatControl::BATTERY_CHEMISTRY_LI_ION, 4.0F));
+  TEST_ASSERT_EQUAL_FLOAT(0.0F, manualStepWatts(20, 3, HeatControl::BATTERY_CHEMISTRY_LI_ION, 4.0F));
+  TEST_ASSERT_EQUAL_FLOAT(0.0F, manualStepWatts(50, 3, HeatControl::BATTERY_CHEMISTRY_LI_ION, 0.0F));
+
+  // 10 W into 4 ohm at 12 V: 40/144 = 277.8 permille.
+  TEST_ASSERT_EQUAL_UINT16(278, constantPowerDutyPermille(10.0F, 12.0F, 4.0F));
+  TEST_ASSERT_EQUAL_UINT16(SLOW_PWM_DUTY_MAX, constantPowerDutyPermille(50.0F, 12.0F, 4.0F));
+  TEST_ASSERT_EQUAL_UINT16(0, constantPowerDutyPermille(0.0F, 12.0F, 4.0F));
+  TEST_ASSERT_EQUAL_UINT16(0, constantPowerDutyPermille(10.0F, 0.0F, 4.0F));
+
+  // At nominal voltage both modes agree; a full pack gets less duty, a tired one more.
+  const uint8_t liIon = HeatControl::BATTERY_CHEMISTRY_LI_ION;
+  TEST_ASSERT_EQUAL_UINT16(500, manualModeDutyPermille(ManualPowerMode::ConstantPower, 50, 10.8F, 3, liIon, 4.0F));
+  TEST_ASSERT_TRUE(manualModeDutyPermille(ManualPowerMode::ConstantPower, 50, 12.6F, 3, liIon, 4.0F) < 500);
+  TEST_ASSERT_TRUE(manualModeDutyPermille(ManualPowerMode::ConstantPower, 50, 9.9F, 3, liIon, 4.0F) > 500);
+  TEST_ASSERT_EQUAL_UINT16(0, manualModeDutyPermille(ManualPowerMode::ConstantPower, 20, 12.0F, 3, liIon, 4.0F));
+  // Duty mode, no battery, no measurement yet or no cell count: the plain duty step.
+  TEST_ASSERT_EQUAL_UINT16(500, manualModeDutyPermille(ManualPowerMode::Duty, 50, 12.6F, 3, liIon, 4.0F));
+  TEST_ASSERT_EQUAL_UINT16(500, manualModeDutyPermille(ManualPowerMode::ConstantPower, 50, 0.0F, 3, liIon, 4.0F));
+  TEST_ASSERT_EQUAL_UINT16(500, manualModeDutyPermille(ManualPowerMode::ConstantPower, 50, 1.2F, 3, liIon, 4.0F));
+  TEST_ASSERT_EQUAL_UINT16(500, manualModeDutyPermille(ManualPowerMode::ConstantPower, 50, 12.6F, 0, liIon, 4.0F));
+}
+
+void test_constant_power_over_discharge_curves() {
+  struct Pack {
+    uint8_t chemistry;
+    uint8_t cells;
+    const char *name;
+  };
+  const Pack packs[] = {
+      {HeatControl::BATTERY_CHEMISTRY_LI_ION, 3, "Li-ion 3S"},     {HeatControl::BATTERY_CHEMISTRY_LI_PO, 3, "LiPo 3S"},
+      {HeatControl::BATTERY_CHEMISTRY_LI_FE_PO4, 4, "LiFePO4 4S"}, {HeatControl::BATTERY_CHEMISTRY_NI_MH, 8, "NiMH 8S"},
+      {HeatControl::BATTERY_CHEMISTRY_LEAD_GEL, 6, "lead gel 6S"},
+  };
+  const float ohm = 4.0F;
+  const uint8_t steps[] = {25, 50, 75, 100};
+
+  for (const Pack &pack : packs) {
+    // Walk the cell voltage down the chemistry's curve from full to empty in 2 mV steps.
+    float cellV = 5.0F;
+    while (HeatControl::logic_helpers::voltageToSocFloat(cellV, pack.chemistry) >= 100.0F) cellV -= 0.002F;
+    const float fullV = cellV + 0.002F;
+
+    for (uint8_t percent : steps) {
+      const float target = manualStepWatts(percent, pack.cells, pack.chemistry, ohm);
+      float minDuty = 1.0e9F;
+      float maxDuty = 0.0F;
+      float saturatedSoc = 0.0F;  // SoC left when the step first ran out of headroom
+      for (float v = fullV; HeatControl::logic_helpers::voltageToSocFloat(v, pack.chemistry) > 0.0F; v -= 0.002F) {
+        const float packV = v * pack.cells;
+        const uint16_t duty = manualModeDutyPermille(ManualPowerMode::ConstantPower, percent, packV, pack.cells,
+                                                     pack.chemistry, ohm);
+        const float watts = packV * packV / ohm * duty / SLOW_PWM_DUTY_MAX;
+        if (duty < SLOW_PWM_DUTY_MAX) {
+          // Within half a permille of duty of the target.
+          TEST_ASSERT_FLOAT_WITHIN(packV * packV / ohm * 0.0005F + 0.001F, target, watts);
+        } else if (saturatedSoc == 0.0F) {
+          saturatedSoc = HeatControl::logic_helpers::voltageToSocFloat(v, pack.chemistry);
+        }
+        const float dutyWatts = packV * packV / ohm * manualDutyPermille(percent) / SLOW_PWM_DUTY_MAX;
+        if (dutyWatts < minDuty) minDuty = dutyWatts;
+        if (dutyWatts > maxDuty) maxDuty = dutyWatts;
+      }
+      if (percent <= 50) {
+        TEST_ASSERT_EQUAL_FLOAT(0.0F, saturatedSoc);
+      }
+      if (percent < 100) {
+        // Headroom lasts down to the last fifth of the charge.
+        TEST_ASSERT_TRUE(saturatedSoc < 20.0F);
+      }
+      char message[128];
+      snprintf(message, sizeof(message), "%s %u %%: %.1f W constant | duty steps %.1f..%.1f W | full on below %.0f %%",
+               pack.name, static_cast<unsigned>(percent), target, minDuty, maxDuty, saturatedSoc);
+      TEST_MESSAGE(message);
+    }
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_tick_interval_follows_period_and_resolution);
+  RUN_TEST(test_delivered_duty_within_one_percent);
+  RUN_TEST(test_manual_steps_are_honoured);
+  RUN_TEST(test_pins_are_written_only_on_edges);
+  RUN_TEST(test_duty_change_is_latched_at_period_start);
+  RUN_TEST(test_inhibit_forces_output_off_immediately);
+  RUN_TEST(test_duty_is_clamped);
+  RUN_TEST(test_compute_heater_duties);
+  RUN_TEST(test_constant_power_duty);
+  RUN_TEST(test_constant_power_over_discharge_curves);
+  return UNITY_END();
+}
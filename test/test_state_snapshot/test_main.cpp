@@ -0,0 +1,129 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include <unity.h>
+
+#include "state_snapshot.h"
+
+using namespace HeatControl::logic;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+constexpr int FIELD_COUNT = 64;
+// Long enough for the scheduler to preempt readers mid-copy many times, even on a single core.
+constexpr auto WRITER_DURATION = std::chrono::milliseconds(500);
+
+// Every field carries the same sequence number, so any mix of two publishes is detectable.
+struct TaggedState {
+  uint32_t sequence;
+  float temps[FIELD_COUNT];
+  uint32_t check[FIELD_COUNT];
+  bool odd;
+};
+
+TaggedState makeState(uint32_t sequence) {
+  TaggedState state;
+  state.sequence = sequence;
+  for (int i = 0; i < FIELD_COUNT; ++i) {
+    state.temps[i] = static_cast<float>(sequence) + static_cast<float>(i) * 0.5F;
+    state.check[i] = sequence ^ static_cast<uint32_t>(i);
+  }
+  state.odd = (sequence & 1U) != 0U;
+  return state;
+}
+
+bool isConsistent(const TaggedState &state) {
+  for (int i = 0; i < FIELD_COUNT; ++i) {
+    if (state.check[i] != (state.sequence ^ static_cast<uint32_t>(i))) {
+      return false;
+    }
+    if (state.temps[i] != static_cast<float>(state.sequence) + static_cast<float>(i) * 0.5F) {
+      return false;
+    }
+  }
+  return state.odd == ((state.sequence & 1U) != 0U);
+}
+
+}  // namespace
+
+void test_initial_snapshot_is_version_zero() {
+  SnapshotBuffer<TaggedState> buffer(makeState(0));
+  TaggedState state;
+  TEST_ASSERT_EQUAL_UINT32(0, buffer.read(state));
+  TEST_ASSERT_EQUAL_UINT32(0, buffer.version());
+  TEST_ASSERT_TRUE(isConsistent(state));
+}
+
+void test_publish_bumps_version_and_replaces_value() {
+  SnapshotBuffer<TaggedState> buffer(makeState(0));
+  buffer.publish(makeState(7));
+  buffer.publish(makeState(8));
+
+  TaggedState state;
+  TEST_ASSERT_EQUAL_UINT32(2, buffer.read(state));
+  TEST_ASSERT_EQUAL_UINT32(8, state.sequence);
+  TEST_ASSERT_TRUE(isConsistent(state));
+  TEST_ASSERT_EQUAL_UINT32(8, buffer.read().sequence);
+}
+
+void test_concurrent_readers_never_see_torn_state() {
+  SnapshotBuffer<TaggedState> buffer(makeState(0));
+  std::atomic<bool> done(false);
+  std::atomic<uint32_t> torn(0);
+  std::atomic<uint32_t> regressions(0);
+  std::atomic<uint32_t> reads(0);
+  std::atomic<int> running(0);
+
+  const auto reader = [&]() {
+    uint32_t lastVersion = 0;
+    uint32_t lastSequence = 0;
+    TaggedState state;
+    running.fetch_add(1);
+    while (!done.load(std::memory_order_acquire)) {
+      const uint32_t version = buffer.read(state);
+      if (!isConsistent(state) || state.sequence != version) {
+        torn.fetch_add(1);
+      }
+      if (version < lastVersion || state.sequence < lastSequence) {
+        regressions.fetch_add(1);
+      }
+      lastVersion = version;
+      lastSequence = state.sequence;
+      reads.fetch_add(1, std::memory_order_relaxed);
+    }
+  };
+
+  std::thread reader1(reader);
+  std::thread reader2(reader);
+  while (running.load() < 2) {
+    std::this_thread::yield();
+  }
+  const auto stopAt = std::chrono::steady_clock::now() + WRITER_DURATION;
+  uint32_t published = 0;
+  while (std::chrono::steady_clock::now() < stopAt) {
+    ++published;
+    buffer.publish(makeState(published));
+  }
+  done.store(true, std::memory_order_release);
+  reader1.join();
+  reader2.join();
+
+  TEST_ASSERT_EQUAL_UINT32(0, torn.load());
+  TEST_ASSERT_EQUAL_UINT32(0, regressions.load());
+  TEST_ASSERT_TRUE(reads.load() > 0U);
+  TEST_ASSERT_EQUAL_UINT32(published, buffer.version());
+  TEST_ASSERT_EQUAL_UINT32(published, buffer.read().sequence);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_initial_snapshot_is_version_zero);
+  RUN_TEST(test_publish_bumps_version_and_replaces_value);
+  RUN_TEST(test_concurrent_readers_never_see_torn_state);
+  return UNITY_END();
+}
@@ -1,17 +1,205 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
 #include <string>
 
 #include <unity.h>
 
+#include "logic_helpers.h"
 #include "status_builder.h"
 
 using namespace HeatControl;
 
+namespace {
+unsigned long allocationCount = 0;
+}  // namespace
+
+void *operator new(std::size_t size) {
+  ++allocationCount;
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
 void setUp() {}
 void tearDown() {}
 
+namespace {
+
+// The string-concatenation builder the JsonWriter replaced; kept as the byte-for-byte reference.
+std::string legacyFormatFloat(float value, int decimals) {
+  if (std::isnan(value)) {
+    return "null";
+  }
+  char buffer[32];
+  const float scale = std::pow(10.0F, static_cast<float>(decimals));
+  const float rounded = std::round(value * scale) / scale;
+  snprintf(buffer, sizeof(buffer), "%.*f", decimals, static_cast<double>(rounded));
+  return std::string(buffer);
+}
+
+std::string legacyOptional(bool valid, float value, int decimals) {
+  return valid ? legacyFormatFloat(value, decimals) : "null";
+}
+
+std::string legacyBool(bool value) {
+  return value ? "1" : "0";
+}
+
+std::string legacyBuildStatusJson(const StatusMetrics &m) {
+  using logic_helpers::jsonEscape;
+  std::string json = "{";
+  json += "\"mode\":\"" + jsonEscape(m.modeText) + "\"";
+  json += ",\"logLevel\":\"" + jsonEscape(m.logLevelText) + "\"";
+  json += ",\"manualMode\":" + legacyBool(m.manualMode);
+  json += ",\"manualPercent1\":" + std::to_string(m.manualPercent1);
+  json += ",\"manualPercent2\":" + std::to_string(m.manualPercent2);
+  json += ",\"manualH1Enabled\":" + legacyBool(m.manualHeater1Enabled);
+  json += ",\"manualH2Enabled\":" + legacyBool(m.manualHeater2Enabled);
+  json += ",\"bootPin\":\"" + jsonEscape(m.bootPinText) + "\"";
+  json += ",\"adc1Mv\":" + std::to_string(m.adc1MilliVolts);
+  json += ",\"adc2Mv\":" + std::to_string(m.adc2MilliVolts);
+  json += ",\"ntcMosfet1Mv\":" + std::to_string(m.ntcMosfet1MilliVolts);
+  json += ",\"ntcMosfet2Mv\":" + std::to_string(m.ntcMosfet2MilliVolts);
+  json += ",\"ntcMosfet1C\":" + legacyOptional(m.ntcMosfet1Valid, m.ntcMosfet1TempC, 2);
+  json += ",\"ntcMosfet2C\":" + legacyOptional(m.ntcMosfet2Valid, m.ntcMosfet2TempC, 2);
+  json += ",\"mosfet1OvertempActive\":" + legacyBool(m.mosfet1OvertempActive);
+  json += ",\"mosfet2OvertempActive\":" + legacyBool(m.mosfet2OvertempActive);
+  json += ",\"mosfet1OvertempLatched\":" + legacyBool(m.mosfet1OvertempLatched);
+  json += ",\"mosfet2OvertempLatched\":" + legacyBool(m.mosfet2OvertempLatched);
+  json += ",\"mosfet1OvertempTripC\":" + legacyOptional(m.mosfet1TripValid, m.mosfet1TripTempC, 2);
+  json += ",\"mosfet2OvertempTripC\":" + legacyOptional(m.mosfet2TripValid, m.mosfet2TripTempC, 2);
+  json += ",\"mosfetOvertempLimitC\":" + legacyFormatFloat(m.mosfetOvertempLimitC, 1);
+  json += ",\"batt1Cells\":" + std::to_string(m.battery1CellCount);
+  json += ",\"batt1Chem\":" + std::to_string(m.battery1Chemistry);
+  json += ",\"batt1V\":" + legacyFormatFloat(m.battery1PackVoltage, 2);
+  json += ",\"batt1CellV\":" + legacyFormatFloat(m.battery1CellVoltage, 2);
+  json += ",\"batt1Soc\":" + std::to_string(m.battery1SocPercent);
+  json += ",\"batt1SourceMohm\":" + legacyOptional(m.battery1SourceValid, m.battery1SourceMilliOhm, 0);
+  json += ",\"batt1Weak\":" + legacyBool(m.battery1Weak);
+  json += ",\"batt2Cells\":" + std::to_string(m.battery2CellCount);
+  json += ",\"batt2Chem\":" + std::to_string(m.battery2Chemistry);
+  json += ",\"batt2V\":" + legacyFormatFloat(m.battery2PackVoltage, 2);
+  json += ",\"batt2CellV\":" + legacyFormatFloat(m.battery2CellVoltage, 2);
+  json += ",\"batt2Soc\":" + std::to_string(m.battery2SocPercent);
+  json += ",\"batt2SourceMohm\":" + legacyOptional(m.battery2SourceValid, m.battery2SourceMilliOhm, 0);
+  json += ",\"batt2Weak\":" + legacyBool(m.battery2Weak);
+  json += ",\"manualToggleMaxOffMs\":" + std::to_string(m.manualToggleMaxOffMs);
+  json += ",\"signalTimingPreset\":" + std::to_string(m.signalTimingPreset);
+  json += ",\"current1\":" + legacyFormatFloat(m.displayTemp1, 2);
+  json += ",\"current2\":" + legacyFormatFloat(m.displayTemp2, 2);
+  json += ",\"target1\":" + legacyFormatFloat(m.targetTemp1, 1);
+  json += ",\"target2\":" + legacyFormatFloat(m.targetTemp2, 1);
+  json += ",\"swap\":" + legacyBool(m.swapAssignment);
+  json += ",\"controlMode\":" + std::to_string(m.controlMode);
+  json += ",\"pidKp\":" + legacyFormatFloat(m.pidKp, 4);
+  json += ",\"pidKi\":" + legacyFormatFloat(m.pidKi, 5);
+  json += ",\"pidKd\":" + legacyFormatFloat(m.pidKd, 3);
+  json += ",\"manualPowerMode\":" + std::to_string(m.manualPowerMode);
+  json += ",\"heaterOhm\":" + legacyFormatFloat(m.heaterElementOhm, 2);
+  json += ",\"manualW1\":" + legacyFormatFloat(m.manualWatts1, 1);
+  json += ",\"manualW2\":" + legacyFormatFloat(m.manualWatts2, 1);
+  json += ",\"duty1\":" + std::to_string(m.heater1DutyPermille);
+  json += ",\"duty2\":" + std::to_string(m.heater2DutyPermille);
+  json += ",\"energy1Wh\":" + legacyFormatFloat(m.heater1EnergyWh, 3);
+  json += ",\"energy2Wh\":" + legacyFormatFloat(m.heater2EnergyWh, 3);
+  json += ",\"power1W\":" + legacyFormatFloat(m.heater1MeanWatts, 1);
+  json += ",\"power2W\":" + legacyFormatFloat(m.heater2MeanWatts, 1);
+  json += ",\"runtimeLeft1Min\":" + legacyOptional(m.battery1RuntimeLeftValid, m.battery1RuntimeLeftMinutes, 0);
+  json += ",\"runtimeLeft2Min\":" + legacyOptional(m.battery2RuntimeLeftValid, m.battery2RuntimeLeftMinutes, 0);
+  json += ",\"ctlPeriodUs\":" + std::to_string(m.controlPeriodUs);
+  json += ",\"ssid\":\"" + jsonEscape(m.ssid) + "\"";
+  json += ",\"apSsid\":\"" + jsonEscape(m.apSsid) + "\"";
+  json += ",\"staIp\":\"" + jsonEscape(m.staIp) + "\"";
+  json += ",\"apTimeoutMin\":" + std::to_string(m.apAutoOffMinutes);
+  json += ",\"staConnected\":" + legacyBool(m.staConnected);
+  json += ",\"apEnabled\":" + legacyBool(m.apEnabled);
+  json += ",\"wifiRadiosDisabled\":" + legacyBool(m.wifiRadiosDisabled);
+  json += ",\"h1\":" + legacyBool(m.heater1On);
+  json += ",\"h2\":" + legacyBool(m.heater2On);
+  json += ",\"totalRuntime\":\"" + jsonEscape(m.totalRuntime) + "\"";
+  json += "}";
+  return json;
+}
+
+// The /ws form: the /status document followed by the live fields.
+std::string legacyBuildLiveStatusJson(const StatusMetrics &m) {
+  using logic_helpers::jsonEscape;
+  std::string json = legacyBuildStatusJson(m);
+  json.pop_back();
+  json += ",\"ctlTicks\":" + std::to_string(m.controlTicks);
+  json += ",\"ctlJitterMeanUs\":" + std::to_string(m.controlJitterMeanUs);
+  json += ",\"ctlJitterMaxUs\":" + std::to_string(m.controlJitterMaxUs);
+  json += ",\"ctlOverruns\":" + std::to_string(m.controlOverruns);
+  json += ",\"ctlBusyMaxUs\":" + std::to_string(m.controlBusyMaxUs);
+  json += ",\"currentRuntime\":\"" + jsonEscape(m.currentRuntime) + "\"";
+  json += "}";
+  return json;
+}
+
+StatusMetrics sampleMetrics(unsigned seed) {
+  StatusMetrics m;
+  const float f = static_cast<float>(seed);
+  setStatusText(m.modeText, (seed % 3U == 0U) ? "MANUAL H1 25% / H2 100%" : "NORMAL");
+  m.logLevelText = "INFO";
+  m.manualMode = (seed & 1U) != 0U;
+  m.manualPercent1 = static_cast<uint8_t>(seed % 101U);
+  m.manualPercent2 = static_cast<uint8_t>((seed * 7U) % 101U);
+  m.bootPinText = "LOW";
+  m.adc1MilliVolts = static_cast<uint16_t>(seed * 37U);
+  m.ntcMosfet1Valid = (seed % 4U) != 0U;
+  m.ntcMosfet1TempC = 20.0F + f * 0.137F;
+  m.mosfet1TripValid = (seed % 5U) == 0U;
+  m.mosfet1TripTempC = 80.0F + f * 0.011F;
+  m.mosfetOvertempLimitC = 80.0F;
+  m.battery1CellCount = static_cast<uint8_t>(1U + seed % 6U);
+  m.battery1PackVoltage = 3.0F + f * 0.0173F;
+  m.battery1CellVoltage = -0.004F + f * 0.0031F;
+  m.battery1SourceValid = (seed % 4U) == 1U;
+  m.battery1SourceMilliOhm = f * 1.7F;
+  m.battery2Weak = (seed % 6U) == 0U;
+  m.battery2PackVoltage = NAN;
+  m.displayTemp1 = (seed % 7U == 0U) ? -127.0F : 18.0F + f * 0.0625F;
+  m.displayTemp2 = -5.0F + f * 0.005F;
+  m.targetTemp1 = 10.0F + static_cast<float>(seed % 70U) * 0.5F;
+  m.targetTemp2 = 23.0F;
+  m.pidKp = 0.1F + f * 0.0001F;
+  m.pidKi = 0.001F * f;
+  m.pidKd = f * 0.25F;
+  m.manualPowerMode = static_cast<uint8_t>(seed & 1U);
+  m.heaterElementOhm = 0.5F + f * 0.013F;
+  m.manualWatts1 = f * 0.77F;
+  m.heater1DutyPermille = static_cast<uint16_t>(seed % 1001U);
+  m.heater1EnergyWh = static_cast<float>(seed * 1237U % 100000U) / 1000.0F;
+  m.heater2MeanWatts = f * 0.31F;
+  m.battery1RuntimeLeftValid = (seed % 3U) != 0U;
+  m.battery1RuntimeLeftMinutes = static_cast<float>(seed % 500U);
+  m.controlTicks = seed * 1000003U;
+  setStatusText(m.ssid, "Heat\"Control\\");
+  setStatusText(m.apSsid, "AP\nline");
+  setStatusText(m.staIp, "192.168.1.20");
+  setStatusText(m.totalRuntime, "12h 3m");
+  setStatusText(m.currentRuntime, "3m 2s");
+  return m;
+}
+
+}  // namespace
+
 void test_status_json_basic_fields() {
   StatusMetrics metrics;
-  metrics.modeText = "MANUAL";
+  setStatusText(metrics.modeText, "MANUAL");
   metrics.manualMode = true;
   metrics.manualPercent1 = 25;
   metrics.manualPercent2 = 50;
@@ -47,15 +235,21 @@ void test_status_json_basic_fields() {
   metrics.targetTemp1 = 24.0F;
   metrics.targetTemp2 = 22.5F;
   metrics.swapAssignment = true;
-  metrics.ssid = "HeatControl";
+  metrics.controlMode = 1;
+  metrics.pidKp = 0.1F;
+  metrics.pidKi = 0.001F;
+  metrics.heater1DutyPermille = 420;
+  metrics.controlPeriodUs = 100000;
+  metrics.controlJitterMaxUs = 850;
+  setStatusText(metrics.ssid, "HeatControl");
   metrics.apAutoOffMinutes = 10;
   metrics.staConnected = true;
   metrics.apEnabled = false;
   metrics.wifiRadiosDisabled = false;
   metrics.heater1On = true;
   metrics.heater2On = false;
-  metrics.totalRuntime = "1h 2m";
-  metrics.currentRuntime = "10m 2s";
+  setStatusText(metrics.totalRuntime, "1h 2m");
+  setStatusText(metrics.currentRuntime, "10m 2s");
 
   const std::string json = buildStatusJson(metrics);
   TEST_ASSERT_NOT_EQUAL(std::string::npos, json.find("\"mode\":\"MANUAL\""));
@@ -66,16 +260,24 @@ void test_status_json_basic_fields() {
   TEST_ASSERT_NOT_EQUAL(std::string::npos, json.find("\"staConnected\":1"));
   TEST_ASSERT_NOT_EQUAL(std::string::npos, json.find("\"h2\":0"));
   TEST_ASSERT_NOT_EQUAL(std::string::npos, json.find("\"totalRuntime\":\"1h 2m\""));
+  TEST_ASSERT_NOT_EQUAL(std::string::npos, json.find("\"controlMode\":1"));
+  TEST_ASSERT_NOT_EQUAL(std::string::npos, json.find("\"pidKp\":0.1000"));
+  TEST_ASSERT_NOT_EQUAL(std::string::npos, json.find("\"pidKi\":0.00100"));
+  TEST_ASSERT_NOT_EQUAL(std::string::npos, json.find("\"duty1\":420"));
+  TEST_ASSERT_NOT_EQUAL(std::string::npos, json.find("\"ctlPeriodUs\":100000"));
+  // Live fields go out over /ws only.
+  TEST_ASSERT_EQUAL(std::string::npos, json.find("\"ctlJitterMaxUs\""));
+  TEST_ASSERT_EQUAL(std::string::npos, json.find("\"currentRuntime\""));
 }
 
 void test_status_json_handles_zero_values() {
   StatusMetrics metrics;
-  metrics.modeText = "NORMAL";
+  setStatusText(metrics.modeText, "NORMAL");
   metrics.manualMode = false;
   metrics.manualPercent1 = 0;
   metrics.manualPercent2 = 0;
   metrics.bootPinText = "LOW";
-  metrics.ssid = "";
+  setStatusText(metrics.ssid, "");
   metrics.ntcMosfet1Valid = false;
   metrics.ntcMosfet2Valid = false;
   metrics.mosfet1TripValid = false;
@@ -87,9 +289,149 @@ void test_status_json_handles_zero_values() {
   TEST_ASSERT_NOT_EQUAL(std::string::npos, json.find("\"bootPin\":\"LOW\""));
 }
 
+void test_writer_output_is_byte_identical_to_legacy_builder() {
+  for (unsigned seed = 0; seed < 400; ++seed) {
+    const StatusMetrics metrics = sampleMetrics(seed);
+    const std::string expected = legacyBuildStatusJson(metrics);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), buildStatusJson(metrics).c_str());
+  }
+}
+
+void test_write_status_json_rejects_small_buffer() {
+  const StatusMetrics metrics = sampleMetrics(3);
+  char small[64];
+  TEST_ASSERT_EQUAL(0, writeStatusJson(metrics, small, sizeof(small)));
+}
+
+void test_delta_starts_with_full_document() {
+  const StatusMetrics metrics = sampleMetrics(5);
+  StatusFieldDigest digest = {};
+  char buffer[STATUS_JSON_MAX_BYTES];
+  uint8_t changed = 0;
+  const size_t length = writeStatusJsonDelta(metrics, digest, buffer, sizeof(buffer), &changed);
+
+  TEST_ASSERT_EQUAL_UINT8(STATUS_FIELD_COUNT, changed);
+  TEST_ASSERT_EQUAL_STRING(legacyBuildLiveStatusJson(metrics).c_str(), buffer);
+  TEST_ASSERT_EQUAL(legacyBuildLiveStatusJson(metrics).size(), length);
+  TEST_ASSERT_TRUE(digest.primed);
+}
+
+void test_delta_contains_only_changed_fields() {
+  StatusMetrics metrics = sampleMetrics(5);
+  StatusFieldDigest digest = {};
+  char buffer[STATUS_JSON_MAX_BYTES];
+  uint8_t changed = 0;
+  writeStatusJsonDelta(metrics, digest, buffer, sizeof(buffer), &changed);
+
+  TEST_ASSERT_EQUAL(2, writeStatusJsonDelta(metrics, digest, buffer, sizeof(buffer), &changed));
+  TEST_ASSERT_EQUAL_UINT8(0, changed);
+  TEST_ASSERT_EQUAL_STRING("{}", buffer);
+
+  setStatusText(metrics.modeText, "POWER");
+  metrics.heater2On = true;
+  metrics.displayTemp1 = 18.3140F;  // still renders as 18.31
+  writeStatusJsonDelta(metrics, digest, buffer, sizeof(buffer), &changed);
+  TEST_ASSERT_EQUAL_UINT8(2, changed);
+  TEST_ASSERT_EQUAL_STRING("{\"mode\":\"POWER\",\"h2\":1}", buffer);
+
+  metrics.displayTemp1 = 18.3151F;
+  setStatusText(metrics.currentRuntime, "3m 3s");
+  writeStatusJsonDelta(metrics, digest, buffer, sizeof(buffer), &changed);
+  TEST_ASSERT_EQUAL_UINT8(2, changed);
+  TEST_ASSERT_EQUAL_STRING("{\"current1\":18.32,\"currentRuntime\":\"3m 3s\"}", buffer);
+}
+
+void test_live_fields_leave_status_document_unchanged() {
+  StatusMetrics metrics = sampleMetrics(9);
+  const std::string before = buildStatusJson(metrics);
+  metrics.controlTicks += 10U;
+  metrics.controlJitterMeanUs = 120;
+  metrics.controlJitterMaxUs = 900;
+  metrics.controlOverruns = 1;
+  metrics.controlBusyMaxUs = 4200;
+  setStatusText(metrics.currentRuntime, "3m 12s");
+  TEST_ASSERT_EQUAL_STRING(before.c_str(), buildStatusJson(metrics).c_str());
+}
+
+void test_delta_overflow_keeps_digest() {
+  StatusMetrics metrics = sampleMetrics(5);
+  StatusFieldDigest digest = {};
+  char buffer[STATUS_JSON_MAX_BYTES];
+  writeStatusJsonDelta(metrics, digest, buffer, sizeof(buffer));
+
+  setStatusText(metrics.ssid, "a-much-longer-network-name");
+  char small[8];
+  uint8_t changed = 1;
+  TEST_ASSERT_EQUAL(0, writeStatusJsonDelta(metrics, digest, small, sizeof(small), &changed));
+  TEST_ASSERT_EQUAL_UINT8(0, changed);
+
+  writeStatusJsonDelta(metrics, digest, buffer, sizeof(buffer), &changed);
+  TEST_ASSERT_EQUAL_UINT8(1, changed);
+  TEST_ASSERT_EQUAL_STRING("{\"ssid\":\"a-much-longer-network-name\"}", buffer);
+}
+
+void test_status_text_fields_truncate() {
+  StatusMetrics metrics;
+  setStatusText(metrics.ssid, "0123456789abcdef0123456789abcdef-cut");
+  TEST_ASSERT_EQUAL_STRING("0123456789abcdef0123456789abcdef", metrics.ssid);
+  setStatusText(metrics.apSsid, nullptr);
+  TEST_ASSERT_EQUAL_STRING("", metrics.apSsid);
+}
+
+void test_status_json_benchmark() {
+  const StatusMetrics metrics = sampleMetrics(42);
+  constexpr int iterations = 20000;
+  size_t sink = 0;
+
+  allocationCount = 0;
+  const auto legacyStart = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    sink += legacyBuildStatusJson(metrics).size();
+  }
+  const auto legacyEnd = std::chrono::steady_clock::now();
+  const double legacyAllocs = static_cast<double>(allocationCount) / iterations;
+
+  char buffer[STATUS_JSON_MAX_BYTES];
+  allocationCount = 0;
+  const auto writerStart = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    // Includes filling the text fields the way the firmware does per render.
+    StatusMetrics filled = metrics;
+    setStatusText(filled.ssid, "HeatControl");
+    logic_helpers::formatRuntime(static_cast<unsigned long>(i), true, filled.currentRuntime,
+                                 sizeof(filled.currentRuntime));
+    sink += writeStatusJson(filled, buffer, sizeof(buffer));
+  }
+  const auto writerEnd = std::chrono::steady_clock::now();
+  const unsigned long writerAllocs = allocationCount;
+
+  const double legacyNs =
+      static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(legacyEnd - legacyStart).count()) /
+      iterations;
+  const double writerNs =
+      static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(writerEnd - writerStart).count()) /
+      iterations;
+  char message[160];
+  snprintf(message, sizeof(message), "status json: legacy %.0f ns/op %.1f allocs/op | writer %.0f ns/op %.1f allocs/op",
+           legacyNs, legacyAllocs, writerNs, static_cast<double>(writerAllocs) / iterations);
+  TEST_MESSAGE(message);
+
+  TEST_ASSERT_TRUE(sink > 0U);
+  TEST_ASSERT_EQUAL_UINT32(0, writerAllocs);
+  TEST_ASSERT_TRUE(legacyAllocs > 10.0);
+}
+
 int main() {
   UNITY_BEGIN();
   RUN_TEST(test_status_json_basic_fields);
   RUN_TEST(test_status_json_handles_zero_values);
+  RUN_TEST(test_writer_output_is_byte_identical_to_legacy_builder);
+  RUN_TEST(test_write_status_json_rejects_small_buffer);
+  RUN_TEST(test_delta_starts_with_full_document);
+  RUN_TEST(test_delta_contains_only_changed_fields);
+  RUN_TEST(test_live_fields_leave_status_document_unchanged);
+  RUN_TEST(test_delta_overflow_keeps_digest);
+  RUN_TEST(test_status_text_fields_truncate);
+  RUN_TEST(test_status_json_benchmark);
   return UNITY_END();
 }
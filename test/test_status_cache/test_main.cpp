@@ -0,0 +1,134 @@
+#include <cstring>
+
+#include <unity.h>
+
+#include "status_cache.h"
+
+using namespace HeatControl;
+
+void setUp() {}
+void tearDown() {}
+
+namespace {
+
+bool publish(StatusDocumentCache &cache, const char *text) {
+  char *buffer = cache.beginRender();
+  if (buffer == nullptr) {
+    return false;
+  }
+  const size_t length = std::strlen(text);
+  std::memcpy(buffer, text, length);
+  return cache.commitRender(length);
+}
+
+}  // namespace
+
+void test_cache_is_empty_until_first_render() {
+  StatusDocumentCache cache;
+  TEST_ASSERT_FALSE(cache.acquire().valid());
+  TEST_ASSERT_EQUAL_UINT32(0, cache.version());
+}
+
+void test_published_document_is_served_with_version() {
+  StatusDocumentCache cache;
+  TEST_ASSERT_TRUE(publish(cache, "{\"a\":1}"));
+  const StatusDocumentCache::Lease first = cache.acquire();
+  TEST_ASSERT_TRUE(first.valid());
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1}", first.data());
+  TEST_ASSERT_EQUAL(7, first.size());
+  TEST_ASSERT_EQUAL_UINT32(1, first.version());
+
+  TEST_ASSERT_TRUE(publish(cache, "{\"a\":2}"));
+  const StatusDocumentCache::Lease second = cache.acquire();
+  TEST_ASSERT_EQUAL_STRING("{\"a\":2}", second.data());
+  TEST_ASSERT_EQUAL_UINT32(2, second.version());
+  TEST_ASSERT_EQUAL_UINT32(2, cache.version());
+}
+
+void test_leased_document_survives_later_renders() {
+  StatusDocumentCache cache;
+  publish(cache, "first");
+  const StatusDocumentCache::Lease slow = cache.acquire();
+
+  // The slow client's slot is skipped; the two remaining slots alternate.
+  for (int i = 0; i < 10; ++i) {
+    TEST_ASSERT_TRUE(publish(cache, i % 2 == 0 ? "even" : "odd"));
+    TEST_ASSERT_EQUAL_STRING("first", slow.data());
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, slow.version());
+  TEST_ASSERT_EQUAL_STRING("odd", cache.acquire().data());
+}
+
+void test_render_is_refused_while_every_spare_slot_is_leased() {
+  StatusDocumentCache cache;
+  publish(cache, "one");
+  StatusDocumentCache::Lease lease1 = cache.acquire();
+  publish(cache, "two");
+  StatusDocumentCache::Lease lease2 = cache.acquire();
+  publish(cache, "three");
+
+  TEST_ASSERT_NULL(cache.beginRender());
+  TEST_ASSERT_EQUAL_STRING("three", cache.acquire().data());
+
+  // Releasing either lease frees its slot again.
+  lease1 = StatusDocumentCache::Lease();
+  TEST_ASSERT_TRUE(publish(cache, "four"));
+  TEST_ASSERT_EQUAL_STRING("two", lease2.data());
+}
+
+void test_copied_leases_keep_the_slot_until_all_are_gone() {
+  StatusDocumentCache cache;
+  publish(cache, "held");
+  StatusDocumentCache::Lease *copy = nullptr;
+  {
+    const StatusDocumentCache::Lease original = cache.acquire();
+    copy = new StatusDocumentCache::Lease(original);
+  }
+  publish(cache, "b");
+  publish(cache, "c");
+  publish(cache, "d");
+  TEST_ASSERT_EQUAL_STRING("held", copy->data());
+  delete copy;
+  publish(cache, "e");
+  publish(cache, "f");
+  TEST_ASSERT_EQUAL_STRING("f", cache.acquire().data());
+}
+
+void test_oversized_or_empty_render_is_discarded() {
+  StatusDocumentCache cache;
+  publish(cache, "keep");
+  TEST_ASSERT_NOT_NULL(cache.beginRender());
+  TEST_ASSERT_FALSE(cache.commitRender(STATUS_DOC_CAPACITY));
+  TEST_ASSERT_NOT_NULL(cache.beginRender());
+  TEST_ASSERT_FALSE(cache.commitRender(0));
+  TEST_ASSERT_FALSE(cache.commitRender(4));
+  TEST_ASSERT_EQUAL_STRING("keep", cache.acquire().data());
+  TEST_ASSERT_EQUAL_UINT32(1, cache.version());
+}
+
+void test_identical_render_keeps_the_version() {
+  StatusDocumentCache cache;
+  publish(cache, "{\"a\":1}");
+  const StatusDocumentCache::Lease first = cache.acquire();
+  TEST_ASSERT_TRUE(publish(cache, "{\"a\":1}"));
+  TEST_ASSERT_EQUAL_UINT32(1, cache.version());
+  TEST_ASSERT_EQUAL_UINT32(1, cache.acquire().version());
+  TEST_ASSERT_TRUE(first.data() == cache.acquire().data());
+
+  // A prefix of the current document is a different document.
+  TEST_ASSERT_TRUE(publish(cache, "{\"a\""));
+  TEST_ASSERT_EQUAL_UINT32(2, cache.version());
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1}", first.data());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_cache_is_empty_until_first_render);
+  RUN_TEST(test_published_document_is_served_with_version);
+  RUN_TEST(test_leased_document_survives_later_renders);
+  RUN_TEST(test_render_is_refused_while_every_spare_slot_is_leased);
+  RUN_TEST(test_copied_leases_keep_the_slot_until_all_are_gone);
+  RUN_TEST(test_oversized_or_empty_render_is_discarded);
+  RUN_TEST(test_identical_render_keeps_the_version);
+  return UNITY_END();
+}
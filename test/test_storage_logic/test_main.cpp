@@ -1,3 +1,5 @@
+#include <cmath>
+
 #include <unity.h>
 
 #include "storage_logic.h"
@@ -65,6 +67,21 @@ void test_battery_chemistry_clamp() {
   TEST_ASSERT_EQUAL_UINT8(BATTERY_CHEMISTRY_LI_ION, clampBatteryChemistry(9));
 }
 
+void test_pid_gain_clamp() {
+  TEST_ASSERT_EQUAL_FLOAT(0.2F, clampPidGain(0.2F, PID_KP_MAX, 0.1F));
+  TEST_ASSERT_EQUAL_FLOAT(0.0F, clampPidGain(0.0F, PID_KP_MAX, 0.1F));
+  TEST_ASSERT_EQUAL_FLOAT(PID_KP_MAX, clampPidGain(50.0F, PID_KP_MAX, 0.1F));
+  TEST_ASSERT_EQUAL_FLOAT(0.1F, clampPidGain(-1.0F, PID_KP_MAX, 0.1F));
+  TEST_ASSERT_EQUAL_FLOAT(0.1F, clampPidGain(NAN, PID_KP_MAX, 0.1F));
+}
+
+void test_heater_element_ohm_clamp() {
+  TEST_ASSERT_EQUAL_FLOAT(4.7F, clampHeaterElementOhm(4.7F));
+  TEST_ASSERT_EQUAL_FLOAT(HEATER_ELEMENT_OHM_MIN, clampHeaterElementOhm(0.0F));
+  TEST_ASSERT_EQUAL_FLOAT(HEATER_ELEMENT_OHM_MAX, clampHeaterElementOhm(1000.0F));
+  TEST_ASSERT_EQUAL_FLOAT(HEATER_ELEMENT_OHM_DEFAULT, clampHeaterElementOhm(NAN));
+}
+
 int main() {
   UNITY_BEGIN();
   RUN_TEST(test_clamp_target_limits);
@@ -76,5 +93,7 @@ int main() {
   RUN_TEST(test_ap_auto_off_minutes_clamp);
   RUN_TEST(test_battery_cell_clamp);
   RUN_TEST(test_battery_chemistry_clamp);
+  RUN_TEST(test_pid_gain_clamp);
+  RUN_TEST(test_heater_element_ohm_clamp);
   return UNITY_END();
 }
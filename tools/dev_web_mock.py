@@ -72,10 +72,12 @@ class MockState:
             f"[{_now_iso()}] INFO Mock server started",
             f"[{_now_iso()}] INFO This is not real firmware",
         ]
+        self.log_first_seq = 0
 
     def add_log(self, level: str, message: str) -> None:
         self.log_lines.append(f"[{_now_iso()}] {level.upper()} {message}")
         if len(self.log_lines) > 400:
+            self.log_first_seq += len(self.log_lines) - 400
             self.log_lines = self.log_lines[-400:]
 
 
@@ -103,11 +105,15 @@ class Handler(BaseHTTPRequestHandler):
     def log_message(self, fmt: str, *args) -> None:
         STATE.add_log("debug", fmt % args)
 
-    def _send_bytes(self, status: int, data: bytes, content_type: str) -> None:
+    def _send_bytes(
+        self, status: int, data: bytes, content_type: str, headers: dict[str, str] | None = None
+    ) -> None:
         self.send_response(status)
         self.send_header("Content-Type", content_type)
         self.send_header("Content-Length", str(len(data)))
         self.send_header("Cache-Control", "no-store")
+        for name, value in (headers or {}).items():
+            self.send_header(name, value)
         self.end_headers()
         self.wfile.write(data)
 
@@ -178,15 +184,80 @@ class Handler(BaseHTTPRequestHandler):
         self._send_bytes(HTTPStatus.OK, data, ctype)
 
     def do_GET(self) -> None:
-        path = urllib.parse.urlparse(self.path).path
+        parsed_url = urllib.parse.urlparse(self.path)
+        path = parsed_url.path
         if self._handle_mock_get(path):
             return
         if path == "/status":
             self._send_json(HTTPStatus.OK, STATE.data)
             return
         if path == "/logs":
-            text = "\n".join(STATE.log_lines) + "\n"
-            self._send_bytes(HTTPStatus.OK, text.encode("utf-8"), "text/plain; charset=utf-8")
+            query = urllib.parse.parse_qs(parsed_url.query)
+            try:
+                since = int(query.get("since", ["0"])[0])
+            except ValueError:
+                since = 0
+            lines = STATE.log_lines[max(0, since - STATE.log_first_seq) :]
+            text = "".join(line + "\n" for line in lines)
+            headers = {
+                "X-Log-First": str(STATE.log_first_seq),
+                "X-Log-Next": str(STATE.log_first_seq + len(STATE.log_lines)),
+            }
+            self._send_bytes(HTTPStatus.OK, text.encode("utf-8"), "text/plain; charset=utf-8", headers)
+            return
+        if path == "/ota/status":
+            self._send_json(
+                HTTPStatus.OK,
+                {
+                    "state": "idle",
+                    "message": "",
+                    "format": "unknown",
+                    "declaredBytes": 0,
+                    "receivedBytes": 0,
+                    "imageBytes": 0,
+                    "writtenBytes": 0,
+                    "progressPermille": None,
+                    "bytesPerSecond": 0,
+                    "elapsedMs": 0,
+                    "chunks": 0,
+                    "chunkMeanUs": 0,
+                    "chunkMaxUs": 0,
+                    "blocks": 0,
+                    "checksumExpected": 0,
+                    "checksumVerified": 0,
+                    "sinkError": 0,
+                    "sha256": None,
+                },
+            )
+            return
+        if path == "/storage/status":
+            self._send_json(
+                HTTPStatus.OK,
+                {
+                    "backend": "partition",
+                    "sectors": 16,
+                    "activeSector": 3,
+                    "usedBytes": 412,
+                    "keys": 30,
+                    "generation": 4,
+                    "minEraseCount": 0,
+                    "maxEraseCount": 1,
+                    "commits": 2,
+                    "compactions": 0,
+                    "bytesWritten": 32,
+                    "lastCommitUs": 180,
+                    "maxCommitUs": 210,
+                    "mountUs": 1900,
+                    "droppedBatches": 0,
+                    "flashErrors": 0,
+                    "persistPending": 0,
+                    "persistMarks": 5,
+                    "persistFlushes": 2,
+                    "persistLastFields": 1,
+                    "persistLastFlushUs": 240,
+                    "persistMaxFlushUs": 310,
+                },
+            )
             return
         if path == "/update":
             update_page = os.path.join(UPLOAD_DIR, "update.html")
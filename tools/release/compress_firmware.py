@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""Compress a firmware image for OTA upload (heatshrink LZSS stream with a small header).
+
+The device inflates the stream on the fly with a 2^window_bits byte window (src/heatshrink.h, at
+most 12 bits) and checks the embedded SHA-256 of the original image before activating it.
+
+Header (little endian, 44 bytes):
+  0  magic "HCHS"
+  4  window bits
+  5  lookahead bits
+  6  reserved (0, 2 bytes)
+  8  original image size (uint32)
+  12 SHA-256 of the original image (32 bytes)
+"""
+
+from __future__ import annotations
+
+import argparse
+import hashlib
+from pathlib import Path
+import struct
+import sys
+import time
+
+
+MAGIC = b"HCHS"
+HEADER = struct.Struct("<4sBBHI32s")
+DEFAULT_WINDOW_BITS = 12
+DEFAULT_LOOKAHEAD_BITS = 4
+MAX_CHAIN = 256
+
+
+class BitWriter:
+    def __init__(self) -> None:
+        self.out = bytearray()
+        self.acc = 0
+        self.bits = 0
+
+    def put(self, value: int, count: int) -> None:
+        self.acc = (self.acc << count) | value
+        self.bits += count
+        while self.bits >= 8:
+            self.bits -= 8
+            self.out.append((self.acc >> self.bits) & 0xFF)
+        self.acc &= (1 << self.bits) - 1
+
+    def flush(self) -> bytes:
+        if self.bits:
+            self.out.append((self.acc << (8 - self.bits)) & 0xFF)
+            self.acc = 0
+            self.bits = 0
+        return bytes(self.out)
+
+
+def longest_matches(data: bytes, window_bits: int, lookahead_bits: int) -> tuple[list[int], list[int]]:
+    """Longest earlier match (length, distance) for every position, found through 2-byte hash chains."""
+    window = 1 << window_bits
+    max_len = 1 << lookahead_bits
+    size = len(data)
+    lengths = [0] * size
+    distances = [0] * size
+    heads: dict[int, int] = {}
+    prev = [-1] * size
+    for i in range(size - 1):
+        key = data[i] | (data[i + 1] << 8)
+        candidate = heads.get(key, -1)
+        prev[i] = candidate
+        heads[key] = i
+        limit = min(max_len, size - i)
+        best_len = 0
+        best_dist = 0
+        chain = 0
+        while candidate >= 0 and i - candidate <= window and chain < MAX_CHAIN:
+            length = 2
+            while length < limit and data[candidate + length] == data[i + length]:
+                length += 1
+            if length > best_len:
+                best_len = length
+                best_dist = i - candidate
+                if length == limit:
+                    break
+            candidate = prev[candidate]
+            chain += 1
+        lengths[i] = best_len
+        distances[i] = best_dist
+    return lengths, distances
+
+
+def compress(data: bytes, window_bits: int = DEFAULT_WINDOW_BITS, lookahead_bits: int = DEFAULT_LOOKAHEAD_BITS) -> bytes:
+    if not 8 <= window_bits <= 15 or not 3 <= lookahead_bits < window_bits:
+        raise ValueError("window bits must be 8..15 and lookahead bits 3..window-1")
+    lengths, distances = longest_matches(data, window_bits, lookahead_bits)
+    literal_cost = 9
+    backref_cost = 1 + window_bits + lookahead_bits
+
+    # Cheapest parse from every position to the end; a match may be cut short to fit the next one.
+    size = len(data)
+    cost = [0] * (size + 1)
+    step = [1] * (size + 1)
+    for i in range(size - 1, -1, -1):
+        best = cost[i + 1] + literal_cost
+        best_step = 1
+        for length in range(2, lengths[i] + 1):
+            candidate = cost[i + length] + backref_cost
+            if candidate < best:
+                best = candidate
+                best_step = length
+        cost[i] = best
+        step[i] = best_step
+
+    writer = BitWriter()
+    i = 0
+    while i < size:
+        length = step[i]
+        if length == 1:
+            writer.put(1, 1)
+            writer.put(data[i], 8)
+        else:
+            writer.put(0, 1)
+            writer.put(distances[i] - 1, window_bits)
+            writer.put(length - 1, lookahead_bits)
+        i += length
+    body = writer.flush()
+    header = HEADER.pack(MAGIC, window_bits, lookahead_bits, 0, size, hashlib.sha256(data).digest())
+    return header + body
+
+
+def decompress(blob: bytes) -> bytes:
+    magic, window_bits, lookahead_bits, _, size, digest = HEADER.unpack_from(blob)
+    if magic != MAGIC:
+        raise ValueError("not a compressed firmware image")
+    bits = "".join(f"{b:08b}" for b in blob[HEADER.size :])
+    out = bytearray()
+    pos = 0
+
+    def take(count: int) -> int:
+        nonlocal pos
+        value = int(bits[pos : pos + count], 2)
+        pos += count
+        return value
+
+    while len(out) < size:
+        if take(1):
+            out.append(take(8))
+        else:
+            distance = take(window_bits) + 1
+            for _ in range(take(lookahead_bits) + 1):
+                out.append(out[-distance])
+    if len(out) != size or hashlib.sha256(out).digest() != digest:
+        raise ValueError("round trip mismatch")
+    return bytes(out)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", type=Path)
+    parser.add_argument("output", type=Path, nargs="?", help="default: <input>.hs")
+    parser.add_argument("--window-bits", type=int, default=DEFAULT_WINDOW_BITS)
+    parser.add_argument("--lookahead-bits", type=int, default=DEFAULT_LOOKAHEAD_BITS)
+    parser.add_argument("--verify", action="store_true", help="decompress again and compare")
+    args = parser.parse_args()
+
+    data = args.input.read_bytes()
+    output = args.output or args.input.with_name(args.input.name + ".hs")
+    started = time.monotonic()
+    blob = compress(data, args.window_bits, args.lookahead_bits)
+    elapsed = time.monotonic() - started
+    if args.verify:
+        decompress(blob)
+    output.write_bytes(blob)
+    print(
+        f"{args.input} -> {output}: {len(data)} -> {len(blob)} bytes "
+        f"({100.0 * len(blob) / max(1, len(data)):.1f} %, w={args.window_bits} l={args.lookahead_bits}, {elapsed:.1f} s)"
+    )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())